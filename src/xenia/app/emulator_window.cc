@@ -9,6 +9,7 @@
 
 #include "xenia/app/emulator_window.h"
 
+#include <algorithm>
 #include <filesystem>
 #include <functional>
 #include <memory>
@@ -36,6 +37,8 @@
 #include "xenia/gpu/d3d12/d3d12_command_processor.h"
 #include "xenia/gpu/graphics_system.h"
 #include "xenia/hid/input_system.h"
+#include "xenia/kernel/kernel_flags.h"
+#include "xenia/kernel/util/export_profiler.h"
 #include "xenia/kernel/xam/xam_module.h"
 #include "xenia/ui/file_picker.h"
 #include "xenia/ui/graphics_provider.h"
@@ -293,6 +296,138 @@ void EmulatorWindow::DisplayConfigGameConfigLoadCallback::PostGameConfigLoad() {
   emulator_window_.ApplyDisplayConfigForCvars();
 }
 
+void EmulatorWindow::KernelExportProfileDialog::OnDraw(ImGuiIO& io) {
+  ImGui::SetNextWindowPos(ImVec2(20, 20), ImGuiCond_FirstUseEver);
+  ImGui::SetNextWindowBgAlpha(0.6f);
+  bool dialog_open = true;
+  if (!ImGui::Begin("Kernel Export Profile", &dialog_open,
+                    ImGuiWindowFlags_NoCollapse |
+                        ImGuiWindowFlags_AlwaysAutoResize)) {
+    ImGui::End();
+    return;
+  }
+
+  bool profile = cvars::profile_kernel_exports;
+  if (ImGui::Checkbox("Profile kernel exports", &profile)) {
+    OVERRIDE_bool(profile_kernel_exports, profile);
+  }
+  ImGui::SameLine();
+  if (ImGui::Button("Reset")) {
+    kernel::ExportProfiler::Reset();
+  }
+  ImGui::SameLine();
+  if (ImGui::Button("Dump to log")) {
+    kernel::ExportProfiler::Dump();
+  }
+  ImGui::Spacing();
+
+  std::vector<kernel::ExportProfiler::ExportStatistics> statistics =
+      kernel::ExportProfiler::GetStatistics();
+  if (statistics.empty()) {
+    ImGui::TextUnformatted("No calls profiled.");
+  } else {
+    constexpr size_t kMaxExportCount = 32;
+    ImGui::Columns(7);
+    ImGui::TextUnformatted("Export");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("Calls");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("Total ms");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("Average us");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("p50 us");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("p99 us");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("Max us");
+    ImGui::NextColumn();
+    ImGui::Separator();
+    for (size_t i = 0; i < std::min(statistics.size(), kMaxExportCount);
+         ++i) {
+      const kernel::ExportProfiler::ExportStatistics& export_statistics =
+          statistics[i];
+      ImGui::TextUnformatted(export_statistics.export_entry->name);
+      ImGui::NextColumn();
+      ImGui::TextUnformatted(
+          fmt::format("{}", export_statistics.call_count).c_str());
+      ImGui::NextColumn();
+      ImGui::Text("%.3f", double(export_statistics.total_ns) / 1e6);
+      ImGui::NextColumn();
+      ImGui::Text("%.2f", double(export_statistics.total_ns) / 1e3 /
+                              double(export_statistics.call_count));
+      ImGui::NextColumn();
+      ImGui::Text("<= %.2f", double(export_statistics.p50_ns) / 1e3);
+      ImGui::NextColumn();
+      ImGui::Text("<= %.2f", double(export_statistics.p99_ns) / 1e3);
+      ImGui::NextColumn();
+      ImGui::Text("%.2f", double(export_statistics.max_ns) / 1e3);
+      ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+  }
+
+  ImGui::End();
+
+  if (!dialog_open) {
+    emulator_window_.ToggleKernelExportProfileDialog();
+    // `this` might have been destroyed by ToggleKernelExportProfileDialog.
+    return;
+  }
+}
+
+void EmulatorWindow::GpuProfileDialog::OnDraw(ImGuiIO& io) {
+  ImGui::SetNextWindowPos(ImVec2(20, 20), ImGuiCond_FirstUseEver);
+  ImGui::SetNextWindowBgAlpha(0.6f);
+  bool dialog_open = true;
+  if (!ImGui::Begin("GPU Timestamp Profile", &dialog_open,
+                    ImGuiWindowFlags_NoCollapse |
+                        ImGuiWindowFlags_AlwaysAutoResize)) {
+    ImGui::End();
+    return;
+  }
+
+  gpu::GraphicsSystem* graphics_system =
+      emulator_window_.emulator_->graphics_system();
+  gpu::CommandProcessor* command_processor =
+      graphics_system ? graphics_system->command_processor() : nullptr;
+  std::vector<std::pair<const char*, double>> profile;
+  if (!command_processor || !command_processor->GetGpuProfile(profile)) {
+    ImGui::TextUnformatted(
+        "GPU time profiling is not available. It requires the Vulkan GPU "
+        "backend,\nwith vulkan_gpu_timestamps enabled.");
+  } else {
+    double total_us = 0.0;
+    ImGui::Columns(2);
+    ImGui::TextUnformatted("Category");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("Last frame us");
+    ImGui::NextColumn();
+    ImGui::Separator();
+    for (const auto& category : profile) {
+      ImGui::TextUnformatted(category.first);
+      ImGui::NextColumn();
+      ImGui::Text("%.2f", category.second);
+      ImGui::NextColumn();
+      total_us += category.second;
+    }
+    ImGui::Separator();
+    ImGui::TextUnformatted("Total");
+    ImGui::NextColumn();
+    ImGui::Text("%.2f", total_us);
+    ImGui::NextColumn();
+    ImGui::Columns(1);
+  }
+
+  ImGui::End();
+
+  if (!dialog_open) {
+    emulator_window_.ToggleGpuProfileDialog();
+    // `this` might have been destroyed by ToggleGpuProfileDialog.
+    return;
+  }
+}
+
 void EmulatorWindow::DisplayConfigDialog::OnDraw(ImGuiIO& io) {
   gpu::GraphicsSystem* graphics_system =
       emulator_window_.emulator_->graphics_system();
@@ -613,6 +748,12 @@ bool EmulatorWindow::Initialize() {
     cpu_menu->AddChild(MenuItem::Create(MenuItem::Type::kString,
                                         "&Pause/Resume Profiler", "`",
                                         []() { Profiler::TogglePause(); }));
+    cpu_menu->AddChild(MenuItem::Create(
+        MenuItem::Type::kString, "Show &Kernel Export Profile",
+        std::bind(&EmulatorWindow::ToggleKernelExportProfileDialog, this)));
+    cpu_menu->AddChild(MenuItem::Create(
+        MenuItem::Type::kString, "Dump Kernel Export Profile",
+        std::bind(&EmulatorWindow::DumpKernelExportProfile, this)));
   }
   cpu_menu->AddChild(MenuItem::Create(MenuItem::Type::kSeparator));
   {
@@ -632,6 +773,9 @@ bool EmulatorWindow::Initialize() {
     gpu_menu->AddChild(
         MenuItem::Create(MenuItem::Type::kString, "&Trace Frame", "F4",
                          std::bind(&EmulatorWindow::GpuTraceFrame, this)));
+    gpu_menu->AddChild(MenuItem::Create(
+        MenuItem::Type::kString, "Show GPU Timestamp &Profile",
+        std::bind(&EmulatorWindow::ToggleGpuProfileDialog, this)));
   }
   gpu_menu->AddChild(MenuItem::Create(MenuItem::Type::kSeparator));
   {
@@ -854,16 +998,22 @@ void EmulatorWindow::OnKeyDown(ui::KeyEvent& e) {
 
 #ifdef DEBUG
     case ui::VirtualKey::kF7: {
-      // Save to file
+      // Save to file, with Shift, only the memory changed since the last full
+      // save or restore.
       // TODO: Choose path based on user input, or from options
       // TODO: Spawn a new thread to do this.
-      emulator()->SaveToFile("test.sav");
+      if (e.is_shift_pressed()) {
+        emulator()->SaveToFile("test_incremental.sav", true);
+      } else {
+        emulator()->SaveToFile("test.sav");
+      }
     } break;
     case ui::VirtualKey::kF8: {
       // Restore from file
       // TODO: Choose path from user
       // TODO: Spawn a new thread to do this.
-      emulator()->RestoreFromFile("test.sav");
+      emulator()->RestoreFromFile(e.is_shift_pressed() ? "test_incremental.sav"
+                                                       : "test.sav");
     } break;
 #endif  // #ifdef DEBUG
 
@@ -1301,6 +1451,15 @@ void EmulatorWindow::GpuClearCaches() {
   emulator()->graphics_system()->ClearCaches();
 }
 
+void EmulatorWindow::ToggleGpuProfileDialog() {
+  if (!gpu_profile_dialog_) {
+    gpu_profile_dialog_ = std::unique_ptr<GpuProfileDialog>(
+        new GpuProfileDialog(imgui_drawer_.get(), *this));
+  } else {
+    gpu_profile_dialog_.reset();
+  }
+}
+
 void EmulatorWindow::SetFullscreen(bool fullscreen) {
   if (window_->IsFullscreen() == fullscreen) {
     return;
@@ -1324,6 +1483,22 @@ void EmulatorWindow::ToggleDisplayConfigDialog() {
   }
 }
 
+void EmulatorWindow::ToggleKernelExportProfileDialog() {
+  if (!kernel_export_profile_dialog_) {
+    kernel_export_profile_dialog_ = std::unique_ptr<KernelExportProfileDialog>(
+        new KernelExportProfileDialog(imgui_drawer_.get(), *this));
+  } else {
+    kernel_export_profile_dialog_.reset();
+  }
+}
+
+void EmulatorWindow::DumpKernelExportProfile() {
+  if (!cvars::profile_kernel_exports) {
+    XELOGW("Kernel export profiling is disabled (profile_kernel_exports)");
+  }
+  kernel::ExportProfiler::Dump();
+}
+
 void EmulatorWindow::ToggleControllerVibration() {
   auto input_sys = emulator()->input_system();
   if (input_sys) {
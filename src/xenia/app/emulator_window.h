@@ -183,6 +183,34 @@ class EmulatorWindow {
     EmulatorWindow& emulator_window_;
   };
 
+  // Overlay listing the kernel exports with the most total time.
+  class KernelExportProfileDialog final : public ui::ImGuiDialog {
+   public:
+    KernelExportProfileDialog(ui::ImGuiDrawer* imgui_drawer,
+                              EmulatorWindow& emulator_window)
+        : ui::ImGuiDialog(imgui_drawer), emulator_window_(emulator_window) {}
+
+   protected:
+    void OnDraw(ImGuiIO& io) override;
+
+   private:
+    EmulatorWindow& emulator_window_;
+  };
+
+  // Overlay showing the host GPU time spent on each category of work.
+  class GpuProfileDialog final : public ui::ImGuiDialog {
+   public:
+    GpuProfileDialog(ui::ImGuiDrawer* imgui_drawer,
+                     EmulatorWindow& emulator_window)
+        : ui::ImGuiDialog(imgui_drawer), emulator_window_(emulator_window) {}
+
+   protected:
+    void OnDraw(ImGuiIO& io) override;
+
+   private:
+    EmulatorWindow& emulator_window_;
+  };
+
   explicit EmulatorWindow(Emulator* emulator,
                           ui::WindowedAppContext& app_context, uint32_t width,
                           uint32_t height);
@@ -221,8 +249,11 @@ class EmulatorWindow {
   void CpuTimeScalarSetDouble();
   void CpuBreakIntoDebugger();
   void CpuBreakIntoHostDebugger();
+  void ToggleKernelExportProfileDialog();
+  void DumpKernelExportProfile();
   void GpuTraceFrame();
   void GpuClearCaches();
+  void ToggleGpuProfileDialog();
   void ToggleDisplayConfigDialog();
   void ToggleControllerVibration();
   void ShowCompatibility();
@@ -262,6 +293,8 @@ class EmulatorWindow {
   bool initializing_shader_storage_ = false;
 
   std::unique_ptr<DisplayConfigDialog> display_config_dialog_;
+  std::unique_ptr<KernelExportProfileDialog> kernel_export_profile_dialog_;
+  std::unique_ptr<GpuProfileDialog> gpu_profile_dialog_;
 
   std::vector<RecentTitleEntry> recently_launched_titles_;
 };
@@ -9,6 +9,8 @@
 
 #include "xenia/apu/xma_decoder.h"
 
+#include <algorithm>
+
 #include "xenia/apu/xma_context.h"
 #include "xenia/apu/xma_context_new.h"
 #include "xenia/apu/xma_context_old.h"
@@ -62,6 +64,12 @@ DEFINE_bool(use_dedicated_xma_thread, true,
             "better results, but decrease performance a bit.",
             "APU");
 
+DEFINE_int32(xma_decoder_threads, -1,
+             "Number of additional threads decoding XMA contexts kicked at the "
+             "same time along with the XMA decoder thread. -1 to calculate "
+             "automatically (a quarter of logical CPU cores, up to 3).",
+             "APU");
+
 namespace xe {
 namespace apu {
 
@@ -172,22 +180,33 @@ X_STATUS XmaDecoder::Setup(kernel::KernelState* kernel_state) {
   worker_thread_->set_can_debugger_suspend(true);
   worker_thread_->Create();
 
+  if (cvars::use_dedicated_xma_thread) {
+    uint32_t decoder_thread_count;
+    if (cvars::xma_decoder_threads < 0) {
+      decoder_thread_count =
+          std::min(xe::threading::logical_processor_count() / 4, uint32_t(3));
+    } else {
+      decoder_thread_count = uint32_t(cvars::xma_decoder_threads);
+    }
+    xe::threading::Thread::CreationParameters thread_params;
+    for (uint32_t i = 0; i < decoder_thread_count; ++i) {
+      std::unique_ptr<xe::threading::Thread> decoder_thread =
+          xe::threading::Thread::Create(thread_params,
+                                        [this]() { DecoderThreadMain(); });
+      assert_not_null(decoder_thread);
+      decoder_thread->set_name("XMA Decoder Worker");
+      decoder_threads_.push_back(std::move(decoder_thread));
+    }
+  }
+
   return X_STATUS_SUCCESS;
 }
 
 void XmaDecoder::WorkerThreadMain() {
   uint32_t idle_loop_count = 0;
   while (worker_running_) {
-    // Okay, let's loop through XMA contexts to find ones we need to decode!
-    bool did_work = false;
-    for (uint32_t n = 0; n < kContextCount; n++) {
-      did_work = contexts_[n]->Work() || did_work;
-
-      // TODO: Need thread safety to do this.
-      // Probably not too important though.
-      // registers_.current_context = n;
-      // registers_.next_context = (n + 1) % kContextCount;
-    }
+    // Okay, let's go through the kicked XMA contexts and decode them!
+    bool did_work = WorkActiveContexts();
 
     if (paused_) {
       pause_fence_.Signal();
@@ -203,6 +222,79 @@ void XmaDecoder::WorkerThreadMain() {
   }
 }
 
+bool XmaDecoder::WorkActiveContexts() {
+  pending_context_count_ = 0;
+  for (uint32_t i = 0; i < xe::countof(active_contexts_); ++i) {
+    uint64_t active_contexts =
+        active_contexts_[i].exchange(0, std::memory_order_acq_rel);
+    while (active_contexts) {
+      pending_contexts_[pending_context_count_++] =
+          uint16_t(i * 64 + xe::tzcnt(active_contexts));
+      active_contexts &= active_contexts - 1;
+    }
+  }
+  if (!pending_context_count_) {
+    return false;
+  }
+  next_pending_context_.store(0, std::memory_order_relaxed);
+
+  if (pending_context_count_ == 1 || decoder_threads_.empty()) {
+    WorkPendingContexts();
+    return true;
+  }
+
+  // Contexts are independent, decode them on the decoder threads too.
+  {
+    std::lock_guard<xe_mutex> lock(decoder_lock_);
+    ++decoder_generation_;
+    running_decoder_thread_count_ = uint32_t(decoder_threads_.size());
+  }
+  decoder_cond_.notify_all();
+  WorkPendingContexts();
+  std::unique_lock<xe_mutex> lock(decoder_lock_);
+  while (running_decoder_thread_count_) {
+    decoder_cond_.wait(lock);
+  }
+  return true;
+}
+
+void XmaDecoder::WorkPendingContexts() {
+  uint32_t pending_context_index;
+  while ((pending_context_index = next_pending_context_.fetch_add(
+              1, std::memory_order_relaxed)) < pending_context_count_) {
+    contexts_[pending_contexts_[pending_context_index]]->Work();
+
+    // TODO: Need thread safety to do this.
+    // Probably not too important though.
+    // registers_.current_context = n;
+    // registers_.next_context = (n + 1) % kContextCount;
+  }
+}
+
+void XmaDecoder::DecoderThreadMain() {
+  uint64_t generation = 0;
+  while (true) {
+    {
+      std::unique_lock<xe_mutex> lock(decoder_lock_);
+      while (!decoder_threads_shutdown_ &&
+             decoder_generation_ == generation) {
+        decoder_cond_.wait(lock);
+      }
+      if (decoder_threads_shutdown_) {
+        return;
+      }
+      generation = decoder_generation_;
+    }
+    WorkPendingContexts();
+    {
+      std::lock_guard<xe_mutex> lock(decoder_lock_);
+      if (!--running_decoder_thread_count_) {
+        decoder_cond_.notify_all();
+      }
+    }
+  }
+}
+
 void XmaDecoder::Shutdown() {
   worker_running_ = false;
 
@@ -220,6 +312,17 @@ void XmaDecoder::Shutdown() {
     worker_thread_.reset();
   }
 
+  {
+    std::lock_guard<xe_mutex> lock(decoder_lock_);
+    decoder_threads_shutdown_ = true;
+  }
+  decoder_cond_.notify_all();
+  for (const std::unique_ptr<xe::threading::Thread>& decoder_thread :
+       decoder_threads_) {
+    xe::threading::Wait(decoder_thread.get(), false);
+  }
+  decoder_threads_.clear();
+
   if (context_data_first_ptr_) {
     memory()->SystemHeapFree(context_data_first_ptr_);
   }
@@ -328,7 +431,10 @@ void XmaDecoder::WriteRegister(uint32_t addr, uint32_t value) {
         uint32_t context_id = base_context_id + i;
         auto& context = *contexts_[context_id];
         context.Enable();
-        if (!cvars::use_dedicated_xma_thread) {
+        if (cvars::use_dedicated_xma_thread) {
+          active_contexts_[context_id / 64].fetch_or(
+              uint64_t(1) << (context_id % 64), std::memory_order_acq_rel);
+        } else {
           context.Work();
         }
       }
@@ -11,12 +11,17 @@
 #define XENIA_APU_XMA_DECODER_H_
 
 #include <atomic>
+#include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <queue>
+#include <vector>
 
 #include "xenia/apu/xma_context.h"
 #include "xenia/apu/xma_register_file.h"
 #include "xenia/base/bit_map.h"
+#include "xenia/base/mutex.h"
+#include "xenia/base/threading.h"
 #include "xenia/kernel/xthread.h"
 #include "xenia/xbox.h"
 
@@ -56,6 +61,11 @@ class XmaDecoder {
 
  private:
   void WorkerThreadMain();
+  // Decodes the contexts kicked since the last call, returns whether there were
+  // any.
+  bool WorkActiveContexts();
+  void WorkPendingContexts();
+  void DecoderThreadMain();
 
   static uint32_t MMIOReadRegisterThunk(void* ppc_context, XmaDecoder* as,
                                         uint32_t addr) {
@@ -84,6 +94,22 @@ class XmaDecoder {
   XmaContext* contexts_[kContextCount];
   BitMap context_bitmap_;
 
+  // Contexts kicked since the worker thread has last collected them, so idle
+  // contexts are not visited.
+  std::atomic<uint64_t> active_contexts_[kContextCount / 64] = {};
+  // Contexts collected by the worker thread, decoded by it together with the
+  // decoder threads.
+  uint16_t pending_contexts_[kContextCount];
+  uint32_t pending_context_count_ = 0;
+  std::atomic<uint32_t> next_pending_context_ = {0};
+
+  std::vector<std::unique_ptr<xe::threading::Thread>> decoder_threads_;
+  xe_mutex decoder_lock_;
+  std::condition_variable_any decoder_cond_;
+  uint64_t decoder_generation_ = 0;
+  uint32_t running_decoder_thread_count_ = 0;
+  bool decoder_threads_shutdown_ = false;
+
   uint32_t context_data_first_ptr_ = 0;
   uint32_t context_data_last_ptr_ = 0;
 };
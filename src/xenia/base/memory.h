@@ -10,13 +10,17 @@
 #ifndef XENIA_BASE_MEMORY_H_
 #define XENIA_BASE_MEMORY_H_
 
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <filesystem>
 #include <functional>
+#include <memory>
 #include <string>
 #include <string_view>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "xenia/base/byte_order.h"
 
@@ -156,6 +160,38 @@ void* MapFileView(FileMappingHandle handle, void* base_address, size_t length,
                   PageAccess access, size_t file_offset);
 bool UnmapFileView(FileMappingHandle handle, void* base_address, size_t length);
 
+#if XE_PLATFORM_LINUX
+// Tracking of writes to pages by the host kernel itself, without delivering an
+// access violation for the first write to every page, using asynchronous
+// userfaultfd write protection and PAGEMAP_SCAN (Linux 6.7+).
+class WriteWatch {
+ public:
+  ~WriteWatch();
+
+  // Returns nullptr if not supported by the host.
+  static std::unique_ptr<WriteWatch> Create();
+
+  // Starts (or restarts) tracking writes to the pages in the range, which must
+  // be mapped. Must be called again after the range has been remapped.
+  bool Watch(void* base_address, size_t length);
+
+  // Appends the runs of pages in the range that have been written to since
+  // they were last watched (as host address and length pairs) to ranges_out,
+  // and atomically starts tracking writes to them again. May also report pages
+  // that are not watched.
+  bool GetWrittenRanges(
+      void* base_address, size_t length,
+      std::vector<std::pair<uintptr_t, size_t>>& ranges_out);
+
+ private:
+  WriteWatch(int userfaultfd, int pagemap)
+      : userfaultfd_(userfaultfd), pagemap_(pagemap) {}
+
+  int userfaultfd_;
+  int pagemap_;
+};
+#endif
+
 inline size_t hash_combine(size_t seed) { return seed; }
 
 template <typename T, typename... Ts>
@@ -27,6 +27,22 @@
 #include "xenia/base/main_android.h"
 #endif
 
+#if XE_PLATFORM_LINUX
+#include <linux/fs.h>
+#include <linux/userfaultfd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <cerrno>
+
+// Asynchronous write protection and PAGEMAP_SCAN are available in the headers
+// of Linux 6.7+.
+#if defined(UFFD_FEATURE_WP_ASYNC) && defined(PAGEMAP_SCAN)
+#define XE_MEMORY_WRITE_WATCH_SUPPORTED 1
+#else
+#define XE_MEMORY_WRITE_WATCH_SUPPORTED 0
+#endif
+#endif
+
 namespace xe {
 namespace memory {
 
@@ -193,5 +209,103 @@ bool UnmapFileView(FileMappingHandle handle, void* base_address,
   return munmap(base_address, length) == 0;
 }
 
+#if XE_PLATFORM_LINUX
+WriteWatch::~WriteWatch() {
+  // Closing the userfaultfd also unregisters all ranges.
+  close(pagemap_);
+  close(userfaultfd_);
+}
+
+std::unique_ptr<WriteWatch> WriteWatch::Create() {
+#if XE_MEMORY_WRITE_WATCH_SUPPORTED
+  // Only user-mode faults can be handled without privileges, but asynchronous
+  // write protection faults are resolved by the kernel without involving the
+  // userfaultfd anyway.
+  int userfaultfd = int(
+      syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK | UFFD_USER_MODE_ONLY));
+  if (userfaultfd < 0 && errno == EINVAL) {
+    userfaultfd = int(syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK));
+  }
+  if (userfaultfd < 0) {
+    return nullptr;
+  }
+  uffdio_api api = {};
+  api.api = UFFD_API;
+  api.features = UFFD_FEATURE_WP_ASYNC | UFFD_FEATURE_WP_UNPOPULATED |
+                 UFFD_FEATURE_WP_HUGETLBFS_SHMEM;
+  if (ioctl(userfaultfd, UFFDIO_API, &api) < 0) {
+    close(userfaultfd);
+    return nullptr;
+  }
+  int pagemap = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+  if (pagemap < 0) {
+    close(userfaultfd);
+    return nullptr;
+  }
+  return std::unique_ptr<WriteWatch>(new WriteWatch(userfaultfd, pagemap));
+#else
+  return nullptr;
+#endif
+}
+
+bool WriteWatch::Watch(void* base_address, size_t length) {
+#if XE_MEMORY_WRITE_WATCH_SUPPORTED
+  // Registering again is needed if the range has been remapped, and adjacent
+  // registered mappings are merged by the kernel.
+  uffdio_register register_args;
+  register_args.range.start =
+      uint64_t(reinterpret_cast<uintptr_t>(base_address));
+  register_args.range.len = uint64_t(length);
+  register_args.mode = UFFDIO_REGISTER_MODE_WP;
+  if (ioctl(userfaultfd_, UFFDIO_REGISTER, &register_args) < 0) {
+    return false;
+  }
+  uffdio_writeprotect writeprotect_args;
+  writeprotect_args.range = register_args.range;
+  writeprotect_args.mode = UFFDIO_WRITEPROTECT_MODE_WP;
+  return ioctl(userfaultfd_, UFFDIO_WRITEPROTECT, &writeprotect_args) == 0;
+#else
+  return false;
+#endif
+}
+
+bool WriteWatch::GetWrittenRanges(
+    void* base_address, size_t length,
+    std::vector<std::pair<uintptr_t, size_t>>& ranges_out) {
+#if XE_MEMORY_WRITE_WATCH_SUPPORTED
+  page_region regions[64];
+  pm_scan_arg scan_args = {};
+  scan_args.size = sizeof(scan_args);
+  // Not using PM_SCAN_CHECK_WPASYNC so mappings not registered (not watched)
+  // are skipped rather than failing the scan.
+  scan_args.flags = PM_SCAN_WP_MATCHING;
+  scan_args.start = uint64_t(reinterpret_cast<uintptr_t>(base_address));
+  scan_args.end = scan_args.start + uint64_t(length);
+  scan_args.vec = uint64_t(reinterpret_cast<uintptr_t>(regions));
+  scan_args.vec_len = xe::countof(regions);
+  scan_args.category_mask = PAGE_IS_WRITTEN;
+  scan_args.return_mask = PAGE_IS_WRITTEN;
+  while (true) {
+    int region_count = ioctl(pagemap_, PAGEMAP_SCAN, &scan_args);
+    if (region_count < 0) {
+      return false;
+    }
+    for (int i = 0; i < region_count; ++i) {
+      ranges_out.emplace_back(uintptr_t(regions[i].start),
+                              size_t(regions[i].end - regions[i].start));
+    }
+    // The walk stops early if the output array is full.
+    if (scan_args.walk_end >= scan_args.end) {
+      break;
+    }
+    scan_args.start = scan_args.walk_end;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+#endif
+
 }  // namespace memory
 }  // namespace xe
@@ -16,6 +16,10 @@
 
 #include <array>
 
+#if XE_PLATFORM_LINUX
+#include <sys/mman.h>
+#endif
+
 namespace xe {
 namespace base {
 namespace test {
@@ -558,6 +562,50 @@ TEST_CASE("read_write_view", "[virtual_memory_mapping]") {
   xe::memory::CloseFileMappingHandle(memory, path);
 }
 
+#if XE_PLATFORM_LINUX
+TEST_CASE("write_watch", "[virtual_memory_mapping]") {
+  auto write_watch = xe::memory::WriteWatch::Create();
+  if (!write_watch) {
+    // Not supported by the host kernel.
+    return;
+  }
+  const size_t page_size = xe::memory::page_size();
+  const size_t page_count = 16;
+  auto base = reinterpret_cast<uint8_t*>(
+      mmap(nullptr, page_size * page_count, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  REQUIRE(base != MAP_FAILED);
+  std::memset(base, 0, page_size * page_count);
+
+  // Only watching pages 4...11.
+  REQUIRE(write_watch->Watch(base + page_size * 4, page_size * 8));
+  base[page_size * 1] = 1;
+  base[page_size * 5] = 1;
+  base[page_size * 6 + 7] = 1;
+  base[page_size * 10] = 1;
+
+  std::vector<std::pair<uintptr_t, size_t>> ranges;
+  REQUIRE(write_watch->GetWrittenRanges(base, page_size * page_count, ranges));
+  REQUIRE(ranges.size() == 2);
+  REQUIRE(ranges[0].first == uintptr_t(base + page_size * 5));
+  REQUIRE(ranges[0].second == page_size * 2);
+  REQUIRE(ranges[1].first == uintptr_t(base + page_size * 10));
+  REQUIRE(ranges[1].second == page_size);
+
+  // Written pages are watched again after being reported.
+  ranges.clear();
+  REQUIRE(write_watch->GetWrittenRanges(base, page_size * page_count, ranges));
+  REQUIRE(ranges.empty());
+  base[page_size * 5] = 2;
+  REQUIRE(write_watch->GetWrittenRanges(base, page_size * page_count, ranges));
+  REQUIRE(ranges.size() == 1);
+  REQUIRE(ranges[0].first == uintptr_t(base + page_size * 5));
+
+  write_watch.reset();
+  munmap(base, page_size * page_count);
+}
+#endif
+
 TEST_CASE("make_fourcc", "[fourcc]") {
   SECTION("'1234'") {
     const uint32_t fourcc_host = 0x31323334;
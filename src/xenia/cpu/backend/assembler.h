@@ -41,6 +41,19 @@ class Assembler {
                         uint32_t debug_info_flags,
                         std::unique_ptr<FunctionDebugInfo> debug_info) = 0;
 
+  // Sets up the function from previously stored machine code instead of
+  // translating it, if there's valid code for it. The function must be already
+  // scanned.
+  virtual bool AssembleFromStorage(GuestFunction* function) { return false; }
+
+  // Translates a function that already has machine code, which may be
+  // executing on other threads, again without debug info, and only replaces the
+  // machine code, leaving the rest of the function unchanged.
+  virtual bool AssembleReplacement(GuestFunction* function,
+                                   hir::HIRBuilder* builder) {
+    return false;
+  }
+
  protected:
   Backend* backend_;
 };
@@ -10,7 +10,9 @@
 #ifndef XENIA_CPU_BACKEND_BACKEND_H_
 #define XENIA_CPU_BACKEND_BACKEND_H_
 
+#include <filesystem>
 #include <memory>
+#include <vector>
 
 #include "xenia/cpu/backend/machine_info.h"
 #include "xenia/cpu/thread_debug_info.h"
@@ -58,11 +60,24 @@ class Backend {
   virtual void CommitExecutableRange(uint32_t guest_low,
                                      uint32_t guest_high) = 0;
 
+  // Called when the guest function at the address is removed, so the
+  // generated code stops calling its machine code.
+  virtual void RemoveFunction(uint32_t guest_address) {}
+
   virtual std::unique_ptr<Assembler> CreateAssembler() = 0;
 
   virtual std::unique_ptr<GuestFunction> CreateGuestFunction(
       Module* module, uint32_t address) = 0;
 
+  // Opens the persistent storage of machine code generated for the module in
+  // storage_root, identified by the hash of the module image. Returns the
+  // guest addresses of the functions that have stored code.
+  virtual std::vector<uint32_t> InitializeCodeStorage(
+      Module* module, const std::filesystem::path& storage_root,
+      const uint8_t* image_hash, size_t image_hash_size) {
+    return {};
+  }
+
   // Calculates the next host instruction based on the current thread state and
   // current PC. This will look for branches and other control flow
   // instructions.
@@ -10,14 +10,17 @@
 #include "xenia/cpu/backend/x64/x64_assembler.h"
 
 #include <climits>
+#include <mutex>
 
 #include "third_party/capstone/include/capstone/capstone.h"
 #include "third_party/capstone/include/capstone/x86.h"
+#include "xenia/base/mutex.h"
 #include "xenia/base/profiling.h"
 #include "xenia/base/reset_scope.h"
 #include "xenia/base/string.h"
 #include "xenia/cpu/backend/x64/x64_backend.h"
 #include "xenia/cpu/backend/x64/x64_code_cache.h"
+#include "xenia/cpu/backend/x64/x64_code_storage.h"
 #include "xenia/cpu/backend/x64/x64_emitter.h"
 #include "xenia/cpu/backend/x64/x64_function.h"
 #include "xenia/cpu/cpu_flags.h"
@@ -78,20 +81,89 @@ bool X64Assembler::Assemble(GuestFunction* function, HIRBuilder* builder,
   // Lower HIR -> x64.
   void* machine_code = nullptr;
   size_t code_size = 0;
+  EmitFunctionInfo func_info;
+  std::vector<SourceMapEntry> source_map;
   if (!emitter_->Emit(function, builder, debug_info_flags, debug_info.get(),
-                      &machine_code, &code_size, &function->source_map())) {
+                      function->is_baseline(), &machine_code, &code_size,
+                      &source_map, &func_info)) {
     return false;
   }
 
   // Stash generated machine code.
   if (debug_info_flags & DebugInfoFlags::kDebugInfoDisasmMachineCode) {
-    DumpMachineCode(machine_code, code_size, function->source_map(),
-                    &string_buffer_);
+    DumpMachineCode(machine_code, code_size, source_map, &string_buffer_);
     debug_info->set_machine_code_disasm(xe_strdup(string_buffer_.buffer()));
     string_buffer_.Reset();
   }
 
   function->set_debug_info(std::move(debug_info));
+  function->source_map() = std::move(source_map);
+  SetupFunction(function, machine_code, code_size);
+  static_cast<X64Function*>(function)->set_entry_redirectable(
+      function->is_baseline());
+
+  // Debug info and tracing are not stored.
+  if (!debug_info_flags && emitter_->is_code_relocatable()) {
+    X64CodeStorage* code_storage =
+        x64_backend_->GetCodeStorage(function->module());
+    if (code_storage) {
+      code_storage->StoreFunction(function, machine_code, func_info,
+                                  emitter_->code_relocations());
+    }
+  }
+
+  return true;
+}
+
+bool X64Assembler::AssembleReplacement(GuestFunction* function,
+                                       HIRBuilder* builder) {
+  SCOPE_profile_cpu_f("cpu");
+
+  // Reset when we leave.
+  xe::make_reset_scope(this);
+
+  void* machine_code = nullptr;
+  size_t code_size = 0;
+  EmitFunctionInfo func_info;
+  std::vector<SourceMapEntry> source_map;
+  if (!emitter_->Emit(function, builder, 0, nullptr, false, &machine_code,
+                      &code_size, &source_map, &func_info)) {
+    return false;
+  }
+
+  ReplaceFunctionCode(function, machine_code, code_size, source_map);
+
+  if (emitter_->is_code_relocatable()) {
+    X64CodeStorage* code_storage =
+        x64_backend_->GetCodeStorage(function->module());
+    if (code_storage) {
+      code_storage->StoreFunction(function, machine_code, func_info,
+                                  emitter_->code_relocations());
+    }
+  }
+
+  return true;
+}
+
+bool X64Assembler::AssembleFromStorage(GuestFunction* function) {
+  SCOPE_profile_cpu_f("cpu");
+
+  X64CodeStorage* code_storage =
+      x64_backend_->GetCodeStorage(function->module());
+  if (!code_storage) {
+    return false;
+  }
+  void* machine_code = nullptr;
+  size_t code_size = 0;
+  if (!code_storage->LoadFunction(function, machine_code, code_size)) {
+    return false;
+  }
+  SetupFunction(function, machine_code, code_size);
+  return true;
+}
+
+void X64Assembler::SetupFunction(GuestFunction* function, void* machine_code,
+                                 size_t code_size) {
   static_cast<X64Function*>(function)->Setup(
       reinterpret_cast<uint8_t*>(machine_code), code_size);
 
@@ -101,8 +173,34 @@ bool X64Assembler::Assemble(GuestFunction* function, HIRBuilder* builder,
   reinterpret_cast<X64CodeCache*>(backend_->code_cache())
       ->AddIndirection(function->address(),
                        static_cast<uint32_t>(host_address));
+}
 
-  return true;
+void X64Assembler::ReplaceFunctionCode(
+    GuestFunction* function, void* machine_code, size_t code_size,
+    std::vector<SourceMapEntry>& source_map) {
+  auto x64_function = static_cast<X64Function*>(function);
+  uint8_t* old_machine_code;
+  bool old_entry_redirectable;
+  {
+    // The code cache lock serializes replacements with the placement of code
+    // and with other translations of the function.
+    auto global_lock = global_critical_region::AcquireDirect();
+    std::lock_guard<xe_unlikely_mutex> lock(function->source_map_lock());
+    old_machine_code = x64_function->machine_code();
+    old_entry_redirectable = x64_function->entry_redirectable();
+    function->RetainSourceMap();
+    function->source_map() = std::move(source_map);
+    SetupFunction(function, machine_code, code_size);
+    function->set_baseline(false);
+    x64_function->set_entry_redirectable(false);
+  }
+  // Registered direct call sites are retargeted along with the indirection
+  // table slot, but without the indirection table, direct calls emitted before
+  // the recompilation still go to the old code.
+  if (old_entry_redirectable) {
+    reinterpret_cast<X64CodeCache*>(backend_->code_cache())
+        ->RedirectCode(old_machine_code, machine_code);
+  }
 }
 
 void X64Assembler::DumpMachineCode(
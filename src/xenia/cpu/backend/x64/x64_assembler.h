@@ -39,7 +39,19 @@ class X64Assembler : public Assembler {
                 uint32_t debug_info_flags,
                 std::unique_ptr<FunctionDebugInfo> debug_info) override;
 
+  bool AssembleFromStorage(GuestFunction* function) override;
+
+  bool AssembleReplacement(GuestFunction* function,
+                           hir::HIRBuilder* builder) override;
+
  private:
+  void SetupFunction(GuestFunction* function, void* machine_code,
+                     size_t code_size);
+  // Installs new code of a function translated earlier, such as optimized code
+  // of a function translated without optimizations.
+  void ReplaceFunctionCode(GuestFunction* function, void* machine_code,
+                           size_t code_size,
+                           std::vector<SourceMapEntry>& source_map);
   void DumpMachineCode(void* machine_code, size_t code_size,
                        const std::vector<SourceMapEntry>& source_map,
                        StringBuffer* str);
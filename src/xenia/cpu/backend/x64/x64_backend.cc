@@ -18,6 +18,7 @@
 #include "xenia/base/logging.h"
 #include "xenia/cpu/backend/x64/x64_assembler.h"
 #include "xenia/cpu/backend/x64/x64_code_cache.h"
+#include "xenia/cpu/backend/x64/x64_code_storage.h"
 #include "xenia/cpu/backend/x64/x64_emitter.h"
 #include "xenia/cpu/backend/x64/x64_function.h"
 #include "xenia/cpu/backend/x64/x64_sequences.h"
@@ -33,6 +34,13 @@ DEFINE_bool(record_mmio_access_exceptions, true,
             "instruct the recompiler to emit checks",
             "x64");
 
+DEFINE_bool(recompile_functions_on_mmio_access, false,
+            "Recompile guest functions in the background when an mmio access "
+            "is first recorded for one of their instructions, so the access "
+            "is checked in the code instead of taking an exception every "
+            "time.",
+            "x64");
+
 DEFINE_int64(max_stackpoints, 65536,
              "Max number of host->guest stack mappings we can record.", "x64");
 
@@ -41,6 +49,13 @@ DEFINE_bool(enable_host_guest_stack_synchronization, true,
             "and checks for reentry at return sites. Has slight performance "
             "impact, but fixes crashes in games that use setjmp/longjmp.",
             "x64");
+
+DEFINE_bool(x64_code_storage, false,
+            "Store the generated x64 code of guest modules in the cache "
+            "directory, and load it instead of translating the functions again "
+            "on subsequent launches of the same title.",
+            "x64");
+DECLARE_bool(emit_mmio_aware_stores_for_recorded_exception_addresses);
 #if XE_X64_PROFILER_AVAILABLE == 1
 DECLARE_bool(instrument_call_times);
 #endif
@@ -136,6 +151,8 @@ X64Backend::X64Backend() : Backend(), code_cache_(nullptr) {
 }
 
 X64Backend::~X64Backend() {
+  code_storages_.clear();
+
   if (capstone_handle_) {
     cs_close(&capstone_handle_);
   }
@@ -328,6 +345,12 @@ void X64Backend::CommitExecutableRange(uint32_t guest_low,
   code_cache_->CommitExecutableRange(guest_low, guest_high);
 }
 
+void X64Backend::RemoveFunction(uint32_t guest_address) {
+  // Direct call sites are retargeted to the resolve thunk along with the
+  // indirection table slot.
+  code_cache_->RemoveIndirection(guest_address);
+}
+
 std::unique_ptr<Assembler> X64Backend::CreateAssembler() {
   return std::make_unique<X64Assembler>(this);
 }
@@ -337,6 +360,31 @@ std::unique_ptr<GuestFunction> X64Backend::CreateGuestFunction(
   return std::make_unique<X64Function>(module, address);
 }
 
+std::vector<uint32_t> X64Backend::InitializeCodeStorage(
+    Module* module, const std::filesystem::path& storage_root,
+    const uint8_t* image_hash, size_t image_hash_size) {
+  if (!cvars::x64_code_storage) {
+    return {};
+  }
+  std::error_code error_code;
+  std::filesystem::create_directories(storage_root, error_code);
+  auto code_storage = std::make_unique<X64CodeStorage>(this);
+  if (!code_storage->Initialize(storage_root / "x64_code.bin", image_hash,
+                                image_hash_size)) {
+    return {};
+  }
+  std::vector<uint32_t> stored_functions = code_storage->GetStoredFunctions();
+  std::lock_guard<xe_mutex> lock(code_storages_lock_);
+  code_storages_[module] = std::move(code_storage);
+  return stored_functions;
+}
+
+X64CodeStorage* X64Backend::GetCodeStorage(Module* module) {
+  std::lock_guard<xe_mutex> lock(code_storages_lock_);
+  auto it = code_storages_.find(module);
+  return it != code_storages_.end() ? it->second.get() : nullptr;
+}
+
 uint64_t ReadCapstoneReg(HostThreadContext* context, x86_reg reg) {
   switch (reg) {
     case X86_REG_RAX:
@@ -579,8 +627,12 @@ void X64Backend::RecordMMIOExceptionForGuestInstruction(void* host_address) {
         cpu::InfoCacheFlags* icf =
             xex_guest_module->GetInstructionAddressFlags(guestaddr);
 
-        if (icf) {
+        if (icf && !icf->accessed_mmio) {
           icf->accessed_mmio = true;
+          if (cvars::recompile_functions_on_mmio_access &&
+              cvars::emit_mmio_aware_stores_for_recorded_exception_addresses) {
+            processor()->frontend()->QueueFunctionRecompilation(fnfor);
+          }
         }
       }
     }
@@ -11,9 +11,11 @@
 #define XENIA_CPU_BACKEND_X64_X64_BACKEND_H_
 
 #include <memory>
+#include <unordered_map>
 
 #include "xenia/base/bit_map.h"
 #include "xenia/base/cvar.h"
+#include "xenia/base/mutex.h"
 #include "xenia/cpu/backend/backend.h"
 
 #if XE_PLATFORM_WIN32 == 1
@@ -27,6 +29,7 @@
 DECLARE_int64(x64_extension_mask);
 DECLARE_int64(max_stackpoints);
 DECLARE_bool(enable_host_guest_stack_synchronization);
+DECLARE_bool(x64_code_storage);
 namespace xe {
 class Exception;
 }  // namespace xe
@@ -38,6 +41,7 @@ namespace x64 {
 using GuestProfilerData = std::map<uint32_t, uint64_t>;
 
 class X64CodeCache;
+class X64CodeStorage;
 
 typedef void* (*HostToGuestThunk)(void* target, void* arg0, void* arg1);
 typedef void* (*GuestToHostThunk)(void* target, void* arg0, void* arg1);
@@ -154,11 +158,19 @@ class X64Backend : public Backend {
 
   void CommitExecutableRange(uint32_t guest_low, uint32_t guest_high) override;
 
+  void RemoveFunction(uint32_t guest_address) override;
+
   std::unique_ptr<Assembler> CreateAssembler() override;
 
   std::unique_ptr<GuestFunction> CreateGuestFunction(Module* module,
                                                      uint32_t address) override;
 
+  std::vector<uint32_t> InitializeCodeStorage(
+      Module* module, const std::filesystem::path& storage_root,
+      const uint8_t* image_hash, size_t image_hash_size) override;
+  // Returns nullptr if the code of the module is not stored.
+  X64CodeStorage* GetCodeStorage(Module* module);
+
   uint64_t CalculateNextHostInstruction(ThreadDebugInfo* thread_info,
                                         uint64_t current_pc) override;
 
@@ -199,6 +211,9 @@ class X64Backend : public Backend {
   std::unique_ptr<X64CodeCache> code_cache_;
   uintptr_t emitter_data_ = 0;
 
+  xe_mutex code_storages_lock_;
+  std::unordered_map<Module*, std::unique_ptr<X64CodeStorage>> code_storages_;
+
   HostToGuestThunk host_to_guest_thunk_;
   GuestToHostThunk guest_to_host_thunk_;
   ResolveFunctionThunk resolve_function_thunk_;
@@ -11,6 +11,7 @@
 
 #include <cstdlib>
 #include <cstring>
+#include <mutex>
 
 #if ENABLE_VTUNE
 #include "third_party/vtune/include/jitprofiling.h"
@@ -19,6 +20,7 @@
 
 #include "third_party/fmt/include/fmt/format.h"
 #include "xenia/base/assert.h"
+#include "xenia/base/atomic.h"
 #include "xenia/base/clock.h"
 #include "xenia/base/literals.h"
 #include "xenia/base/logging.h"
@@ -135,10 +137,82 @@ void X64CodeCache::AddIndirection(uint32_t guest_address,
   if (!indirection_table_base_) {
     return;
   }
+  SetIndirection(guest_address, host_address);
+}
+
+void X64CodeCache::RemoveIndirection(uint32_t guest_address) {
+  if (!indirection_table_base_) {
+    return;
+  }
+  SetIndirection(guest_address, indirection_default_value_);
+}
 
+void X64CodeCache::SetIndirection(uint32_t guest_address,
+                                  uint32_t host_address) {
+  std::lock_guard<xe_mutex> lock(direct_call_sites_lock_);
   uint32_t* indirection_slot = reinterpret_cast<uint32_t*>(
       indirection_table_base_ + (guest_address - kIndirectionTableBase));
   *indirection_slot = host_address;
+  auto call_sites_it = direct_call_sites_.find(guest_address);
+  if (call_sites_it != direct_call_sites_.end()) {
+    for (uint32_t rel32_offset : call_sites_it->second) {
+      PatchDirectCallSite(rel32_offset, host_address);
+    }
+  }
+}
+
+void X64CodeCache::AddDirectCallSite(uint32_t guest_address,
+                                     void* rel32_execute_address) {
+  if (!indirection_table_base_) {
+    return;
+  }
+  auto rel32_offset =
+      uint32_t(reinterpret_cast<uint8_t*>(rel32_execute_address) -
+               generated_code_execute_base_);
+  assert_zero(rel32_offset & 3);
+  std::lock_guard<xe_mutex> lock(direct_call_sites_lock_);
+  direct_call_sites_[guest_address].push_back(rel32_offset);
+  // The function may have been translated after the call site was emitted.
+  PatchDirectCallSite(
+      rel32_offset,
+      *reinterpret_cast<const uint32_t*>(
+          indirection_table_base_ + (guest_address - kIndirectionTableBase)));
+}
+
+void X64CodeCache::PatchDirectCallSite(uint32_t rel32_offset,
+                                       uint32_t host_address) {
+  // Relative to the end of the field, which is the end of the instruction.
+  auto displacement = uint32_t(
+      int32_t(int64_t(host_address) -
+              int64_t(uintptr_t(generated_code_execute_base_) + rel32_offset +
+                      sizeof(uint32_t))));
+  auto rel32_write_address = reinterpret_cast<volatile uint32_t*>(
+      generated_code_write_base_ + rel32_offset);
+  if (*rel32_write_address != displacement) {
+    // Aligned, so threads executing the call concurrently see either the old
+    // or the new target.
+    xe::atomic_exchange(displacement, rel32_write_address);
+  }
+}
+
+void X64CodeCache::RedirectCode(void* code_execute_address,
+                                const void* target_execute_address) {
+  uint8_t* code = reinterpret_cast<uint8_t*>(code_execute_address);
+  // Code is placed with 16-byte alignment.
+  assert_zero(reinterpret_cast<uintptr_t>(code) & 7);
+  auto entry_write_address = reinterpret_cast<volatile uint64_t*>(
+      generated_code_write_base_ + (code - generated_code_execute_base_));
+  int64_t jmp_offset =
+      reinterpret_cast<const uint8_t*>(target_execute_address) -
+      (code + kRedirectableEntrySize);
+  assert_true(jmp_offset == int32_t(jmp_offset));
+  // jmp rel32, leaving the bytes after the entry instruction unchanged. Written
+  // with a single aligned store, so threads entering the code concurrently
+  // execute either the old entry instruction or the jump.
+  uint64_t entry = *entry_write_address;
+  entry = (entry & ~((uint64_t(1) << (kRedirectableEntrySize * 8)) - 1)) |
+          0xE9 | (uint64_t(uint32_t(jmp_offset)) << 8);
+  xe::atomic_exchange(entry, entry_write_address);
 }
 
 void X64CodeCache::CommitExecutableRange(uint32_t guest_low,
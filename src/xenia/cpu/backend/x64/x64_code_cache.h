@@ -15,6 +15,7 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -59,7 +60,28 @@ class X64CodeCache : public CodeCache {
 
   bool has_indirection_table() { return indirection_table_base_ != nullptr; }
   void set_indirection_default(uint32_t default_value);
+  // Also retargets the direct call sites of the guest function.
   void AddIndirection(uint32_t guest_address, uint32_t host_address);
+  // Makes calls to the guest function resolve it again, after it has been
+  // removed.
+  void RemoveIndirection(uint32_t guest_address);
+
+  // Registers a call or a jump from the generated code to a guest function,
+  // which will be made to target the code in the indirection table slot of the
+  // function whenever it changes, instead of loading the slot on every call.
+  // ebx must contain the guest address at the call site, as the resolve thunk
+  // may be the target. The rel32 field must be 4-byte-aligned for atomic
+  // updates.
+  void AddDirectCallSite(uint32_t guest_address, void* rel32_execute_address);
+
+  // Size of the instruction at the beginning of code that can be replaced with
+  // a jump by RedirectCode.
+  static constexpr size_t kRedirectableEntrySize = 5;
+  // Makes previously placed code jump to other code, for callers that have the
+  // old address embedded in them. The old code must begin with an instruction
+  // of kRedirectableEntrySize bytes.
+  void RedirectCode(void* code_execute_address,
+                    const void* target_execute_address);
 
   void CommitExecutableRange(uint32_t guest_low, uint32_t guest_high);
 
@@ -143,6 +165,15 @@ class X64CodeCache : public CodeCache {
   // This can be used to bsearch on host PC to find the guest function.
   // The key is [start address | end address].
   std::vector<std::pair<uint64_t, GuestFunction*>> generated_code_map_;
+
+  // Guest address -> offsets of the rel32 fields of the direct call sites of
+  // the function in the generated code. Also held while changing indirection
+  // table slots, so the call sites are consistent with them.
+  xe_mutex direct_call_sites_lock_;
+  std::unordered_map<uint32_t, std::vector<uint32_t>> direct_call_sites_;
+
+  void SetIndirection(uint32_t guest_address, uint32_t host_address);
+  void PatchDirectCallSite(uint32_t rel32_offset, uint32_t host_address);
 };
 
 }  // namespace x64
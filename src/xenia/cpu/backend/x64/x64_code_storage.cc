@@ -0,0 +1,397 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/cpu/backend/x64/x64_code_storage.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+#include "build/version.h"
+#include "xenia/base/assert.h"
+#include "xenia/base/clock.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/platform_amd64.h"
+#include "xenia/base/xxhash.h"
+#include "xenia/cpu/backend/x64/x64_backend.h"
+#include "xenia/cpu/backend/x64/x64_code_cache.h"
+#include "xenia/cpu/backend/x64/x64_emitter.h"
+#include "xenia/cpu/processor.h"
+#include "xenia/cpu/xex_module.h"
+#include "xenia/memory.h"
+
+namespace xe {
+namespace cpu {
+namespace backend {
+namespace x64 {
+
+static void HostImageAnchor() {}
+
+static bool IsInt32(int64_t value) { return value == int32_t(value); }
+
+uintptr_t X64CodeStorage::host_image_anchor() {
+  return reinterpret_cast<uintptr_t>(&HostImageAnchor);
+}
+
+X64CodeStorage::X64CodeStorage(X64Backend* backend) : backend_(backend) {}
+
+X64CodeStorage::~X64CodeStorage() { Shutdown(); }
+
+bool X64CodeStorage::Initialize(const std::filesystem::path& storage_file_path,
+                                const uint8_t* image_hash,
+                                size_t image_hash_size) {
+  Shutdown();
+
+  uint64_t load_start = xe::Clock::QueryHostTickCount();
+
+  file_ = xe::filesystem::OpenFile(storage_file_path, "a+b");
+  if (!file_) {
+    XELOGE("Failed to open the x64 code storage file {}",
+           xe::path_to_utf8(storage_file_path));
+    return false;
+  }
+
+  FileHeader expected_header = {};
+  expected_header.magic = FileHeader::kMagic;
+  expected_header.version = FileHeader::kVersion;
+  std::memcpy(expected_header.image_hash, image_hash,
+              std::min(image_hash_size, sizeof(expected_header.image_hash)));
+  expected_header.codegen_key = CalculateCodegenKey();
+
+  FileHeader file_header;
+  size_t valid_bytes = 0;
+  if (fread(&file_header, sizeof(file_header), 1, file_) &&
+      !std::memcmp(&file_header, &expected_header, sizeof(file_header))) {
+    valid_bytes = sizeof(file_header);
+    xe::filesystem::Seek(file_, 0, SEEK_END);
+    int64_t told_end = xe::filesystem::Tell(file_);
+    if (told_end > int64_t(sizeof(file_header)) &&
+        xe::filesystem::Seek(file_, int64_t(sizeof(file_header)), SEEK_SET)) {
+      stored_data_.resize(size_t(told_end) - sizeof(file_header));
+      stored_data_.resize(
+          fread(stored_data_.data(), 1, stored_data_.size(), file_));
+    }
+    // Index the records, stopping at the first incomplete or corrupted one.
+    size_t record_offset = 0;
+    while (stored_data_.size() - record_offset >=
+           sizeof(FunctionRecordHeader)) {
+      FunctionRecordHeader record;
+      std::memcpy(&record, stored_data_.data() + record_offset,
+                  sizeof(record));
+      size_t data_size =
+          size_t(record.code_size) +
+          sizeof(CodeRelocation) * size_t(record.relocation_count) +
+          sizeof(SourceMapEntry) * size_t(record.source_map_count);
+      size_t data_offset = record_offset + sizeof(record);
+      if (stored_data_.size() - data_offset < data_size ||
+          XXH3_64bits(stored_data_.data() + data_offset, data_size) !=
+              record.data_hash) {
+        break;
+      }
+      // Newer records for the same function replace older ones.
+      stored_functions_[record.guest_address] = record_offset;
+      record_offset = data_offset + data_size;
+    }
+    stored_data_.resize(record_offset);
+    valid_bytes += record_offset;
+  }
+
+  if (valid_bytes) {
+    xe::filesystem::TruncateStdioFile(file_, valid_bytes);
+  } else {
+    stored_data_.clear();
+    xe::filesystem::TruncateStdioFile(file_, 0);
+    fwrite(&expected_header, sizeof(expected_header), 1, file_);
+  }
+
+  XELOGI("Opened the x64 code storage with {} functions in {} milliseconds",
+         stored_functions_.size(),
+         (xe::Clock::QueryHostTickCount() - load_start) * 1000 /
+             xe::Clock::QueryHostTickFrequency());
+  return true;
+}
+
+void X64CodeStorage::Shutdown() {
+  std::lock_guard<xe_mutex> lock(lock_);
+  if (file_) {
+    fclose(file_);
+    file_ = nullptr;
+  }
+  stored_functions_.clear();
+  stored_data_.clear();
+  stored_data_.shrink_to_fit();
+}
+
+std::vector<uint32_t> X64CodeStorage::GetStoredFunctions() const {
+  std::lock_guard<xe_mutex> lock(lock_);
+  std::vector<uint32_t> addresses;
+  addresses.reserve(stored_functions_.size());
+  for (const auto& stored_function : stored_functions_) {
+    addresses.push_back(stored_function.first);
+  }
+  std::sort(addresses.begin(), addresses.end());
+  return addresses;
+}
+
+bool X64CodeStorage::LoadFunction(GuestFunction* function,
+                                  void*& machine_code_out,
+                                  size_t& code_size_out) {
+  std::lock_guard<xe_mutex> lock(lock_);
+  auto stored_it = stored_functions_.find(function->address());
+  if (stored_it == stored_functions_.end()) {
+    return false;
+  }
+  const uint8_t* record_data = stored_data_.data() + stored_it->second;
+  // Whatever the outcome, the function won't be loaded from the storage again.
+  stored_functions_.erase(stored_it);
+
+  FunctionRecordHeader record;
+  std::memcpy(&record, record_data, sizeof(record));
+  if (record.guest_end_address != function->end_address() ||
+      record.guest_code_hash != CalculateGuestCodeHash(function)) {
+    return false;
+  }
+  const uint8_t* code = record_data + sizeof(record);
+  std::vector<CodeRelocation> relocations(record.relocation_count);
+  std::memcpy(relocations.data(), code + record.code_size,
+              sizeof(CodeRelocation) * relocations.size());
+
+  // Resolve the targets before placing the code, so nothing is wasted if the
+  // executable is too far from the code cache to be called directly.
+  X64CodeCache* code_cache = backend_->code_cache();
+  uintptr_t code_cache_base = code_cache->execute_base_address();
+  uintptr_t code_cache_end = code_cache_base + code_cache->total_size();
+  std::vector<uintptr_t> relocation_targets(relocations.size());
+  for (size_t i = 0; i < relocations.size(); ++i) {
+    const CodeRelocation& relocation = relocations[i];
+    size_t field_size =
+        relocation.type == CodeRelocation::Type::kHostImageAbs64 ? 8 : 4;
+    if (size_t(relocation.code_offset) + field_size > record.code_size) {
+      return false;
+    }
+    uintptr_t target;
+    switch (relocation.type) {
+      case CodeRelocation::Type::kCodeCacheRel32:
+        target = uintptr_t(relocation.value);
+        break;
+      case CodeRelocation::Type::kGuestFunctionRel32:
+        target = GetGuestCallTarget(uint32_t(relocation.value));
+        if (!target) {
+          return false;
+        }
+        break;
+      case CodeRelocation::Type::kHostImageRel32:
+        target = host_image_anchor() + uintptr_t(relocation.value);
+        // Must be reachable from anywhere in the code cache.
+        if (!IsInt32(int64_t(target - code_cache_base)) ||
+            !IsInt32(int64_t(target - code_cache_end))) {
+          return false;
+        }
+        break;
+      case CodeRelocation::Type::kHostImageAbs64:
+        target = host_image_anchor() + uintptr_t(relocation.value);
+        break;
+      default:
+        return false;
+    }
+    relocation_targets[i] = target;
+  }
+
+  EmitFunctionInfo func_info = {};
+  func_info.code_size.prolog = record.prolog_size;
+  func_info.code_size.body = record.body_size;
+  func_info.code_size.epilog = record.epilog_size;
+  func_info.code_size.tail = record.tail_size;
+  func_info.code_size.total = record.code_size;
+  func_info.prolog_stack_alloc_offset = record.prolog_stack_alloc_offset;
+  func_info.stack_size = record.stack_size;
+  void* code_execute_address;
+  void* code_write_address;
+  code_cache->PlaceGuestCode(function->address(), const_cast<uint8_t*>(code),
+                             func_info, function, code_execute_address,
+                             code_write_address);
+  uint8_t* code_write = reinterpret_cast<uint8_t*>(code_write_address);
+  uintptr_t code_execute = reinterpret_cast<uintptr_t>(code_execute_address);
+  for (size_t i = 0; i < relocations.size(); ++i) {
+    const CodeRelocation& relocation = relocations[i];
+    uintptr_t target = relocation_targets[i];
+    if (relocation.type == CodeRelocation::Type::kHostImageAbs64) {
+      uint64_t value = uint64_t(target);
+      std::memcpy(code_write + relocation.code_offset, &value, sizeof(value));
+    } else {
+      // Relative to the end of the 32-bit displacement, which is the last
+      // field of all the call and jump instructions that are relocated.
+      int32_t displacement = int32_t(
+          target - (code_execute + relocation.code_offset + sizeof(int32_t)));
+      std::memcpy(code_write + relocation.code_offset, &displacement,
+                  sizeof(displacement));
+    }
+  }
+
+  for (const CodeRelocation& relocation : relocations) {
+    if (relocation.type == CodeRelocation::Type::kGuestFunctionRel32) {
+      code_cache->AddDirectCallSite(
+          uint32_t(relocation.value),
+          reinterpret_cast<void*>(code_execute + relocation.code_offset));
+    }
+  }
+
+  std::vector<SourceMapEntry>& source_map = function->source_map();
+  source_map.resize(record.source_map_count);
+  std::memcpy(source_map.data(),
+              code + record.code_size +
+                  sizeof(CodeRelocation) * record.relocation_count,
+              sizeof(SourceMapEntry) * source_map.size());
+
+  machine_code_out = code_execute_address;
+  code_size_out = record.code_size;
+  return true;
+}
+
+void X64CodeStorage::StoreFunction(
+    GuestFunction* function, const void* machine_code,
+    const EmitFunctionInfo& func_info,
+    const std::vector<CodeRelocation>& relocations) {
+  const std::vector<SourceMapEntry>& source_map = function->source_map();
+
+  FunctionRecordHeader record = {};
+  record.guest_address = function->address();
+  record.guest_end_address = function->end_address();
+  record.guest_code_hash = CalculateGuestCodeHash(function);
+  record.code_size = uint32_t(func_info.code_size.total);
+  record.relocation_count = uint32_t(relocations.size());
+  record.source_map_count = uint32_t(source_map.size());
+  record.prolog_size = uint32_t(func_info.code_size.prolog);
+  record.body_size = uint32_t(func_info.code_size.body);
+  record.epilog_size = uint32_t(func_info.code_size.epilog);
+  record.tail_size = uint32_t(func_info.code_size.tail);
+  record.prolog_stack_alloc_offset =
+      uint32_t(func_info.prolog_stack_alloc_offset);
+  record.stack_size = uint32_t(func_info.stack_size);
+
+  std::vector<uint8_t> data(
+      record.code_size + sizeof(CodeRelocation) * relocations.size() +
+      sizeof(SourceMapEntry) * source_map.size());
+  uint8_t* data_ptr = data.data();
+  std::memcpy(data_ptr, machine_code, record.code_size);
+  data_ptr += record.code_size;
+  std::memcpy(data_ptr, relocations.data(),
+              sizeof(CodeRelocation) * relocations.size());
+  data_ptr += sizeof(CodeRelocation) * relocations.size();
+  std::memcpy(data_ptr, source_map.data(),
+              sizeof(SourceMapEntry) * source_map.size());
+  record.data_hash = XXH3_64bits(data.data(), data.size());
+
+  std::lock_guard<xe_mutex> lock(lock_);
+  if (!file_) {
+    return;
+  }
+  fwrite(&record, sizeof(record), 1, file_);
+  fwrite(data.data(), data.size(), 1, file_);
+}
+
+uint64_t X64CodeStorage::CalculateCodegenKey() const {
+  XXH3_state_t hash_state;
+  XXH3_64bits_reset(&hash_state);
+  auto hash_value = [&hash_state](uint64_t value) {
+    XXH3_64bits_update(&hash_state, &value, sizeof(value));
+  };
+
+  // The emulator build - offsets of host executable pointers are only valid
+  // for the exact same executable.
+  XXH3_64bits_update(&hash_state, XE_BUILD_COMMIT, sizeof(XE_BUILD_COMMIT));
+  hash_value(reinterpret_cast<uintptr_t>(&X64Emitter::PlaceConstData) -
+             host_image_anchor());
+  hash_value(reinterpret_cast<uintptr_t>(&mxcsr_table[0]) -
+             host_image_anchor());
+
+  // Options affecting the translation.
+  if (cvar::ConfigVars) {
+    for (const auto& config_var : *cvar::ConfigVars) {
+      const std::string& category = config_var.second->category();
+      if (category != "CPU" && category != "x64" && category != "Memory") {
+        continue;
+      }
+      XXH3_64bits_update(&hash_state, config_var.first.data(),
+                         config_var.first.size());
+      std::string value = config_var.second->config_value();
+      XXH3_64bits_update(&hash_state, value.data(), value.size());
+    }
+  }
+  hash_value(amd64::GetFeatureFlags());
+
+  // Host addresses referenced by the generated code directly.
+  hash_value(reinterpret_cast<uintptr_t>(
+      backend_->processor()->memory()->virtual_membase()));
+  hash_value(backend_->emitter_data());
+  hash_value(reinterpret_cast<uintptr_t>(backend_->host_to_guest_thunk()));
+  hash_value(reinterpret_cast<uintptr_t>(backend_->guest_to_host_thunk()));
+  hash_value(reinterpret_cast<uintptr_t>(backend_->resolve_function_thunk()));
+  hash_value(reinterpret_cast<uintptr_t>(
+      backend_->synchronize_guest_and_host_stack_helper()));
+  for (size_t size = 1; size <= 4; size <<= 1) {
+    hash_value(reinterpret_cast<uintptr_t>(
+        backend_->synchronize_guest_and_host_stack_helper_for_size(size)));
+  }
+  hash_value(
+      reinterpret_cast<uintptr_t>(backend_->try_acquire_reservation_helper_));
+  hash_value(reinterpret_cast<uintptr_t>(backend_->reserved_store_32_helper));
+  hash_value(reinterpret_cast<uintptr_t>(backend_->reserved_store_64_helper));
+  hash_value(reinterpret_cast<uintptr_t>(backend_->vrsqrtefp_vector_helper));
+  hash_value(reinterpret_cast<uintptr_t>(backend_->vrsqrtefp_scalar_helper));
+  hash_value(reinterpret_cast<uintptr_t>(backend_->frsqrtefp_helper));
+
+  return XXH3_64bits_digest(&hash_state);
+}
+
+uint64_t X64CodeStorage::CalculateGuestCodeHash(GuestFunction* function) {
+  uint32_t address = function->address();
+  uint32_t instruction_count = (function->end_address() - address) / 4 + 1;
+  XXH3_state_t hash_state;
+  XXH3_64bits_reset(&hash_state);
+  XXH3_64bits_update(&hash_state,
+                     function->module()->memory()->TranslateVirtual(address),
+                     instruction_count * 4);
+  // Loads and stores that have accessed MMIO are translated differently.
+  auto xex_module = dynamic_cast<XexModule*>(function->module());
+  if (xex_module) {
+    std::vector<uint8_t> accessed_mmio(instruction_count);
+    for (uint32_t i = 0; i < instruction_count; ++i) {
+      InfoCacheFlags* flags =
+          xex_module->GetInstructionAddressFlags(address + i * 4);
+      accessed_mmio[i] = flags && flags->accessed_mmio;
+    }
+    XXH3_64bits_update(&hash_state, accessed_mmio.data(),
+                       accessed_mmio.size());
+  }
+  return XXH3_64bits_digest(&hash_state);
+}
+
+uintptr_t X64CodeStorage::GetGuestCallTarget(uint32_t guest_address) {
+  Function* callee = backend_->processor()->LookupFunction(guest_address);
+  if (callee && callee->is_guest()) {
+    uint8_t* machine_code = static_cast<GuestFunction*>(callee)->machine_code();
+    if (machine_code) {
+      return reinterpret_cast<uintptr_t>(machine_code);
+    }
+  }
+  if (!backend_->code_cache()->has_indirection_table()) {
+    return 0;
+  }
+  // Retargeted by the code cache once the function is translated, the guest
+  // address for the thunk is loaded at the call site.
+  return reinterpret_cast<uintptr_t>(backend_->resolve_function_thunk());
+}
+
+}  // namespace x64
+}  // namespace backend
+}  // namespace cpu
+}  // namespace xe
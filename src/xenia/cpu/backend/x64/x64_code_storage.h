@@ -0,0 +1,136 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_CPU_BACKEND_X64_X64_CODE_STORAGE_H_
+#define XENIA_CPU_BACKEND_X64_X64_CODE_STORAGE_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+
+#include "xenia/base/mutex.h"
+#include "xenia/cpu/function.h"
+
+namespace xe {
+namespace cpu {
+namespace backend {
+namespace x64 {
+
+class X64Backend;
+struct EmitFunctionInfo;
+
+// A location in the emitted code which depends on where the code and the
+// emulator executable are placed in the host address space.
+struct CodeRelocation {
+  enum class Type : uint32_t {
+    // rel32 of a call or a jump to code at a fixed address in the code cache
+    // (thunks and helpers), value is the absolute target address.
+    kCodeCacheRel32,
+    // rel32 of a call or a jump to the machine code of a guest function, value
+    // is the guest address of the function. Registered as a direct call site
+    // in the code cache.
+    kGuestFunctionRel32,
+    // rel32 of a call or a jump into the emulator executable, value is the
+    // offset from the executable anchor.
+    kHostImageRel32,
+    // 64-bit absolute pointer into the emulator executable, value is the
+    // offset from the executable anchor.
+    kHostImageAbs64,
+  };
+
+  uint32_t code_offset;
+  Type type;
+  uint64_t value;
+};
+
+// Persistent storage of the x64 code generated for the functions of a single
+// guest module, so the code doesn't need to be translated again on subsequent
+// launches. Stored functions are validated by the hash of the guest code they
+// were translated from, and the whole storage is discarded if the image hash,
+// the code generation options or the emulator build differ.
+class X64CodeStorage {
+ public:
+  // Offsets of host executable pointers are relative to this address.
+  static uintptr_t host_image_anchor();
+
+  X64CodeStorage(X64Backend* backend);
+  ~X64CodeStorage();
+
+  bool Initialize(const std::filesystem::path& storage_file_path,
+                  const uint8_t* image_hash, size_t image_hash_size);
+  void Shutdown();
+
+  // Guest addresses of the functions that have code in the storage.
+  std::vector<uint32_t> GetStoredFunctions() const;
+
+  // Places the stored code of the function into the code cache if it's still
+  // valid for it. The function must be already scanned.
+  bool LoadFunction(GuestFunction* function, void*& machine_code_out,
+                    size_t& code_size_out);
+
+  void StoreFunction(GuestFunction* function, const void* machine_code,
+                     const EmitFunctionInfo& func_info,
+                     const std::vector<CodeRelocation>& relocations);
+
+ private:
+  // Update kVersion if anything in the storage or the code generation changes!
+  struct FileHeader {
+    static constexpr uint32_t kMagic = 0x53433658;  // 'X6CS'
+    static constexpr uint32_t kVersion = 0x20261017;
+    uint32_t magic;
+    uint32_t version;
+    uint8_t image_hash[20];
+    uint32_t reserved;
+    uint64_t codegen_key;
+  };
+
+  struct FunctionRecordHeader {
+    uint32_t guest_address;
+    uint32_t guest_end_address;
+    uint64_t guest_code_hash;
+    uint32_t code_size;
+    uint32_t relocation_count;
+    uint32_t source_map_count;
+    uint32_t prolog_size;
+    uint32_t body_size;
+    uint32_t epilog_size;
+    uint32_t tail_size;
+    uint32_t prolog_stack_alloc_offset;
+    uint32_t stack_size;
+    uint32_t reserved;
+    // Hash of everything after the header.
+    uint64_t data_hash;
+  };
+
+  uint64_t CalculateCodegenKey() const;
+  // Hash of the guest instructions and of the per-instruction translation
+  // hints recorded for the module.
+  static uint64_t CalculateGuestCodeHash(GuestFunction* function);
+  // Returns the address of machine code to call for the guest function,
+  // either the code of the function itself or the resolve thunk.
+  uintptr_t GetGuestCallTarget(uint32_t guest_address);
+
+  X64Backend* backend_;
+
+  mutable xe_mutex lock_;
+  FILE* file_ = nullptr;
+  // Stored function data read from the file.
+  std::vector<uint8_t> stored_data_;
+  // Guest address -> offset of the record in stored_data_.
+  std::unordered_map<uint32_t, size_t> stored_functions_;
+};
+
+}  // namespace x64
+}  // namespace backend
+}  // namespace cpu
+}  // namespace xe
+
+#endif  // XENIA_CPU_BACKEND_X64_X64_CODE_STORAGE_H_
@@ -11,6 +11,7 @@
 
 #include <stddef.h>
 
+#include <algorithm>
 #include <climits>
 #include <cstring>
 
@@ -110,8 +111,10 @@ X64Emitter::~X64Emitter() = default;
 
 bool X64Emitter::Emit(GuestFunction* function, HIRBuilder* builder,
                       uint32_t debug_info_flags, FunctionDebugInfo* debug_info,
-                      void** out_code_address, size_t* out_code_size,
-                      std::vector<SourceMapEntry>* out_source_map) {
+                      bool baseline, void** out_code_address,
+                      size_t* out_code_size,
+                      std::vector<SourceMapEntry>* out_source_map,
+                      EmitFunctionInfo* out_func_info) {
   SCOPE_profile_cpu_f("cpu");
   guest_module_ = dynamic_cast<XexModule*>(function->module());
   current_guest_function_ = function->address();
@@ -120,6 +123,11 @@ bool X64Emitter::Emit(GuestFunction* function, HIRBuilder* builder,
   debug_info_flags_ = debug_info_flags;
   trace_data_ = &function->trace_data();
   source_map_arena_.Reset();
+  code_relocatable_ = true;
+  code_relocations_.clear();
+  direct_call_sites_.clear();
+  baseline_function_ =
+      baseline ? static_cast<X64Function*>(function) : nullptr;
 
   // Fill the generator with code.
   EmitFunctionInfo func_info = {};
@@ -130,10 +138,19 @@ bool X64Emitter::Emit(GuestFunction* function, HIRBuilder* builder,
   // Copy the final code to the cache and relocate it.
   *out_code_size = getSize();
   *out_code_address = Emplace(func_info, function);
+  for (const DirectCallSite& call_site : direct_call_sites_) {
+    code_cache_->AddDirectCallSite(
+        call_site.guest_address,
+        reinterpret_cast<uint8_t*>(*out_code_address) + call_site.rel32_offset);
+  }
 
   // Stash source map.
   source_map_arena_.CloneContents(out_source_map);
 
+  if (out_func_info) {
+    *out_func_info = func_info;
+  }
+
   return true;
 }
 void* X64Emitter::Emplace(const EmitFunctionInfo& func_info,
@@ -235,6 +252,19 @@ bool X64Emitter::Emit(HIRBuilder* builder, EmitFunctionInfo& func_info) {
   func_info.stack_size = stack_size;
   stack_size_ = stack_size;
 
+  if (baseline_function_) {
+    // Replaced with a jump to the optimized code once the function is
+    // recompiled, for callers that call this code directly. A single
+    // instruction, so it's never partially executed while being replaced.
+    static_assert(X64CodeCache::kRedirectableEntrySize == 5);
+    // nop dword ptr [rax+rax*1+0x0]
+    db(0x0F);
+    db(0x1F);
+    db(0x44);
+    db(0x00);
+    db(0x00);
+  }
+
   PushStackpoint();
   sub(rsp, (uint32_t)stack_size);
 
@@ -250,6 +280,10 @@ bool X64Emitter::Emit(HIRBuilder* builder, EmitFunctionInfo& func_info) {
 
   mov(qword[rsp + StackLayout::GUEST_CALL_RET_ADDR], rax);  // 0
 
+  if (baseline_function_) {
+    EmitBaselineCallCounter();
+  }
+
 #if XE_X64_PROFILER_AVAILABLE == 1
   if (cvars::instrument_call_times) {
     mov(rdx, 0x7ffe0014);  // load pointer to kusershared systemtime
@@ -260,6 +294,7 @@ bool X64Emitter::Emit(HIRBuilder* builder, EmitFunctionInfo& func_info) {
 #endif
   // Safe now to do some tracing.
   if (debug_info_flags_ & DebugInfoFlags::kDebugInfoTraceFunctions) {
+    MarkCodeNotRelocatable();
     // We require 32-bit addresses.
     assert_true(uint64_t(trace_data_->header()) < UINT_MAX);
     auto trace_header = trace_data_->header();
@@ -381,6 +416,7 @@ void X64Emitter::EmitProfilerEpilogue() {
     mov(ecx, 0x7ffe0014);
     mov(rdx, qword[rcx]);
     mov(r10, (uintptr_t)profiler_entry);
+    MarkCodeNotRelocatable();
     sub(rdx, qword[rsp + StackLayout::GUEST_PROFILER_START]);
 
     // atomic add our time to the profiler entry
@@ -702,11 +738,38 @@ void X64Emitter::Call(const hir::Instr* instr, GuestFunction* function) {
   auto fn = static_cast<X64Function*>(function);
   // Resolve address to the function to call and store in rax.
 
-  if (fn->machine_code()) {
+  if (code_cache_->has_indirection_table()) {
+    // Call directly, either the code of the function or the resolve thunk
+    // until it's translated - the call site is retargeted by the code cache.
+    const void* target =
+        fn->machine_code()
+            ? reinterpret_cast<const void*>(fn->machine_code())
+            : reinterpret_cast<const void*>(
+                  backend()->resolve_function_thunk());
+    if (!(instr->flags & hir::CALL_TAIL)) {
+      mov(rcx, qword[rsp + StackLayout::GUEST_CALL_RET_ADDR]);
+
+      EmitDirectGuestCall(function->address(), target, false);
+      synchronize_stack_on_next_instruction_ = true;
+    } else {
+      // tail call
+      EmitTraceUserCallReturn();
+      EmitProfilerEpilogue();
+      // Pass the callers return address over.
+      mov(rcx, qword[rsp + StackLayout::GUEST_RET_ADDR]);
+
+      add(rsp, static_cast<uint32_t>(stack_size()));
+      PopStackpoint();
+      EmitDirectGuestCall(function->address(), target, true);
+    }
+    return;
+  } else if (fn->machine_code()) {
     if (!(instr->flags & hir::CALL_TAIL)) {
       mov(rcx, qword[rsp + StackLayout::GUEST_CALL_RET_ADDR]);
 
       call((void*)fn->machine_code());
+      AddCodeRelocation(CodeRelocation::Type::kGuestFunctionRel32,
+                        fn->address(), 4);
       synchronize_stack_on_next_instruction_ = true;
     } else {
       // tail call
@@ -718,19 +781,14 @@ void X64Emitter::Call(const hir::Instr* instr, GuestFunction* function) {
       add(rsp, static_cast<uint32_t>(stack_size()));
       PopStackpoint();
       jmp((void*)fn->machine_code(), T_NEAR);
+      AddCodeRelocation(CodeRelocation::Type::kGuestFunctionRel32,
+                        fn->address(), 4);
     }
 
     return;
-  } else if (code_cache_->has_indirection_table()) {
-    // Load the pointer to the indirection table maintained in X64CodeCache.
-    // The target dword will either contain the address of the generated code
-    // or a thunk to ResolveAddress.
-    mov(ebx, function->address());
-    mov(eax, dword[ebx]);
   } else {
     // Old-style resolve.
     // Not too important because indirection table is almost always available.
-    // TODO: Overwrite the call-site with a straight call.
     CallNative(&ResolveFunction, function->address());
   }
 
@@ -754,6 +812,23 @@ void X64Emitter::Call(const hir::Instr* instr, GuestFunction* function) {
   }
 }
 
+void X64Emitter::EmitDirectGuestCall(uint32_t guest_address,
+                                     const void* target, bool tail) {
+  // The resolve thunk takes the guest address in ebx.
+  mov(ebx, guest_address);
+  // Align the rel32 field, which is the last 4 bytes of the instruction, for
+  // atomic retargeting. The code is placed with 16-byte alignment.
+  nop((4 - ((getSize() + 1) & 3)) & 3);
+  if (tail) {
+    jmp(target, T_NEAR);
+  } else {
+    call(target);
+  }
+  AddCodeRelocation(CodeRelocation::Type::kGuestFunctionRel32, guest_address,
+                    4);
+  direct_call_sites_.push_back({uint32_t(getSize() - 4), guest_address});
+}
+
 void X64Emitter::CallIndirect(const hir::Instr* instr,
                               const Xbyak::Reg64& reg) {
   ForgetMxcsrMode();
@@ -775,7 +850,7 @@ void X64Emitter::CallIndirect(const hir::Instr* instr,
     // Old-style resolve.
     // Not too important because indirection table is almost always available.
     mov(edx, reg.cvt32());
-    mov(rax, reinterpret_cast<uint64_t>(ResolveFunction));
+    MovHostImagePointer(rax, reinterpret_cast<void*>(ResolveFunction));
     mov(rcx, GetContextReg());
     call(rax);
   }
@@ -822,10 +897,13 @@ void X64Emitter::CallExtern(const hir::Instr* instr, const Function* function) {
       // rdx = arg0
       // r8  = arg1
       // r9  = arg2
-      mov(rcx, reinterpret_cast<uint64_t>(builtin_function->handler()));
+      MovHostImagePointer(
+          rcx, reinterpret_cast<void*>(builtin_function->handler()));
       mov(rdx, reinterpret_cast<uint64_t>(builtin_function->arg0()));
       mov(r8, reinterpret_cast<uint64_t>(builtin_function->arg1()));
-      call(backend()->guest_to_host_thunk());
+      MarkCodeNotRelocatable();
+      CallHostCode(
+          reinterpret_cast<const void*>(backend()->guest_to_host_thunk()));
       // rax = host return
     }
   } else if (function->behavior() == Function::Behavior::kExtern) {
@@ -836,16 +914,50 @@ void X64Emitter::CallExtern(const hir::Instr* instr, const Function* function) {
       // rdx = arg0
       // r8  = arg1
       // r9  = arg2
-      mov(rcx, reinterpret_cast<uint64_t>(extern_function->extern_handler()));
+      MovHostImagePointer(
+          rcx, reinterpret_cast<void*>(extern_function->extern_handler()));
       mov(rdx,
           qword[GetContextReg() + offsetof(ppc::PPCContext, kernel_state)]);
-      call(backend()->guest_to_host_thunk());
+      CallHostCode(
+          reinterpret_cast<const void*>(backend()->guest_to_host_thunk()));
       // rax = host return
     }
   }
   if (undefined) {
     CallNative(UndefinedCallExtern, reinterpret_cast<uint64_t>(function));
+    MarkCodeNotRelocatable();
+  }
+}
+
+uint64_t RequestFunctionRecompilation(void* raw_context,
+                                      uint64_t function_ptr) {
+  auto function = reinterpret_cast<X64Function*>(function_ptr);
+  if (function->RequestRecompilation()) {
+    auto ppc_context = reinterpret_cast<ppc::PPCContext*>(raw_context);
+    ppc_context->processor->frontend()->QueueFunctionRecompilation(function);
   }
+  return 0;
+}
+
+void X64Emitter::EmitBaselineCallCounter() {
+  // The counter is allocated in the heap, but baseline code is never stored
+  // anyway, as it's only used until the function is recompiled.
+  MarkCodeNotRelocatable();
+  mov(rax, reinterpret_cast<uint64_t>(baseline_function_->call_counter()));
+  add(dword[rax], 1);
+  cmp(dword[rax], uint32_t(std::max(cvars::tiered_jit_threshold, 1)));
+
+  Xbyak::Label& return_from_request = NewCachedLabel();
+  Xbyak::Label& request_label = AddToTail(
+      [&return_from_request, function = baseline_function_](
+          X64Emitter& e, Xbyak::Label& our_tail_label) {
+        e.L(our_tail_label);
+        e.CallNative(RequestFunctionRecompilation,
+                     reinterpret_cast<uint64_t>(function));
+        e.jmp(return_from_request, T_NEAR);
+      });
+  je(request_label, T_NEAR);
+  L(return_from_request);
 }
 
 void X64Emitter::CallNative(void* fn) { CallNativeSafe(fn); }
@@ -869,11 +981,49 @@ void X64Emitter::CallNativeSafe(void* fn) {
   // rdx = arg0
   // r8  = arg1
   // r9  = arg2
-  mov(rcx, reinterpret_cast<uint64_t>(fn));
-  call(backend()->guest_to_host_thunk());
+  MovHostImagePointer(rcx, fn);
+  CallHostCode(reinterpret_cast<const void*>(backend()->guest_to_host_thunk()));
   // rax = host return
 }
 
+void X64Emitter::CallHostCode(const void* target) {
+  call(target);
+  uintptr_t target_address = reinterpret_cast<uintptr_t>(target);
+  uintptr_t code_cache_base = code_cache_->execute_base_address();
+  if (target_address >= code_cache_base &&
+      target_address - code_cache_base < code_cache_->total_size()) {
+    AddCodeRelocation(CodeRelocation::Type::kCodeCacheRel32, target_address,
+                      4);
+  } else {
+    AddCodeRelocation(CodeRelocation::Type::kHostImageRel32,
+                      target_address - X64CodeStorage::host_image_anchor(), 4);
+  }
+}
+
+void X64Emitter::MovHostImagePointer(const Xbyak::Reg64& reg,
+                                     const void* pointer) {
+  size_t mov_offset = getSize();
+  mov(reg, reinterpret_cast<uint64_t>(pointer));
+  if (getSize() - mov_offset == 10) {
+    AddCodeRelocation(CodeRelocation::Type::kHostImageAbs64,
+                      reinterpret_cast<uintptr_t>(pointer) -
+                          X64CodeStorage::host_image_anchor(),
+                      8);
+  } else {
+    // Encoded with a 32-bit immediate, which may be not enough for the
+    // executable placed elsewhere.
+    MarkCodeNotRelocatable();
+  }
+}
+
+void X64Emitter::AddCodeRelocation(CodeRelocation::Type type, uint64_t value,
+                                   size_t field_size) {
+  CodeRelocation& relocation = code_relocations_.emplace_back();
+  relocation.code_offset = uint32_t(getSize() - field_size);
+  relocation.type = type;
+  relocation.value = value;
+}
+
 void X64Emitter::SetReturnAddress(uint64_t value) {
   mov(rax, value);
   mov(qword[rsp + StackLayout::GUEST_CALL_RET_ADDR], rax);
@@ -1820,15 +1970,18 @@ void X64Emitter::EnsureSynchronizedGuestAndHostStack() {
         uint32_t stack32 = static_cast<uint32_t>(e.stack_size());
         auto backend = e.backend();
         if (stack32 < 256) {
-          e.call(backend->synchronize_guest_and_host_stack_helper_for_size(1));
+          e.CallHostCode(
+              backend->synchronize_guest_and_host_stack_helper_for_size(1));
           e.db(stack32);
 
         } else if (stack32 < 65536) {
-          e.call(backend->synchronize_guest_and_host_stack_helper_for_size(2));
+          e.CallHostCode(
+              backend->synchronize_guest_and_host_stack_helper_for_size(2));
           e.dw(stack32);
         } else {
           // ought to be impossible, a host stack bigger than 65536??
-          e.call(backend->synchronize_guest_and_host_stack_helper_for_size(4));
+          e.CallHostCode(
+              backend->synchronize_guest_and_host_stack_helper_for_size(4));
           e.dd(stack32);
         }
         e.jmp(return_from_sync, T_NEAR);
@@ -13,6 +13,7 @@
 #include <vector>
 
 #include "xenia/base/arena.h"
+#include "xenia/cpu/backend/x64/x64_code_storage.h"
 #include "xenia/cpu/function.h"
 #include "xenia/cpu/function_trace_data.h"
 #include "xenia/cpu/hir/hir_builder.h"
@@ -37,6 +38,7 @@ namespace x64 {
 using namespace amd64;
 class X64Backend;
 class X64CodeCache;
+class X64Function;
 
 struct EmitFunctionInfo;
 
@@ -216,10 +218,20 @@ class X64Emitter : public Xbyak::CodeGenerator {
   static uintptr_t PlaceConstData();
   static void FreeConstData(uintptr_t data);
 
+  // Baseline code counts the calls to request the recompilation of the
+  // function.
   bool Emit(GuestFunction* function, hir::HIRBuilder* builder,
             uint32_t debug_info_flags, FunctionDebugInfo* debug_info,
-            void** out_code_address, size_t* out_code_size,
-            std::vector<SourceMapEntry>* out_source_map);
+            bool baseline, void** out_code_address, size_t* out_code_size,
+            std::vector<SourceMapEntry>* out_source_map,
+            EmitFunctionInfo* out_func_info = nullptr);
+
+  // Whether the last emitted function only references host memory that can be
+  // relocated using code_relocations(), and thus can be stored.
+  bool is_code_relocatable() const { return code_relocatable_; }
+  const std::vector<CodeRelocation>& code_relocations() const {
+    return code_relocations_;
+  }
 
  public:
   // Reserved:  rsp, rsi, rdi
@@ -268,6 +280,17 @@ class X64Emitter : public Xbyak::CodeGenerator {
   void CallNative(uint64_t (*fn)(void* raw_context, uint64_t arg0),
                   uint64_t arg0);
   void CallNativeSafe(void* fn);
+  // Calls code at a fixed host address - a thunk or a helper in the code cache,
+  // or a function in the emulator executable. All calls to absolute addresses
+  // must be done through this so the code can be relocated.
+  void CallHostCode(const void* target);
+  // Moves a pointer to a function or to static data in the emulator executable
+  // into a register.
+  void MovHostImagePointer(const Xbyak::Reg64& reg, const void* pointer);
+  // Must be called when emitting a pointer to host memory that is not a part of
+  // the emulator executable, such as heap objects, or anything else that
+  // can't be reproduced in another process.
+  void MarkCodeNotRelocatable() { code_relocatable_ = false; }
   void SetReturnAddress(uint64_t value);
 
   Xbyak::Reg64 GetNativeParam(uint32_t param);
@@ -392,7 +415,16 @@ class X64Emitter : public Xbyak::CodeGenerator {
   bool Emit(hir::HIRBuilder* builder, EmitFunctionInfo& func_info);
   void EmitGetCurrentThreadId();
   void EmitTraceUserCallReturn();
+  // Call or tail jump to a guest function that can be retargeted by the code
+  // cache.
+  void EmitDirectGuestCall(uint32_t guest_address, const void* target,
+                           bool tail);
+  // Counts calls of baseline code and requests recompilation of the function
+  // once it's called often enough.
+  void EmitBaselineCallCounter();
   static void HandleStackpointOverflowError(ppc::PPCContext* context);
+  void AddCodeRelocation(CodeRelocation::Type type, uint64_t value,
+                         size_t field_size);
 
  protected:
   Processor* processor_ = nullptr;
@@ -405,6 +437,8 @@ class X64Emitter : public Xbyak::CodeGenerator {
   Xbyak::util::Cpu cpu_;
   uint64_t feature_flags_ = 0;
   uint32_t current_guest_function_ = 0;
+  // Function being translated without optimizations, if it is.
+  X64Function* baseline_function_ = nullptr;
   Xbyak::Label* epilog_label_ = nullptr;
 
   hir::Instr* current_instr_ = nullptr;
@@ -414,6 +448,15 @@ class X64Emitter : public Xbyak::CodeGenerator {
   FunctionTraceData* trace_data_ = nullptr;
   Arena source_map_arena_;
 
+  bool code_relocatable_ = true;
+  std::vector<CodeRelocation> code_relocations_;
+
+  struct DirectCallSite {
+    uint32_t rel32_offset;
+    uint32_t guest_address;
+  };
+  std::vector<DirectCallSite> direct_call_sites_;
+
   size_t stack_size_ = 0;
 
   static const uint32_t gpr_reg_map_[GPR_COUNT];
@@ -10,6 +10,8 @@
 #ifndef XENIA_CPU_BACKEND_X64_X64_FUNCTION_H_
 #define XENIA_CPU_BACKEND_X64_X64_FUNCTION_H_
 
+#include <atomic>
+
 #include "xenia/cpu/function.h"
 #include "xenia/cpu/thread_state.h"
 
@@ -28,12 +30,29 @@ class X64Function : public GuestFunction {
 
   void Setup(uint8_t* machine_code, size_t machine_code_length);
 
+  // Whether the machine code begins with an instruction that can be replaced
+  // by X64CodeCache::RedirectCode.
+  bool entry_redirectable() const { return entry_redirectable_; }
+  void set_entry_redirectable(bool value) { entry_redirectable_ = value; }
+
+  // Incremented by the baseline machine code on every call.
+  uint32_t* call_counter() { return &call_counter_; }
+  // Returns true only for the first request.
+  bool RequestRecompilation() {
+    return !recompilation_requested_.exchange(true, std::memory_order_relaxed);
+  }
+
  protected:
   bool CallImpl(ThreadState* thread_state, uint32_t return_address) override;
 
  private:
   uint8_t* machine_code_ = nullptr;
   size_t machine_code_length_ = 0;
+  bool entry_redirectable_ = false;
+  // Not atomic, as it's only used as a heuristic, and it's more important for
+  // the baseline code to be fast.
+  uint32_t call_counter_ = 0;
+  std::atomic<bool> recompilation_requested_{false};
 };
 
 }  // namespace x64
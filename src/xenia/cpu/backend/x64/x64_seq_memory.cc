@@ -495,7 +495,7 @@ struct RESERVED_LOAD_INT32
     // atomic op in the store
     e.prefetchw(e.ptr[e.rax]);
     e.mov(e.ecx, i.src1.reg().cvt32());
-    e.call(e.backend()->try_acquire_reservation_helper_);
+    e.CallHostCode(e.backend()->try_acquire_reservation_helper_);
     e.mov(i.dest, e.dword[e.rax]);
 
     e.mov(
@@ -515,7 +515,7 @@ struct RESERVED_LOAD_INT64
     // atomic op in the store
     e.prefetchw(e.ptr[e.rax]);
 
-    e.call(e.backend()->try_acquire_reservation_helper_);
+    e.CallHostCode(e.backend()->try_acquire_reservation_helper_);
     e.mov(i.dest, e.qword[ComputeMemoryAddress(e, i.src1)]);
 
     e.mov(
@@ -540,7 +540,7 @@ struct RESERVED_STORE_INT32
     e.mov(e.ecx, i.src1.reg().cvt32());
     e.lea(e.r9, e.ptr[ComputeMemoryAddress(e, i.src1)]);
     e.mov(e.r8d, i.src2);
-    e.call(e.backend()->reserved_store_32_helper);
+    e.CallHostCode(e.backend()->reserved_store_32_helper);
     e.setz(i.dest);
   }
 };
@@ -552,7 +552,7 @@ struct RESERVED_STORE_INT64
     e.mov(e.ecx, i.src1.reg().cvt32());
     e.lea(e.r9, e.ptr[ComputeMemoryAddress(e, i.src1)]);
     e.mov(e.r8, i.src2);
-    e.call(e.backend()->reserved_store_64_helper);
+    e.CallHostCode(e.backend()->reserved_store_64_helper);
     e.setz(i.dest);
   }
 };
@@ -1127,6 +1127,7 @@ struct LOAD_MMIO_I32
     auto mmio_range = reinterpret_cast<MMIORange*>(i.src1.value);
     auto read_address = uint32_t(i.src2.value);
     e.mov(e.GetNativeParam(0), uint64_t(mmio_range->callback_context));
+    e.MarkCodeNotRelocatable();
     e.mov(e.GetNativeParam(1).cvt32(), read_address);
     e.CallNativeSafe(reinterpret_cast<void*>(mmio_range->read));
     e.bswap(e.eax);
@@ -1152,6 +1153,7 @@ struct STORE_MMIO_I32
     auto mmio_range = reinterpret_cast<MMIORange*>(i.src1.value);
     auto write_address = uint32_t(i.src2.value);
     e.mov(e.GetNativeParam(0), uint64_t(mmio_range->callback_context));
+    e.MarkCodeNotRelocatable();
     e.mov(e.GetNativeParam(1).cvt32(), write_address);
     if (i.src3.is_constant) {
       e.mov(e.GetNativeParam(2).cvt32(), xe::byte_swap(i.src3.constant()));
@@ -33,6 +33,17 @@ DEFINE_bool(trace_function_data, false,
 DEFINE_bool(validate_hir, false,
             "Perform validation checks on the HIR during compilation.", "CPU");
 
+DEFINE_bool(tiered_jit, false,
+            "Translate functions quickly without optimizations at first, and "
+            "recompile them with all optimizations on a background thread "
+            "once they have been called tiered_jit_threshold times.",
+            "CPU");
+DEFINE_int32(tiered_jit_threshold, 1000,
+             "Number of calls after which a function translated without "
+             "optimizations is recompiled with them when tiered_jit is "
+             "enabled.",
+             "CPU");
+
 DEFINE_uint64(
     pvr, 0x710700,
     "Processor version and revision number.\nBits 0 to 15 are the version "
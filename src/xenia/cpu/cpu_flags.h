@@ -24,6 +24,9 @@ DECLARE_bool(trace_function_data);
 
 DECLARE_bool(validate_hir);
 
+DECLARE_bool(tiered_jit);
+DECLARE_int32(tiered_jit_threshold);
+
 DECLARE_uint64(pvr);
 
 // Breakpoints:
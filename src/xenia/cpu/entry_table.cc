@@ -9,98 +9,160 @@
 
 #include "xenia/cpu/entry_table.h"
 
+#include <algorithm>
+#include <mutex>
+
+#include "xenia/base/assert.h"
 #include "xenia/base/profiling.h"
-#include "xenia/base/threading.h"
 
 namespace xe {
 namespace cpu {
 
-EntryTable::EntryTable() = default;
+EntryTable::EntryTable() : pages_(new std::atomic<Page*>[kPageCount]()) {}
 
 EntryTable::~EntryTable() {
-  auto global_lock = global_critical_region_.Acquire();
-  for (auto it : map_.Values()) {
-    Entry* entry = it;
+  for (size_t i = 0; i < kPageCount; ++i) {
+    delete pages_[i].load(std::memory_order_relaxed);
+  }
+  for (Entry* entry : entries_) {
+    delete entry;
+  }
+  for (Entry* entry : retired_entries_) {
     delete entry;
   }
 }
 
-Entry* EntryTable::Get(uint32_t address) {
-  auto global_lock = global_critical_region_.Acquire();
-  uint32_t idx = map_.IndexForKey(address);
-  if (idx == map_.size() || *map_.KeyAt(idx) != address) {
+std::atomic<Entry*>* EntryTable::GetSlot(uint32_t address, bool create) {
+  // Guest code is always 4-byte-aligned, and indirect branches ignore the
+  // lower bits of the target.
+  if (address & ((uint32_t(1) << kSlotShift) - 1)) {
     return nullptr;
   }
-  Entry* entry = *map_.ValueAt(idx);
-  if (entry) {
-    // TODO(benvanik): wait if needed?
-    if (entry->status != Entry::STATUS_READY) {
-      entry = nullptr;
+  std::atomic<Page*>& page_ref = pages_[address >> kPageShift];
+  Page* page = page_ref.load(std::memory_order_acquire);
+  if (!page) {
+    if (!create) {
+      return nullptr;
+    }
+    Page* new_page = new Page();
+    if (page_ref.compare_exchange_strong(page, new_page,
+                                         std::memory_order_acq_rel,
+                                         std::memory_order_acquire)) {
+      page = new_page;
+    } else {
+      // Another thread has allocated the page first.
+      delete new_page;
     }
   }
+  return &page->entries[(address & ((uint32_t(1) << kPageShift) - 1)) >>
+                        kSlotShift];
+}
+
+Entry* EntryTable::Get(uint32_t address) {
+  std::atomic<Entry*>* slot = GetSlot(address, false);
+  if (!slot) {
+    return nullptr;
+  }
+  Entry* entry = slot->load(std::memory_order_acquire);
+  if (entry && entry->status.load(std::memory_order_acquire) !=
+                   Entry::STATUS_READY) {
+    entry = nullptr;
+  }
   return entry;
 }
 
 Entry::Status EntryTable::GetOrCreate(uint32_t address, Entry** out_entry) {
-  // TODO(benvanik): replace with a map with wait-free for find.
-  // https://github.com/facebook/folly/blob/master/folly/AtomicHashMap.h
-
-  auto global_lock = global_critical_region_.Acquire();
-
-  uint32_t idx = map_.IndexForKey(address);
+  std::atomic<Entry*>* slot = GetSlot(address, true);
+  if (!slot) {
+    *out_entry = nullptr;
+    return Entry::STATUS_FAILED;
+  }
 
-  Entry* entry = idx != map_.size() && *map_.KeyAt(idx) == address
-                     ? *map_.ValueAt(idx)
-                     : nullptr;
-  Entry::Status status;
-  if (entry) {
-    // If we aren't ready yet spin and wait.
-    if (entry->status == Entry::STATUS_COMPILING) {
-      // chrispy: i think this is dead code, if we are compiling we're holding
-      // the global lock, arent we? so we wouldnt be executing here
-      // Still compiling, so spin.
-      do {
-        global_lock.unlock();
-        // TODO(benvanik): sleep for less time?
-        xe::threading::Sleep(std::chrono::microseconds(10));
-        global_lock.lock();
-      } while (entry->status == Entry::STATUS_COMPILING);
-    }
-    status = entry->status;
-  } else {
+  Entry* entry = slot->load(std::memory_order_acquire);
+  if (!entry) {
     // Create and return for initialization.
-    entry = new Entry();
-    entry->address = address;
-    entry->end_address = 0;
-    entry->status = Entry::STATUS_COMPILING;
-    entry->function = 0;
-    map_.InsertAt(address, entry, idx);
-    // map_[address] = entry;
-    status = Entry::STATUS_NEW;
-  }
-  global_lock.unlock();
+    Entry* new_entry = new Entry();
+    new_entry->address = address;
+    new_entry->end_address = 0;
+    new_entry->status.store(Entry::STATUS_COMPILING, std::memory_order_relaxed);
+    new_entry->function = nullptr;
+    if (slot->compare_exchange_strong(entry, new_entry,
+                                      std::memory_order_acq_rel,
+                                      std::memory_order_acquire)) {
+      {
+        std::lock_guard<xe_mutex> lock(entries_lock_);
+        entries_.push_back(new_entry);
+      }
+      *out_entry = new_entry;
+      return Entry::STATUS_NEW;
+    }
+    // Another thread has created the entry first.
+    delete new_entry;
+  }
+
+  Entry::Status status = entry->status.load(std::memory_order_acquire);
+  if (status == Entry::STATUS_COMPILING) {
+    // Another thread is compiling the function - wait until it's done.
+    WaitForCompilation(entry);
+    status = entry->status.load(std::memory_order_acquire);
+  }
   *out_entry = entry;
   return status;
 }
 
+void EntryTable::SetStatus(Entry* entry, Entry::Status status) {
+  entry->status.store(status, std::memory_order_seq_cst);
+  // Paired with the waiter count increment in WaitForCompilation - either the
+  // waiter sees the new status, or this sees the waiter.
+  if (compile_waiters_.load(std::memory_order_seq_cst)) {
+    // Synchronize with waiters that have checked the status, but have not
+    // started waiting on the condition variable yet.
+    { std::lock_guard<xe_mutex> lock(compile_wait_lock_); }
+    compile_wait_cond_.notify_all();
+  }
+}
+
+void EntryTable::WaitForCompilation(Entry* entry) {
+  SCOPE_profile_cpu_f("cpu");
+  std::unique_lock<xe_mutex> lock(compile_wait_lock_);
+  compile_waiters_.fetch_add(1, std::memory_order_seq_cst);
+  while (entry->status.load(std::memory_order_seq_cst) ==
+         Entry::STATUS_COMPILING) {
+    compile_wait_cond_.wait(lock);
+  }
+  compile_waiters_.fetch_sub(1, std::memory_order_relaxed);
+}
+
 void EntryTable::Delete(uint32_t address) {
-  auto global_lock = global_critical_region_.Acquire();
-  // doesnt this leak memory by not deleting the entry?
-  uint32_t idx = map_.IndexForKey(address);
-  if (idx != map_.size() && *map_.KeyAt(idx) == address) {
-    map_.EraseAt(idx);
+  std::atomic<Entry*>* slot = GetSlot(address, false);
+  if (!slot) {
+    return;
+  }
+  Entry* entry = slot->exchange(nullptr, std::memory_order_acq_rel);
+  if (!entry) {
+    return;
   }
+  // Other threads may still be holding the entry, so keep it alive until the
+  // table is destroyed.
+  std::lock_guard<xe_mutex> lock(entries_lock_);
+  auto it = std::find(entries_.begin(), entries_.end(), entry);
+  assert_true(it != entries_.end());
+  if (it != entries_.end()) {
+    *it = entries_.back();
+    entries_.pop_back();
+  }
+  retired_entries_.push_back(entry);
 }
 
 std::vector<Function*> EntryTable::FindWithAddress(uint32_t address) {
-  auto global_lock = global_critical_region_.Acquire();
+  std::lock_guard<xe_mutex> lock(entries_lock_);
   std::vector<Function*> fns;
-  for (auto& it : map_.Values()) {
-    Entry* entry = it;
+  for (Entry* entry : entries_) {
+    if (entry->status.load(std::memory_order_acquire) != Entry::STATUS_READY) {
+      continue;
+    }
     if (address >= entry->address && address <= entry->end_address) {
-      if (entry->status == Entry::STATUS_READY) {
-        fns.push_back(entry->function);
-      }
+      fns.push_back(entry->function);
     }
   }
   return fns;
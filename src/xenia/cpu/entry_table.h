@@ -10,11 +10,13 @@
 #ifndef XENIA_CPU_ENTRY_TABLE_H_
 #define XENIA_CPU_ENTRY_TABLE_H_
 
-#include <unordered_map>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
 #include <vector>
 
 #include "xenia/base/mutex.h"
-#include "xenia/base/split_map.h"
 namespace xe {
 namespace cpu {
 
@@ -30,26 +32,62 @@ typedef struct Entry_t {
 
   uint32_t address;
   uint32_t end_address;
-  Status status;
+  // Must be changed via EntryTable::SetStatus once the entry has been handed
+  // out, so threads waiting for the compilation are woken up. function and
+  // end_address must be written before the status is set to STATUS_READY.
+  std::atomic<Status> status;
   Function* function;
 } Entry;
 
+// Guest address -> function entry map with wait-free lookups, as it's queried
+// by all guest threads on indirect calls. Entries are stored in a two-level
+// radix table indexed by the instruction address, with pages allocated on
+// demand. Entries are never freed while the table is alive, so pointers
+// returned by it stay valid even if the entry is deleted concurrently.
 class EntryTable {
  public:
   EntryTable();
   ~EntryTable();
 
   Entry* Get(uint32_t address);
+  // Returns STATUS_NEW if the entry has just been created - the caller must
+  // compile the function and then call SetStatus with STATUS_READY or
+  // STATUS_FAILED. If another thread is compiling the function, waits until
+  // it's done.
   Entry::Status GetOrCreate(uint32_t address, Entry** out_entry);
+  void SetStatus(Entry* entry, Entry::Status status);
   void Delete(uint32_t address);
 
   std::vector<Function*> FindWithAddress(uint32_t address);
 
  private:
-  xe::global_critical_region global_critical_region_;
-  // TODO(benvanik): replace with a better data structure.
-  xe::split_map<uint32_t, Entry*> map_;
-  // std::unordered_map<uint32_t, Entry*> map_;
+  // Guest instructions are 4-byte-aligned.
+  static constexpr uint32_t kSlotShift = 2;
+  static constexpr uint32_t kPageShift = 16;
+  static constexpr size_t kPageCount = size_t(1) << (32 - kPageShift);
+  static constexpr size_t kSlotsPerPage = size_t(1)
+                                          << (kPageShift - kSlotShift);
+  struct Page {
+    std::atomic<Entry*> entries[kSlotsPerPage];
+  };
+
+  std::atomic<Entry*>* GetSlot(uint32_t address, bool create);
+  void WaitForCompilation(Entry* entry);
+
+  std::unique_ptr<std::atomic<Page*>[]> pages_;
+
+  // Protects the list of all entries (for range lookups and destruction),
+  // entry creation is rare, so this is only taken on the slow path.
+  xe_mutex entries_lock_;
+  std::vector<Entry*> entries_;
+  // Entries removed from the table, which may still be referenced by other
+  // threads.
+  std::vector<Entry*> retired_entries_;
+
+  // Threads waiting for STATUS_COMPILING to change.
+  xe_mutex compile_wait_lock_;
+  std::condition_variable_any compile_wait_cond_;
+  std::atomic<uint32_t> compile_waiters_{0};
 };
 
 }  // namespace cpu
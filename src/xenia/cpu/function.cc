@@ -9,6 +9,8 @@
 
 #include "xenia/cpu/function.h"
 
+#include <mutex>
+
 #include "xenia/base/logging.h"
 #include "xenia/cpu/symbol.h"
 #include "xenia/cpu/thread_state.h"
@@ -89,16 +91,21 @@ const SourceMapEntry* GuestFunction::LookupHIROffset(uint32_t offset) const {
   return nullptr;
 }
 
-const SourceMapEntry* GuestFunction::LookupMachineCodeOffset(
-    uint32_t offset) const {
+static const SourceMapEntry* LookupMachineCodeOffsetInSourceMap(
+    const std::vector<SourceMapEntry>& source_map, uint32_t offset) {
   // TODO(benvanik): binary search? We know the list is sorted by code order.
-  for (int64_t i = source_map_.size() - 1; i >= 0; --i) {
-    const auto& entry = source_map_[i];
+  for (int64_t i = source_map.size() - 1; i >= 0; --i) {
+    const auto& entry = source_map[i];
     if (entry.code_offset <= offset) {
       return &entry;
     }
   }
-  return source_map_.empty() ? nullptr : &source_map_[0];
+  return source_map.empty() ? nullptr : &source_map[0];
+}
+
+const SourceMapEntry* GuestFunction::LookupMachineCodeOffset(
+    uint32_t offset) const {
+  return LookupMachineCodeOffsetInSourceMap(source_map_, offset);
 }
 
 uint32_t GuestFunction::MapGuestAddressToMachineCodeOffset(
@@ -120,11 +127,29 @@ uintptr_t GuestFunction::MapGuestAddressToMachineCode(
 
 uint32_t GuestFunction::MapMachineCodeToGuestAddress(
     uintptr_t host_address) const {
+  std::lock_guard<xe_unlikely_mutex> lock(source_map_lock_);
+  for (const RetainedSourceMap& retained : retained_source_maps_) {
+    if (host_address - retained.machine_code < retained.machine_code_length) {
+      // Still executing the code the function had before being recompiled.
+      auto entry = LookupMachineCodeOffsetInSourceMap(
+          retained.source_map,
+          static_cast<uint32_t>(host_address - retained.machine_code));
+      return entry ? entry->guest_address : address();
+    }
+  }
   auto entry = LookupMachineCodeOffset(static_cast<uint32_t>(
       host_address - reinterpret_cast<uintptr_t>(machine_code())));
   return entry ? entry->guest_address : address();
 }
 
+void GuestFunction::RetainSourceMap() {
+  RetainedSourceMap& retained = retained_source_maps_.emplace_back();
+  retained.machine_code = reinterpret_cast<uintptr_t>(machine_code());
+  retained.machine_code_length = machine_code_length();
+  retained.source_map = std::move(source_map_);
+  source_map_.clear();
+}
+
 bool GuestFunction::Call(ThreadState* thread_state, uint32_t return_address) {
   // SCOPE_profile_cpu_f("cpu");
 
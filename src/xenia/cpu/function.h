@@ -13,6 +13,7 @@
 #include <memory>
 #include <vector>
 
+#include "xenia/base/mutex.h"
 #include "xenia/cpu/function_debug_info.h"
 #include "xenia/cpu/function_trace_data.h"
 #include "xenia/cpu/ppc/ppc_context.h"
@@ -137,6 +138,19 @@ class GuestFunction : public Function {
   FunctionTraceData& trace_data() { return trace_data_; }
   std::vector<SourceMapEntry>& source_map() { return source_map_; }
 
+  // Whether the machine code has been translated without optimizations, to be
+  // replaced with optimized code once the function is called frequently.
+  bool is_baseline() const { return is_baseline_; }
+  void set_baseline(bool value) { is_baseline_ = value; }
+
+  // Must be held while replacing the machine code and the source map of a
+  // function that may be executing already.
+  xe_unlikely_mutex& source_map_lock() const { return source_map_lock_; }
+  // Keeps the current source map for lookups in the current machine code, which
+  // may still be executing on other threads after the function has been
+  // translated again. source_map_lock must be held.
+  void RetainSourceMap();
+
   ExternHandler extern_handler() const { return extern_handler_; }
   Export* export_data() const { return export_data_; }
   void SetupExtern(ExternHandler handler, Export* export_data = nullptr);
@@ -158,6 +172,14 @@ class GuestFunction : public Function {
   std::unique_ptr<FunctionDebugInfo> debug_info_;
   FunctionTraceData trace_data_;
   std::vector<SourceMapEntry> source_map_;
+  bool is_baseline_ = false;
+  mutable xe_unlikely_mutex source_map_lock_;
+  struct RetainedSourceMap {
+    uintptr_t machine_code;
+    size_t machine_code_length;
+    std::vector<SourceMapEntry> source_map;
+  };
+  std::vector<RetainedSourceMap> retained_source_maps_;
   ExternHandler extern_handler_ = nullptr;
   Export* export_data_ = nullptr;
 };
@@ -62,12 +62,15 @@ MMIOHandler::MMIOHandler(uint8_t* virtual_membase, uint8_t* physical_membase,
     : virtual_membase_(virtual_membase),
       physical_membase_(physical_membase),
       memory_end_(membase_end),
+      range_block_table_(new uint8_t[kRangeBlockCount]()),
       host_to_guest_virtual_(host_to_guest_virtual),
       host_to_guest_virtual_context_(host_to_guest_virtual_context),
       access_violation_callback_(access_violation_callback),
       access_violation_callback_context_(access_violation_callback_context),
       record_mmio_callback_(record_mmio_callback),
-      record_mmio_context_(record_mmio_context) {}
+      record_mmio_context_(record_mmio_context) {
+  mapped_ranges_.reserve(kRangeBlockShared - 1);
+}
 
 MMIOHandler::~MMIOHandler() {
   ExceptionHandler::Uninstall(ExceptionCallbackThunk, this);
@@ -80,6 +83,10 @@ bool MMIOHandler::RegisterRange(uint32_t virtual_address, uint32_t mask,
                                 uint32_t size, void* context,
                                 MMIOReadCallback read_callback,
                                 MMIOWriteCallback write_callback) {
+  if (mapped_ranges_.size() >= mapped_ranges_.capacity()) {
+    assert_always("Too many MMIO ranges");
+    return false;
+  }
   mapped_ranges_.push_back({
       virtual_address,
       mask,
@@ -88,10 +95,29 @@ bool MMIOHandler::RegisterRange(uint32_t virtual_address, uint32_t mask,
       read_callback,
       write_callback,
   });
+  auto range_index = uint8_t(mapped_ranges_.size());
+  // Mark all blocks containing addresses that may match the range.
+  uint32_t block_mask = mask >> kRangeBlockShift;
+  uint32_t block_address = (virtual_address & mask) >> kRangeBlockShift;
+  for (size_t block = 0; block < kRangeBlockCount; ++block) {
+    if ((uint32_t(block) & block_mask) != block_address) {
+      continue;
+    }
+    uint8_t& block_range = range_block_table_[block];
+    block_range = block_range ? kRangeBlockShared : range_index;
+  }
   return true;
 }
 
 MMIORange* MMIOHandler::LookupRange(uint32_t virtual_address) {
+  uint8_t block_range = range_block_table_[virtual_address >> kRangeBlockShift];
+  if (!block_range) {
+    return nullptr;
+  }
+  if (block_range != kRangeBlockShared) {
+    MMIORange& range = mapped_ranges_[block_range - 1];
+    return (virtual_address & range.mask) == range.address ? &range : nullptr;
+  }
   for (auto& range : mapped_ranges_) {
     if ((virtual_address & range.mask) == range.address) {
       return &range;
@@ -101,24 +127,22 @@ MMIORange* MMIOHandler::LookupRange(uint32_t virtual_address) {
 }
 
 bool MMIOHandler::CheckLoad(uint32_t virtual_address, uint32_t* out_value) {
-  for (const auto& range : mapped_ranges_) {
-    if ((virtual_address & range.mask) == range.address) {
-      *out_value = static_cast<uint32_t>(
-          range.read(nullptr, range.callback_context, virtual_address));
-      return true;
-    }
+  const MMIORange* range = LookupRange(virtual_address);
+  if (!range) {
+    return false;
   }
-  return false;
+  *out_value = static_cast<uint32_t>(
+      range->read(nullptr, range->callback_context, virtual_address));
+  return true;
 }
 
 bool MMIOHandler::CheckStore(uint32_t virtual_address, uint32_t value) {
-  for (const auto& range : mapped_ranges_) {
-    if ((virtual_address & range.mask) == range.address) {
-      range.write(nullptr, range.callback_context, virtual_address, value);
-      return true;
-    }
+  const MMIORange* range = LookupRange(virtual_address);
+  if (!range) {
+    return false;
   }
-  return false;
+  range->write(nullptr, range->callback_context, virtual_address, value);
+  return true;
 }
 
 bool MMIOHandler::TryDecodeLoadStore(const uint8_t* p,
@@ -421,21 +445,13 @@ bool MMIOHandler::ExceptionCallback(Exception* ex) {
 
   void* fault_host_address = reinterpret_cast<void*>(ex->fault_address());
 
-  // Access violations are pretty rare, so we can do a linear search here.
   // Only check if in the virtual range, as we only support virtual ranges.
   const MMIORange* range = nullptr;
   uint32_t fault_guest_virtual_address = 0;
   if (ex->fault_address() < uint64_t(physical_membase_)) {
     fault_guest_virtual_address = host_to_guest_virtual_(
         host_to_guest_virtual_context_, fault_host_address);
-    for (const auto& test_range : mapped_ranges_) {
-      if ((fault_guest_virtual_address & test_range.mask) ==
-          test_range.address) {
-        // Address is within the range of this mapping.
-        range = &test_range;
-        break;
-      }
-    }
+    range = LookupRange(fault_guest_virtual_address);
   }
   if (!range) {
     // Recheck if the pages are still protected (race condition - another thread
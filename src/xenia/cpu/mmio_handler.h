@@ -10,6 +10,7 @@
 #ifndef XENIA_CPU_MMIO_HANDLER_H_
 #define XENIA_CPU_MMIO_HANDLER_H_
 
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <vector>
@@ -94,7 +95,18 @@ class MMIOHandler {
   uint8_t* physical_membase_;
   uint8_t* memory_end_;
 
+  // Ranges are looked up through blocks of the guest virtual address space,
+  // the granularity of the ranges of the devices.
+  static constexpr uint32_t kRangeBlockShift = 16;
+  static constexpr size_t kRangeBlockCount = size_t(1)
+                                             << (32 - kRangeBlockShift);
+  // Block contains multiple ranges, which need to be checked one by one.
+  static constexpr uint8_t kRangeBlockShared = UINT8_MAX;
+  // Never reallocated, as generated code references the ranges.
   std::vector<MMIORange> mapped_ranges_;
+  // Index + 1 of the range in mapped_ranges_ for each block, or 0 if no range
+  // is in the block.
+  std::unique_ptr<uint8_t[]> range_block_table_;
 
   HostToGuestVirtual host_to_guest_virtual_;
   const void* host_to_guest_virtual_context_;
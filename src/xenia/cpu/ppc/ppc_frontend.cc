@@ -9,9 +9,15 @@
 
 #include "xenia/cpu/ppc/ppc_frontend.h"
 
+#include <algorithm>
+#include <mutex>
+
+#include "xenia/base/assert.h"
 #include "xenia/base/atomic.h"
+#include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/mutex.h"
+#include "xenia/cpu/cpu_flags.h"
 #include "xenia/cpu/ppc/ppc_context.h"
 #include "xenia/cpu/ppc/ppc_emit.h"
 #include "xenia/cpu/ppc/ppc_opcode_info.h"
@@ -48,6 +54,7 @@ PPCFrontend::PPCFrontend(Processor* processor) : processor_(processor) {
 }
 
 PPCFrontend::~PPCFrontend() {
+  ShutdownFunctionRecompilation();
   // Force cleanup now before we deinit.
   translator_pool_.Reset();
 }
@@ -123,12 +130,88 @@ bool PPCFrontend::DeclareFunction(GuestFunction* function) {
 bool PPCFrontend::DefineFunction(GuestFunction* function,
                                  uint32_t debug_info_flags) {
   auto translator = translator_pool_.Allocate(this);
-  bool result = translator->Translate(function, debug_info_flags);
+  bool result =
+      translator->Translate(function, debug_info_flags, cvars::tiered_jit);
   translator->Reset();
   translator_pool_.Release(translator);
   return result;
 }
 
+void PPCFrontend::QueueFunctionRecompilation(GuestFunction* function) {
+  std::lock_guard<xe_mutex> lock(recompilation_lock_);
+  if (recompilation_shutdown_ ||
+      std::find(recompilation_queue_.begin(), recompilation_queue_.end(),
+                function) != recompilation_queue_.end()) {
+    return;
+  }
+  recompilation_queue_.push_back(function);
+  if (!recompilation_thread_) {
+    xe::threading::Thread::CreationParameters thread_params;
+    thread_params.initial_priority = xe::threading::ThreadPriority::kLowest;
+    recompilation_thread_ = xe::threading::Thread::Create(
+        thread_params, [this]() { RecompilationThread(); });
+    assert_not_null(recompilation_thread_);
+    recompilation_thread_->set_name("Function Recompilation");
+  }
+  recompilation_cond_.notify_all();
+}
+
+void PPCFrontend::CancelFunctionRecompilation(Module* module) {
+  std::unique_lock<xe_mutex> lock(recompilation_lock_);
+  recompilation_queue_.erase(
+      std::remove_if(recompilation_queue_.begin(), recompilation_queue_.end(),
+                     [module](GuestFunction* function) {
+                       return function->module() == module;
+                     }),
+      recompilation_queue_.end());
+  while (recompiling_function_ && recompiling_function_->module() == module) {
+    recompilation_cond_.wait(lock);
+  }
+}
+
+void PPCFrontend::ShutdownFunctionRecompilation() {
+  {
+    std::lock_guard<xe_mutex> lock(recompilation_lock_);
+    recompilation_shutdown_ = true;
+    recompilation_queue_.clear();
+    recompilation_cond_.notify_all();
+  }
+  if (recompilation_thread_) {
+    xe::threading::Wait(recompilation_thread_.get(), false);
+    recompilation_thread_.reset();
+  }
+}
+
+void PPCFrontend::RecompilationThread() {
+  while (true) {
+    GuestFunction* function;
+    {
+      std::unique_lock<xe_mutex> lock(recompilation_lock_);
+      if (recompiling_function_) {
+        recompiling_function_ = nullptr;
+        recompilation_cond_.notify_all();
+      }
+      while (!recompilation_shutdown_ && recompilation_queue_.empty()) {
+        recompilation_cond_.wait(lock);
+      }
+      if (recompilation_shutdown_) {
+        return;
+      }
+      function = recompilation_queue_.front();
+      recompilation_queue_.pop_front();
+      recompiling_function_ = function;
+    }
+    // The function stays defined, so the baseline code keeps being used if the
+    // recompilation fails.
+    auto translator = translator_pool_.Allocate(this);
+    if (!translator->Recompile(function)) {
+      XELOGW("Failed to recompile function {:08X}", function->address());
+    }
+    translator->Reset();
+    translator_pool_.Release(translator);
+  }
+}
+
 }  // namespace ppc
 }  // namespace cpu
 }  // namespace xe
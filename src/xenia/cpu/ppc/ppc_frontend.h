@@ -10,8 +10,12 @@
 #ifndef XENIA_CPU_PPC_PPC_FRONTEND_H_
 #define XENIA_CPU_PPC_PPC_FRONTEND_H_
 
+#include <condition_variable>
+#include <deque>
 #include <memory>
 
+#include "xenia/base/mutex.h"
+#include "xenia/base/threading.h"
 #include "xenia/base/type_pool.h"
 #include "xenia/cpu/function.h"
 #include "xenia/memory.h"
@@ -50,10 +54,30 @@ class PPCFrontend {
   bool DeclareFunction(GuestFunction* function);
   bool DefineFunction(GuestFunction* function, uint32_t debug_info_flags);
 
+  // Translates a function again with optimizations on a background thread,
+  // either because it has been translated without them (see cvars::tiered_jit)
+  // or because the translation hints for its instructions have changed.
+  void QueueFunctionRecompilation(GuestFunction* function);
+  // Drops the pending recompilation of the functions of the module, and waits
+  // for the one being recompiled if it's from the module. Must be called before
+  // the module is destroyed.
+  void CancelFunctionRecompilation(Module* module);
+  void ShutdownFunctionRecompilation();
+
  private:
+  void RecompilationThread();
+
   Processor* processor_;
   PPCBuiltins builtins_ = {0};
   TypePool<PPCTranslator, PPCFrontend*> translator_pool_;
+
+  xe_mutex recompilation_lock_;
+  // Notified when a function is queued, or when a recompilation is done.
+  std::condition_variable_any recompilation_cond_;
+  std::deque<GuestFunction*> recompilation_queue_;
+  GuestFunction* recompiling_function_ = nullptr;
+  bool recompilation_shutdown_ = false;
+  std::unique_ptr<xe::threading::Thread> recompilation_thread_;
 };
 // Checks the state of the global lock and sets scratch to the current MSR
 // value.
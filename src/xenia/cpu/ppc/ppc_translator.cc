@@ -97,6 +97,22 @@ PPCTranslator::PPCTranslator(PPCFrontend* frontend) : frontend_(frontend) {
 
   // Must come last. The HIR is not really HIR after this.
   compiler_->AddPass(std::make_unique<passes::FinalizationPass>());
+
+  // Baseline translation. Constant propagation is cheap, and it's needed for
+  // folding instructions with only constant operands, which the backend
+  // doesn't handle.
+  baseline_compiler_.reset(new Compiler(frontend->processor()));
+  baseline_compiler_->AddPass(
+      std::make_unique<passes::ConstantPropagationPass>());
+  if (validate) {
+    baseline_compiler_->AddPass(std::make_unique<passes::ValidationPass>());
+  }
+  baseline_compiler_->AddPass(std::make_unique<passes::RegisterAllocationPass>(
+      backend->machine_info()));
+  if (validate) {
+    baseline_compiler_->AddPass(std::make_unique<passes::ValidationPass>());
+  }
+  baseline_compiler_->AddPass(std::make_unique<passes::FinalizationPass>());
 }
 
 PPCTranslator::~PPCTranslator() = default;
@@ -151,12 +167,13 @@ void PPCTranslator::DumpHIR(GuestFunction* function, PPCHIRBuilder* builder) {
   }
 }
 bool PPCTranslator::Translate(GuestFunction* function,
-                              uint32_t debug_info_flags) {
+                              uint32_t debug_info_flags, bool baseline) {
   SCOPE_profile_cpu_f("cpu");
   HirBuilderScope hir_build_scope{builder_.get()};
   // Reset() all caching when we leave.
   xe::make_reset_scope(builder_);
   xe::make_reset_scope(compiler_);
+  xe::make_reset_scope(baseline_compiler_);
   xe::make_reset_scope(assembler_);
   xe::make_reset_scope(&string_buffer_);
 
@@ -186,6 +203,14 @@ bool PPCTranslator::Translate(GuestFunction* function,
     return false;
   }
 
+  // Use the previously generated machine code if it's still valid.
+  if (!debug_info_flags && assembler_->AssembleFromStorage(function)) {
+    return true;
+  }
+
+  baseline = baseline && !debug_info_flags;
+  function->set_baseline(baseline);
+
   // Setup trace data, if needed.
   if (debug_info_flags & DebugInfoFlags::kDebugInfoTraceFunctions) {
     // Base trace data.
@@ -231,7 +256,8 @@ bool PPCTranslator::Translate(GuestFunction* function,
   }
 
   // Compile/optimize/etc.
-  if (!compiler_->Compile(builder_.get())) {
+  Compiler* compiler = baseline ? baseline_compiler_.get() : compiler_.get();
+  if (!compiler->Compile(builder_.get())) {
     return false;
   }
 
@@ -252,6 +278,24 @@ bool PPCTranslator::Translate(GuestFunction* function,
 
   return true;
 }
+bool PPCTranslator::Recompile(GuestFunction* function) {
+  SCOPE_profile_cpu_f("cpu");
+  HirBuilderScope hir_build_scope{builder_.get()};
+  // Reset() all caching when we leave.
+  xe::make_reset_scope(builder_);
+  xe::make_reset_scope(compiler_);
+  xe::make_reset_scope(assembler_);
+
+  // Already scanned for the baseline translation.
+  if (!builder_->Emit(function, 0)) {
+    return false;
+  }
+  if (!compiler_->Compile(builder_.get())) {
+    return false;
+  }
+  return assembler_->AssembleReplacement(function, builder_.get());
+}
+
 void PPCTranslator::Reset() { builder_->ResetPools(); }
 void PPCTranslator::DumpSource(GuestFunction* function,
                                StringBuffer* string_buffer) {
@@ -30,7 +30,16 @@ class PPCTranslator {
   explicit PPCTranslator(PPCFrontend* frontend);
   ~PPCTranslator();
 
-  bool Translate(GuestFunction* function, uint32_t debug_info_flags);
+  // Baseline translation skips the optimizations, for functions that may be
+  // called too rarely for them to pay off - such functions are translated
+  // again with all optimizations if they're called frequently. Ignored if any
+  // debug info is needed.
+  bool Translate(GuestFunction* function, uint32_t debug_info_flags,
+                 bool baseline = false);
+  // Translates a baseline function, which may be executing on other threads,
+  // again with all optimizations, and replaces its machine code. The rest of
+  // the function, such as its extents from the scan, is not modified.
+  bool Recompile(GuestFunction* function);
   void DumpHIR(GuestFunction* function, PPCHIRBuilder* builder);
   void Reset();
 
@@ -41,6 +50,8 @@ class PPCTranslator {
   std::unique_ptr<PPCScanner> scanner_;
   std::unique_ptr<PPCHIRBuilder> builder_;
   std::unique_ptr<compiler::Compiler> compiler_;
+  // Only the passes needed by the backend.
+  std::unique_ptr<compiler::Compiler> baseline_compiler_;
   std::unique_ptr<backend::Assembler> assembler_;
 
   StringBuffer string_buffer_;
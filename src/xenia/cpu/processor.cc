@@ -86,6 +86,12 @@ Processor::Processor(xe::Memory* memory, ExportResolver* export_resolver)
     : memory_(memory), export_resolver_(export_resolver) {}
 
 Processor::~Processor() {
+  // Before destroying the functions being recompiled. Not under the global
+  // lock, as placing the code requires it.
+  if (frontend_) {
+    frontend_->ShutdownFunctionRecompilation();
+  }
+
   {
     auto global_lock = global_critical_region_.Acquire();
     modules_.clear();
@@ -176,6 +182,12 @@ bool Processor::AddModule(std::unique_ptr<Module> module) {
 }
 
 void Processor::RemoveModule(const std::string_view name) {
+  // Not under the global lock, as recompilation requires it to place the code.
+  Module* removed_module = GetModule(name);
+  if (removed_module && frontend_) {
+    frontend_->CancelFunctionRecompilation(removed_module);
+  }
+
   auto global_lock = global_critical_region_.Acquire();
 
   auto itr =
@@ -247,6 +259,7 @@ std::vector<Function*> Processor::FindFunctionsWithAddress(uint32_t address) {
 
 void Processor::RemoveFunctionByAddress(uint32_t address) {
   entry_table_.Delete(address);
+  backend_->RemoveFunction(address);
 }
 
 Function* Processor::ResolveFunction(uint32_t address) {
@@ -259,12 +272,12 @@ Function* Processor::ResolveFunction(uint32_t address) {
     auto function = LookupFunction(address);
 
     if (!function) {
-      entry->status = Entry::STATUS_FAILED;
+      entry_table_.SetStatus(entry, Entry::STATUS_FAILED);
       return nullptr;
     }
 
     if (!DemandFunction(function)) {
-      entry->status = Entry::STATUS_FAILED;
+      entry_table_.SetStatus(entry, Entry::STATUS_FAILED);
       return nullptr;
     }
     // only add it to the list of resolved functions if resolving succeeded
@@ -280,7 +293,8 @@ Function* Processor::ResolveFunction(uint32_t address) {
 
     entry->function = function;
     entry->end_address = function->end_address();
-    status = entry->status = Entry::STATUS_READY;
+    status = Entry::STATUS_READY;
+    entry_table_.SetStatus(entry, status);
   }
   if (status == Entry::STATUS_READY) {
     // Ready to use.
@@ -304,6 +318,13 @@ Module* Processor::LookupModule(uint32_t address) {
 Function* Processor::LookupFunction(uint32_t address) {
   // TODO(benvanik): fast reject invalid addresses/log errors.
 
+  // Already resolved functions can be returned without taking the global lock
+  // in LookupModule.
+  Entry* entry = entry_table_.Get(address);
+  if (entry) {
+    return entry->function;
+  }
+
   // Find the module that contains the address.
   Module* code_module = LookupModule(address);
 
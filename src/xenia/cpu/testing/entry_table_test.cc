@@ -0,0 +1,154 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "xenia/cpu/entry_table.h"
+
+#include "third_party/catch/include/catch.hpp"
+
+namespace xe {
+namespace cpu {
+namespace test {
+
+constexpr uint32_t kBaseAddress = 0x82000000;
+
+// Resolves the same set of addresses from all threads, "compiling" each entry
+// on the thread that has created it, like Processor::ResolveFunction does.
+static void ResolveFromThreads(EntryTable& table, uint32_t address_count,
+                               uint32_t thread_count, uint32_t iterations,
+                               std::atomic<uint32_t>* new_counts,
+                               std::atomic<uint32_t>& mismatch_count) {
+  std::vector<std::thread> threads;
+  for (uint32_t thread_index = 0; thread_index < thread_count;
+       ++thread_index) {
+    threads.emplace_back([&, thread_index]() {
+      for (uint32_t iteration = 0; iteration < iterations; ++iteration) {
+        for (uint32_t i = 0; i < address_count; ++i) {
+          // Different starting points for different threads for contention on
+          // both creation and lookup.
+          uint32_t address_index =
+              (i + thread_index * (address_count / thread_count)) %
+              address_count;
+          uint32_t address = kBaseAddress + address_index * 4;
+          Entry* entry;
+          Entry::Status status = table.GetOrCreate(address, &entry);
+          if (status == Entry::STATUS_NEW) {
+            new_counts[address_index].fetch_add(1, std::memory_order_relaxed);
+            entry->function =
+                reinterpret_cast<Function*>(uintptr_t(address) << 4);
+            entry->end_address = address;
+            table.SetStatus(entry, Entry::STATUS_READY);
+            status = Entry::STATUS_READY;
+          }
+          if (status != Entry::STATUS_READY || entry->address != address ||
+              entry->function !=
+                  reinterpret_cast<Function*>(uintptr_t(address) << 4)) {
+            mismatch_count.fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+static uint32_t GetTestThreadCount() {
+  return std::max(std::thread::hardware_concurrency(), 4u);
+}
+
+TEST_CASE("EntryTable concurrent GetOrCreate", "[entry_table]") {
+  constexpr uint32_t kAddressCount = 1 << 14;
+  EntryTable table;
+  auto new_counts = std::make_unique<std::atomic<uint32_t>[]>(kAddressCount);
+  std::atomic<uint32_t> mismatch_count(0);
+  ResolveFromThreads(table, kAddressCount, GetTestThreadCount(), 4,
+                     new_counts.get(), mismatch_count);
+  REQUIRE(mismatch_count == 0);
+  for (uint32_t i = 0; i < kAddressCount; ++i) {
+    REQUIRE(new_counts[i] == 1);
+  }
+  for (uint32_t i = 0; i < kAddressCount; ++i) {
+    Entry* entry = table.Get(kBaseAddress + i * 4);
+    REQUIRE(entry != nullptr);
+    REQUIRE(entry->status == Entry::STATUS_READY);
+  }
+  REQUIRE(table.FindWithAddress(kBaseAddress + 4).size() == 1);
+}
+
+TEST_CASE("EntryTable waits for compilation", "[entry_table]") {
+  EntryTable table;
+  Entry* entry;
+  REQUIRE(table.GetOrCreate(kBaseAddress, &entry) == Entry::STATUS_NEW);
+  // Not visible to lookups until ready.
+  REQUIRE(table.Get(kBaseAddress) == nullptr);
+  std::atomic<bool> waiter_done(false);
+  Entry* waiter_entry = nullptr;
+  Entry::Status waiter_status = Entry::STATUS_NEW;
+  std::thread waiter([&]() {
+    waiter_status = table.GetOrCreate(kBaseAddress, &waiter_entry);
+    waiter_done = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  REQUIRE_FALSE(waiter_done);
+  table.SetStatus(entry, Entry::STATUS_FAILED);
+  waiter.join();
+  REQUIRE(waiter_done);
+  REQUIRE(waiter_status == Entry::STATUS_FAILED);
+  REQUIRE(waiter_entry == entry);
+}
+
+TEST_CASE("EntryTable delete and unaligned addresses", "[entry_table]") {
+  EntryTable table;
+  Entry* entry;
+  REQUIRE(table.GetOrCreate(kBaseAddress + 2, &entry) ==
+          Entry::STATUS_FAILED);
+  REQUIRE(table.GetOrCreate(kBaseAddress, &entry) == Entry::STATUS_NEW);
+  table.SetStatus(entry, Entry::STATUS_READY);
+  REQUIRE(table.Get(kBaseAddress) == entry);
+  table.Delete(kBaseAddress);
+  REQUIRE(table.Get(kBaseAddress) == nullptr);
+  REQUIRE(table.FindWithAddress(kBaseAddress).empty());
+  REQUIRE(table.GetOrCreate(kBaseAddress, &entry) == Entry::STATUS_NEW);
+  table.SetStatus(entry, Entry::STATUS_READY);
+}
+
+// Microbenchmark, run explicitly with the [.benchmark] tag.
+TEST_CASE("EntryTable multithreaded resolution throughput",
+          "[entry_table][.benchmark]") {
+  constexpr uint32_t kAddressCount = 1 << 16;
+  constexpr uint32_t kIterations = 64;
+  uint32_t thread_count = GetTestThreadCount();
+  EntryTable table;
+  auto new_counts = std::make_unique<std::atomic<uint32_t>[]>(kAddressCount);
+  std::atomic<uint32_t> mismatch_count(0);
+  auto start = std::chrono::steady_clock::now();
+  ResolveFromThreads(table, kAddressCount, thread_count, kIterations,
+                     new_counts.get(), mismatch_count);
+  auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+  REQUIRE(mismatch_count == 0);
+  uint64_t lookups = uint64_t(kAddressCount) * kIterations * thread_count;
+  WARN(thread_count << " threads, " << lookups << " lookups, "
+                    << double(elapsed_ns) / double(lookups)
+                    << " ns per lookup");
+}
+
+}  // namespace test
+}  // namespace cpu
+}  // namespace xe
@@ -14,11 +14,16 @@
 #include "third_party/fmt/include/fmt/format.h"
 
 #include "xenia/base/byte_order.h"
+#include "xenia/base/clock.h"
 #include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/base/memory.h"
+#include "xenia/base/string.h"
+#include "xenia/base/xxhash.h"
 
+#include "xenia/cpu/backend/backend.h"
 #include "xenia/cpu/cpu_flags.h"
 #include "xenia/cpu/export_resolver.h"
 #include "xenia/cpu/lzx.h"
@@ -47,6 +52,19 @@ DEFINE_bool(
     "we've recognized as being functions via simple heuristics, good for error "
     "finding/stress testing with the JIT",
     "CPU");
+DEFINE_int32(
+    precompilation_threads, -1,
+    "Number of low-priority threads translating functions in the background "
+    "when enable_early_precompilation is on. -1 to calculate automatically "
+    "(half of logical CPU cores), a positive number to specify the number of "
+    "threads explicitly (up to the number of logical CPU cores), 0 to "
+    "translate on the module loading thread.",
+    "CPU");
+
+DEFINE_bool(xex_image_cache, true,
+            "Cache decrypted and decompressed XEX images, with title updates "
+            "applied, in the cache directory for faster module loading.",
+            "CPU");
 
 DECLARE_bool(allow_plugins);
 
@@ -85,7 +103,7 @@ using xe::kernel::KernelState;
 XexModule::XexModule(Processor* processor, KernelState* kernel_state)
     : Module(processor), processor_(processor), kernel_state_(kernel_state) {}
 
-XexModule::~XexModule() {}
+XexModule::~XexModule() { ShutdownPrecompilation(); }
 
 bool XexModule::GetOptHeader(const xex2_header* header, xex2_header_keys key,
                              void** out_ptr) {
@@ -242,6 +260,16 @@ int XexModule::ApplyPatch(XexModule* module) {
         "will likely fail!");
   }
 
+  // The result depends on both the base image and the patch.
+  uint64_t patched_image_cache_key = XXH3_64bits_withSeed(
+      xex_header_mem_.data(), xex_header_mem_.size(), module->image_cache_key_);
+  auto cached_image = OpenCachedImage(patched_image_cache_key);
+  if (cached_image && module->ApplyCachedImage(*cached_image)) {
+    module->image_cache_key_ = patched_image_cache_key;
+    XELOGI("XEX patch applied from the XEX image cache");
+    return 0;
+  }
+
   uint32_t size = module->xex_header()->header_size;
   if (patch_header->delta_headers_source_offset > size) {
     XELOGE("XEX header patch source is outside base XEX header area");
@@ -477,6 +505,9 @@ int XexModule::ApplyPatch(XexModule* module) {
         "version: {}.{}.{}.{}",
         source_ver.major, source_ver.minor, source_ver.build, source_ver.qfe,
         target_ver.major, target_ver.minor, target_ver.build, target_ver.qfe);
+
+    module->image_cache_key_ = patched_image_cache_key;
+    module->StoreCachedImage(patched_image_cache_key);
   } else {
     XELOGE("XEX patch application failed, error code {}", result_code);
   }
@@ -794,6 +825,130 @@ int XexModule::ReadImageCompressed(const void* xex_addr, size_t xex_length) {
   return result_code;
 }
 
+std::filesystem::path XexModule::GetImageCachePath(uint64_t key) const {
+  return kernel_state_->emulator()->cache_root() / "modules" / "images" /
+         fmt::format("{:016X}.bin", key);
+}
+
+std::unique_ptr<MappedMemory> XexModule::OpenCachedImage(uint64_t key) const {
+  if (!cvars::xex_image_cache) {
+    return nullptr;
+  }
+  auto cache_path = GetImageCachePath(key);
+  std::error_code error_code;
+  if (!std::filesystem::exists(cache_path, error_code)) {
+    return nullptr;
+  }
+  auto cached_image =
+      MappedMemory::Open(cache_path, MappedMemory::Mode::kRead);
+  if (!cached_image || cached_image->size() < sizeof(ImageCacheHeader)) {
+    return nullptr;
+  }
+  const auto& cache_header =
+      *reinterpret_cast<const ImageCacheHeader*>(cached_image->data());
+  if (cache_header.magic != ImageCacheHeader::kMagic ||
+      cache_header.version != ImageCacheHeader::kVersion ||
+      cache_header.key != key ||
+      cached_image->size() != sizeof(ImageCacheHeader) +
+                                  size_t(cache_header.xex_header_size) +
+                                  cache_header.image_size) {
+    return nullptr;
+  }
+  const uint8_t* cached_data = cached_image->data() + sizeof(ImageCacheHeader);
+  if (XXH3_64bits(cached_data, size_t(cache_header.xex_header_size) +
+                                   cache_header.image_size) !=
+      cache_header.data_hash) {
+    XELOGW("XEX image cache file {} is corrupted",
+           xe::path_to_utf8(cache_path));
+    return nullptr;
+  }
+  return cached_image;
+}
+
+bool XexModule::ApplyCachedImage(const MappedMemory& cached_image) {
+  const auto& cache_header =
+      *reinterpret_cast<const ImageCacheHeader*>(cached_image.data());
+  const uint8_t* cached_xex_header =
+      cached_image.data() + sizeof(ImageCacheHeader);
+
+  // Title updates may change the size of the image.
+  uint32_t original_image_size = image_size();
+  uint32_t new_image_size = cache_header.image_size;
+  if (new_image_size > original_image_size) {
+    uint32_t addr_new_mem = base_address_ + original_image_size;
+    if (!memory()
+             ->LookupHeap(addr_new_mem)
+             ->AllocFixed(
+                 addr_new_mem, new_image_size - original_image_size, 4096,
+                 xe::kMemoryAllocationReserve | xe::kMemoryAllocationCommit,
+                 xe::kMemoryProtectRead | xe::kMemoryProtectWrite)) {
+      return false;
+    }
+  } else if (new_image_size < original_image_size) {
+    uint32_t addr_free_mem = base_address_ + new_image_size;
+    memory()
+        ->LookupHeap(addr_free_mem)
+        ->Decommit(addr_free_mem, original_image_size - new_image_size);
+  }
+
+  xex_header_mem_.assign(cached_xex_header,
+                         cached_xex_header + cache_header.xex_header_size);
+  ReadSecurityInfo();
+  std::memcpy(session_key_, cache_header.session_key, sizeof(session_key_));
+  is_dev_kit_ = cache_header.is_dev_kit != 0;
+  std::memcpy(memory()->TranslateVirtual(base_address_),
+              cached_xex_header + cache_header.xex_header_size,
+              new_image_size);
+  return true;
+}
+
+void XexModule::StoreCachedImage(uint64_t key) const {
+  if (!cvars::xex_image_cache) {
+    return;
+  }
+  auto cache_path = GetImageCachePath(key);
+  std::error_code error_code;
+  std::filesystem::create_directories(cache_path.parent_path(), error_code);
+
+  ImageCacheHeader cache_header = {};
+  cache_header.magic = ImageCacheHeader::kMagic;
+  cache_header.version = ImageCacheHeader::kVersion;
+  cache_header.key = key;
+  cache_header.xex_header_size = uint32_t(xex_header_mem_.size());
+  cache_header.image_size = image_size();
+  std::memcpy(cache_header.session_key, session_key_, sizeof(session_key_));
+  cache_header.is_dev_kit = is_dev_kit_ ? 1 : 0;
+  const uint8_t* image = memory()->TranslateVirtual(base_address_);
+  XXH3_state_t hash_state;
+  XXH3_64bits_reset(&hash_state);
+  XXH3_64bits_update(&hash_state, xex_header_mem_.data(),
+                     xex_header_mem_.size());
+  XXH3_64bits_update(&hash_state, image, cache_header.image_size);
+  cache_header.data_hash = XXH3_64bits_digest(&hash_state);
+
+  // Written to a temporary file first, so a partially written file is never
+  // loaded.
+  auto temp_path = cache_path;
+  temp_path += ".tmp";
+  FILE* file = xe::filesystem::OpenFile(temp_path, "wb");
+  if (!file) {
+    return;
+  }
+  bool written =
+      fwrite(&cache_header, sizeof(cache_header), 1, file) == 1 &&
+      fwrite(xex_header_mem_.data(), 1, xex_header_mem_.size(), file) ==
+          xex_header_mem_.size() &&
+      fwrite(image, 1, cache_header.image_size, file) ==
+          cache_header.image_size;
+  fclose(file);
+  if (written) {
+    std::filesystem::rename(temp_path, cache_path, error_code);
+  }
+  if (!written || error_code) {
+    std::filesystem::remove(temp_path, error_code);
+  }
+}
+
 int XexModule::ReadPEHeaders() {
   const uint8_t* p = memory()->TranslateVirtual(base_address_);
 
@@ -951,6 +1106,25 @@ bool XexModule::Load(const std::string_view name, const std::string_view path,
   name_ = name;
   path_ = path;
 
+  image_cache_key_ = XXH3_64bits_withSeed(
+      xex_header_mem_.data(), xex_header_mem_.size(), uint64_t(xex_length));
+  if (!is_patch()) {
+    auto cached_image = OpenCachedImage(image_cache_key_);
+    if (cached_image) {
+      memory()->LookupHeap(base_address_)->Reset();
+      if (memory()
+              ->LookupHeap(base_address_)
+              ->AllocFixed(
+                  base_address_, image_size(), 4096,
+                  xe::kMemoryAllocationReserve | xe::kMemoryAllocationCommit,
+                  xe::kMemoryProtectRead | xe::kMemoryProtectWrite) &&
+          ApplyCachedImage(*cached_image)) {
+        XELOGI("Loaded the image of {} from the XEX image cache", name);
+        return true;
+      }
+    }
+  }
+
   // Load in the XEX basefile
   // We'll try using both XEX2 keys to see if any give a valid PE
   int result_code = ReadImage(xex_addr, xex_length, false);
@@ -966,6 +1140,10 @@ bool XexModule::Load(const std::string_view name, const std::string_view path,
     }
   }
 
+  if (!is_patch()) {
+    StoreCachedImage(image_cache_key_);
+  }
+
   // Note: caller will have to call LoadContinue once it's determined whether a
   // patch file exists or not!
   return true;
@@ -1132,7 +1310,16 @@ void XexModule::Precompile() {
   }
 
   info_cache_.Init(this);
-  PrecompileDiscoveredFunctions();
+  PrecompileStoredFunctions();
+  if (cvars::enable_early_precompilation) {
+    std::vector<uint32_t> addresses;
+    GetKnownFunctions(addresses);
+    GetDiscoveredFunctions(addresses);
+    std::sort(addresses.begin(), addresses.end());
+    addresses.erase(std::unique(addresses.begin(), addresses.end()),
+                    addresses.end());
+    PrecompileFunctions(std::move(addresses));
+  }
 }
 bool XexModule::Unload() {
   if (!loaded_) {
@@ -1140,6 +1327,8 @@ bool XexModule::Unload() {
   }
   loaded_ = false;
 
+  ShutdownPrecompilation();
+
   // If this isn't a patch, just deallocate the memory occupied by the exe
   if (!is_patch()) {
     assert_not_zero(base_address_);
@@ -1399,44 +1588,119 @@ InfoCacheFlags* XexModule::GetInstructionAddressFlags(uint32_t guest_addr) {
 
   return info_cache_.LookupFlags(guest_addr);
 }
-void XexModule::PrecompileDiscoveredFunctions() {
-  if (!cvars::enable_early_precompilation) {
-    return;
-  }
+void XexModule::GetDiscoveredFunctions(std::vector<uint32_t>& addresses) {
   auto others = PreanalyzeCode();
 
   for (auto&& other : others) {
     if (other < low_address_ || other >= high_address_) {
       continue;
     }
-    auto sym = processor_->LookupFunction(other);
-
+    addresses.push_back(other);
+  }
+}
+void XexModule::PrecompileStoredFunctions() {
+  std::filesystem::path storage_root = kernel_state_->emulator()->cache_root();
+  storage_root.append("modules");
+  storage_root.append(image_sha_str_);
+  std::vector<uint32_t> stored_functions =
+      processor_->backend()->InitializeCodeStorage(
+          this, storage_root, image_sha_bytes_, sizeof(image_sha_bytes_));
+  // Setting up stored functions is cheap, so set up all of them now rather
+  // than on the first call.
+  for (uint32_t address : stored_functions) {
+    auto sym = processor_->LookupFunction(address);
     if (!sym || sym->status() != Symbol::Status::kDefined) {
-      processor_->ResolveFunction(other);
+      processor_->ResolveFunction(address);
     }
   }
 }
-void XexModule::PrecompileKnownFunctions() {
-  if (!cvars::enable_early_precompilation) {
-    return;
-  }
-  uint32_t start = 0;
+void XexModule::GetKnownFunctions(std::vector<uint32_t>& addresses) {
   uint32_t end = (high_address_ - low_address_) / 4;
   auto flags = info_cache_.LookupFlags(0);
   if (!flags) {
     return;
   }
-  // maybe should pre-acquire global crit?
   for (uint32_t i = 0; i < end; i++) {
     if (flags[i].was_resolved) {
-      uint32_t addr = low_address_ + (i * 4);
-      auto sym = processor_->LookupFunction(addr);
+      addresses.push_back(low_address_ + (i * 4));
+    }
+  }
+}
 
-      if (!sym || sym->status() != Symbol::Status::kDefined) {
-        processor_->ResolveFunction(addr);
-      }
+void XexModule::PrecompileFunctions(std::vector<uint32_t> addresses) {
+  ShutdownPrecompilation();
+  if (addresses.empty()) {
+    return;
+  }
+  precompile_addresses_ = std::move(addresses);
+  precompile_next_index_ = 0;
+  precompile_done_count_ = 0;
+  precompile_shutdown_ = false;
+  precompile_start_time_ = xe::Clock::QueryHostTickCount();
+
+  uint32_t logical_processor_count = xe::threading::logical_processor_count();
+  uint32_t thread_count;
+  if (cvars::precompilation_threads < 0) {
+    thread_count = std::max(logical_processor_count / 2, uint32_t(1));
+  } else {
+    thread_count = std::min(uint32_t(cvars::precompilation_threads),
+                            logical_processor_count);
+  }
+  XELOGI("Precompiling {} functions of {} on {} threads",
+         precompile_addresses_.size(), name(), thread_count);
+  if (!thread_count) {
+    PrecompileThread();
+    return;
+  }
+  // Each thread takes its own translator from the frontend's pool, and only
+  // synchronizes with the others when placing the code in the code cache.
+  xe::threading::Thread::CreationParameters thread_params;
+  thread_params.initial_priority = xe::threading::ThreadPriority::kLowest;
+  for (uint32_t i = 0; i < thread_count; ++i) {
+    std::unique_ptr<xe::threading::Thread> precompile_thread =
+        xe::threading::Thread::Create(thread_params,
+                                      [this]() { PrecompileThread(); });
+    assert_not_null(precompile_thread);
+    precompile_thread->set_name("Precompilation");
+    precompile_threads_.push_back(std::move(precompile_thread));
+  }
+}
+
+void XexModule::PrecompileThread() {
+  size_t address_count = precompile_addresses_.size();
+  while (!precompile_shutdown_.load(std::memory_order_relaxed)) {
+    size_t index =
+        precompile_next_index_.fetch_add(1, std::memory_order_relaxed);
+    if (index >= address_count) {
+      break;
     }
+    uint32_t address = precompile_addresses_[index];
+    auto sym = processor_->LookupFunction(address);
+    if (!sym || sym->status() != Symbol::Status::kDefined) {
+      processor_->ResolveFunction(address);
+    }
+
+    size_t done_count =
+        precompile_done_count_.fetch_add(1, std::memory_order_relaxed) + 1;
+    // Report the progress every 10%.
+    if (done_count * 10 / address_count !=
+        (done_count - 1) * 10 / address_count) {
+      XELOGI("Precompiled {}/{} functions of {} in {} milliseconds",
+             done_count, address_count, name(),
+             (xe::Clock::QueryHostTickCount() - precompile_start_time_) *
+                 1000 / xe::Clock::QueryHostTickFrequency());
+    }
+  }
+}
+
+void XexModule::ShutdownPrecompilation() {
+  precompile_shutdown_ = true;
+  for (const std::unique_ptr<xe::threading::Thread>& precompile_thread :
+       precompile_threads_) {
+    xe::threading::Wait(precompile_thread.get(), false);
   }
+  precompile_threads_.clear();
+  precompile_addresses_.clear();
 }
 
 static uint32_t GetBLCalledFunction(XexModule* xexmod, uint32_t current_base,
@@ -10,9 +10,13 @@
 #ifndef XENIA_CPU_XEX_MODULE_H_
 #define XENIA_CPU_XEX_MODULE_H_
 
+#include <atomic>
+#include <filesystem>
+#include <memory>
 #include <string>
 #include <vector>
 #include "xenia/base/mapped_memory.h"
+#include "xenia/base/threading.h"
 #include "xenia/cpu/module.h"
 #include "xenia/kernel/util/xex2_info.h"
 
@@ -238,8 +242,14 @@ class XexModule : public xe::cpu::Module {
   std::unique_ptr<Function> CreateFunction(uint32_t address) override;
 
  private:
-  void PrecompileKnownFunctions();
-  void PrecompileDiscoveredFunctions();
+  void GetKnownFunctions(std::vector<uint32_t>& addresses);
+  void PrecompileStoredFunctions();
+  void GetDiscoveredFunctions(std::vector<uint32_t>& addresses);
+  // Translates the functions on low-priority background threads, so guest
+  // execution can start while they're being translated.
+  void PrecompileFunctions(std::vector<uint32_t> addresses);
+  void PrecompileThread();
+  void ShutdownPrecompilation();
   std::vector<uint32_t> PreanalyzeCode();
   friend struct XexInfoCache;
   void ReadSecurityInfo();
@@ -249,6 +259,30 @@ class XexModule : public xe::cpu::Module {
   int ReadImageBasicCompressed(const void* xex_addr, size_t xex_length);
   int ReadImageCompressed(const void* xex_addr, size_t xex_length);
 
+  // Decrypted and decompressed images, with patches applied, are cached on
+  // the disk, keyed by the hash of the XEX headers of the base and the patch,
+  // so loading them again only needs copying them into guest memory.
+  struct ImageCacheHeader {
+    static constexpr uint32_t kMagic = 0x43495858;  // 'XXIC'
+    static constexpr uint32_t kVersion = 1;
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t xex_header_size;
+    uint32_t image_size;
+    uint8_t session_key[0x10];
+    uint8_t is_dev_kit;
+    uint8_t reserved[7];
+    // Hash of the XEX header and the image following the header.
+    uint64_t data_hash;
+  };
+  std::filesystem::path GetImageCachePath(uint64_t key) const;
+  std::unique_ptr<MappedMemory> OpenCachedImage(uint64_t key) const;
+  // Replaces the XEX header, the session key and the image with the cached
+  // ones. The image of the base XEX must be allocated already.
+  bool ApplyCachedImage(const MappedMemory& cached_image);
+  void StoreCachedImage(uint64_t key) const;
+
   int ReadPEHeaders();
 
   bool SetupLibraryImports(const std::string_view name,
@@ -271,6 +305,9 @@ class XexModule : public xe::cpu::Module {
 
   uint8_t session_key_[0x10];
   bool is_dev_kit_ = false;
+  // Key of the image in the image cache, also for deriving the key of patched
+  // images.
+  uint64_t image_cache_key_ = 0;
 
   bool loaded_ = false;         // Loaded into memory?
   bool finished_load_ = false;  // PE/imports/symbols/etc all loaded?
@@ -285,6 +322,13 @@ class XexModule : public xe::cpu::Module {
   uint8_t image_sha_bytes_[20];
   std::string image_sha_str_;
   XexInfoCache info_cache_;
+
+  std::vector<uint32_t> precompile_addresses_;
+  std::atomic<size_t> precompile_next_index_{0};
+  std::atomic<size_t> precompile_done_count_{0};
+  std::atomic<bool> precompile_shutdown_{false};
+  uint64_t precompile_start_time_ = 0;
+  std::vector<std::unique_ptr<xe::threading::Thread>> precompile_threads_;
 };
 
 }  // namespace cpu
@@ -11,6 +11,8 @@
 
 #include <algorithm>
 #include <cinttypes>
+#include <cstring>
+#include <random>
 
 #include "config.h"
 #include "third_party/fmt/include/fmt/format.h"
@@ -25,6 +27,7 @@
 #include "xenia/base/cvar.h"
 #include "xenia/base/debugging.h"
 #include "xenia/base/exception_handler.h"
+#include "xenia/base/filesystem.h"
 #include "xenia/base/literals.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/mapped_memory.h"
@@ -642,8 +645,13 @@ X_STATUS Emulator::InstallContentPackage(
 
   vfs::VirtualFileSystem::ExtractContentHeader(device.get(), header_path);
 
-  return vfs::VirtualFileSystem::ExtractContentFiles(device.get(),
-                                                     installation_path);
+  X_STATUS result = vfs::VirtualFileSystem::ExtractContentFiles(
+      device.get(), installation_path);
+  if (kernel_state_) {
+    kernel_state_->content_manager()->InvalidateContentIndex(
+        XContentType(dev->content_type()), dev->title_id());
+  }
+  return result;
 }
 
 X_STATUS Emulator::ExtractZarchivePackage(
@@ -820,8 +828,18 @@ void Emulator::Resume() {
   }
 }
 
-bool Emulator::SaveToFile(const std::filesystem::path& path) {
+bool Emulator::SaveToFile(const std::filesystem::path& path,
+                          bool incremental) {
   Pause();
+  // Guest threads are paused, but the host file I/O workers may still be
+  // writing guest memory and signaling events.
+  kernel_state_->file_io_queue()->Drain();
+
+  if (incremental &&
+      (save_state_base_path_.empty() || path == save_state_base_path_)) {
+    XELOGW("No base save state for an incremental save, saving everything");
+    incremental = false;
+  }
 
   filesystem::CreateEmptyFile(path);
   auto map = MappedMemory::Open(path, MappedMemory::Mode::kReadWrite, 0, 2_GiB);
@@ -832,6 +850,22 @@ bool Emulator::SaveToFile(const std::filesystem::path& path) {
   // Save the emulator state to a file
   ByteStream stream(map->data(), map->size());
   stream.Write(kEmulatorSaveSignature);
+  stream.Write(kEmulatorSaveVersion);
+  stream.Write(incremental);
+  // For a full save, the identifier of the memory contents it contains, for an
+  // incremental one, the identifier of the base that it has been made against.
+  uint64_t save_id = save_state_base_id_;
+  if (incremental) {
+    stream.Write(xe::path_to_utf8(save_state_base_path_));
+  } else {
+    save_id = std::random_device()();
+    save_id = (save_id << 32) | std::random_device()();
+  }
+  stream.Write(save_id);
+  // Offset of the memory, for restoring it from the base of an incremental
+  // save state.
+  size_t memory_offset_offset = stream.offset();
+  stream.Write(uint64_t(0));
   stream.Write(title_id_.has_value());
   if (title_id_.has_value()) {
     stream.Write(title_id_.value());
@@ -843,9 +877,17 @@ bool Emulator::SaveToFile(const std::filesystem::path& path) {
   graphics_system_->Save(&stream);
   audio_system_->Save(&stream);
   kernel_state_->Save(&stream);
-  memory_->Save(&stream);
+  uint64_t memory_offset = stream.offset();
+  std::memcpy(map->data() + memory_offset_offset, &memory_offset,
+              sizeof(memory_offset));
+  memory_->Save(&stream, incremental);
   map->Close(stream.offset());
 
+  if (!incremental) {
+    save_state_base_path_ = path;
+    save_state_base_id_ = save_id;
+  }
+
   Resume();
   return true;
 }
@@ -865,10 +907,19 @@ bool Emulator::RestoreFromFile(const std::filesystem::path& path) {
 
   auto lock = global_critical_region::AcquireDirect();
   ByteStream stream(map->data(), map->size());
-  if (stream.Read<uint32_t>() != kEmulatorSaveSignature) {
+  if (stream.Read<uint32_t>() != kEmulatorSaveSignature ||
+      stream.Read<uint32_t>() != kEmulatorSaveVersion) {
     return false;
   }
 
+  bool incremental = stream.Read<bool>();
+  std::filesystem::path base_path;
+  if (incremental) {
+    base_path = xe::to_path(stream.Read<std::string>());
+  }
+  uint64_t save_id = stream.Read<uint64_t>();
+  stream.Read<uint64_t>();
+
   auto has_title_id = stream.Read<bool>();
   std::optional<uint32_t> title_id;
   if (!has_title_id) {
@@ -899,10 +950,41 @@ bool Emulator::RestoreFromFile(const std::filesystem::path& path) {
     XELOGE("Could not restore kernel state!");
     return false;
   }
-  if (!memory_->Restore(&stream)) {
+  if (incremental) {
+    // Only the memory of the base save state is needed.
+    auto base_map = MappedMemory::Open(base_path, MappedMemory::Mode::kRead);
+    if (!base_map) {
+      XELOGE("Could not open the base save state {}!",
+             xe::path_to_utf8(base_path));
+      return false;
+    }
+    ByteStream base_stream(base_map->data(), base_map->size());
+    if (base_stream.Read<uint32_t>() != kEmulatorSaveSignature ||
+        base_stream.Read<uint32_t>() != kEmulatorSaveVersion ||
+        base_stream.Read<bool>()) {
+      XELOGE("Base save state {} is not a full save state!",
+             xe::path_to_utf8(base_path));
+      return false;
+    }
+    // The file may have been overwritten by another full save since, and the
+    // unchanged memory chunks are only valid for the original one.
+    if (base_stream.Read<uint64_t>() != save_id) {
+      XELOGE("Base save state {} is not the one the save state was made from!",
+             xe::path_to_utf8(base_path));
+      return false;
+    }
+    base_stream.set_offset(size_t(base_stream.Read<uint64_t>()));
+    if (!memory_->Restore(&base_stream)) {
+      XELOGE("Could not restore memory from the base save state!");
+      return false;
+    }
+  }
+  if (!memory_->Restore(&stream, incremental)) {
     XELOGE("Could not restore memory!");
     return false;
   }
+  save_state_base_path_ = incremental ? base_path : path;
+  save_state_base_id_ = save_id;
 
   // Update the main thread.
   auto threads =
@@ -52,6 +52,7 @@ class Window;
 namespace xe {
 
 constexpr fourcc_t kEmulatorSaveSignature = make_fourcc("XSAV");
+constexpr uint32_t kEmulatorSaveVersion = 3;
 static const std::string kDefaultGameSymbolicLink = "GAME:";
 static const std::string kDefaultPartitionSymbolicLink = "D:";
 
@@ -251,7 +252,9 @@ class Emulator {
   void Pause();
   void Resume();
   bool is_paused() const { return paused_; }
-  bool SaveToFile(const std::filesystem::path& path);
+  // Incremental save states only contain the memory changed since the last
+  // full save or restore, which is then needed to restore them.
+  bool SaveToFile(const std::filesystem::path& path, bool incremental = false);
   bool RestoreFromFile(const std::filesystem::path& path);
 
   // The game can request another title to be loaded.
@@ -321,6 +324,10 @@ class Emulator {
 
   bool paused_;
   bool restoring_;
+  // Base of incremental save states, and the random identifier of its memory
+  // contents that incremental save states made from it must refer to.
+  std::filesystem::path save_state_base_path_;
+  uint64_t save_state_base_id_ = 0;
   threading::Fence restore_fence_;  // Fired on restore finish.
 };
 
@@ -9,6 +9,7 @@
 
 #include "xenia/gpu/command_processor.h"
 
+#include <algorithm>
 #include <cinttypes>
 
 #include "third_party/fmt/include/fmt/format.h"
@@ -16,10 +17,13 @@
 #include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/profiling.h"
+#include "xenia/base/xxhash.h"
 #include "xenia/gpu/gpu_flags.h"
 #include "xenia/gpu/graphics_system.h"
 #include "xenia/gpu/packet_disassembler.h"
 #include "xenia/gpu/sampler_info.h"
+#include "xenia/gpu/shader.h"
+#include "xenia/gpu/shared_memory.h"
 #include "xenia/gpu/texture_info.h"
 #include "xenia/kernel/kernel_state.h"
 #include "xenia/kernel/user_module.h"
@@ -50,6 +54,14 @@ DEFINE_bool(clear_memory_page_state, false,
             "for 'Team Ninja' Games to fix missing character models)",
             "GPU");
 
+DEFINE_bool(
+    skip_idle_frames, false,
+    "Skip drawing frames that are identical to the previous one - with the "
+    "same commands, and without modifications of the memory they use - and "
+    "keep displaying the previous frame instead. Frames containing resolves "
+    "or memexport are always drawn.",
+    "GPU");
+
 namespace xe {
 namespace gpu {
 
@@ -226,6 +238,228 @@ void CommandProcessor::SetDesiredSwapPostEffect(
   });
 }
 
+namespace {
+
+// A command buffer in guest memory, with wraparound for the primary ring
+// buffer, sizes and offsets in dwords.
+struct FrameCommandBuffer {
+  const uint32_t* dwords;
+  uint32_t capacity;
+  uint32_t offset;
+  uint32_t remaining;
+};
+
+enum class FrameHashResult {
+  kEnd,
+  kSwap,
+  kUnsupported,
+};
+
+// Hashes the packets of the buffer and the memory they load registers and
+// shaders from, until the end of the buffer or a swap.
+FrameHashResult HashFrameCommandBuffer(const Memory& memory,
+                                       FrameCommandBuffer buffer,
+                                       XXH3_state_t& hash_state,
+                                       uint32_t depth) {
+  // Nested indirect buffers are normally not used.
+  constexpr uint32_t kMaxIndirectBufferDepth = 4;
+  auto read = [&buffer]() {
+    uint32_t value = xe::byte_swap(buffer.dwords[buffer.offset]);
+    if (++buffer.offset >= buffer.capacity) {
+      buffer.offset = 0;
+    }
+    --buffer.remaining;
+    return value;
+  };
+  auto hash = [&buffer, &hash_state](uint32_t count) {
+    while (count) {
+      uint32_t part_count = std::min(count, buffer.capacity - buffer.offset);
+      XXH3_64bits_update(&hash_state, buffer.dwords + buffer.offset,
+                         sizeof(uint32_t) * part_count);
+      buffer.offset += part_count;
+      if (buffer.offset >= buffer.capacity) {
+        buffer.offset = 0;
+      }
+      buffer.remaining -= part_count;
+      count -= part_count;
+    }
+  };
+  while (buffer.remaining) {
+    uint32_t packet = read();
+    XXH3_64bits_update(&hash_state, &packet, sizeof(packet));
+    uint32_t packet_type = packet >> 30;
+    uint32_t count;
+    if (packet_type == 0x1) {
+      count = 2;
+    } else if (packet_type == 0x2) {
+      count = 0;
+    } else {
+      count = ((packet >> 16) & 0x3FFF) + 1;
+    }
+    if (count > buffer.remaining) {
+      // Not submitted completely yet.
+      return FrameHashResult::kUnsupported;
+    }
+    if (packet_type != 0x3) {
+      hash(count);
+      continue;
+    }
+    // Predicated packets are hashed regardless of whether they're executed,
+    // and predicated swaps are skipped by the command processor.
+    bool predicated = (packet & 1) != 0;
+    switch ((packet >> 8) & 0x7F) {
+      case PM4_XE_SWAP:
+        hash(count);
+        if (!predicated) {
+          return FrameHashResult::kSwap;
+        }
+        break;
+      case PM4_INDIRECT_BUFFER:
+      case PM4_INDIRECT_BUFFER_PFD: {
+        if (count < 2 || depth >= kMaxIndirectBufferDepth) {
+          return FrameHashResult::kUnsupported;
+        }
+        uint32_t list[2];
+        list[0] = read() & 0x1FFFFFFF;
+        list[1] = read() & 0xFFFFF;
+        XXH3_64bits_update(&hash_state, list, sizeof(list));
+        hash(count - 2);
+        if (list[1]) {
+          FrameCommandBuffer indirect_buffer;
+          indirect_buffer.dwords =
+              memory.TranslatePhysical<const uint32_t*>(list[0]);
+          indirect_buffer.capacity = list[1];
+          indirect_buffer.offset = 0;
+          indirect_buffer.remaining = list[1];
+          // The swap is expected to be in the primary buffer.
+          if (HashFrameCommandBuffer(memory, indirect_buffer, hash_state,
+                                     depth + 1) != FrameHashResult::kEnd) {
+            return FrameHashResult::kUnsupported;
+          }
+        }
+      } break;
+      case PM4_IM_LOAD: {
+        if (count < 2) {
+          return FrameHashResult::kUnsupported;
+        }
+        uint32_t load[2];
+        load[0] = read();
+        load[1] = read();
+        XXH3_64bits_update(&hash_state, load, sizeof(load));
+        hash(count - 2);
+        XXH3_64bits_update(
+            &hash_state, memory.TranslatePhysical(load[0] & ~uint32_t(3)),
+            sizeof(uint32_t) * (load[1] & 0xFFFF));
+      } break;
+      case PM4_LOAD_ALU_CONSTANT: {
+        if (count < 3) {
+          return FrameHashResult::kUnsupported;
+        }
+        uint32_t load[3];
+        load[0] = read() & 0x3FFFFFFF;
+        load[1] = read();
+        load[2] = read() & 0xFFF;
+        XXH3_64bits_update(&hash_state, load, sizeof(load));
+        hash(count - 3);
+        XXH3_64bits_update(&hash_state, memory.TranslatePhysical(load[0]),
+                           sizeof(uint32_t) * load[2]);
+      } break;
+      default:
+        hash(count);
+        break;
+    }
+  }
+  return FrameHashResult::kEnd;
+}
+
+}  // namespace
+
+uint64_t CommandProcessor::ComputeFrameFingerprint(
+    const RingBuffer& reader) const {
+  SCOPE_profile_cpu_f("gpu");
+  XXH3_state_t hash_state;
+  XXH3_64bits_reset(&hash_state);
+  // The state that the frame begins with.
+  XXH3_64bits_update(&hash_state, register_file_->values,
+                     sizeof(register_file_->values));
+  uint64_t state[] = {
+      bin_select_,
+      bin_mask_,
+      active_vertex_shader_ ? active_vertex_shader_->ucode_data_hash() : 0,
+      active_pixel_shader_ ? active_pixel_shader_->ucode_data_hash() : 0,
+      uint64_t(swap_post_effect_actual_),
+  };
+  XXH3_64bits_update(&hash_state, state, sizeof(state));
+  XXH3_64bits_update(&hash_state, gamma_ramp_256_entry_table_,
+                     sizeof(gamma_ramp_256_entry_table_));
+  XXH3_64bits_update(&hash_state, gamma_ramp_pwl_rgb_,
+                     sizeof(gamma_ramp_pwl_rgb_));
+  FrameCommandBuffer buffer;
+  buffer.dwords = reinterpret_cast<const uint32_t*>(reader.buffer());
+  buffer.capacity = uint32_t(reader.capacity() / sizeof(uint32_t));
+  buffer.offset = uint32_t(reader.read_offset() / sizeof(uint32_t));
+  buffer.remaining = uint32_t(reader.read_count() / sizeof(uint32_t));
+  if (!buffer.capacity || HashFrameCommandBuffer(*memory_, buffer, hash_state,
+                                                 0) != FrameHashResult::kSwap) {
+    return 0;
+  }
+  // 0 means no fingerprint.
+  return std::max(uint64_t(XXH3_64bits_digest(&hash_state)), uint64_t(1));
+}
+
+void CommandProcessor::BeginFrame(const RingBuffer& reader) {
+  frame_begin_pending_ = false;
+  bool previous_frame_wrote_memory = frame_writes_memory_;
+  frame_writes_memory_ = false;
+  SharedMemory* shared_memory = GetSharedMemory();
+  if (!cvars::skip_idle_frames || !shared_memory) {
+    idle_frame_ = false;
+    return;
+  }
+  uint64_t fingerprint = ComputeFrameFingerprint(reader);
+  uint64_t invalidation_count = shared_memory->cpu_invalidation_count();
+  // Traces must contain all the draws.
+  // A frame that is the same as the previous one writes memory if the
+  // previous one did.
+  bool idle_frame = fingerprint && !trace_writer_.is_open() &&
+                    !previous_frame_wrote_memory &&
+                    fingerprint == previous_frame_fingerprint_ &&
+                    invalidation_count == previous_frame_invalidation_count_;
+  if (idle_frame != idle_frame_) {
+    if (idle_frame) {
+      XELOGI("Frame {} is the same as the previous one, skipping idle frames",
+             counter_);
+    } else {
+      XELOGI("Frame {} has changed, resuming drawing", counter_);
+    }
+  }
+  idle_frame_ = idle_frame;
+  previous_frame_fingerprint_ = fingerprint;
+  previous_frame_invalidation_count_ = invalidation_count;
+}
+
+void CommandProcessor::EndFrame() {
+  if (!cvars::skip_idle_frames) {
+    idle_frame_ = false;
+    return;
+  }
+  if (reader_.buffer() != memory_->TranslatePhysical(primary_buffer_ptr_)) {
+    // Swapped in an indirect buffer - the beginning of the next frame is not
+    // known, start over from the next submission.
+    idle_frame_ = false;
+    previous_frame_fingerprint_ = 0;
+    frame_begin_pending_ = true;
+    return;
+  }
+  // The next frame begins after the swap, fingerprint it when it's
+  // submitted if it hasn't been yet.
+  if (reader_.read_count()) {
+    BeginFrame(reader_);
+  } else {
+    frame_begin_pending_ = true;
+  }
+}
+
 void CommandProcessor::WorkerThreadMain() {
   if (!SetupContext()) {
     xe::FatalError("Unable to setup command processor internal state");
@@ -268,6 +502,11 @@ void CommandProcessor::WorkerThreadMain() {
     }
     assert_true(read_ptr_index_ != write_ptr_index);
 
+    // With the host write watch, guest writes to the memory used by the GPU
+    // are only detected here - the guest must have finished writing the data
+    // used by the new commands before submitting them.
+    memory_->TriggerPhysicalMemoryWriteWatchCallbacks();
+
     // Execute. Note that we handle wraparound transparently.
     read_ptr_index_ = ExecutePrimaryBuffer(read_ptr_index_, write_ptr_index);
 
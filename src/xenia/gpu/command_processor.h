@@ -17,6 +17,7 @@
 #include <mutex>
 #include <queue>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "xenia/base/ring_buffer.h"
@@ -41,6 +42,7 @@ void CommonSaveGPUSetting(CommonGPUSetting setting, uint64_t value);
 
 class GraphicsSystem;
 class Shader;
+class SharedMemory;
 
 struct SwapState {
   // Lock must be held when changing data in this structure.
@@ -123,6 +125,27 @@ class CommandProcessor {
 
   virtual void TracePlaybackWroteMemory(uint32_t base_ptr, uint32_t length) = 0;
 
+  // GPU time in microseconds spent on each category of work in the last
+  // completed frame, measured by the host GPU. Can be called from any thread.
+  // Returns false if GPU time profiling is not supported or not enabled.
+  virtual bool GetGpuProfile(
+      std::vector<std::pair<const char*, double>>& profile_out) const {
+    return false;
+  }
+
+  // Cumulative counters of the backend for benchmarking, such as in trace
+  // playback. Counters not tracked by the backend are left zero.
+  struct PerformanceCounters {
+    uint64_t submissions = 0;
+    uint64_t pipeline_lookups = 0;
+    uint64_t pipeline_lookup_hits = 0;
+    uint64_t texture_lookups = 0;
+    uint64_t texture_lookup_hits = 0;
+    uint64_t render_target_ownership_transfers = 0;
+  };
+  virtual void GetPerformanceCounters(PerformanceCounters& counters_out) const {
+  }
+
   void RestoreRegisters(uint32_t first_register,
                         const uint32_t* register_values,
                         uint32_t register_count, bool execute_callbacks);
@@ -249,6 +272,19 @@ class CommandProcessor {
     return swap_post_effect_actual_;
   }
 
+  // The guest memory used by the GPU, for detecting whether the memory that a
+  // frame reads may have been modified. nullptr if not tracked.
+  virtual SharedMemory* GetSharedMemory() const { return nullptr; }
+
+  // Idle frame detection (skip_idle_frames). BeginFrame is called with the
+  // reader positioned at the first packet of a frame, EndFrame after its swap.
+  void BeginFrame(const RingBuffer& reader);
+  void EndFrame();
+  // Hash of the state at the beginning of the frame and of everything that the
+  // frame's commands read, or 0 if the whole frame hasn't been submitted yet or
+  // can't be fingerprinted.
+  uint64_t ComputeFrameFingerprint(const RingBuffer& reader) const;
+
   virtual void InitializeTrace();
 
   Memory* memory_ = nullptr;
@@ -299,6 +335,16 @@ class CommandProcessor {
   SwapPostEffect swap_post_effect_desired_ = SwapPostEffect::kNone;
   SwapPostEffect swap_post_effect_actual_ = SwapPostEffect::kNone;
 
+  // Whether the current frame is the same as the previous one, and its draws
+  // and the swap are skipped, keeping the previous guest output.
+  bool idle_frame_ = false;
+  bool frame_begin_pending_ = true;
+  uint64_t previous_frame_fingerprint_ = 0;
+  uint64_t previous_frame_invalidation_count_ = 0;
+  // Whether a resolve or a memexport draw has been encountered since the
+  // beginning of the current frame.
+  bool frame_writes_memory_ = false;
+
  private:
   reg::DC_LUT_30_COLOR gamma_ramp_256_entry_table_[256] = {};
   reg::DC_LUT_PWL_DATA gamma_ramp_pwl_rgb_[128][3] = {};
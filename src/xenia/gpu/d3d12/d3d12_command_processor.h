@@ -324,6 +324,9 @@ class D3D12CommandProcessor final : public CommandProcessor {
   bool IssueCopy() override;
   XE_NOINLINE
   bool IssueCopy_ReadbackResolvePath();
+  SharedMemory* GetSharedMemory() const override {
+    return shared_memory_.get();
+  }
   void InitializeTrace() override;
 
  private:
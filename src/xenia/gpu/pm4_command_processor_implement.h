@@ -660,10 +660,14 @@ bool COMMAND_PROCESSOR::ExecutePacketType3_XE_SWAP(uint32_t packet,
   uint32_t frontbuffer_height = reader_.ReadAndSwap<uint32_t>();
   reader_.AdvanceRead((count - 4) * sizeof(uint32_t));
 
-  COMMAND_PROCESSOR::IssueSwap(frontbuffer_ptr, frontbuffer_width,
-                               frontbuffer_height);
+  // For an idle frame, keep presenting the previous guest output.
+  if (!idle_frame_) {
+    COMMAND_PROCESSOR::IssueSwap(frontbuffer_ptr, frontbuffer_width,
+                                 frontbuffer_height);
+  }
 
   ++counter_;
+  EndFrame();
   return true;
 }
 
@@ -715,6 +719,7 @@ bool COMMAND_PROCESSOR::ExecutePacketType3_WAIT_REG_MEM(
                 : register_file_->values[poll_reg_addr];
 
   bool matched = false;
+  bool waited = false;
 
   do {
     uint32_t value = value_ref;
@@ -749,9 +754,16 @@ bool COMMAND_PROCESSOR::ExecutePacketType3_WAIT_REG_MEM(
         }
       } else {
       }
+      waited = true;
     }
   } while (!matched);
 
+  if (waited) {
+    // The CPU may have written the data to use before writing the value waited
+    // for, whether it's in memory or in a register written by the CPU.
+    memory_->TriggerPhysicalMemoryWriteWatchCallbacks();
+  }
+
   return true;
 }
 XE_NOINLINE
@@ -1075,7 +1087,20 @@ bool COMMAND_PROCESSOR::ExecutePacketType3Draw(
   // we don't support yet.
   reader_.AdvanceRead(count_remaining * sizeof(uint32_t));
 
-  if (draw_succeeded) {
+  // Resolves (including EDRAM clears) and memexport write guest memory, and
+  // multipass frames resolve what has been drawn to EDRAM within the same
+  // frame. Frames with them are never treated as idle, so skipped draws never
+  // result in stale EDRAM contents being written to memory.
+  if (register_file_->Get<reg::RB_MODECONTROL>().edram_mode ==
+          xenos::ModeControl::kCopy ||
+      (active_vertex_shader_ &&
+       active_vertex_shader_->memexport_eM_written()) ||
+      (active_pixel_shader_ && active_pixel_shader_->memexport_eM_written())) {
+    frame_writes_memory_ = true;
+  }
+
+  // Nothing to draw in an idle frame, it's the same as the previous one.
+  if (draw_succeeded && !idle_frame_) {
     auto viz_query = register_file_->Get<reg::PA_SC_VIZ_QUERY>();
     if (!(viz_query.viz_query_ena && viz_query.kill_pix_post_hi_z)) {
       // TODO(Triang3l): Don't drop the draw call completely if the vertex
@@ -1386,6 +1411,9 @@ uint32_t COMMAND_PROCESSOR::ExecutePrimaryBuffer(uint32_t read_index,
 
   reader_.set_read_offset(read_index * sizeof(uint32_t));
   reader_.set_write_offset(write_index * sizeof(uint32_t));
+  if (frame_begin_pending_) {
+    BeginFrame(reader_);
+  }
   // prefetch the wraparound range
   // it likely is already in L3 cache, but in a zen system it may be another
   // chiplets l3
@@ -1643,6 +1643,7 @@ void RenderTargetCache::ChangeOwnership(
                       transfer_host_depth_source_rt_it != render_targets_.end()
                           ? transfer_host_depth_source_rt_it->second
                           : nullptr);
+                  ++ownership_transfer_count_;
                 }
               }
             }
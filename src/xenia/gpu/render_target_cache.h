@@ -204,6 +204,12 @@ class RenderTargetCache {
     return draw_resolution_scale_x() > 1 || draw_resolution_scale_y() > 1;
   }
 
+  // Copying transfers of EDRAM range ownership between render targets, for
+  // performance statistics.
+  uint64_t ownership_transfer_count() const {
+    return ownership_transfer_count_;
+  }
+
   // Virtual (both the common code and the implementation may do something
   // here), don't call from destructors (does work not needed for shutdown
   // also).
@@ -618,6 +624,7 @@ class RenderTargetCache {
 
  private:
   const RegisterFile& register_file_;
+  uint64_t ownership_transfer_count_ = 0;
   uint32_t draw_resolution_scale_x_;
   uint32_t draw_resolution_scale_y_;
 
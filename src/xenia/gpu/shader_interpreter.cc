@@ -13,13 +13,43 @@
 #include <cmath>
 #include <cstring>
 
+#include "xenia/base/cvar.h"
+
+DEFINE_bool(shader_interpreter_jit, false,
+            "Compile the shaders executed on the CPU, such as for draw extent "
+            "estimation, to native code rather than interpreting them, where "
+            "supported by the compiler.",
+            "GPU");
+
 namespace xe {
 namespace gpu {
 
+void ShaderInterpreter::SetShader(const Shader& shader) {
+  assert_true(CanInterpretShader(shader));
+  SetShader(shader.type(), shader.ucode_dwords());
+  if (!cvars::shader_interpreter_jit) {
+    return;
+  }
+  auto jit_shader_it = jit_shaders_.find(shader.ucode_data_hash());
+  if (jit_shader_it == jit_shaders_.end()) {
+    jit_shader_it =
+        jit_shaders_
+            .emplace(shader.ucode_data_hash(),
+                     ShaderInterpreterJit::Compile(shader))
+            .first;
+  }
+  jit_shader_ = jit_shader_it->second.get();
+}
+
 void ShaderInterpreter::Execute() {
   // For more consistency between invocations in case of a malformed shader.
   state_.Reset();
 
+  if (jit_shader_) {
+    ExecuteJit();
+    return;
+  }
+
   const uint32_t* bool_constants =
       &register_file_[XE_GPU_REG_SHADER_CONSTANT_BOOL_000_031];
 
@@ -250,6 +280,20 @@ void ShaderInterpreter::Execute() {
   }
 }
 
+void ShaderInterpreter::ExecuteJit() {
+  auto base_and_size_minus_1 = register_file_.Get<reg::SQ_VS_CONST>(
+      shader_type_ == xenos::ShaderType::kVertex ? XE_GPU_REG_SQ_VS_CONST
+                                                 : XE_GPU_REG_SQ_PS_CONST);
+  ShaderInterpreterJit::Context context;
+  context.temp_registers = temp_registers_;
+  context.registers = register_file_.values;
+  context.interpreter = this;
+  context.float_constant_base = base_and_size_minus_1.base;
+  context.float_constant_size = base_and_size_minus_1.size;
+  context.previous_scalar = 0.0f;
+  jit_shader_->function()(&context);
+}
+
 const std::array<float, 4> ShaderInterpreter::GetFloatConstant(
     uint32_t address, bool is_relative, bool relative_address_is_a0) const {
   int32_t index = int32_t(address);
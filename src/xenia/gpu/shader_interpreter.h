@@ -14,9 +14,12 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <unordered_map>
 
 #include "xenia/gpu/register_file.h"
 #include "xenia/gpu/shader.h"
+#include "xenia/gpu/shader_interpreter_jit.h"
 #include "xenia/gpu/trace_writer.h"
 #include "xenia/memory.h"
 
@@ -61,15 +64,16 @@ class ShaderInterpreter {
   void SetShader(xenos::ShaderType shader_type, const uint32_t* ucode) {
     shader_type_ = shader_type;
     ucode_ = ucode;
+    jit_shader_ = nullptr;
   }
-  void SetShader(const Shader& shader) {
-    assert_true(CanInterpretShader(shader));
-    SetShader(shader.type(), shader.ucode_dwords());
-  }
+  // Also uses the native code compiled from the shader if possible.
+  void SetShader(const Shader& shader);
 
   void Execute();
 
  private:
+  friend class ShaderInterpreterJit;
+
   struct State {
     ucode::VertexFetchInstruction vfetch_full_last;
     uint32_t vfetch_address_dwords;
@@ -125,6 +129,7 @@ class ShaderInterpreter {
   void StoreFetchResult(uint32_t dest, bool is_dest_relative, uint32_t swizzle,
                         const float* value);
   void ExecuteVertexFetchInstruction(ucode::VertexFetchInstruction instr);
+  void ExecuteJit();
 
   const RegisterFile& register_file_;
   const Memory& memory_;
@@ -136,6 +141,12 @@ class ShaderInterpreter {
   xenos::ShaderType shader_type_ = xenos::ShaderType::kVertex;
   const uint32_t* ucode_ = nullptr;
 
+  // Compiled shaders by the ucode hash, or nullptr if a shader can't be
+  // compiled.
+  std::unordered_map<uint64_t, std::unique_ptr<ShaderInterpreterJit>>
+      jit_shaders_;
+  const ShaderInterpreterJit* jit_shader_ = nullptr;
+
   // For both inputs and locals.
   float temp_registers_[xenos::kMaxShaderTempRegisters][4];
 
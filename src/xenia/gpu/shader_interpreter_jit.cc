@@ -0,0 +1,831 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/shader_interpreter_jit.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+#include "xenia/base/logging.h"
+#include "xenia/base/platform.h"
+#include "xenia/gpu/register_file.h"
+#include "xenia/gpu/shader_interpreter.h"
+
+#if XE_ARCH_AMD64
+#define XBYAK_NO_OP_NAMES
+#include "third_party/xbyak/xbyak/xbyak.h"
+#endif
+
+namespace xe {
+namespace gpu {
+
+#if XE_ARCH_AMD64
+
+namespace {
+
+float Exp2(float value) { return std::exp2(value); }
+float Log2(float value) { return std::log2(value); }
+float Log2Clamped(float value) {
+  float result = std::log2(value);
+  return result == -INFINITY ? -FLT_MAX : result;
+}
+float Sin(float value) { return std::sin(value); }
+float Cos(float value) { return std::cos(value); }
+
+// vcmpps predicates.
+constexpr uint8_t kCmpEqOq = 0x00;
+constexpr uint8_t kCmpNeqUq = 0x04;
+constexpr uint8_t kCmpGeOq = 0x1D;
+constexpr uint8_t kCmpGtOq = 0x1E;
+// vroundps modes.
+constexpr uint8_t kRoundFloor = 0b01;
+constexpr uint8_t kRoundTrunc = 0b11;
+
+}  // namespace
+
+// Registers in the compiled code:
+// - rbx - the context.
+// - r12 - the temporary registers.
+// - r13 - the register file.
+// - xmm0:xmm2 - operands, xmm3 - results, xmm4:xmm5 - scratch. xmm6 and above
+//   are not used as they are callee-saved in the Windows x64 calling
+//   convention.
+// The semantics of the interpreter, including the handling of zeros, NaNs and
+// denormals, are replicated exactly.
+class ShaderInterpreterJit::Emitter : public Xbyak::CodeGenerator {
+ public:
+  Emitter() : CodeGenerator(4096, Xbyak::AutoGrow) {}
+
+  bool Emit(const Shader& shader);
+
+ private:
+  static Xbyak::Reg64 GetArgumentRegister(uint32_t index) {
+#if XE_PLATFORM_WIN32
+    static const int kArgumentRegisters[] = {
+        Xbyak::Operand::RCX, Xbyak::Operand::RDX, Xbyak::Operand::R8,
+        Xbyak::Operand::R9};
+#else
+    static const int kArgumentRegisters[] = {
+        Xbyak::Operand::RDI, Xbyak::Operand::RSI, Xbyak::Operand::RDX,
+        Xbyak::Operand::RCX};
+#endif
+    return Xbyak::Reg64(kArgumentRegisters[index]);
+  }
+
+  Xbyak::Address GetTempRegister(uint32_t index) {
+    return ptr[r12 + sizeof(float) * 4 *
+                         (index & (xenos::kMaxShaderTempRegisters - 1))];
+  }
+  Xbyak::Address GetConstant(Xbyak::Label& label) { return ptr[rip + label]; }
+
+  void CallHelper(const void* function);
+
+  void LoadFloatConstant(const Xbyak::Xmm& dest, uint32_t address);
+  void ApplySourceModifiers(const Xbyak::Xmm& value, uint32_t swizzle,
+                            bool absolute, bool negate);
+  void EmitMultiplication(const Xbyak::Xmm& dest, const Xbyak::Xmm& a,
+                          const Xbyak::Xmm& b, bool scalar);
+  void EmitScalarReplacement(const Xbyak::Xmm& value, Xbyak::Label& from,
+                             Xbyak::Label& to);
+  void EmitSaturation(const Xbyak::Xmm& value);
+
+  bool EmitControlFlowExec(const Shader& shader,
+                           const ucode::ControlFlowExecInstruction& cf_exec);
+  bool EmitFetchInstruction(const ucode::FetchInstruction& instr);
+  bool EmitAluInstruction(const ucode::AluInstruction& instr);
+  bool EmitVectorOperation(ucode::AluVectorOpcode opcode);
+  bool EmitScalarOperation(ucode::AluScalarOpcode opcode);
+
+  void EmitConstants();
+
+  Xbyak::Label end_label_;
+
+  Xbyak::Label abs_mask_;
+  Xbyak::Label sign_mask_;
+  Xbyak::Label zero_;
+  Xbyak::Label one_;
+  Xbyak::Label flt_max_;
+  Xbyak::Label negative_flt_max_;
+  Xbyak::Label infinity_;
+  Xbyak::Label negative_infinity_;
+};
+
+bool ShaderInterpreterJit::Emitter::Emit(const Shader& shader) {
+  const uint32_t* ucode = shader.ucode_dwords();
+
+  // Aligns the stack to 16 bytes, and allocates the shadow space for the
+  // helper calls.
+  push(rbx);
+  push(r12);
+  push(r13);
+  sub(rsp, 32);
+  mov(rbx, GetArgumentRegister(0));
+  mov(r12, qword[rbx + offsetof(Context, temp_registers)]);
+  mov(r13, qword[rbx + offsetof(Context, registers)]);
+
+  bool exec_ended = false;
+  uint32_t cf_index_bound = 2 * shader.cf_pair_index_bound();
+  for (uint32_t cf_index = 0; !exec_ended; ++cf_index) {
+    if (cf_index >= cf_index_bound) {
+      // Not ended by an unconditional exec.
+      return false;
+    }
+
+    const uint32_t* cf_pair = &ucode[3 * (cf_index >> 1)];
+    ucode::ControlFlowInstruction cf_instr;
+    if (cf_index & 1) {
+      cf_instr.dword_0 = (cf_pair[1] >> 16) | (cf_pair[2] << 16);
+      cf_instr.dword_1 = cf_pair[2] >> 16;
+    } else {
+      cf_instr.dword_0 = cf_pair[0];
+      cf_instr.dword_1 = cf_pair[1] & 0xFFFF;
+    }
+
+    ucode::ControlFlowOpcode cf_opcode = cf_instr.opcode();
+    switch (cf_opcode) {
+      case ucode::ControlFlowOpcode::kNop:
+      case ucode::ControlFlowOpcode::kMarkVsFetchDone: {
+      } break;
+
+      case ucode::ControlFlowOpcode::kExec:
+      case ucode::ControlFlowOpcode::kExecEnd:
+      case ucode::ControlFlowOpcode::kCondExec:
+      case ucode::ControlFlowOpcode::kCondExecEnd:
+      case ucode::ControlFlowOpcode::kCondExecPredClean:
+      case ucode::ControlFlowOpcode::kCondExecPredCleanEnd: {
+        const ucode::ControlFlowExecInstruction& cf_exec =
+            *reinterpret_cast<const ucode::ControlFlowExecInstruction*>(
+                &cf_instr);
+        bool is_conditional = cf_opcode != ucode::ControlFlowOpcode::kExec &&
+                              cf_opcode != ucode::ControlFlowOpcode::kExecEnd;
+        Xbyak::Label skip_label;
+        if (is_conditional) {
+          const ucode::ControlFlowCondExecInstruction& cf_cond_exec =
+              *reinterpret_cast<const ucode::ControlFlowCondExecInstruction*>(
+                  &cf_exec);
+          uint32_t bool_address = cf_cond_exec.bool_address();
+          test(dword[r13 + sizeof(uint32_t) *
+                               (XE_GPU_REG_SHADER_CONSTANT_BOOL_000_031 +
+                                (bool_address >> 5))],
+               UINT32_C(1) << (bool_address & 31));
+          if (cf_cond_exec.condition()) {
+            jz(skip_label, T_NEAR);
+          } else {
+            jnz(skip_label, T_NEAR);
+          }
+        }
+        if (!EmitControlFlowExec(shader, cf_exec)) {
+          return false;
+        }
+        if (ucode::DoesControlFlowOpcodeEndShader(cf_opcode)) {
+          if (is_conditional) {
+            jmp(end_label_, T_NEAR);
+          } else {
+            exec_ended = true;
+          }
+        }
+        if (is_conditional) {
+          L(skip_label);
+        }
+      } break;
+
+      case ucode::ControlFlowOpcode::kAlloc: {
+        const ucode::ControlFlowAllocInstruction& cf_alloc =
+            *reinterpret_cast<const ucode::ControlFlowAllocInstruction*>(
+                &cf_instr);
+        mov(GetArgumentRegister(0), rbx);
+        mov(GetArgumentRegister(1).cvt32(), uint32_t(cf_alloc.alloc_type()));
+        mov(GetArgumentRegister(2).cvt32(), cf_alloc.size());
+        CallHelper(reinterpret_cast<const void*>(&AllocExport));
+      } break;
+
+      default:
+        // Predication, loops, calls and jumps.
+        return false;
+    }
+  }
+
+  L(end_label_);
+  add(rsp, 32);
+  pop(r13);
+  pop(r12);
+  pop(rbx);
+  ret();
+
+  EmitConstants();
+  return true;
+}
+
+void ShaderInterpreterJit::Emitter::CallHelper(const void* function) {
+  mov(rax, reinterpret_cast<uint64_t>(function));
+  call(rax);
+}
+
+void ShaderInterpreterJit::Emitter::LoadFloatConstant(const Xbyak::Xmm& dest,
+                                                      uint32_t address) {
+  // Bounds checking like in ShaderInterpreter::GetFloatConstant.
+  Xbyak::Label zero_label, loaded_label;
+  cmp(dword[rbx + offsetof(Context, float_constant_size)], address);
+  jb(zero_label, T_NEAR);
+  mov(eax, dword[rbx + offsetof(Context, float_constant_base)]);
+  add(eax, address);
+  cmp(eax, 512);
+  jae(zero_label, T_NEAR);
+  shl(eax, 4);
+  vmovups(dest, ptr[r13 + rax + sizeof(uint32_t) *
+                                    XE_GPU_REG_SHADER_CONSTANT_000_X]);
+  jmp(loaded_label, T_NEAR);
+  L(zero_label);
+  vxorps(dest, dest, dest);
+  L(loaded_label);
+}
+
+void ShaderInterpreterJit::Emitter::ApplySourceModifiers(
+    const Xbyak::Xmm& value, uint32_t swizzle, bool absolute, bool negate) {
+  uint8_t swizzle_imm = 0;
+  for (uint32_t i = 0; i < 4; ++i) {
+    swizzle_imm |=
+        uint8_t(ucode::AluInstruction::GetSwizzledComponentIndex(swizzle, i)
+                << (i * 2));
+  }
+  if (swizzle_imm != 0b11100100) {
+    vpermilps(value, value, swizzle_imm);
+  }
+  // Flush denormals, keeping the sign.
+  vandps(xmm5, value, GetConstant(infinity_));
+  vpcmpeqd(xmm5, xmm5, GetConstant(zero_));
+  vandps(xmm5, xmm5, GetConstant(abs_mask_));
+  vandnps(value, xmm5, value);
+  if (absolute) {
+    vandps(value, value, GetConstant(abs_mask_));
+  }
+  if (negate) {
+    vxorps(value, value, GetConstant(sign_mask_));
+  }
+}
+
+void ShaderInterpreterJit::Emitter::EmitMultiplication(const Xbyak::Xmm& dest,
+                                                       const Xbyak::Xmm& a,
+                                                       const Xbyak::Xmm& b,
+                                                       bool scalar) {
+  // Direct3D 9 behavior (0 or denormal * anything = +0).
+  vxorps(xmm5, xmm5, xmm5);
+  if (scalar) {
+    vcmpss(xmm4, a, xmm5, kCmpNeqUq);
+    vcmpss(xmm5, b, xmm5, kCmpNeqUq);
+    vmulss(dest, a, b);
+  } else {
+    vcmpps(xmm4, a, xmm5, kCmpNeqUq);
+    vcmpps(xmm5, b, xmm5, kCmpNeqUq);
+    vmulps(dest, a, b);
+  }
+  vandps(xmm4, xmm4, xmm5);
+  vandps(dest, dest, xmm4);
+}
+
+void ShaderInterpreterJit::Emitter::EmitScalarReplacement(
+    const Xbyak::Xmm& value, Xbyak::Label& from, Xbyak::Label& to) {
+  vcmpss(xmm4, value, GetConstant(from), kCmpEqOq);
+  vblendvps(value, value, GetConstant(to), xmm4);
+}
+
+void ShaderInterpreterJit::Emitter::EmitSaturation(const Xbyak::Xmm& value) {
+  // NaN is converted to 0, like in xe::saturate.
+  vmaxps(value, value, GetConstant(zero_));
+  vminps(value, value, GetConstant(one_));
+}
+
+bool ShaderInterpreterJit::Emitter::EmitControlFlowExec(
+    const Shader& shader, const ucode::ControlFlowExecInstruction& cf_exec) {
+  const uint32_t* ucode = shader.ucode_dwords();
+  for (uint32_t exec_index = 0; exec_index < cf_exec.count(); ++exec_index) {
+    uint32_t instruction_index = cf_exec.address() + exec_index;
+    if (3 * (instruction_index + 1) > shader.ucode_dword_count()) {
+      return false;
+    }
+    const uint32_t* exec_instruction = &ucode[3 * instruction_index];
+    if ((cf_exec.sequence() >> (exec_index << 1)) & 0b01) {
+      if (!EmitFetchInstruction(
+              *reinterpret_cast<const ucode::FetchInstruction*>(
+                  exec_instruction))) {
+        return false;
+      }
+    } else {
+      if (!EmitAluInstruction(*reinterpret_cast<const ucode::AluInstruction*>(
+              exec_instruction))) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool ShaderInterpreterJit::Emitter::EmitFetchInstruction(
+    const ucode::FetchInstruction& instr) {
+  if (instr.is_predicated()) {
+    return false;
+  }
+  if (instr.opcode() == ucode::FetchOpcode::kVertexFetch) {
+    const ucode::VertexFetchInstruction& vfetch = instr.vertex_fetch();
+    if (vfetch.is_src_relative() || vfetch.is_dest_relative()) {
+      return false;
+    }
+    // Copying the instruction to the code, the ucode is owned by the shader.
+    uint32_t dwords[3];
+    std::memcpy(dwords, &vfetch, sizeof(dwords));
+    mov(GetArgumentRegister(0), rbx);
+    mov(GetArgumentRegister(1).cvt32(), dwords[0]);
+    mov(GetArgumentRegister(2).cvt32(), dwords[1]);
+    mov(GetArgumentRegister(3).cvt32(), dwords[2]);
+    CallHelper(reinterpret_cast<const void*>(&ExecuteVertexFetchInstruction));
+  } else {
+    // Not supporting texture fetching, like the interpreter.
+    if (instr.is_dest_relative()) {
+      return false;
+    }
+    mov(GetArgumentRegister(0), rbx);
+    mov(GetArgumentRegister(1).cvt32(), instr.dest());
+    mov(GetArgumentRegister(2).cvt32(), instr.dest_swizzle());
+    CallHelper(reinterpret_cast<const void*>(&StoreZeroFetchResult));
+  }
+  return true;
+}
+
+bool ShaderInterpreterJit::Emitter::EmitAluInstruction(
+    const ucode::AluInstruction& instr) {
+  if (instr.is_predicated()) {
+    return false;
+  }
+
+  // Vector operation, with the result stored in the context.
+  ucode::AluVectorOpcode vector_opcode = instr.vector_opcode();
+  const ucode::AluVectorOpcodeInfo& vector_opcode_info =
+      ucode::GetAluVectorOpcodeInfo(vector_opcode);
+  if (vector_opcode_info.changed_state) {
+    // Predicate, address register or kill.
+    return false;
+  }
+  uint32_t vector_result_write_mask = instr.GetVectorOpResultWriteMask();
+  if (vector_result_write_mask) {
+    for (uint32_t i = 0; i < 3; ++i) {
+      if (!vector_opcode_info.operand_components_used[i]) {
+        continue;
+      }
+      Xbyak::Xmm operand(int(i));
+      uint32_t vector_src_register = instr.src_reg(1 + i);
+      bool vector_src_absolute = false;
+      if (instr.src_is_temp(1 + i)) {
+        if (ucode::AluInstruction::is_src_temp_relative(vector_src_register)) {
+          return false;
+        }
+        vmovups(operand, GetTempRegister(ucode::AluInstruction::src_temp_reg(
+                             vector_src_register)));
+        vector_src_absolute = ucode::AluInstruction::is_src_temp_value_absolute(
+            vector_src_register);
+      } else {
+        if (instr.src_const_is_addressed(1 + i)) {
+          return false;
+        }
+        LoadFloatConstant(operand, vector_src_register);
+      }
+      ApplySourceModifiers(operand, instr.src_swizzle(1 + i),
+                           vector_src_absolute, instr.src_negate(1 + i));
+    }
+    if (!EmitVectorOperation(vector_opcode)) {
+      return false;
+    }
+    if (instr.vector_clamp()) {
+      EmitSaturation(xmm3);
+    }
+    vmovups(ptr[rbx + offsetof(Context, vector_result)], xmm3);
+  }
+
+  // Scalar operation, with the result stored as the previous scalar.
+  ucode::AluScalarOpcode scalar_opcode = instr.scalar_opcode();
+  const ucode::AluScalarOpcodeInfo& scalar_opcode_info =
+      ucode::GetAluScalarOpcodeInfo(scalar_opcode);
+  uint32_t scalar_src_swizzle = instr.src_swizzle(3);
+  switch (scalar_opcode_info.operand_count) {
+    case 1: {
+      // r#/c#.w or r#/c#.wx.
+      uint32_t scalar_src_register = instr.src_reg(3);
+      bool scalar_src_absolute = false;
+      if (instr.src_is_temp(3)) {
+        if (ucode::AluInstruction::is_src_temp_relative(scalar_src_register)) {
+          return false;
+        }
+        vmovups(xmm1, GetTempRegister(ucode::AluInstruction::src_temp_reg(
+                          scalar_src_register)));
+        scalar_src_absolute = ucode::AluInstruction::is_src_temp_value_absolute(
+            scalar_src_register);
+      } else {
+        if (instr.src_const_is_addressed(3)) {
+          return false;
+        }
+        LoadFloatConstant(xmm1, scalar_src_register);
+      }
+      // Moving the used components to x without further swizzling.
+      vpermilps(xmm0, xmm1,
+                uint8_t(ucode::AluInstruction::GetSwizzledComponentIndex(
+                    scalar_src_swizzle, 3)));
+      ApplySourceModifiers(xmm0, 0b11100100, scalar_src_absolute,
+                           instr.src_negate(3));
+      if (scalar_opcode_info.single_operand_is_two_component) {
+        vpermilps(xmm1, xmm1,
+                  uint8_t(ucode::AluInstruction::GetSwizzledComponentIndex(
+                      scalar_src_swizzle, 0)));
+        ApplySourceModifiers(xmm1, 0b11100100, scalar_src_absolute,
+                             instr.src_negate(3));
+      }
+    } break;
+    case 2: {
+      // c#.w.
+      if (instr.src_const_is_addressed(3)) {
+        return false;
+      }
+      LoadFloatConstant(xmm0, instr.src_reg(3));
+      vpermilps(xmm0, xmm0,
+                uint8_t(ucode::AluInstruction::GetSwizzledComponentIndex(
+                    scalar_src_swizzle, 3)));
+      ApplySourceModifiers(xmm0, 0b11100100, false, instr.src_negate(3));
+      // r#.x.
+      vmovups(xmm1, GetTempRegister(instr.scalar_const_reg_op_src_temp_reg()));
+      vpermilps(xmm1, xmm1,
+                uint8_t(ucode::AluInstruction::GetSwizzledComponentIndex(
+                    scalar_src_swizzle, 0)));
+      ApplySourceModifiers(xmm1, 0b11100100, false, instr.src_negate(3));
+    } break;
+  }
+  if (!EmitScalarOperation(scalar_opcode)) {
+    return false;
+  }
+
+  // Results - the vector result in xmm0, the replicated scalar result in xmm1.
+  uint32_t scalar_result_write_mask = instr.GetScalarOpResultWriteMask();
+  if (vector_result_write_mask) {
+    vmovups(xmm0, ptr[rbx + offsetof(Context, vector_result)]);
+  }
+  vbroadcastss(xmm1, dword[rbx + offsetof(Context, previous_scalar)]);
+  if (instr.scalar_clamp()) {
+    EmitSaturation(xmm1);
+  }
+  if (instr.is_export()) {
+    uint32_t export_constant_1_mask = instr.GetConstant1WriteMask();
+    uint32_t export_mask = vector_result_write_mask | scalar_result_write_mask |
+                           instr.GetConstant0WriteMask() |
+                           export_constant_1_mask;
+    vxorps(xmm2, xmm2, xmm2);
+    if (vector_result_write_mask) {
+      vblendps(xmm2, xmm2, xmm0, uint8_t(vector_result_write_mask));
+    }
+    uint32_t export_scalar_mask =
+        scalar_result_write_mask & ~vector_result_write_mask;
+    if (export_scalar_mask) {
+      vblendps(xmm2, xmm2, xmm1, uint8_t(export_scalar_mask));
+    }
+    export_constant_1_mask &=
+        ~(vector_result_write_mask | scalar_result_write_mask);
+    if (export_constant_1_mask) {
+      vblendps(xmm2, xmm2, GetConstant(one_), uint8_t(export_constant_1_mask));
+    }
+    vmovups(ptr[rbx + offsetof(Context, export_value)], xmm2);
+    mov(GetArgumentRegister(0), rbx);
+    mov(GetArgumentRegister(1).cvt32(), instr.vector_dest());
+    mov(GetArgumentRegister(2).cvt32(), export_mask);
+    CallHelper(reinterpret_cast<const void*>(&Export));
+  } else {
+    if (vector_result_write_mask) {
+      if (instr.is_vector_dest_relative()) {
+        return false;
+      }
+      Xbyak::Address vector_dest = GetTempRegister(instr.vector_dest());
+      vmovups(xmm2, vector_dest);
+      vblendps(xmm2, xmm2, xmm0, uint8_t(vector_result_write_mask));
+      vmovups(vector_dest, xmm2);
+    }
+    if (scalar_result_write_mask) {
+      if (instr.is_scalar_dest_relative()) {
+        return false;
+      }
+      Xbyak::Address scalar_dest = GetTempRegister(instr.scalar_dest());
+      vmovups(xmm2, scalar_dest);
+      vblendps(xmm2, xmm2, xmm1, uint8_t(scalar_result_write_mask));
+      vmovups(scalar_dest, xmm2);
+    }
+  }
+  return true;
+}
+
+bool ShaderInterpreterJit::Emitter::EmitVectorOperation(
+    ucode::AluVectorOpcode opcode) {
+  switch (opcode) {
+    case ucode::AluVectorOpcode::kAdd:
+      vaddps(xmm3, xmm0, xmm1);
+      break;
+    case ucode::AluVectorOpcode::kMul:
+      EmitMultiplication(xmm3, xmm0, xmm1, false);
+      break;
+    case ucode::AluVectorOpcode::kMax:
+      vcmpps(xmm4, xmm0, xmm1, kCmpGeOq);
+      vblendvps(xmm3, xmm1, xmm0, xmm4);
+      break;
+    case ucode::AluVectorOpcode::kMin:
+      // Returns the second operand if either is NaN, like std::isless.
+      vminps(xmm3, xmm0, xmm1);
+      break;
+    case ucode::AluVectorOpcode::kSeq:
+      vcmpps(xmm3, xmm0, xmm1, kCmpEqOq);
+      vandps(xmm3, xmm3, GetConstant(one_));
+      break;
+    case ucode::AluVectorOpcode::kSgt:
+      vcmpps(xmm3, xmm0, xmm1, kCmpGtOq);
+      vandps(xmm3, xmm3, GetConstant(one_));
+      break;
+    case ucode::AluVectorOpcode::kSge:
+      vcmpps(xmm3, xmm0, xmm1, kCmpGeOq);
+      vandps(xmm3, xmm3, GetConstant(one_));
+      break;
+    case ucode::AluVectorOpcode::kSne:
+      vcmpps(xmm3, xmm0, xmm1, kCmpNeqUq);
+      vandps(xmm3, xmm3, GetConstant(one_));
+      break;
+    case ucode::AluVectorOpcode::kFrc:
+      vroundps(xmm4, xmm0, kRoundFloor);
+      vsubps(xmm3, xmm0, xmm4);
+      break;
+    case ucode::AluVectorOpcode::kTrunc:
+      vroundps(xmm3, xmm0, kRoundTrunc);
+      break;
+    case ucode::AluVectorOpcode::kFloor:
+      vroundps(xmm3, xmm0, kRoundFloor);
+      break;
+    case ucode::AluVectorOpcode::kMad:
+      // Doing the addition rather than conditional assignment even for zero
+      // operands because +0 + -0 must be +0.
+      EmitMultiplication(xmm3, xmm0, xmm1, false);
+      vaddps(xmm3, xmm3, xmm2);
+      break;
+    case ucode::AluVectorOpcode::kCndEq:
+      vxorps(xmm4, xmm4, xmm4);
+      vcmpps(xmm4, xmm0, xmm4, kCmpEqOq);
+      vblendvps(xmm3, xmm2, xmm1, xmm4);
+      break;
+    case ucode::AluVectorOpcode::kCndGe:
+      vxorps(xmm4, xmm4, xmm4);
+      vcmpps(xmm4, xmm0, xmm4, kCmpGeOq);
+      vblendvps(xmm3, xmm2, xmm1, xmm4);
+      break;
+    case ucode::AluVectorOpcode::kCndGt:
+      vxorps(xmm4, xmm4, xmm4);
+      vcmpps(xmm4, xmm0, xmm4, kCmpGtOq);
+      vblendvps(xmm3, xmm2, xmm1, xmm4);
+      break;
+    case ucode::AluVectorOpcode::kDp4:
+    case ucode::AluVectorOpcode::kDp3:
+    case ucode::AluVectorOpcode::kDp2Add: {
+      uint32_t component_count =
+          opcode == ucode::AluVectorOpcode::kDp4
+              ? 4
+              : (opcode == ucode::AluVectorOpcode::kDp3 ? 3 : 2);
+      EmitMultiplication(xmm3, xmm0, xmm1, false);
+      // Adding in the same order as the interpreter, starting from +0 because
+      // +0 + -0 must be +0.
+      vxorps(xmm4, xmm4, xmm4);
+      vaddss(xmm4, xmm4, xmm3);
+      for (uint32_t i = 1; i < component_count; ++i) {
+        vpermilps(xmm5, xmm3, uint8_t(i));
+        vaddss(xmm4, xmm4, xmm5);
+      }
+      if (opcode == ucode::AluVectorOpcode::kDp2Add) {
+        vaddss(xmm4, xmm4, xmm2);
+      }
+      vpermilps(xmm3, xmm4, 0);
+    } break;
+    default:
+      // Cube, Max4 and Dst are rare in the vertex shaders, others change the
+      // state.
+      return false;
+  }
+  return true;
+}
+
+bool ShaderInterpreterJit::Emitter::EmitScalarOperation(
+    ucode::AluScalarOpcode opcode) {
+  const void* helper = nullptr;
+  switch (opcode) {
+    case ucode::AluScalarOpcode::kAdds:
+    case ucode::AluScalarOpcode::kAddsc0:
+    case ucode::AluScalarOpcode::kAddsc1:
+      vaddss(xmm3, xmm0, xmm1);
+      break;
+    case ucode::AluScalarOpcode::kAddsPrev:
+      vaddss(xmm3, xmm0, dword[rbx + offsetof(Context, previous_scalar)]);
+      break;
+    case ucode::AluScalarOpcode::kMuls:
+    case ucode::AluScalarOpcode::kMulsc0:
+    case ucode::AluScalarOpcode::kMulsc1:
+      EmitMultiplication(xmm3, xmm0, xmm1, true);
+      break;
+    case ucode::AluScalarOpcode::kMulsPrev:
+      vmovss(xmm2, dword[rbx + offsetof(Context, previous_scalar)]);
+      EmitMultiplication(xmm3, xmm0, xmm2, true);
+      break;
+    case ucode::AluScalarOpcode::kMaxs:
+      vcmpss(xmm4, xmm0, xmm1, kCmpGeOq);
+      vblendvps(xmm3, xmm1, xmm0, xmm4);
+      break;
+    case ucode::AluScalarOpcode::kMins:
+      vminss(xmm3, xmm0, xmm1);
+      break;
+    case ucode::AluScalarOpcode::kSeqs:
+      vcmpss(xmm3, xmm0, GetConstant(zero_), kCmpEqOq);
+      vandps(xmm3, xmm3, GetConstant(one_));
+      break;
+    case ucode::AluScalarOpcode::kSgts:
+      vcmpss(xmm3, xmm0, GetConstant(zero_), kCmpGtOq);
+      vandps(xmm3, xmm3, GetConstant(one_));
+      break;
+    case ucode::AluScalarOpcode::kSges:
+      vcmpss(xmm3, xmm0, GetConstant(zero_), kCmpGeOq);
+      vandps(xmm3, xmm3, GetConstant(one_));
+      break;
+    case ucode::AluScalarOpcode::kSnes:
+      vcmpss(xmm3, xmm0, GetConstant(zero_), kCmpNeqUq);
+      vandps(xmm3, xmm3, GetConstant(one_));
+      break;
+    case ucode::AluScalarOpcode::kFrcs:
+      vroundss(xmm4, xmm0, xmm0, kRoundFloor);
+      vsubss(xmm3, xmm0, xmm4);
+      break;
+    case ucode::AluScalarOpcode::kTruncs:
+      vroundss(xmm3, xmm0, xmm0, kRoundTrunc);
+      break;
+    case ucode::AluScalarOpcode::kFloors:
+      vroundss(xmm3, xmm0, xmm0, kRoundFloor);
+      break;
+    case ucode::AluScalarOpcode::kExp:
+      helper = reinterpret_cast<const void*>(&Exp2);
+      break;
+    case ucode::AluScalarOpcode::kLogc:
+      helper = reinterpret_cast<const void*>(&Log2Clamped);
+      break;
+    case ucode::AluScalarOpcode::kLog:
+      helper = reinterpret_cast<const void*>(&Log2);
+      break;
+    case ucode::AluScalarOpcode::kRcpc:
+    case ucode::AluScalarOpcode::kRcpf:
+    case ucode::AluScalarOpcode::kRcp:
+      vmovaps(xmm3, GetConstant(one_));
+      vdivss(xmm3, xmm3, xmm0);
+      break;
+    case ucode::AluScalarOpcode::kRsqc:
+    case ucode::AluScalarOpcode::kRsqf:
+    case ucode::AluScalarOpcode::kRsq:
+      vsqrtss(xmm4, xmm0, xmm0);
+      vmovaps(xmm3, GetConstant(one_));
+      vdivss(xmm3, xmm3, xmm4);
+      break;
+    case ucode::AluScalarOpcode::kSubs:
+    case ucode::AluScalarOpcode::kSubsc0:
+    case ucode::AluScalarOpcode::kSubsc1:
+      vsubss(xmm3, xmm0, xmm1);
+      break;
+    case ucode::AluScalarOpcode::kSubsPrev:
+      vsubss(xmm3, xmm0, dword[rbx + offsetof(Context, previous_scalar)]);
+      break;
+    case ucode::AluScalarOpcode::kSqrt:
+      vsqrtss(xmm3, xmm0, xmm0);
+      break;
+    case ucode::AluScalarOpcode::kSin:
+      helper = reinterpret_cast<const void*>(&Sin);
+      break;
+    case ucode::AluScalarOpcode::kCos:
+      helper = reinterpret_cast<const void*>(&Cos);
+      break;
+    case ucode::AluScalarOpcode::kRetainPrev:
+      return true;
+    default:
+      // MulsPrev2, address register, predicate and kill operations.
+      return false;
+  }
+  switch (opcode) {
+    case ucode::AluScalarOpcode::kRcpc:
+    case ucode::AluScalarOpcode::kRsqc:
+      EmitScalarReplacement(xmm3, negative_infinity_, negative_flt_max_);
+      EmitScalarReplacement(xmm3, infinity_, flt_max_);
+      break;
+    case ucode::AluScalarOpcode::kRcpf:
+    case ucode::AluScalarOpcode::kRsqf:
+      // The sign mask is -0.
+      EmitScalarReplacement(xmm3, negative_infinity_, sign_mask_);
+      EmitScalarReplacement(xmm3, infinity_, zero_);
+      break;
+    default:
+      break;
+  }
+  if (helper) {
+    // The operand is already in xmm0, which is also where the result is
+    // returned.
+    CallHelper(helper);
+    vmovss(dword[rbx + offsetof(Context, previous_scalar)], xmm0);
+  } else {
+    vmovss(dword[rbx + offsetof(Context, previous_scalar)], xmm3);
+  }
+  return true;
+}
+
+void ShaderInterpreterJit::Emitter::EmitConstants() {
+  auto emit_constant = [this](Xbyak::Label& label, uint32_t value) {
+    L(label);
+    for (uint32_t i = 0; i < 4; ++i) {
+      dd(value);
+    }
+  };
+  align(16);
+  emit_constant(abs_mask_, UINT32_C(0x7FFFFFFF));
+  emit_constant(sign_mask_, UINT32_C(0x80000000));
+  emit_constant(zero_, UINT32_C(0));
+  emit_constant(one_, UINT32_C(0x3F800000));
+  emit_constant(flt_max_, UINT32_C(0x7F7FFFFF));
+  emit_constant(negative_flt_max_, UINT32_C(0xFF7FFFFF));
+  // Also the exponent mask.
+  emit_constant(infinity_, UINT32_C(0x7F800000));
+  emit_constant(negative_infinity_, UINT32_C(0xFF800000));
+}
+
+#else
+
+class ShaderInterpreterJit::Emitter {};
+
+#endif  // XE_ARCH_AMD64
+
+ShaderInterpreterJit::~ShaderInterpreterJit() = default;
+
+std::unique_ptr<ShaderInterpreterJit> ShaderInterpreterJit::Compile(
+    const Shader& shader) {
+#if XE_ARCH_AMD64
+  std::unique_ptr<ShaderInterpreterJit> jit(new ShaderInterpreterJit);
+  try {
+    jit->emitter_ = std::make_unique<Emitter>();
+    if (!jit->emitter_->Emit(shader)) {
+      return nullptr;
+    }
+    jit->emitter_->ready();
+  } catch (const Xbyak::Error& error) {
+    XELOGE("Failed to compile shader {:016X} for the interpreter: {}",
+           shader.ucode_data_hash(), error.what());
+    return nullptr;
+  }
+  jit->function_ = jit->emitter_->getCode<Function>();
+  return jit;
+#else
+  return nullptr;
+#endif  // XE_ARCH_AMD64
+}
+
+void ShaderInterpreterJit::AllocExport(Context* context, uint32_t type,
+                                       uint32_t size) {
+  ShaderInterpreter::ExportSink* export_sink =
+      context->interpreter->export_sink_;
+  if (export_sink) {
+    export_sink->AllocExport(ucode::AllocType(type), size);
+  }
+}
+
+void ShaderInterpreterJit::Export(Context* context, uint32_t export_register,
+                                  uint32_t value_mask) {
+  ShaderInterpreter::ExportSink* export_sink =
+      context->interpreter->export_sink_;
+  if (export_sink) {
+    export_sink->Export(ucode::ExportRegister(export_register),
+                        context->export_value, value_mask);
+  }
+}
+
+void ShaderInterpreterJit::ExecuteVertexFetchInstruction(Context* context,
+                                                         uint32_t dword_0,
+                                                         uint32_t dword_1,
+                                                         uint32_t dword_2) {
+  uint32_t dwords[] = {dword_0, dword_1, dword_2};
+  ucode::VertexFetchInstruction instr;
+  std::memcpy(&instr, dwords, sizeof(instr));
+  context->interpreter->ExecuteVertexFetchInstruction(instr);
+}
+
+void ShaderInterpreterJit::StoreZeroFetchResult(Context* context,
+                                                uint32_t dest,
+                                                uint32_t swizzle) {
+  float zero_result[4] = {};
+  context->interpreter->StoreFetchResult(dest, false, swizzle, zero_result);
+}
+
+}  // namespace gpu
+}  // namespace xe
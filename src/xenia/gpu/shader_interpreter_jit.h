@@ -0,0 +1,77 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_GPU_SHADER_INTERPRETER_JIT_H_
+#define XENIA_GPU_SHADER_INTERPRETER_JIT_H_
+
+#include <cstdint>
+#include <memory>
+
+#include "xenia/gpu/shader.h"
+#include "xenia/gpu/ucode.h"
+
+namespace xe {
+namespace gpu {
+
+class ShaderInterpreter;
+
+// Native x86-64 code compiled from the ucode of a shader, executed by the
+// ShaderInterpreter instead of interpreting the ucode for every vertex.
+//
+// Only the subset of the shaders that is common in the vertex shaders executed
+// on the CPU is compiled - straight-line code, with execs conditional on bool
+// constants, without predication, loops, calls, jumps and relative addressing.
+// Other shaders are interpreted.
+class ShaderInterpreterJit {
+ public:
+  // State accessed by the compiled code, set up by the interpreter for each
+  // invocation.
+  struct Context {
+    float (*temp_registers)[4];
+    const uint32_t* registers;
+    ShaderInterpreter* interpreter;
+    uint32_t float_constant_base;
+    // Vec4 count minus one.
+    uint32_t float_constant_size;
+    float previous_scalar;
+    float vector_result[4];
+    float export_value[4];
+  };
+  using Function = void (*)(Context* context);
+
+  ~ShaderInterpreterJit();
+
+  // Returns nullptr if the shader can't be compiled, and needs to be
+  // interpreted.
+  static std::unique_ptr<ShaderInterpreterJit> Compile(const Shader& shader);
+
+  Function function() const { return function_; }
+
+ private:
+  class Emitter;
+
+  ShaderInterpreterJit() = default;
+
+  // Called from the compiled code.
+  static void AllocExport(Context* context, uint32_t type, uint32_t size);
+  static void Export(Context* context, uint32_t export_register,
+                     uint32_t value_mask);
+  static void ExecuteVertexFetchInstruction(Context* context, uint32_t dword_0,
+                                            uint32_t dword_1, uint32_t dword_2);
+  static void StoreZeroFetchResult(Context* context, uint32_t dest,
+                                   uint32_t swizzle);
+
+  std::unique_ptr<Emitter> emitter_;
+  Function function_ = nullptr;
+};
+
+}  // namespace gpu
+}  // namespace xe
+
+#endif  // XENIA_GPU_SHADER_INTERPRETER_JIT_H_
@@ -558,6 +558,8 @@ std::pair<uint32_t, uint32_t> SharedMemory::MemoryInvalidationCallback(
   uint32_t block_first = page_first >> 6;
   uint32_t block_last = page_last >> 6;
 
+  cpu_invalidation_count_.fetch_add(1, std::memory_order_relaxed);
+
   auto global_lock = global_critical_region_.Acquire();
 
   if (!exact_range) {
@@ -10,6 +10,8 @@
 #ifndef XENIA_GPU_SHARED_MEMORY_H_
 #define XENIA_GPU_SHARED_MEMORY_H_
 
+#include <atomic>
+
 #include "xenia/memory.h"
 
 namespace xe {
@@ -93,6 +95,13 @@ class SharedMemory {
   std::pair<uint32_t, uint32_t> MemoryInvalidationCallback(
       uint32_t physical_address_start, uint32_t length, bool exact_range);
 
+  // Incremented whenever the CPU modifies memory that has been uploaded, so
+  // comparing the values before and after a frame shows whether the data that
+  // the GPU may be reading could have been changed.
+  uint64_t cpu_invalidation_count() const {
+    return cpu_invalidation_count_.load(std::memory_order_relaxed);
+  }
+
   // Marks the range as containing GPU-generated data (such as resolves),
   // triggering modification callbacks, making it valid (so pages are not
   // copied from the main memory until they're modified by the CPU) and
@@ -168,6 +177,8 @@ class SharedMemory {
  private:
   Memory& memory_;
 
+  std::atomic<uint64_t> cpu_invalidation_count_{0};
+
   // Log2 of invalidation granularity (the system page size, but the dependency
   // on it is not hard - the access callback takes a range as an argument, and
   // touched pages of the buffer of this size will be invalidated).
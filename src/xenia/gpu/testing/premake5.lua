@@ -0,0 +1,18 @@
+project_root = "../../../.."
+include(project_root.."/tools/build")
+
+test_suite("xenia-gpu-tests", project_root, ".", {
+  links = {
+    "dxbc",
+    "fmt",
+    "glslang-spirv",
+    "snappy",
+    "xenia-base",
+    "xenia-core",
+    "xenia-cpu",
+    "xenia-gpu",
+    "xenia-ui",
+    "xxhash",
+    "zstd",
+  },
+})
@@ -0,0 +1,213 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/shader_interpreter.h"
+
+#include <bit>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "third_party/catch/include/catch.hpp"
+
+#include "xenia/base/cvar.h"
+#include "xenia/base/math.h"
+#include "xenia/base/platform.h"
+#include "xenia/base/string_buffer.h"
+#include "xenia/gpu/register_file.h"
+#include "xenia/gpu/shader.h"
+#include "xenia/gpu/shader_interpreter_jit.h"
+#include "xenia/gpu/ucode.h"
+#include "xenia/memory.h"
+
+DECLARE_bool(shader_interpreter_jit);
+
+namespace xe {
+namespace gpu {
+namespace test {
+
+// Appends an ALU instruction with temporary register operands without
+// swizzling.
+void AppendAluInstruction(std::vector<uint32_t>& ucode_dwords,
+                          ucode::AluVectorOpcode vector_opcode,
+                          uint32_t vector_dest, uint32_t vector_write_mask,
+                          ucode::AluScalarOpcode scalar_opcode,
+                          uint32_t scalar_dest, uint32_t scalar_write_mask,
+                          uint32_t src1, uint32_t src2, uint32_t src3,
+                          bool is_export = false) {
+  ucode_dwords.push_back(vector_dest | (scalar_dest << 8) |
+                         (uint32_t(is_export) << 15) |
+                         (vector_write_mask << 16) |
+                         (scalar_write_mask << 20) |
+                         (uint32_t(scalar_opcode) << 26));
+  ucode_dwords.push_back(0);
+  // All operands are temporary registers.
+  ucode_dwords.push_back(src3 | (src2 << 8) | (src1 << 16) |
+                         (uint32_t(vector_opcode) << 24) |
+                         (UINT32_C(0b111) << 29));
+}
+
+// Allocates and exports the position, and writes the results of the
+// multiplication, the minimum, the maximum and the addition of r0 and r1 to
+// r2...r7 with both vector and scalar operations.
+std::vector<uint32_t> BuildTestShaderUcode() {
+  using namespace ucode;
+  constexpr uint32_t kInstructionCount = 6;
+  std::vector<uint32_t> ucode_dwords;
+  // alloc position
+  uint32_t alloc_dword_0 = 1;
+  uint32_t alloc_dword_1 = (uint32_t(AllocType::kVsPosition) << 9) |
+                           (uint32_t(ControlFlowOpcode::kAlloc) << 12);
+  // exec_end of all ALU instructions, which begin after the control flow pair.
+  uint32_t exec_dword_0 = 1 | (kInstructionCount << 12);
+  uint32_t exec_dword_1 = uint32_t(ControlFlowOpcode::kExecEnd) << 12;
+  ucode_dwords.push_back(alloc_dword_0);
+  ucode_dwords.push_back((alloc_dword_1 & 0xFFFF) | (exec_dword_0 << 16));
+  ucode_dwords.push_back((exec_dword_0 >> 16) | (exec_dword_1 << 16));
+  // The scalar operations take the W and the X components of the operand.
+  AppendAluInstruction(ucode_dwords, AluVectorOpcode::kMul, 2, 0b1111,
+                       AluScalarOpcode::kMuls, 3, 0b0001, 0, 1, 0);
+  AppendAluInstruction(ucode_dwords, AluVectorOpcode::kMax, 4, 0b1111,
+                       AluScalarOpcode::kMaxs, 3, 0b0010, 0, 1, 1);
+  AppendAluInstruction(ucode_dwords, AluVectorOpcode::kMin, 5, 0b1111,
+                       AluScalarOpcode::kMins, 3, 0b0100, 0, 1, 1);
+  AppendAluInstruction(ucode_dwords, AluVectorOpcode::kAdd, 6, 0b1111,
+                       AluScalarOpcode::kAdds, 3, 0b1000, 0, 1, 0);
+  AppendAluInstruction(ucode_dwords, AluVectorOpcode::kMad, 7, 0b1111,
+                       AluScalarOpcode::kRetainPrev, 0, 0b0000, 0, 1, 1);
+  AppendAluInstruction(ucode_dwords, AluVectorOpcode::kMul,
+                       uint32_t(ExportRegister::kVSPosition), 0b1111,
+                       AluScalarOpcode::kRetainPrev, 0, 0b0000, 0, 1, 0, true);
+  return ucode_dwords;
+}
+
+class RecordingExportSink : public ShaderInterpreter::ExportSink {
+ public:
+  struct RecordedExport {
+    ucode::ExportRegister export_register;
+    float value[4];
+    uint32_t value_mask;
+  };
+
+  void AllocExport(ucode::AllocType type, uint32_t size) override {
+    allocs.emplace_back(type, size);
+  }
+  void Export(ucode::ExportRegister export_register, const float* value,
+              uint32_t value_mask) override {
+    RecordedExport& recorded_export = exports.emplace_back();
+    recorded_export.export_register = export_register;
+    std::memcpy(recorded_export.value, value, sizeof(recorded_export.value));
+    recorded_export.value_mask = value_mask;
+  }
+
+  std::vector<std::pair<ucode::AllocType, uint32_t>> allocs;
+  std::vector<RecordedExport> exports;
+};
+
+// Bitwise equality, but with any NaN being equal to any NaN.
+bool FloatsMatch(float a, float b) {
+  if (std::isnan(a) || std::isnan(b)) {
+    return std::isnan(a) && std::isnan(b);
+  }
+  return std::bit_cast<uint32_t>(a) == std::bit_cast<uint32_t>(b);
+}
+
+void ExecuteShader(ShaderInterpreter& interpreter, const Shader& shader,
+                   const float (&inputs)[2][4], bool jit,
+                   RecordingExportSink& export_sink) {
+  cvars::shader_interpreter_jit = jit;
+  interpreter.SetShader(shader);
+  interpreter.SetExportSink(&export_sink);
+  float* temps = interpreter.temp_registers();
+  // Registers not written by the shader must stay unchanged too.
+  for (uint32_t i = 0; i < xenos::kMaxShaderTempRegisters * 4; ++i) {
+    temps[i] = float(i) + 0.25f;
+  }
+  std::memcpy(temps, inputs, sizeof(inputs));
+  interpreter.Execute();
+}
+
+TEST_CASE("Shader interpreter JIT matches the interpreter",
+          "[shader_interpreter]") {
+  const float kInfinity = INFINITY;
+  const float kNaN = NAN;
+  const float kDenormal = std::bit_cast<float>(UINT32_C(0x00000001));
+  const float kNegativeDenormal = std::bit_cast<float>(UINT32_C(0x80400000));
+
+  std::vector<uint32_t> ucode_dwords = BuildTestShaderUcode();
+  Shader shader(xenos::ShaderType::kVertex, 1, ucode_dwords.data(),
+                ucode_dwords.size(), std::endian::native);
+  StringBuffer ucode_disasm_buffer;
+  shader.AnalyzeUcode(ucode_disasm_buffer);
+  REQUIRE(ShaderInterpreter::CanInterpretShader(shader));
+#if XE_ARCH_AMD64
+  // Otherwise the test would compare the interpreter to itself.
+  REQUIRE(ShaderInterpreterJit::Compile(shader));
+#endif  // XE_ARCH_AMD64
+
+  RegisterFile register_file;
+  Memory memory;
+  ShaderInterpreter interpreter(register_file, memory);
+
+  const float inputs[][2][4] = {
+      // Zero multiplication rule - 0 or denormal * anything = +0.
+      {{0.0f, -0.0f, 1.5f, kDenormal}, {kInfinity, kNaN, kDenormal, 2.0f}},
+      {{-kInfinity, kNaN, 0.0f, -0.0f}, {0.0f, -0.0f, kNaN, -kInfinity}},
+      // NaN in either operand of min and max.
+      {{kNaN, 1.0f, -kInfinity, kNaN}, {1.0f, kNaN, kNaN, -1.0f}},
+      {{-0.0f, 0.0f, kNaN, kNaN}, {0.0f, -0.0f, kNaN, kInfinity}},
+      // Denormal operands and results.
+      {{kDenormal, kNegativeDenormal, -0.0f, 3.0f},
+       {kDenormal, kDenormal, 0.0f, -3.0f}},
+      {{1.0e-20f, -1.0e-20f, FLT_MAX, 1.0e-30f},
+       {1.0e-20f, 1.0e-20f, FLT_MAX, kNegativeDenormal}},
+  };
+  for (size_t input_index = 0; input_index < xe::countof(inputs);
+       ++input_index) {
+    CAPTURE(input_index);
+    RecordingExportSink interpreter_exports;
+    ExecuteShader(interpreter, shader, inputs[input_index], false,
+                  interpreter_exports);
+    std::vector<float> interpreter_temps(
+        interpreter.temp_registers(),
+        interpreter.temp_registers() + xenos::kMaxShaderTempRegisters * 4);
+
+    RecordingExportSink jit_exports;
+    ExecuteShader(interpreter, shader, inputs[input_index], true,
+                  jit_exports);
+
+    for (uint32_t i = 0; i < xenos::kMaxShaderTempRegisters * 4; ++i) {
+      CAPTURE(i >> 2, i & 3, interpreter_temps[i],
+              interpreter.temp_registers()[i]);
+      REQUIRE(FloatsMatch(interpreter_temps[i],
+                          interpreter.temp_registers()[i]));
+    }
+
+    REQUIRE(interpreter_exports.allocs == jit_exports.allocs);
+    REQUIRE(interpreter_exports.exports.size() == 1);
+    REQUIRE(jit_exports.exports.size() == 1);
+    const RecordingExportSink::RecordedExport& interpreter_export =
+        interpreter_exports.exports.front();
+    const RecordingExportSink::RecordedExport& jit_export =
+        jit_exports.exports.front();
+    REQUIRE(jit_export.export_register == interpreter_export.export_register);
+    REQUIRE(jit_export.value_mask == interpreter_export.value_mask);
+    for (uint32_t i = 0; i < 4; ++i) {
+      CAPTURE(i, interpreter_export.value[i], jit_export.value[i]);
+      REQUIRE(FloatsMatch(interpreter_export.value[i], jit_export.value[i]));
+    }
+  }
+
+  cvars::shader_interpreter_jit = false;
+}
+
+}  // namespace test
+}  // namespace gpu
+}  // namespace xe
@@ -618,8 +618,10 @@ TextureCache::Texture* TextureCache::FindOrCreateTexture(TextureKey key) {
   // Try to find an existing texture.
   // TODO(Triang3l): Reuse a texture with mip_page unchanged, but base_page
   // previously 0, now not 0, to save memory - common case in streaming.
+  ++texture_lookup_count_;
   auto found_texture_it = textures_.find(key);
   if (found_texture_it != textures_.end()) {
+    ++texture_lookup_hit_count_;
     return found_texture_it->second.get();
   }
 
@@ -72,6 +72,13 @@ class TextureCache {
   uint32_t draw_resolution_scale_x() const { return draw_resolution_scale_x_; }
   uint32_t draw_resolution_scale_y() const { return draw_resolution_scale_y_; }
 
+  // Lookups of textures by key when bindings change, and how many of them have
+  // found an existing texture, for performance statistics.
+  uint64_t texture_lookup_count() const { return texture_lookup_count_; }
+  uint64_t texture_lookup_hit_count() const {
+    return texture_lookup_hit_count_;
+  }
+
   divisors::MagicDiv draw_resolution_scale_x_divisor() const {
     return draw_resolution_scale_x_divisor_;
   }
@@ -602,6 +609,9 @@ class TextureCache {
  private:
   void UpdateTexturesTotalHostMemoryUsage(uint64_t add, uint64_t subtract);
 
+  uint64_t texture_lookup_count_ = 0;
+  uint64_t texture_lookup_hit_count_ = 0;
+
   // Shared memory callback for texture data invalidation.
   static void WatchCallback(const global_unique_lock_type& global_lock,
                             void* context, void* data, uint64_t argument,
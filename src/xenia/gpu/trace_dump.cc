@@ -9,7 +9,12 @@
 
 #include "xenia/gpu/trace_dump.h"
 
+#include <algorithm>
+#include <iterator>
+
 #include "third_party/stb/stb_image_write.h"
+#include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/cvar.h"
 #include "xenia/base/filesystem.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/profiling.h"
@@ -30,6 +35,11 @@
 
 DEFINE_path(target_trace_file, "", "Specifies the trace file to load.", "GPU");
 DEFINE_path(trace_dump_path, "", "Output path for dumped files.", "GPU");
+DEFINE_int32(trace_dump_benchmark_iterations, 0,
+             "If not 0, instead of taking a screenshot, replay all frames of "
+             "the trace this many times, and write the CPU command processing "
+             "time and the backend counters of every frame to a .json file.",
+             "GPU");
 
 namespace xe {
 namespace gpu {
@@ -119,6 +129,10 @@ bool TraceDump::Load(const std::filesystem::path& trace_file_path) {
 }
 
 int TraceDump::Run() {
+  if (cvars::trace_dump_benchmark_iterations > 0) {
+    return RunBenchmark(uint32_t(cvars::trace_dump_benchmark_iterations));
+  }
+
   BeginHostCapture();
   player_->SeekFrame(0);
   player_->SeekCommand(
@@ -151,5 +165,153 @@ int TraceDump::Run() {
   return result;
 }
 
+int TraceDump::RunBenchmark(uint32_t iterations) {
+  using PerformanceCounters = CommandProcessor::PerformanceCounters;
+  int frame_count = player_->frame_count();
+  if (frame_count <= 0) {
+    XELOGE("The trace doesn't contain any frames");
+    return 1;
+  }
+
+  struct FrameResult {
+    uint32_t iteration;
+    int frame;
+    uint64_t cpu_time_ns;
+    PerformanceCounters counters;
+  };
+  std::vector<FrameResult> frame_results;
+  frame_results.reserve(size_t(iterations) * size_t(frame_count));
+  // The counters are cumulative, sampled around every frame.
+  const CommandProcessor* command_processor =
+      graphics_system_->command_processor();
+  PerformanceCounters counters_total;
+  PerformanceCounters counters_before;
+  command_processor->GetPerformanceCounters(counters_before);
+  for (uint32_t i = 0; i < iterations; ++i) {
+    for (int j = 0; j < frame_count; ++j) {
+      player_->PlayFrame(j, false);
+      PerformanceCounters counters_after;
+      command_processor->GetPerformanceCounters(counters_after);
+      FrameResult& frame_result = frame_results.emplace_back();
+      frame_result.iteration = i;
+      frame_result.frame = j;
+      frame_result.cpu_time_ns = player_->last_playback_time_ns();
+      PerformanceCounters& counters = frame_result.counters;
+      counters.submissions =
+          counters_after.submissions - counters_before.submissions;
+      counters.pipeline_lookups =
+          counters_after.pipeline_lookups - counters_before.pipeline_lookups;
+      counters.pipeline_lookup_hits = counters_after.pipeline_lookup_hits -
+                                      counters_before.pipeline_lookup_hits;
+      counters.texture_lookups =
+          counters_after.texture_lookups - counters_before.texture_lookups;
+      counters.texture_lookup_hits = counters_after.texture_lookup_hits -
+                                     counters_before.texture_lookup_hits;
+      counters.render_target_ownership_transfers =
+          counters_after.render_target_ownership_transfers -
+          counters_before.render_target_ownership_transfers;
+      counters_before = counters_after;
+    }
+  }
+
+  auto hit_rate = [](uint64_t hits, uint64_t lookups) {
+    return lookups ? double(hits) / double(lookups) : 1.0;
+  };
+  auto append_counters = [](std::string& json,
+                            const PerformanceCounters& counters) {
+    fmt::format_to(std::back_inserter(json),
+                   "\"submissions\": {}, \"pipeline_lookups\": {}, "
+                   "\"pipeline_lookup_hits\": {}, \"texture_lookups\": {}, "
+                   "\"texture_lookup_hits\": {}, "
+                   "\"render_target_ownership_transfers\": {}",
+                   counters.submissions, counters.pipeline_lookups,
+                   counters.pipeline_lookup_hits, counters.texture_lookups,
+                   counters.texture_lookup_hits,
+                   counters.render_target_ownership_transfers);
+  };
+
+  std::string trace_name = xe::path_to_utf8(trace_file_path_.filename());
+  std::string trace_name_escaped;
+  for (char c : trace_name) {
+    if (c == '"' || c == '\\') {
+      trace_name_escaped.push_back('\\');
+    }
+    trace_name_escaped.push_back(c);
+  }
+  std::string json;
+  fmt::format_to(std::back_inserter(json),
+                 "{{\n  \"trace\": \"{}\",\n  \"iterations\": {},\n"
+                 "  \"frame_count\": {},\n  \"frames\": [\n",
+                 trace_name_escaped, iterations, frame_count);
+  std::vector<uint64_t> cpu_times_ns;
+  cpu_times_ns.reserve(frame_results.size());
+  uint64_t cpu_time_total_ns = 0;
+  for (size_t i = 0; i < frame_results.size(); ++i) {
+    const FrameResult& frame_result = frame_results[i];
+    fmt::format_to(std::back_inserter(json),
+                   "    {{\"iteration\": {}, \"frame\": {}, "
+                   "\"cpu_time_ns\": {}, ",
+                   frame_result.iteration, frame_result.frame,
+                   frame_result.cpu_time_ns);
+    append_counters(json, frame_result.counters);
+    json += i + 1 < frame_results.size() ? "},\n" : "}\n";
+    cpu_times_ns.push_back(frame_result.cpu_time_ns);
+    cpu_time_total_ns += frame_result.cpu_time_ns;
+    const PerformanceCounters& counters = frame_result.counters;
+    counters_total.submissions += counters.submissions;
+    counters_total.pipeline_lookups += counters.pipeline_lookups;
+    counters_total.pipeline_lookup_hits += counters.pipeline_lookup_hits;
+    counters_total.texture_lookups += counters.texture_lookups;
+    counters_total.texture_lookup_hits += counters.texture_lookup_hits;
+    counters_total.render_target_ownership_transfers +=
+        counters.render_target_ownership_transfers;
+  }
+  std::sort(cpu_times_ns.begin(), cpu_times_ns.end());
+  size_t cpu_time_count = cpu_times_ns.size();
+  uint64_t cpu_time_p50_ns = cpu_times_ns[(cpu_time_count - 1) / 2];
+  uint64_t cpu_time_p99_ns = cpu_times_ns[(cpu_time_count - 1) * 99 / 100];
+  uint64_t cpu_time_mean_ns = cpu_time_total_ns / cpu_time_count;
+  double pipeline_hit_rate = hit_rate(counters_total.pipeline_lookup_hits,
+                                      counters_total.pipeline_lookups);
+  double texture_hit_rate = hit_rate(counters_total.texture_lookup_hits,
+                                     counters_total.texture_lookups);
+  fmt::format_to(std::back_inserter(json),
+                 "  ],\n  \"summary\": {{\"cpu_time_total_ns\": {}, "
+                 "\"cpu_time_mean_ns\": {}, \"cpu_time_p50_ns\": {}, "
+                 "\"cpu_time_p99_ns\": {}, \"cpu_time_max_ns\": {}, ",
+                 cpu_time_total_ns, cpu_time_mean_ns, cpu_time_p50_ns,
+                 cpu_time_p99_ns, cpu_times_ns.back());
+  append_counters(json, counters_total);
+  fmt::format_to(std::back_inserter(json),
+                 ", \"pipeline_cache_hit_rate\": {:.6f}, "
+                 "\"texture_cache_hit_rate\": {:.6f}}}\n}}\n",
+                 pipeline_hit_rate, texture_hit_rate);
+
+  XELOGI(
+      "Replayed {} frames {} times: {:.3f} ms mean, {:.3f} ms p99 CPU time "
+      "per frame, {} submissions, {:.1f}% pipeline and {:.1f}% texture cache "
+      "hits, {} render target ownership transfers",
+      frame_count, iterations, double(cpu_time_mean_ns) / 1e6,
+      double(cpu_time_p99_ns) / 1e6, counters_total.submissions,
+      pipeline_hit_rate * 100.0, texture_hit_rate * 100.0,
+      counters_total.render_target_ownership_transfers);
+
+  int result = 0;
+  std::filesystem::path json_path = base_output_path_;
+  json_path.replace_extension(".json");
+  FILE* file = filesystem::OpenFile(json_path, "wb");
+  if (file) {
+    fwrite(json.data(), 1, json.size(), file);
+    fclose(file);
+  } else {
+    XELOGE("Failed to open {} for writing", xe::path_to_utf8(json_path));
+    result = 1;
+  }
+
+  player_.reset();
+  emulator_.reset();
+  return result;
+}
+
 }  //  namespace gpu
 }  //  namespace xe
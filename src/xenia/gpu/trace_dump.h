@@ -47,6 +47,9 @@ class TraceDump {
   bool Setup();
   bool Load(const std::filesystem::path& trace_file_path);
   int Run();
+  // Replays all frames of the trace the specified number of times, and writes
+  // the timing and the counters of every frame to a JSON file.
+  int RunBenchmark(uint32_t iterations);
 
   std::filesystem::path trace_file_path_;
   std::filesystem::path base_output_path_;
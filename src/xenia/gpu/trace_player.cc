@@ -9,6 +9,7 @@
 
 #include "xenia/gpu/trace_player.h"
 
+#include <chrono>
 #include <memory>
 
 #include "xenia/gpu/command_processor.h"
@@ -81,6 +82,17 @@ void TracePlayer::SeekCommand(int target_command) {
   }
 }
 
+void TracePlayer::PlayFrame(int target_frame, bool clear_caches) {
+  current_frame_index_ = target_frame;
+  auto frame = current_frame();
+  current_command_index_ = int(frame->commands.size()) - 1;
+
+  assert_true(frame->start_ptr <= frame->end_ptr);
+  PlayTrace(frame->start_ptr, frame->end_ptr - frame->start_ptr,
+            TracePlaybackMode::kUntilEnd, clear_caches);
+  WaitOnPlayback();
+}
+
 void TracePlayer::WaitOnPlayback() {
   xe::threading::Wait(playback_event_.get(), true);
 }
@@ -105,6 +117,8 @@ void TracePlayer::PlayTraceOnThread(const uint8_t* trace_data,
     command_processor->ClearCaches();
   }
 
+  auto start_time = std::chrono::steady_clock::now();
+
   playback_percent_ = 0;
   auto trace_end = trace_data + trace_size;
 
@@ -244,6 +258,10 @@ void TracePlayer::PlayTraceOnThread(const uint8_t* trace_data,
 
   playing_trace_ = false;
 
+  last_playback_time_ns_ =
+      uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now() - start_time)
+                   .count());
   playback_event_->Set();
 }
 
@@ -43,9 +43,16 @@ class TracePlayer : public TraceReader {
 
   void SeekFrame(int target_frame);
   void SeekCommand(int target_command);
+  // Plays all commands of the frame, including the swap, until the end, and
+  // waits for the playback to be completed.
+  void PlayFrame(int target_frame, bool clear_caches);
 
   void WaitOnPlayback();
 
+  // Time spent on the command processor thread on the last playback that has
+  // reached the end of the commands.
+  uint64_t last_playback_time_ns() const { return last_playback_time_ns_; }
+
  private:
   void PlayTrace(const uint8_t* trace_data, size_t trace_size,
                  TracePlaybackMode playback_mode, bool clear_caches);
@@ -57,6 +64,7 @@ class TracePlayer : public TraceReader {
   int current_command_index_;
   bool playing_trace_ = false;
   std::atomic<uint32_t> playback_percent_ = {0};
+  uint64_t last_playback_time_ns_ = 0;
   std::unique_ptr<xe::threading::Event> playback_event_;
 };
 
@@ -17,6 +17,7 @@
 #include "xenia/base/math.h"
 #include "xenia/base/profiling.h"
 #include "xenia/gpu/vulkan/vulkan_command_processor.h"
+#include "xenia/gpu/vulkan/vulkan_pipeline_cache.h"
 
 namespace xe {
 namespace gpu {
@@ -39,6 +40,9 @@ void DeferredCommandBuffer::Execute(VkCommandBuffer command_buffer) {
       command_processor_.GetVulkanProvider().dfn();
   const uintmax_t* stream = command_stream_.data();
   size_t stream_remaining = command_stream_.size();
+  // Whether the currently bound graphics pipeline has failed to be created, and
+  // draws must be skipped.
+  bool graphics_pipeline_missing = false;
   while (stream_remaining) {
     const CommandHeader& header =
         *reinterpret_cast<const CommandHeader*>(stream);
@@ -46,6 +50,18 @@ void DeferredCommandBuffer::Execute(VkCommandBuffer command_buffer) {
     stream_remaining -= kCommandHeaderSizeElements;
 
     switch (header.command) {
+      case Command::kBindGraphicsPipelineHandle: {
+        auto& args =
+            *reinterpret_cast<const ArgsBindGraphicsPipelineHandle*>(stream);
+        VkPipeline pipeline = VulkanPipelineCache::GetVulkanPipelineByHandle(
+            args.pipeline_handle);
+        graphics_pipeline_missing = pipeline == VK_NULL_HANDLE;
+        if (!graphics_pipeline_missing) {
+          dfn.vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                pipeline);
+        }
+      } break;
+
       case Command::kVkBeginRenderPass: {
         auto& args = *reinterpret_cast<const ArgsVkBeginRenderPass*>(stream);
         size_t offset_bytes = sizeof(ArgsVkBeginRenderPass);
@@ -101,6 +117,9 @@ void DeferredCommandBuffer::Execute(VkCommandBuffer command_buffer) {
         auto& args = *reinterpret_cast<const ArgsVkBindPipeline*>(stream);
         dfn.vkCmdBindPipeline(command_buffer, args.pipeline_bind_point,
                               args.pipeline);
+        if (args.pipeline_bind_point == VK_PIPELINE_BIND_POINT_GRAPHICS) {
+          graphics_pipeline_missing = false;
+        }
       } break;
 
       case Command::kVkBindVertexBuffers: {
@@ -172,12 +191,18 @@ void DeferredCommandBuffer::Execute(VkCommandBuffer command_buffer) {
       } break;
 
       case Command::kVkDraw: {
+        if (graphics_pipeline_missing) {
+          break;
+        }
         auto& args = *reinterpret_cast<const ArgsVkDraw*>(stream);
         dfn.vkCmdDraw(command_buffer, args.vertex_count, args.instance_count,
                       args.first_vertex, args.first_instance);
       } break;
 
       case Command::kVkDrawIndexed: {
+        if (graphics_pipeline_missing) {
+          break;
+        }
         auto& args = *reinterpret_cast<const ArgsVkDrawIndexed*>(stream);
         dfn.vkCmdDrawIndexed(command_buffer, args.index_count,
                              args.instance_count, args.first_index,
@@ -235,6 +260,12 @@ void DeferredCommandBuffer::Execute(VkCommandBuffer command_buffer) {
                                    sizeof(ArgsVkPushConstants));
       } break;
 
+      case Command::kVkResetQueryPool: {
+        auto& args = *reinterpret_cast<const ArgsVkResetQueryPool*>(stream);
+        dfn.vkCmdResetQueryPool(command_buffer, args.query_pool,
+                                args.first_query, args.query_count);
+      } break;
+
       case Command::kVkSetBlendConstants: {
         auto& args = *reinterpret_cast<const ArgsVkSetBlendConstants*>(stream);
         dfn.vkCmdSetBlendConstants(command_buffer, args.blend_constants);
@@ -286,6 +317,12 @@ void DeferredCommandBuffer::Execute(VkCommandBuffer command_buffer) {
                 xe::align(sizeof(ArgsVkSetViewport), alignof(VkViewport))));
       } break;
 
+      case Command::kVkWriteTimestamp: {
+        auto& args = *reinterpret_cast<const ArgsVkWriteTimestamp*>(stream);
+        dfn.vkCmdWriteTimestamp(command_buffer, args.pipeline_stage,
+                                args.query_pool, args.query);
+      } break;
+
       default:
         assert_unhandled_case(header.command);
         break;
@@ -32,6 +32,17 @@ class DeferredCommandBuffer {
   void Reset();
   void Execute(VkCommandBuffer command_buffer);
 
+  // Binds a graphics pipeline from the VulkanPipelineCache which may still be
+  // being created when the command is recorded - the Vulkan pipeline is looked
+  // up at execution time. Draws are dropped until the next pipeline binding if
+  // the pipeline has failed to be created.
+  void CmdBindGraphicsPipelineHandle(const void* pipeline_handle) {
+    auto& args = *reinterpret_cast<ArgsBindGraphicsPipelineHandle*>(
+        WriteCommand(Command::kBindGraphicsPipelineHandle,
+                     sizeof(ArgsBindGraphicsPipelineHandle)));
+    args.pipeline_handle = pipeline_handle;
+  }
+
   // render_pass_begin->pNext of all barriers must be null.
   void CmdVkBeginRenderPass(const VkRenderPassBeginInfo* render_pass_begin,
                             VkSubpassContents contents) {
@@ -288,6 +299,15 @@ class DeferredCommandBuffer {
     std::memcpy(args_ptr + sizeof(ArgsVkPushConstants), values, size);
   }
 
+  void CmdVkResetQueryPool(VkQueryPool query_pool, uint32_t first_query,
+                           uint32_t query_count) {
+    auto& args = *reinterpret_cast<ArgsVkResetQueryPool*>(WriteCommand(
+        Command::kVkResetQueryPool, sizeof(ArgsVkResetQueryPool)));
+    args.query_pool = query_pool;
+    args.first_query = first_query;
+    args.query_count = query_count;
+  }
+
   void CmdVkSetBlendConstants(const float* blend_constants) {
     auto& args = *reinterpret_cast<ArgsVkSetBlendConstants*>(WriteCommand(
         Command::kVkSetBlendConstants, sizeof(ArgsVkSetBlendConstants)));
@@ -357,8 +377,18 @@ class DeferredCommandBuffer {
                 sizeof(VkViewport) * viewport_count);
   }
 
+  void CmdVkWriteTimestamp(VkPipelineStageFlagBits pipeline_stage,
+                           VkQueryPool query_pool, uint32_t query) {
+    auto& args = *reinterpret_cast<ArgsVkWriteTimestamp*>(WriteCommand(
+        Command::kVkWriteTimestamp, sizeof(ArgsVkWriteTimestamp)));
+    args.pipeline_stage = pipeline_stage;
+    args.query_pool = query_pool;
+    args.query = query;
+  }
+
  private:
   enum class Command {
+    kBindGraphicsPipelineHandle,
     kVkBeginRenderPass,
     kVkBindDescriptorSets,
     kVkBindIndexBuffer,
@@ -374,6 +404,7 @@ class DeferredCommandBuffer {
     kVkEndRenderPass,
     kVkPipelineBarrier,
     kVkPushConstants,
+    kVkResetQueryPool,
     kVkSetBlendConstants,
     kVkSetDepthBias,
     kVkSetScissor,
@@ -381,6 +412,7 @@ class DeferredCommandBuffer {
     kVkSetStencilReference,
     kVkSetStencilWriteMask,
     kVkSetViewport,
+    kVkWriteTimestamp,
   };
 
   struct CommandHeader {
@@ -390,6 +422,10 @@ class DeferredCommandBuffer {
   static constexpr size_t kCommandHeaderSizeElements =
       (sizeof(CommandHeader) + sizeof(uintmax_t) - 1) / sizeof(uintmax_t);
 
+  struct ArgsBindGraphicsPipelineHandle {
+    const void* pipeline_handle;
+  };
+
   struct ArgsVkBeginRenderPass {
     VkRenderPass render_pass;
     VkFramebuffer framebuffer;
@@ -506,6 +542,12 @@ class DeferredCommandBuffer {
     // Followed by `size` bytes of values.
   };
 
+  struct ArgsVkResetQueryPool {
+    VkQueryPool query_pool;
+    uint32_t first_query;
+    uint32_t query_count;
+  };
+
   struct ArgsVkSetBlendConstants {
     float blend_constants[4];
   };
@@ -535,6 +577,12 @@ class DeferredCommandBuffer {
     static_assert(alignof(VkViewport) <= alignof(uintmax_t));
   };
 
+  struct ArgsVkWriteTimestamp {
+    VkPipelineStageFlagBits pipeline_stage;
+    VkQueryPool query_pool;
+    uint32_t query;
+  };
+
   void* WriteCommand(Command command, size_t arguments_size_bytes);
 
   const VulkanCommandProcessor& command_processor_;
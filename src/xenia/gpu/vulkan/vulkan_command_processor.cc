@@ -40,6 +40,7 @@
 #include "xenia/ui/vulkan/vulkan_util.h"
 
 DECLARE_bool(clear_memory_page_state);
+DECLARE_bool(vulkan_gpu_timestamps);
 
 namespace xe {
 namespace gpu {
@@ -100,6 +101,12 @@ void VulkanCommandProcessor::ClearCaches() {
   cache_clear_requested_ = true;
 }
 
+void VulkanCommandProcessor::InitializeShaderStorage(
+    const std::filesystem::path& cache_root, uint32_t title_id, bool blocking) {
+  CommandProcessor::InitializeShaderStorage(cache_root, title_id, blocking);
+  pipeline_cache_->InitializeShaderStorage(cache_root, title_id, blocking);
+}
+
 void VulkanCommandProcessor::TracePlaybackWroteMemory(uint32_t base_ptr,
                                                       uint32_t length) {
   shared_memory_->MemoryInvalidationCallback(base_ptr, length, true);
@@ -365,6 +372,11 @@ bool VulkanCommandProcessor::SetupContext() {
     return false;
   }
 
+  gpu_profiler_ = std::make_unique<VulkanGpuProfiler>(*this);
+  if (!gpu_profiler_->Initialize()) {
+    gpu_profiler_.reset();
+  }
+
   // Shared memory and EDRAM common bindings.
   VkDescriptorPoolSize descriptor_pool_sizes[1];
   descriptor_pool_sizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
@@ -1048,6 +1060,8 @@ void VulkanCommandProcessor::ShutdownContext() {
 
   DestroyScratchBuffer();
 
+  gpu_profiler_.reset();
+
   for (SwapFramebuffer& swap_framebuffer : swap_framebuffers_) {
     ui::vulkan::util::DestroyAndNullHandle(dfn.vkDestroyFramebuffer, device,
                                            swap_framebuffer.framebuffer);
@@ -1237,6 +1251,40 @@ void VulkanCommandProcessor::WriteRegistersFromMem(uint32_t start_index,
     VulkanCommandProcessor::WriteRegister(start_index + i, data);
   }
 }
+
+void VulkanCommandProcessor::GetPerformanceCounters(
+    PerformanceCounters& counters_out) const {
+  // Submissions that have been sent to the queue.
+  counters_out.submissions = GetCurrentSubmission() - 1;
+  counters_out.pipeline_lookups =
+      pipeline_cache_ ? pipeline_cache_->pipeline_lookup_count() : 0;
+  counters_out.pipeline_lookup_hits =
+      pipeline_cache_ ? pipeline_cache_->pipeline_lookup_hit_count() : 0;
+  counters_out.texture_lookups =
+      texture_cache_ ? texture_cache_->texture_lookup_count() : 0;
+  counters_out.texture_lookup_hits =
+      texture_cache_ ? texture_cache_->texture_lookup_hit_count() : 0;
+  counters_out.render_target_ownership_transfers =
+      render_target_cache_ ? render_target_cache_->ownership_transfer_count()
+                           : 0;
+}
+
+bool VulkanCommandProcessor::GetGpuProfile(
+    std::vector<std::pair<const char*, double>>& profile_out) const {
+  if (!gpu_profiler_ || !cvars::vulkan_gpu_timestamps) {
+    return false;
+  }
+  double times_us[size_t(VulkanGpuProfiler::Category::kCount)];
+  gpu_profiler_->GetLastFrameTimes(times_us);
+  profile_out.clear();
+  for (size_t i = 0; i < size_t(VulkanGpuProfiler::Category::kCount); ++i) {
+    profile_out.emplace_back(VulkanGpuProfiler::GetCategoryName(
+                                 VulkanGpuProfiler::Category(i)),
+                             times_us[i]);
+  }
+  return true;
+}
+
 void VulkanCommandProcessor::SparseBindBuffer(
     VkBuffer buffer, uint32_t bind_count, const VkSparseMemoryBind* binds,
     VkPipelineStageFlags wait_stage_mask) {
@@ -1299,6 +1347,8 @@ void VulkanCommandProcessor::IssueSwap(uint32_t frontbuffer_ptr,
           return false;
         }
 
+        SetGpuProfilerCategory(VulkanGpuProfiler::Category::kOther);
+
         auto& vulkan_context = static_cast<
             ui::vulkan::VulkanPresenter::VulkanGuestOutputRefreshContext&>(
             context);
@@ -2106,7 +2156,7 @@ void VulkanCommandProcessor::BindExternalGraphicsPipeline(
   deferred_command_buffer_.CmdVkBindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS,
                                              pipeline);
   current_external_graphics_pipeline_ = pipeline;
-  current_guest_graphics_pipeline_ = VK_NULL_HANDLE;
+  current_guest_graphics_pipeline_ = nullptr;
   current_guest_graphics_pipeline_layout_ = VK_NULL_HANDLE;
 }
 
@@ -2385,16 +2435,21 @@ bool VulkanCommandProcessor::IssueDraw(xenos::PrimitiveType prim_type,
   // Create the pipeline (for this, need the render pass from the render target
   // cache), translating the shaders - doing this now to obtain the used
   // textures.
-  VkPipeline pipeline;
+  const void* pipeline_handle;
   const VulkanPipelineCache::PipelineLayoutProvider* pipeline_layout_provider;
   if (!pipeline_cache_->ConfigurePipeline(
           vertex_shader_translation, pixel_shader_translation,
           primitive_processing_result, normalized_depth_control,
           normalized_color_mask,
-          render_target_cache_->last_update_render_pass_key(), pipeline,
+          render_target_cache_->last_update_render_pass_key(), pipeline_handle,
           pipeline_layout_provider)) {
     return false;
   }
+  if (!pipeline_handle) {
+    // The pipeline is still being created asynchronously, and the draw is
+    // dropped not to stall the submission.
+    return true;
+  }
 
   // Update the textures before most other work in the submission because
   // samplers depend on this (and in case of sampler overflow in a submission,
@@ -2406,13 +2461,14 @@ bool VulkanCommandProcessor::IssueDraw(xenos::PrimitiveType prim_type,
            : 0);
   texture_cache_->RequestTextures(used_texture_mask);
 
+  SetGpuProfilerCategory(VulkanGpuProfiler::Category::kDraws);
+
   // Update the graphics pipeline, and if the new graphics pipeline has a
   // different layout, invalidate incompatible descriptor sets before updating
   // current_guest_graphics_pipeline_layout_.
-  if (current_guest_graphics_pipeline_ != pipeline) {
-    deferred_command_buffer_.CmdVkBindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                               pipeline);
-    current_guest_graphics_pipeline_ = pipeline;
+  if (current_guest_graphics_pipeline_ != pipeline_handle) {
+    deferred_command_buffer_.CmdBindGraphicsPipelineHandle(pipeline_handle);
+    current_guest_graphics_pipeline_ = pipeline_handle;
     current_external_graphics_pipeline_ = VK_NULL_HANDLE;
   }
   auto pipeline_layout =
@@ -2779,6 +2835,10 @@ void VulkanCommandProcessor::CheckSubmissionFenceAndDeviceLoss(
 
   texture_cache_->CompletedSubmissionUpdated(submission_completed_);
 
+  if (gpu_profiler_) {
+    gpu_profiler_->CompletedSubmissionUpdated(submission_completed_);
+  }
+
   // Destroy objects scheduled for destruction.
   while (!destroy_framebuffers_.empty()) {
     const auto& destroy_pair = destroy_framebuffers_.front();
@@ -2857,6 +2917,10 @@ bool VulkanCommandProcessor::BeginSubmission(bool is_guest_command) {
     // are fulfilled).
     deferred_command_buffer_.Reset();
 
+    if (gpu_profiler_) {
+      gpu_profiler_->BeginSubmission();
+    }
+
     // Reset cached state of the command buffer.
     dynamic_viewport_update_needed_ = true;
     dynamic_scissor_update_needed_ = true;
@@ -2870,7 +2934,7 @@ bool VulkanCommandProcessor::BeginSubmission(bool is_guest_command) {
     dynamic_stencil_reference_back_update_needed_ = true;
     current_render_pass_ = VK_NULL_HANDLE;
     current_framebuffer_ = nullptr;
-    current_guest_graphics_pipeline_ = VK_NULL_HANDLE;
+    current_guest_graphics_pipeline_ = nullptr;
     current_external_graphics_pipeline_ = VK_NULL_HANDLE;
     current_external_compute_pipeline_ = VK_NULL_HANDLE;
     current_guest_graphics_pipeline_layout_ = nullptr;
@@ -3024,6 +3088,7 @@ bool VulkanCommandProcessor::EndSubmission(bool is_swap) {
 
   if (is_closing_frame) {
     primitive_processor_->EndFrame();
+    pipeline_cache_->EndFrame();
   }
 
   if (submission_open_) {
@@ -3031,6 +3096,8 @@ bool VulkanCommandProcessor::EndSubmission(bool is_swap) {
 
     EndRenderPass();
 
+    pipeline_cache_->EndSubmission();
+
     render_target_cache_->EndSubmission();
 
     primitive_processor_->EndSubmission();
@@ -3093,6 +3160,10 @@ bool VulkanCommandProcessor::EndSubmission(bool is_swap) {
 
     SubmitBarriers(true);
 
+    if (gpu_profiler_) {
+      gpu_profiler_->EndSubmission();
+    }
+
     assert_false(command_buffers_writable_.empty());
     CommandBuffer command_buffer = command_buffers_writable_.back();
     if (dfn.vkResetCommandPool(device, command_buffer.pool, 0) != VK_SUCCESS) {
@@ -3169,6 +3240,10 @@ bool VulkanCommandProcessor::EndSubmission(bool is_swap) {
     submissions_in_flight_fences_.push_back(fence);
     fences_free_.pop_back();
 
+    if (gpu_profiler_) {
+      gpu_profiler_->SubmissionSubmitted(submission_current, is_closing_frame);
+    }
+
     submission_open_ = false;
   }
 
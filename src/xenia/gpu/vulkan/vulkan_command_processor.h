@@ -28,6 +28,7 @@
 #include "xenia/gpu/registers.h"
 #include "xenia/gpu/spirv_shader_translator.h"
 #include "xenia/gpu/vulkan/deferred_command_buffer.h"
+#include "xenia/gpu/vulkan/vulkan_gpu_profiler.h"
 #include "xenia/gpu/vulkan/vulkan_graphics_system.h"
 #include "xenia/gpu/vulkan/vulkan_pipeline_cache.h"
 #include "xenia/gpu/vulkan/vulkan_primitive_processor.h"
@@ -143,6 +144,9 @@ class VulkanCommandProcessor final : public CommandProcessor {
 
   void ClearCaches() override;
 
+  void InitializeShaderStorage(const std::filesystem::path& cache_root,
+                               uint32_t title_id, bool blocking) override;
+
   void TracePlaybackWroteMemory(uint32_t base_ptr, uint32_t length) override;
 
   void RestoreEdramSnapshot(const void* snapshot) override;
@@ -166,6 +170,19 @@ class VulkanCommandProcessor final : public CommandProcessor {
   }
   uint64_t GetCompletedSubmission() const { return submission_completed_; }
 
+  void GetPerformanceCounters(
+      PerformanceCounters& counters_out) const override;
+
+  bool GetGpuProfile(std::vector<std::pair<const char*, double>>& profile_out)
+      const override;
+  // Attributes the GPU time of the commands recorded after this call to the
+  // category, if GPU timestamps are enabled.
+  void SetGpuProfilerCategory(VulkanGpuProfiler::Category category) {
+    if (gpu_profiler_) {
+      gpu_profiler_->SetCategory(category);
+    }
+  }
+
   // Sparse binds are:
   // - In a single submission, all submitted in one vkQueueBindSparse.
   // - Sent to the queue without waiting for a semaphore.
@@ -287,6 +304,9 @@ class VulkanCommandProcessor final : public CommandProcessor {
                  IndexBufferInfo* index_buffer_info,
                  bool major_mode_explicit) override;
   bool IssueCopy() override;
+  SharedMemory* GetSharedMemory() const override {
+    return shared_memory_.get();
+  }
 
   void InitializeTrace() override;
 
@@ -580,6 +600,9 @@ class VulkanCommandProcessor final : public CommandProcessor {
 
   std::unique_ptr<VulkanTextureCache> texture_cache_;
 
+  // Null if timestamp queries are not supported.
+  std::unique_ptr<VulkanGpuProfiler> gpu_profiler_;
+
   VkDescriptorPool shared_memory_and_edram_descriptor_pool_ = VK_NULL_HANDLE;
   VkDescriptorSet shared_memory_and_edram_descriptor_set_;
 
@@ -700,12 +723,11 @@ class VulkanCommandProcessor final : public CommandProcessor {
   VkRenderPass current_render_pass_;
   const VulkanRenderTargetCache::Framebuffer* current_framebuffer_;
 
-  // Currently bound graphics pipeline, either from the pipeline cache (with
-  // potentially deferred creation - current_external_graphics_pipeline_ is
-  // VK_NULL_HANDLE in this case) or a non-Xenos one
-  // (current_guest_graphics_pipeline_ is VK_NULL_HANDLE in this case).
-  // TODO(Triang3l): Change to a deferred compilation handle.
-  VkPipeline current_guest_graphics_pipeline_;
+  // Currently bound graphics pipeline, either from the pipeline cache (a
+  // handle with potentially deferred creation -
+  // current_external_graphics_pipeline_ is VK_NULL_HANDLE in this case) or a
+  // non-Xenos one (current_guest_graphics_pipeline_ is nullptr in this case).
+  const void* current_guest_graphics_pipeline_;
   VkPipeline current_external_graphics_pipeline_;
   VkPipeline current_external_compute_pipeline_;
 
@@ -0,0 +1,262 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/vulkan/vulkan_gpu_profiler.h"
+
+#include <cstring>
+
+#include "xenia/base/assert.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/profiling.h"
+#include "xenia/gpu/vulkan/vulkan_command_processor.h"
+
+DEFINE_bool(vulkan_gpu_timestamps, false,
+            "Measure the GPU time spent on draws, render target ownership "
+            "transfers, texture loading and resolves with timestamp queries, "
+            "for displaying in the profiler and in the GPU timestamp profile "
+            "dialog.",
+            "Vulkan");
+
+namespace xe {
+namespace gpu {
+namespace vulkan {
+
+const char* VulkanGpuProfiler::GetCategoryName(Category category) {
+  switch (category) {
+    case Category::kDraws:
+      return "Draws";
+    case Category::kRenderTargetTransfers:
+      return "Render target transfers";
+    case Category::kTextureLoads:
+      return "Texture loads";
+    case Category::kResolves:
+      return "Resolves";
+    case Category::kOther:
+      return "Other";
+    default:
+      assert_unhandled_case(category);
+      return "";
+  }
+}
+
+VulkanGpuProfiler::VulkanGpuProfiler(VulkanCommandProcessor& command_processor)
+    : command_processor_(command_processor) {}
+
+VulkanGpuProfiler::~VulkanGpuProfiler() { Shutdown(); }
+
+bool VulkanGpuProfiler::Initialize() {
+  const ui::vulkan::VulkanProvider& provider =
+      command_processor_.GetVulkanProvider();
+  uint32_t timestamp_valid_bits =
+      provider.queue_families()[provider.queue_family_graphics_compute()]
+          .timestamp_valid_bits;
+  if (!timestamp_valid_bits) {
+    XELOGW(
+        "Vulkan graphics and compute queue doesn't support timestamps, GPU "
+        "time profiling is not available");
+    return false;
+  }
+  timestamp_mask_ = timestamp_valid_bits >= 64
+                        ? UINT64_MAX
+                        : (uint64_t(1) << timestamp_valid_bits) - 1;
+  timestamp_period_us_ =
+      double(provider.device_info().timestampPeriod) / 1000.0;
+  initialized_ = true;
+  return true;
+}
+
+void VulkanGpuProfiler::Shutdown() {
+  if (!initialized_) {
+    return;
+  }
+  const ui::vulkan::VulkanProvider& provider =
+      command_processor_.GetVulkanProvider();
+  const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
+  VkDevice device = provider.device();
+  // Only called when the GPU is not using the query pools anymore.
+  for (const Submission& submission : submissions_pending_) {
+    if (submission.query_pool != VK_NULL_HANDLE) {
+      dfn.vkDestroyQueryPool(device, submission.query_pool, nullptr);
+    }
+  }
+  submissions_pending_.clear();
+  if (current_submission_.query_pool != VK_NULL_HANDLE) {
+    dfn.vkDestroyQueryPool(device, current_submission_.query_pool, nullptr);
+  }
+  current_submission_ = Submission();
+  for (VkQueryPool query_pool : query_pools_free_) {
+    dfn.vkDestroyQueryPool(device, query_pool, nullptr);
+  }
+  query_pools_free_.clear();
+  submission_profiled_ = false;
+  initialized_ = false;
+}
+
+void VulkanGpuProfiler::BeginSubmission() {
+  submission_profiled_ = false;
+  submission_ended_ = false;
+  if (!initialized_) {
+    return;
+  }
+  // The query pool of a submission that has failed to be submitted can be
+  // reused.
+  VkQueryPool query_pool = current_submission_.query_pool;
+  current_submission_ = Submission();
+  if (!cvars::vulkan_gpu_timestamps) {
+    if (query_pool != VK_NULL_HANDLE) {
+      query_pools_free_.push_back(query_pool);
+    }
+    return;
+  }
+  if (query_pool == VK_NULL_HANDLE) {
+    if (!query_pools_free_.empty()) {
+      query_pool = query_pools_free_.back();
+      query_pools_free_.pop_back();
+    } else {
+      const ui::vulkan::VulkanProvider& provider =
+          command_processor_.GetVulkanProvider();
+      VkQueryPoolCreateInfo query_pool_create_info;
+      query_pool_create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+      query_pool_create_info.pNext = nullptr;
+      query_pool_create_info.flags = 0;
+      query_pool_create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+      query_pool_create_info.queryCount = kMaxQueriesPerSubmission;
+      query_pool_create_info.pipelineStatistics = 0;
+      if (provider.dfn().vkCreateQueryPool(
+              provider.device(), &query_pool_create_info, nullptr,
+              &query_pool) != VK_SUCCESS) {
+        XELOGE("Failed to create a Vulkan timestamp query pool");
+        return;
+      }
+    }
+  }
+  current_submission_.query_pool = query_pool;
+  // Queries must be reset outside render passes, and nothing has been recorded
+  // yet.
+  command_processor_.deferred_command_buffer().CmdVkResetQueryPool(
+      query_pool, 0, kMaxQueriesPerSubmission);
+  current_category_ = Category::kOther;
+  submission_profiled_ = true;
+}
+
+void VulkanGpuProfiler::SetCategory(Category category) {
+  if (!submission_profiled_ || submission_ended_) {
+    return;
+  }
+  if (!current_submission_.query_count) {
+    current_category_ = category;
+    WriteTimestamp();
+    return;
+  }
+  // Keep the last query for the end of the submission.
+  if (category == current_category_ ||
+      current_submission_.query_count + 1 >= kMaxQueriesPerSubmission) {
+    return;
+  }
+  current_submission_.interval_categories.push_back(current_category_);
+  current_category_ = category;
+  WriteTimestamp();
+}
+
+void VulkanGpuProfiler::EndSubmission() {
+  if (!submission_profiled_ || submission_ended_) {
+    return;
+  }
+  submission_ended_ = true;
+  if (current_submission_.query_count) {
+    current_submission_.interval_categories.push_back(current_category_);
+    WriteTimestamp();
+  }
+}
+
+void VulkanGpuProfiler::SubmissionSubmitted(uint64_t submission,
+                                            bool is_closing_frame) {
+  if (!initialized_) {
+    return;
+  }
+  // Also tracking submissions that haven't been profiled, for frame
+  // boundaries.
+  current_submission_.submission = submission;
+  current_submission_.is_closing_frame = is_closing_frame;
+  submissions_pending_.push_back(std::move(current_submission_));
+  current_submission_ = Submission();
+  submission_profiled_ = false;
+}
+
+void VulkanGpuProfiler::CompletedSubmissionUpdated(
+    uint64_t completed_submission) {
+  const ui::vulkan::VulkanProvider& provider =
+      command_processor_.GetVulkanProvider();
+  const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
+  VkDevice device = provider.device();
+  while (!submissions_pending_.empty()) {
+    Submission& submission = submissions_pending_.front();
+    if (submission.submission > completed_submission) {
+      break;
+    }
+    if (submission.query_pool != VK_NULL_HANDLE) {
+      if (submission.query_count >= 2) {
+        query_results_.resize(submission.query_count);
+        // Not waiting - the submission fence has been signaled.
+        if (dfn.vkGetQueryPoolResults(
+                device, submission.query_pool, 0, submission.query_count,
+                sizeof(uint64_t) * submission.query_count,
+                query_results_.data(), sizeof(uint64_t),
+                VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+          for (size_t i = 0; i < submission.interval_categories.size(); ++i) {
+            uint64_t ticks =
+                (query_results_[i + 1] - query_results_[i]) & timestamp_mask_;
+            frame_times_us_[size_t(submission.interval_categories[i])] +=
+                double(ticks) * timestamp_period_us_;
+          }
+        }
+      }
+      query_pools_free_.push_back(submission.query_pool);
+    }
+    if (submission.is_closing_frame) {
+      {
+        std::lock_guard<xe_mutex> lock(last_frame_times_mutex_);
+        std::memcpy(last_frame_times_us_, frame_times_us_,
+                    sizeof(last_frame_times_us_));
+      }
+      COUNT_profile_set("gpu/vulkan/gpu_time_us/draws",
+                        int64_t(frame_times_us_[size_t(Category::kDraws)]));
+      COUNT_profile_set(
+          "gpu/vulkan/gpu_time_us/render_target_transfers",
+          int64_t(frame_times_us_[size_t(Category::kRenderTargetTransfers)]));
+      COUNT_profile_set(
+          "gpu/vulkan/gpu_time_us/texture_loads",
+          int64_t(frame_times_us_[size_t(Category::kTextureLoads)]));
+      COUNT_profile_set(
+          "gpu/vulkan/gpu_time_us/resolves",
+          int64_t(frame_times_us_[size_t(Category::kResolves)]));
+      COUNT_profile_set("gpu/vulkan/gpu_time_us/other",
+                        int64_t(frame_times_us_[size_t(Category::kOther)]));
+      std::memset(frame_times_us_, 0, sizeof(frame_times_us_));
+    }
+    submissions_pending_.pop_front();
+  }
+}
+
+void VulkanGpuProfiler::GetLastFrameTimes(
+    double (&times_us_out)[size_t(Category::kCount)]) const {
+  std::lock_guard<xe_mutex> lock(last_frame_times_mutex_);
+  std::memcpy(times_us_out, last_frame_times_us_, sizeof(times_us_out));
+}
+
+void VulkanGpuProfiler::WriteTimestamp() {
+  command_processor_.deferred_command_buffer().CmdVkWriteTimestamp(
+      VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, current_submission_.query_pool,
+      current_submission_.query_count++);
+}
+
+}  // namespace vulkan
+}  // namespace gpu
+}  // namespace xe
@@ -0,0 +1,117 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_GPU_VULKAN_VULKAN_GPU_PROFILER_H_
+#define XENIA_GPU_VULKAN_VULKAN_GPU_PROFILER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "xenia/base/mutex.h"
+#include "xenia/ui/vulkan/vulkan_provider.h"
+
+namespace xe {
+namespace gpu {
+namespace vulkan {
+
+class VulkanCommandProcessor;
+
+// Measures how much GPU time is spent on different kinds of work with
+// timestamp queries, when vulkan_gpu_timestamps is enabled.
+//
+// Submissions are split into intervals at points where the kind of the work
+// being recorded changes, and the time between the timestamps at the ends of
+// each interval is attributed to its kind. This is approximate since the GPU
+// may overlap the work of adjacent intervals, but it doesn't require the work
+// to be nested properly. The results are read back without waiting when the
+// submission is known to be completed.
+class VulkanGpuProfiler {
+ public:
+  enum class Category : uint32_t {
+    // Guest draws in render passes.
+    kDraws,
+    // Copying between render targets for EDRAM ownership transfers.
+    kRenderTargetTransfers,
+    // Texture loading and untiling dispatches.
+    kTextureLoads,
+    // Copying from render targets to the shared memory, and resolve clears.
+    kResolves,
+    // Presentation and anything else.
+    kOther,
+
+    kCount,
+  };
+  static const char* GetCategoryName(Category category);
+
+  explicit VulkanGpuProfiler(VulkanCommandProcessor& command_processor);
+  ~VulkanGpuProfiler();
+
+  // Returns false if timestamps are not supported by the queue.
+  bool Initialize();
+  void Shutdown();
+
+  // Called after the deferred command buffer has been reset for a new
+  // submission.
+  void BeginSubmission();
+  // Ends the current interval if the category is different, and begins a new
+  // one.
+  void SetCategory(Category category);
+  // Called before the deferred command buffer is executed - may be called
+  // multiple times if submitting fails.
+  void EndSubmission();
+  // Called after the submission has been sent to the queue.
+  void SubmissionSubmitted(uint64_t submission, bool is_closing_frame);
+  void CompletedSubmissionUpdated(uint64_t completed_submission);
+
+  // GPU time spent on each category in the last completed frame. Can be called
+  // from any thread.
+  void GetLastFrameTimes(
+      double (&times_us_out)[size_t(Category::kCount)]) const;
+
+ private:
+  static constexpr uint32_t kMaxQueriesPerSubmission = 1024;
+
+  struct Submission {
+    VkQueryPool query_pool = VK_NULL_HANDLE;
+    uint32_t query_count = 0;
+    // Category of the interval ending at each query after the first.
+    std::vector<Category> interval_categories;
+    uint64_t submission = 0;
+    bool is_closing_frame = false;
+  };
+
+  void WriteTimestamp();
+
+  VulkanCommandProcessor& command_processor_;
+
+  bool initialized_ = false;
+  double timestamp_period_us_ = 0.0;
+  uint64_t timestamp_mask_ = 0;
+
+  bool submission_profiled_ = false;
+  bool submission_ended_ = false;
+  Category current_category_ = Category::kOther;
+  Submission current_submission_;
+  std::deque<Submission> submissions_pending_;
+  std::vector<VkQueryPool> query_pools_free_;
+  std::vector<uint64_t> query_results_;
+
+  double frame_times_us_[size_t(Category::kCount)] = {};
+  mutable xe_mutex last_frame_times_mutex_;
+  double last_frame_times_us_[size_t(Category::kCount)] = {};
+};
+
+}  // namespace vulkan
+}  // namespace gpu
+}  // namespace xe
+
+#endif  // XENIA_GPU_VULKAN_VULKAN_GPU_PROFILER_H_
@@ -11,16 +11,24 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cstdint>
 #include <cstring>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <tuple>
 #include <utility>
 #include <vector>
 
 #include "third_party/fmt/include/fmt/format.h"
 #include "xenia/base/assert.h"
+#include "xenia/base/byte_order.h"
+#include "xenia/base/clock.h"
+#include "xenia/base/filesystem.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
+#include "xenia/base/memory.h"
 #include "xenia/base/profiling.h"
 #include "xenia/base/xxhash.h"
 #include "xenia/gpu/draw_util.h"
@@ -34,6 +42,22 @@
 #include "xenia/gpu/xenos.h"
 #include "xenia/ui/vulkan/vulkan_util.h"
 
+DEFINE_int32(
+    vulkan_pipeline_creation_threads, -1,
+    "Number of threads used for graphics pipeline creation. -1 to calculate "
+    "automatically (75% of logical CPU cores), a positive number to specify "
+    "the number of threads explicitly (up to the number of logical CPU cores), "
+    "0 to disable multithreaded pipeline creation.",
+    "Vulkan");
+DEFINE_bool(
+    vulkan_async_pipeline_creation_skip_draws, false,
+    "Drop draws using graphics pipelines that are still being created on the "
+    "pipeline creation threads instead of waiting for their creation at the "
+    "end of the submission. Removes stuttering when new pipelines are "
+    "encountered, at the cost of some objects not being drawn for a few "
+    "frames. Requires vulkan_pipeline_creation_threads to be non-zero.",
+    "Vulkan");
+
 namespace xe {
 namespace gpu {
 namespace vulkan {
@@ -81,6 +105,43 @@ bool VulkanPipelineCache::Initialize() {
     }
   }
 
+  uint32_t logical_processor_count = xe::threading::logical_processor_count();
+  if (!logical_processor_count) {
+    // Pick some reasonable amount if couldn't determine the number of cores.
+    logical_processor_count = 6;
+  }
+  // Initialize creation thread synchronization data even if not using creation
+  // threads because they may be used anyway to create pipelines from the
+  // storage.
+  creation_threads_busy_ = 0;
+  creation_completion_event_ =
+      xe::threading::Event::CreateManualResetEvent(true);
+  assert_not_null(creation_completion_event_);
+  creation_completion_set_event_ = false;
+  creation_threads_shutdown_from_ = SIZE_MAX;
+  if (cvars::vulkan_pipeline_creation_threads != 0) {
+    size_t creation_thread_count;
+    if (cvars::vulkan_pipeline_creation_threads < 0) {
+      creation_thread_count =
+          std::max(logical_processor_count * 3 / 4, uint32_t(1));
+    } else {
+      creation_thread_count =
+          std::min(uint32_t(cvars::vulkan_pipeline_creation_threads),
+                   logical_processor_count);
+    }
+    for (size_t i = 0; i < creation_thread_count; ++i) {
+      std::unique_ptr<xe::threading::Thread> creation_thread =
+          xe::threading::Thread::Create({}, [this, i]() { CreationThread(i); });
+      assert_not_null(creation_thread);
+      creation_thread->set_name("Vulkan Pipelines");
+      creation_threads_.push_back(std::move(creation_thread));
+    }
+  }
+  creation_skip_draws_ = !creation_threads_.empty() &&
+                         cvars::vulkan_async_pipeline_creation_skip_draws;
+  pipelines_created_in_frame_.store(0, std::memory_order_relaxed);
+  draws_skipped_in_frame_ = 0;
+
   return true;
 }
 
@@ -90,6 +151,28 @@ void VulkanPipelineCache::Shutdown() {
   const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
   VkDevice device = provider.device();
 
+  // Shut down all threads, before destroying the pipelines since they may be
+  // creating them.
+  if (!creation_threads_.empty()) {
+    {
+      std::lock_guard<xe_mutex> lock(creation_request_lock_);
+      creation_threads_shutdown_from_ = 0;
+    }
+    creation_request_cond_.notify_all();
+    for (size_t i = 0; i < creation_threads_.size(); ++i) {
+      xe::threading::Wait(creation_threads_[i].get(), false);
+    }
+    creation_threads_.clear();
+  }
+  // Pipelines that haven't been created before the shutdown are not needed
+  // anymore.
+  creation_queue_.clear();
+  creation_completion_event_.reset();
+  creation_skip_draws_ = false;
+
+  // Shut down the persistent shader / pipeline storage.
+  ShutdownShaderStorage();
+
   // Destroy all pipelines.
   last_pipeline_ = nullptr;
   for (const auto& pipeline_pair : pipelines_) {
@@ -114,6 +197,7 @@ void VulkanPipelineCache::Shutdown() {
     delete it.second;
   }
   shaders_.clear();
+  shader_storage_index_ = 0;
   texture_binding_layout_map_.clear();
   texture_binding_layouts_.clear();
 
@@ -121,12 +205,702 @@ void VulkanPipelineCache::Shutdown() {
   shader_translator_.reset();
 }
 
+void VulkanPipelineCache::InitializeShaderStorage(
+    const std::filesystem::path& cache_root, uint32_t title_id, bool blocking) {
+  ShutdownShaderStorage();
+
+  const ui::vulkan::VulkanProvider& provider =
+      command_processor_.GetVulkanProvider();
+  const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
+  VkDevice device = provider.device();
+  const ui::vulkan::VulkanProvider::DeviceInfo& device_info =
+      provider.device_info();
+
+  auto shader_storage_root = cache_root / "shaders";
+  // For files that can be moved between different hosts.
+  auto shader_storage_shareable_root = shader_storage_root / "shareable";
+  if (!std::filesystem::exists(shader_storage_shareable_root)) {
+    if (!std::filesystem::create_directories(shader_storage_shareable_root)) {
+      XELOGE(
+          "Failed to create the shareable shader storage directory, persistent "
+          "shader storage will be disabled: {}",
+          xe::path_to_utf8(shader_storage_shareable_root));
+      return;
+    }
+  }
+  // For the driver's pipeline cache data, which is valid only for the specific
+  // device and driver version.
+  auto shader_storage_local_root = shader_storage_root / "local";
+
+  bool edram_fragment_shader_interlock =
+      render_target_cache_.GetPath() ==
+      RenderTargetCache::Path::kPixelShaderInterlock;
+
+  // Initialize the pipeline storage stream - read pipeline descriptions and
+  // collect used shader modifications to translate.
+  std::vector<PipelineStoredDescription> pipeline_stored_descriptions;
+  // <Shader hash, modification bits>.
+  std::set<std::pair<uint64_t, uint64_t>> shader_translations_needed;
+  auto pipeline_storage_file_path =
+      shader_storage_shareable_root /
+      fmt::format("{:08X}.{}.vulkan.xpso", title_id,
+                  edram_fragment_shader_interlock ? "fsi" : "fbo");
+  pipeline_storage_file_ =
+      xe::filesystem::OpenFile(pipeline_storage_file_path, "a+b");
+  if (!pipeline_storage_file_) {
+    XELOGE(
+        "Failed to open the Vulkan pipeline description storage file for "
+        "writing, persistent shader storage will be disabled: {}",
+        xe::path_to_utf8(pipeline_storage_file_path));
+    return;
+  }
+  pipeline_storage_file_flush_needed_ = false;
+  // 'XEPS'.
+  const uint32_t pipeline_storage_magic = 0x53504558;
+  // 'VKFS' or 'VKRT'.
+  const uint32_t pipeline_storage_magic_api =
+      edram_fragment_shader_interlock ? 0x53464B56 : 0x54524B56;
+  const uint32_t pipeline_storage_version_swapped =
+      xe::byte_swap(PipelineDescription::kVersion);
+  const uint32_t pipeline_storage_modification_version_swapped =
+      xe::byte_swap(SpirvShaderTranslator::Modification::kVersion);
+  struct {
+    uint32_t magic;
+    uint32_t magic_api;
+    uint32_t version_swapped;
+    uint32_t modification_version_swapped;
+  } pipeline_storage_file_header;
+  if (fread(&pipeline_storage_file_header, sizeof(pipeline_storage_file_header),
+            1, pipeline_storage_file_) &&
+      pipeline_storage_file_header.magic == pipeline_storage_magic &&
+      pipeline_storage_file_header.magic_api == pipeline_storage_magic_api &&
+      pipeline_storage_file_header.version_swapped ==
+          pipeline_storage_version_swapped &&
+      pipeline_storage_file_header.modification_version_swapped ==
+          pipeline_storage_modification_version_swapped) {
+    xe::filesystem::Seek(pipeline_storage_file_, 0, SEEK_END);
+    int64_t pipeline_storage_told_end =
+        xe::filesystem::Tell(pipeline_storage_file_);
+    size_t pipeline_storage_told_count =
+        size_t(pipeline_storage_told_end >=
+                       int64_t(sizeof(pipeline_storage_file_header))
+                   ? (uint64_t(pipeline_storage_told_end) -
+                      sizeof(pipeline_storage_file_header)) /
+                         sizeof(PipelineStoredDescription)
+                   : 0);
+    if (pipeline_storage_told_count &&
+        xe::filesystem::Seek(pipeline_storage_file_,
+                             int64_t(sizeof(pipeline_storage_file_header)),
+                             SEEK_SET)) {
+      pipeline_stored_descriptions.resize(pipeline_storage_told_count);
+      pipeline_stored_descriptions.resize(
+          fread(pipeline_stored_descriptions.data(),
+                sizeof(PipelineStoredDescription), pipeline_storage_told_count,
+                pipeline_storage_file_));
+      size_t pipeline_storage_read_count = pipeline_stored_descriptions.size();
+      for (size_t i = 0; i < pipeline_storage_read_count; ++i) {
+        const PipelineStoredDescription& pipeline_stored_description =
+            pipeline_stored_descriptions[i];
+        // Validate file integrity, stop and truncate the stream if data is
+        // corrupted.
+        if (pipeline_stored_description.description.GetHash() !=
+            pipeline_stored_description.description_hash) {
+          pipeline_stored_descriptions.resize(i);
+          break;
+        }
+        // Skip pipelines requiring unsupported device features (to keep the
+        // cache files mostly shareable across devices), but keep them in the
+        // file.
+        if (!ArePipelineRequirementsMet(
+                pipeline_stored_description.description)) {
+          continue;
+        }
+        // Mark the shader modifications as needed for translation.
+        shader_translations_needed.emplace(
+            pipeline_stored_description.description.vertex_shader_hash,
+            pipeline_stored_description.description.vertex_shader_modification);
+        if (pipeline_stored_description.description.pixel_shader_hash) {
+          shader_translations_needed.emplace(
+              pipeline_stored_description.description.pixel_shader_hash,
+              pipeline_stored_description.description
+                  .pixel_shader_modification);
+        }
+      }
+    }
+  }
+
+  size_t logical_processor_count = xe::threading::logical_processor_count();
+  if (!logical_processor_count) {
+    // Pick some reasonable amount if couldn't determine the number of cores.
+    logical_processor_count = 6;
+  }
+
+  // Initialize the Xenos shader storage stream. The format is the same as in
+  // the Direct3D 12 backend, so the file is shared between the two.
+  uint64_t shader_storage_initialization_start =
+      xe::Clock::QueryHostTickCount();
+  auto shader_storage_file_path =
+      shader_storage_shareable_root / fmt::format("{:08X}.xsh", title_id);
+  shader_storage_file_ =
+      xe::filesystem::OpenFile(shader_storage_file_path, "a+b");
+  if (!shader_storage_file_) {
+    XELOGE(
+        "Failed to open the guest shader storage file for writing, persistent "
+        "shader storage will be disabled: {}",
+        xe::path_to_utf8(shader_storage_file_path));
+    fclose(pipeline_storage_file_);
+    pipeline_storage_file_ = nullptr;
+    return;
+  }
+  ++shader_storage_index_;
+  shader_storage_file_flush_needed_ = false;
+  struct {
+    uint32_t magic;
+    uint32_t version_swapped;
+  } shader_storage_file_header;
+  // 'XESH'.
+  const uint32_t shader_storage_magic = 0x48534558;
+  if (fread(&shader_storage_file_header, sizeof(shader_storage_file_header), 1,
+            shader_storage_file_) &&
+      shader_storage_file_header.magic == shader_storage_magic &&
+      xe::byte_swap(shader_storage_file_header.version_swapped) ==
+          ShaderStoredHeader::kVersion) {
+    uint64_t shader_storage_valid_bytes = sizeof(shader_storage_file_header);
+    // Load and translate shaders written by previous Xenia executions until the
+    // end of the file or until a corrupted one is detected.
+    ShaderStoredHeader shader_header;
+    std::vector<uint32_t> ucode_dwords;
+    ucode_dwords.reserve(0xFFFF);
+    size_t shaders_translated = 0;
+
+    // Threads overlapping file reading.
+    std::mutex shaders_translation_thread_mutex;
+    std::condition_variable shaders_translation_thread_cond;
+    std::deque<VulkanShader*> shaders_to_translate;
+    size_t shader_translation_threads_busy = 0;
+    bool shader_translation_threads_shutdown = false;
+    std::mutex shaders_failed_to_translate_mutex;
+    std::vector<VulkanShader::VulkanTranslation*> shaders_failed_to_translate;
+    auto shader_translation_thread_function = [&]() {
+      StringBuffer ucode_disasm_buffer;
+      SpirvShaderTranslator translator(
+          SpirvShaderTranslator::Features(device_info),
+          render_target_cache_.msaa_2x_attachments_supported(),
+          render_target_cache_.msaa_2x_no_attachments_supported(),
+          edram_fragment_shader_interlock);
+      for (;;) {
+        VulkanShader* shader_to_translate;
+        for (;;) {
+          std::unique_lock<std::mutex> lock(shaders_translation_thread_mutex);
+          if (shaders_to_translate.empty()) {
+            if (shader_translation_threads_shutdown) {
+              return;
+            }
+            shaders_translation_thread_cond.wait(lock);
+            continue;
+          }
+          shader_to_translate = shaders_to_translate.front();
+          shaders_to_translate.pop_front();
+          ++shader_translation_threads_busy;
+          break;
+        }
+        shader_to_translate->AnalyzeUcode(ucode_disasm_buffer);
+        // Translate each needed modification on this thread after performing
+        // modification-independent analysis of the whole shader.
+        uint64_t ucode_data_hash = shader_to_translate->ucode_data_hash();
+        for (auto modification_it = shader_translations_needed.lower_bound(
+                 std::make_pair(ucode_data_hash, uint64_t(0)));
+             modification_it != shader_translations_needed.end() &&
+             modification_it->first == ucode_data_hash;
+             ++modification_it) {
+          VulkanShader::VulkanTranslation* translation =
+              static_cast<VulkanShader::VulkanTranslation*>(
+                  shader_to_translate->GetOrCreateTranslation(
+                      modification_it->second));
+          // Only try (and delete in case of failure) if it's a new translation.
+          // If it's a shader previously encountered in the game, translation of
+          // which has failed, and the shader storage is loaded later, keep it
+          // this way not to try to translate it again.
+          if (!translation->is_translated() &&
+              !TranslateAnalyzedShader(translator, *translation)) {
+            std::lock_guard<std::mutex> lock(shaders_failed_to_translate_mutex);
+            shaders_failed_to_translate.push_back(translation);
+          }
+        }
+        {
+          std::lock_guard<std::mutex> lock(shaders_translation_thread_mutex);
+          --shader_translation_threads_busy;
+        }
+      }
+    };
+    std::vector<std::unique_ptr<xe::threading::Thread>>
+        shader_translation_threads;
+
+    while (true) {
+      if (!fread(&shader_header, sizeof(shader_header), 1,
+                 shader_storage_file_)) {
+        break;
+      }
+      size_t ucode_byte_count =
+          shader_header.ucode_dword_count * sizeof(uint32_t);
+      ucode_dwords.resize(shader_header.ucode_dword_count);
+      if (shader_header.ucode_dword_count &&
+          !fread(ucode_dwords.data(), ucode_byte_count, 1,
+                 shader_storage_file_)) {
+        break;
+      }
+      uint64_t ucode_data_hash =
+          XXH3_64bits(ucode_dwords.data(), ucode_byte_count);
+      if (shader_header.ucode_data_hash != ucode_data_hash) {
+        // Validation failed.
+        break;
+      }
+      shader_storage_valid_bytes += sizeof(shader_header) + ucode_byte_count;
+      VulkanShader* shader =
+          LoadShader(shader_header.type, ucode_dwords.data(),
+                     shader_header.ucode_dword_count, ucode_data_hash);
+      if (shader->ucode_storage_index() == shader_storage_index_) {
+        // Appeared twice in this file for some reason - skip, otherwise race
+        // condition will be caused by translating twice in parallel.
+        continue;
+      }
+      // Loaded from the current storage - don't write again.
+      shader->set_ucode_storage_index(shader_storage_index_);
+      // Create new threads if the currently existing threads can't keep up
+      // with file reading, but not more than the number of logical processors
+      // minus one.
+      size_t shader_translation_threads_needed;
+      {
+        std::lock_guard<std::mutex> lock(shaders_translation_thread_mutex);
+        shader_translation_threads_needed =
+            std::min(shader_translation_threads_busy +
+                         shaders_to_translate.size() + size_t(1),
+                     logical_processor_count - size_t(1));
+      }
+      while (shader_translation_threads.size() <
+             shader_translation_threads_needed) {
+        auto thread = xe::threading::Thread::Create(
+            {}, shader_translation_thread_function);
+        assert_not_null(thread);
+        thread->set_name("Shader Translation");
+        shader_translation_threads.push_back(std::move(thread));
+      }
+      // Request ucode information gathering and translation of all the needed
+      // shaders.
+      {
+        std::lock_guard<std::mutex> lock(shaders_translation_thread_mutex);
+        shaders_to_translate.push_back(shader);
+      }
+      shaders_translation_thread_cond.notify_one();
+      ++shaders_translated;
+    }
+    if (!shader_translation_threads.empty()) {
+      {
+        std::lock_guard<std::mutex> lock(shaders_translation_thread_mutex);
+        shader_translation_threads_shutdown = true;
+      }
+      shaders_translation_thread_cond.notify_all();
+      for (auto& shader_translation_thread : shader_translation_threads) {
+        xe::threading::Wait(shader_translation_thread.get(), false);
+      }
+      shader_translation_threads.clear();
+      for (VulkanShader::VulkanTranslation* translation :
+           shaders_failed_to_translate) {
+        VulkanShader* shader =
+            static_cast<VulkanShader*>(&translation->shader());
+        shader->DestroyTranslation(translation->modification());
+        if (shader->translations().empty()) {
+          shaders_.erase(shader->ucode_data_hash());
+          delete shader;
+        }
+      }
+    }
+    XELOGGPU("Translated {} shaders from the storage in {} milliseconds",
+             shaders_translated,
+             (xe::Clock::QueryHostTickCount() -
+              shader_storage_initialization_start) *
+                 1000 / xe::Clock::QueryHostTickFrequency());
+    xe::filesystem::TruncateStdioFile(shader_storage_file_,
+                                      shader_storage_valid_bytes);
+  } else {
+    xe::filesystem::TruncateStdioFile(shader_storage_file_, 0);
+    shader_storage_file_header.magic = shader_storage_magic;
+    shader_storage_file_header.version_swapped =
+        xe::byte_swap(ShaderStoredHeader::kVersion);
+    fwrite(&shader_storage_file_header, sizeof(shader_storage_file_header), 1,
+           shader_storage_file_);
+  }
+
+  // Load the driver pipeline cache data from the previous runs on this device
+  // to skip backend compilation of the pipelines being created.
+  vk_pipeline_cache_file_path_ =
+      shader_storage_local_root / fmt::format("{:08X}.vulkan.bin", title_id);
+  std::vector<uint8_t> vk_pipeline_cache_data;
+  {
+    FILE* vk_pipeline_cache_file =
+        xe::filesystem::OpenFile(vk_pipeline_cache_file_path_, "rb");
+    if (vk_pipeline_cache_file) {
+      PipelineCacheStoredHeader vk_pipeline_cache_header;
+      if (fread(&vk_pipeline_cache_header, sizeof(vk_pipeline_cache_header), 1,
+                vk_pipeline_cache_file) &&
+          vk_pipeline_cache_header.magic == kPipelineCacheStoredMagic &&
+          vk_pipeline_cache_header.version ==
+              PipelineCacheStoredHeader::kVersion &&
+          vk_pipeline_cache_header.vendor_id == device_info.vendorID &&
+          vk_pipeline_cache_header.device_id == device_info.deviceID &&
+          vk_pipeline_cache_header.driver_version ==
+              device_info.driverVersion &&
+          !std::memcmp(vk_pipeline_cache_header.pipeline_cache_uuid,
+                       device_info.pipelineCacheUUID, VK_UUID_SIZE) &&
+          vk_pipeline_cache_header.data_size) {
+        vk_pipeline_cache_data.resize(
+            size_t(vk_pipeline_cache_header.data_size));
+        if (!fread(vk_pipeline_cache_data.data(),
+                   vk_pipeline_cache_data.size(), 1, vk_pipeline_cache_file) ||
+            XXH3_64bits(vk_pipeline_cache_data.data(),
+                        vk_pipeline_cache_data.size()) !=
+                vk_pipeline_cache_header.data_hash) {
+          vk_pipeline_cache_data.clear();
+        }
+      }
+      fclose(vk_pipeline_cache_file);
+    }
+  }
+  VkPipelineCacheCreateInfo vk_pipeline_cache_create_info;
+  vk_pipeline_cache_create_info.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  vk_pipeline_cache_create_info.pNext = nullptr;
+  vk_pipeline_cache_create_info.flags = 0;
+  vk_pipeline_cache_create_info.initialDataSize = vk_pipeline_cache_data.size();
+  vk_pipeline_cache_create_info.pInitialData =
+      vk_pipeline_cache_data.empty() ? nullptr : vk_pipeline_cache_data.data();
+  if (dfn.vkCreatePipelineCache(device, &vk_pipeline_cache_create_info,
+                                nullptr, &vk_pipeline_cache_) != VK_SUCCESS) {
+    vk_pipeline_cache_ = VK_NULL_HANDLE;
+    if (!vk_pipeline_cache_data.empty()) {
+      // The driver has rejected the data - try to create an empty cache.
+      vk_pipeline_cache_create_info.initialDataSize = 0;
+      vk_pipeline_cache_create_info.pInitialData = nullptr;
+      if (dfn.vkCreatePipelineCache(device, &vk_pipeline_cache_create_info,
+                                    nullptr,
+                                    &vk_pipeline_cache_) != VK_SUCCESS) {
+        vk_pipeline_cache_ = VK_NULL_HANDLE;
+      }
+    }
+    if (vk_pipeline_cache_ == VK_NULL_HANDLE) {
+      XELOGE(
+          "Failed to create the Vulkan pipeline cache, pipelines will be "
+          "compiled from scratch in every run");
+    }
+  }
+  vk_pipeline_cache_data.clear();
+  vk_pipeline_cache_data.shrink_to_fit();
+
+  // Create the pipelines.
+  if (!pipeline_stored_descriptions.empty()) {
+    uint64_t pipeline_creation_start_ = xe::Clock::QueryHostTickCount();
+
+    // Launch additional creation threads to use all cores to create
+    // pipelines faster. Will also be using the main thread, so minus 1.
+    size_t creation_thread_original_count = creation_threads_.size();
+    size_t creation_thread_needed_count = std::max(
+        std::min(pipeline_stored_descriptions.size(), logical_processor_count) -
+            size_t(1),
+        creation_thread_original_count);
+    while (creation_threads_.size() < creation_thread_needed_count) {
+      size_t creation_thread_index = creation_threads_.size();
+      std::unique_ptr<xe::threading::Thread> creation_thread =
+          xe::threading::Thread::Create({}, [this, creation_thread_index]() {
+            CreationThread(creation_thread_index);
+          });
+      assert_not_null(creation_thread);
+      creation_thread->set_name("Vulkan Pipelines");
+      creation_threads_.push_back(std::move(creation_thread));
+    }
+
+    // Look up all the objects needed for pipeline creation on this thread
+    // since the caches are not thread-safe, then create the Vulkan pipelines
+    // themselves in parallel.
+    size_t pipelines_created = 0;
+    for (const PipelineStoredDescription& pipeline_stored_description :
+         pipeline_stored_descriptions) {
+      const PipelineDescription& pipeline_description =
+          pipeline_stored_description.description;
+      if (!ArePipelineRequirementsMet(pipeline_description)) {
+        continue;
+      }
+      // Skip already known pipelines - those have already been created.
+      if (pipelines_.find(pipeline_description) != pipelines_.end()) {
+        continue;
+      }
+
+      auto vertex_shader_it =
+          shaders_.find(pipeline_description.vertex_shader_hash);
+      if (vertex_shader_it == shaders_.end()) {
+        continue;
+      }
+      auto vertex_shader_translation =
+          static_cast<VulkanShader::VulkanTranslation*>(
+              vertex_shader_it->second->GetTranslation(
+                  pipeline_description.vertex_shader_modification));
+      if (!vertex_shader_translation ||
+          !vertex_shader_translation->is_translated() ||
+          !vertex_shader_translation->is_valid()) {
+        continue;
+      }
+      VulkanShader::VulkanTranslation* pixel_shader_translation = nullptr;
+      if (pipeline_description.pixel_shader_hash) {
+        auto pixel_shader_it =
+            shaders_.find(pipeline_description.pixel_shader_hash);
+        if (pixel_shader_it == shaders_.end()) {
+          continue;
+        }
+        pixel_shader_translation =
+            static_cast<VulkanShader::VulkanTranslation*>(
+                pixel_shader_it->second->GetTranslation(
+                    pipeline_description.pixel_shader_modification));
+        if (!pixel_shader_translation ||
+            !pixel_shader_translation->is_translated() ||
+            !pixel_shader_translation->is_valid()) {
+          continue;
+        }
+      }
+
+      const PipelineLayoutProvider* pipeline_layout;
+      VkShaderModule geometry_shader;
+      VkRenderPass render_pass;
+      if (!GetPipelineCreationObjects(
+              pipeline_description, vertex_shader_translation,
+              pixel_shader_translation, pipeline_layout, geometry_shader,
+              render_pass)) {
+        continue;
+      }
+
+      PipelineCreationArguments creation_arguments;
+      creation_arguments.pipeline =
+          &*pipelines_
+                .emplace(std::piecewise_construct,
+                         std::forward_as_tuple(pipeline_description),
+                         std::forward_as_tuple(pipeline_layout))
+                .first;
+      creation_arguments.vertex_shader = vertex_shader_translation;
+      creation_arguments.pixel_shader = pixel_shader_translation;
+      creation_arguments.geometry_shader = geometry_shader;
+      creation_arguments.render_pass = render_pass;
+      QueuePipelineCreation(creation_arguments);
+      ++pipelines_created;
+    }
+
+    COUNT_profile_set("gpu/pipeline_cache/pipelines", pipelines_.size());
+
+    if (!creation_threads_.empty()) {
+      CreateQueuedPipelinesOnProcessorThread();
+      if (creation_threads_.size() > creation_thread_original_count) {
+        {
+          std::lock_guard<xe_mutex> lock(creation_request_lock_);
+          creation_threads_shutdown_from_ = creation_thread_original_count;
+          // Assuming the queue is empty because of
+          // CreateQueuedPipelinesOnProcessorThread.
+        }
+        creation_request_cond_.notify_all();
+        while (creation_threads_.size() > creation_thread_original_count) {
+          xe::threading::Wait(creation_threads_.back().get(), false);
+          creation_threads_.pop_back();
+        }
+        {
+          // Cleanup so additional threads can be created later again.
+          std::lock_guard<xe_mutex> lock(creation_request_lock_);
+          creation_threads_shutdown_from_ = SIZE_MAX;
+        }
+      }
+      // If the invocation is blocking, all the shader storage initialization
+      // is expected to be done before proceeding, to avoid latency in the
+      // command processor after the invocation. Otherwise, the persistent
+      // creation threads will finish the pipelines they have already taken.
+      if (blocking) {
+        AwaitPipelineCreation();
+      }
+    }
+
+    XELOGGPU(
+        "Created {} graphics pipelines (not including reading the "
+        "descriptions) from the storage in {} milliseconds",
+        pipelines_created,
+        (xe::Clock::QueryHostTickCount() - pipeline_creation_start_) * 1000 /
+            xe::Clock::QueryHostTickFrequency());
+    // If any pipeline descriptions were corrupted (or the whole file has excess
+    // bytes in the end), truncate to the last valid pipeline description.
+    xe::filesystem::TruncateStdioFile(
+        pipeline_storage_file_,
+        uint64_t(sizeof(pipeline_storage_file_header) +
+                 sizeof(PipelineStoredDescription) *
+                     pipeline_stored_descriptions.size()));
+  } else {
+    xe::filesystem::TruncateStdioFile(pipeline_storage_file_, 0);
+    pipeline_storage_file_header.magic = pipeline_storage_magic;
+    pipeline_storage_file_header.magic_api = pipeline_storage_magic_api;
+    pipeline_storage_file_header.version_swapped =
+        pipeline_storage_version_swapped;
+    pipeline_storage_file_header.modification_version_swapped =
+        pipeline_storage_modification_version_swapped;
+    fwrite(&pipeline_storage_file_header, sizeof(pipeline_storage_file_header),
+           1, pipeline_storage_file_);
+  }
+
+  shader_storage_cache_root_ = cache_root;
+  shader_storage_title_id_ = title_id;
+
+  // Start the storage writing thread.
+  storage_write_flush_shaders_ = false;
+  storage_write_flush_pipelines_ = false;
+  storage_write_thread_shutdown_ = false;
+  storage_write_thread_ =
+      xe::threading::Thread::Create({}, [this]() { StorageWriteThread(); });
+  assert_not_null(storage_write_thread_);
+  storage_write_thread_->set_name("Vulkan Storage writer");
+}
+
+void VulkanPipelineCache::ShutdownShaderStorage() {
+  // The driver pipeline cache may still be used by the creation threads.
+  AwaitPipelineCreation();
+
+  if (storage_write_thread_) {
+    {
+      std::lock_guard<std::mutex> lock(storage_write_request_lock_);
+      storage_write_thread_shutdown_ = true;
+    }
+    storage_write_request_cond_.notify_all();
+    xe::threading::Wait(storage_write_thread_.get(), false);
+    storage_write_thread_.reset();
+  }
+  storage_write_shader_queue_.clear();
+  storage_write_pipeline_queue_.clear();
+
+  if (pipeline_storage_file_) {
+    fclose(pipeline_storage_file_);
+    pipeline_storage_file_ = nullptr;
+    pipeline_storage_file_flush_needed_ = false;
+  }
+
+  if (shader_storage_file_) {
+    fclose(shader_storage_file_);
+    shader_storage_file_ = nullptr;
+    shader_storage_file_flush_needed_ = false;
+  }
+
+  if (vk_pipeline_cache_ != VK_NULL_HANDLE) {
+    const ui::vulkan::VulkanProvider& provider =
+        command_processor_.GetVulkanProvider();
+    const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
+    VkDevice device = provider.device();
+    // Write the data accumulated by the driver for the next runs.
+    size_t vk_pipeline_cache_data_size = 0;
+    std::vector<uint8_t> vk_pipeline_cache_data;
+    if (dfn.vkGetPipelineCacheData(device, vk_pipeline_cache_,
+                                   &vk_pipeline_cache_data_size,
+                                   nullptr) == VK_SUCCESS &&
+        vk_pipeline_cache_data_size) {
+      vk_pipeline_cache_data.resize(vk_pipeline_cache_data_size);
+      if (dfn.vkGetPipelineCacheData(
+              device, vk_pipeline_cache_, &vk_pipeline_cache_data_size,
+              vk_pipeline_cache_data.data()) == VK_SUCCESS) {
+        vk_pipeline_cache_data.resize(vk_pipeline_cache_data_size);
+      } else {
+        vk_pipeline_cache_data.clear();
+      }
+    }
+    if (!vk_pipeline_cache_data.empty()) {
+      std::filesystem::path vk_pipeline_cache_directory =
+          vk_pipeline_cache_file_path_.parent_path();
+      if (!std::filesystem::exists(vk_pipeline_cache_directory)) {
+        std::filesystem::create_directories(vk_pipeline_cache_directory);
+      }
+      FILE* vk_pipeline_cache_file =
+          xe::filesystem::OpenFile(vk_pipeline_cache_file_path_, "wb");
+      if (vk_pipeline_cache_file) {
+        const ui::vulkan::VulkanProvider::DeviceInfo& device_info =
+            provider.device_info();
+        PipelineCacheStoredHeader vk_pipeline_cache_header;
+        vk_pipeline_cache_header.magic = kPipelineCacheStoredMagic;
+        vk_pipeline_cache_header.version = PipelineCacheStoredHeader::kVersion;
+        vk_pipeline_cache_header.vendor_id = device_info.vendorID;
+        vk_pipeline_cache_header.device_id = device_info.deviceID;
+        vk_pipeline_cache_header.driver_version = device_info.driverVersion;
+        std::memcpy(vk_pipeline_cache_header.pipeline_cache_uuid,
+                    device_info.pipelineCacheUUID, VK_UUID_SIZE);
+        vk_pipeline_cache_header.data_size =
+            uint64_t(vk_pipeline_cache_data.size());
+        vk_pipeline_cache_header.data_hash = XXH3_64bits(
+            vk_pipeline_cache_data.data(), vk_pipeline_cache_data.size());
+        fwrite(&vk_pipeline_cache_header, sizeof(vk_pipeline_cache_header), 1,
+               vk_pipeline_cache_file);
+        fwrite(vk_pipeline_cache_data.data(), vk_pipeline_cache_data.size(), 1,
+               vk_pipeline_cache_file);
+        fclose(vk_pipeline_cache_file);
+      } else {
+        XELOGE("Failed to open the Vulkan pipeline cache file for writing: {}",
+               xe::path_to_utf8(vk_pipeline_cache_file_path_));
+      }
+    }
+    dfn.vkDestroyPipelineCache(device, vk_pipeline_cache_, nullptr);
+    vk_pipeline_cache_ = VK_NULL_HANDLE;
+  }
+  vk_pipeline_cache_file_path_.clear();
+
+  shader_storage_cache_root_.clear();
+  shader_storage_title_id_ = 0;
+}
+
+void VulkanPipelineCache::EndSubmission() {
+  if (shader_storage_file_flush_needed_ ||
+      pipeline_storage_file_flush_needed_) {
+    {
+      std::lock_guard<std::mutex> lock(storage_write_request_lock_);
+      if (shader_storage_file_flush_needed_) {
+        storage_write_flush_shaders_ = true;
+      }
+      if (pipeline_storage_file_flush_needed_) {
+        storage_write_flush_pipelines_ = true;
+      }
+    }
+    storage_write_request_cond_.notify_one();
+    shader_storage_file_flush_needed_ = false;
+    pipeline_storage_file_flush_needed_ = false;
+  }
+  // The command buffer may reference pipelines that are still being created
+  // unless draws with them are dropped.
+  if (!creation_skip_draws_) {
+    AwaitPipelineCreation();
+  }
+}
+
+void VulkanPipelineCache::EndFrame() {
+  size_t pipelines_pending = 0;
+  if (!creation_threads_.empty()) {
+    std::lock_guard<xe_mutex> lock(creation_request_lock_);
+    pipelines_pending = creation_queue_.size() + creation_threads_busy_;
+  }
+  COUNT_profile_set(
+      "gpu/pipeline_cache/created_in_frame",
+      pipelines_created_in_frame_.exchange(0, std::memory_order_relaxed));
+  COUNT_profile_set("gpu/pipeline_cache/pending", pipelines_pending);
+  COUNT_profile_set("gpu/pipeline_cache/draws_skipped_in_frame",
+                    draws_skipped_in_frame_);
+  draws_skipped_in_frame_ = 0;
+}
+
 VulkanShader* VulkanPipelineCache::LoadShader(xenos::ShaderType shader_type,
                                               const uint32_t* host_address,
                                               uint32_t dword_count) {
   // Hash the input memory and lookup the shader.
-  uint64_t data_hash =
-      XXH3_64bits(host_address, dword_count * sizeof(uint32_t));
+  return LoadShader(shader_type, host_address, dword_count,
+                    XXH3_64bits(host_address, dword_count * sizeof(uint32_t)));
+}
+
+VulkanShader* VulkanPipelineCache::LoadShader(xenos::ShaderType shader_type,
+                                              const uint32_t* host_address,
+                                              uint32_t dword_count,
+                                              uint64_t data_hash) {
   auto it = shaders_.find(data_hash);
   if (it != shaders_.end()) {
     // Shader has been previously loaded.
@@ -238,6 +1012,7 @@ bool VulkanPipelineCache::EnsureShadersTranslated(
       XELOGE("Failed to translate the vertex shader!");
       return false;
     }
+    StoreShader(vertex_shader->shader());
   }
   if (!vertex_shader->is_valid()) {
     // Translation attempted previously, but not valid.
@@ -250,6 +1025,7 @@ bool VulkanPipelineCache::EnsureShadersTranslated(
         XELOGE("Failed to translate the pixel shader!");
         return false;
       }
+      StoreShader(pixel_shader->shader());
     }
     if (!pixel_shader->is_valid()) {
       // Translation attempted previously, but not valid.
@@ -266,7 +1042,7 @@ bool VulkanPipelineCache::ConfigurePipeline(
     reg::RB_DEPTHCONTROL normalized_depth_control,
     uint32_t normalized_color_mask,
     VulkanRenderTargetCache::RenderPassKey render_pass_key,
-    VkPipeline& pipeline_out,
+    const void*& pipeline_handle_out,
     const PipelineLayoutProvider*& pipeline_layout_out) {
 #if XE_UI_VULKAN_FINE_GRAINED_DRAW_SCOPES
   SCOPE_profile_cpu_f("gpu");
@@ -284,20 +1060,86 @@ bool VulkanPipelineCache::ConfigurePipeline(
           description)) {
     return false;
   }
+  ++pipeline_lookup_count_;
   if (last_pipeline_ && last_pipeline_->first == description) {
-    pipeline_out = last_pipeline_->second.pipeline;
+    ++pipeline_lookup_hit_count_;
+    pipeline_handle_out = GetPipelineHandleForDraw(last_pipeline_->second);
     pipeline_layout_out = last_pipeline_->second.pipeline_layout;
     return true;
   }
   auto it = pipelines_.find(description);
   if (it != pipelines_.end()) {
+    ++pipeline_lookup_hit_count_;
     last_pipeline_ = &*it;
-    pipeline_out = it->second.pipeline;
+    pipeline_handle_out = GetPipelineHandleForDraw(it->second);
     pipeline_layout_out = it->second.pipeline_layout;
     return true;
   }
 
   // Create the pipeline if not the latest and not already existing.
+  const PipelineLayoutProvider* pipeline_layout;
+  VkShaderModule geometry_shader;
+  VkRenderPass render_pass;
+  if (!GetPipelineCreationObjects(description, vertex_shader, pixel_shader,
+                                  pipeline_layout, geometry_shader,
+                                  render_pass)) {
+    return false;
+  }
+  PipelineCreationArguments creation_arguments;
+  auto& pipeline = *pipelines_
+                        .emplace(std::piecewise_construct,
+                                 std::forward_as_tuple(description),
+                                 std::forward_as_tuple(pipeline_layout))
+                        .first;
+  COUNT_profile_set("gpu/pipeline_cache/pipelines", pipelines_.size());
+  creation_arguments.pipeline = &pipeline;
+  creation_arguments.vertex_shader = vertex_shader;
+  creation_arguments.pixel_shader = pixel_shader;
+  creation_arguments.geometry_shader = geometry_shader;
+  creation_arguments.render_pass = render_pass;
+
+  if (pipeline_storage_file_) {
+    assert_not_null(storage_write_thread_);
+    pipeline_storage_file_flush_needed_ = true;
+    {
+      std::lock_guard<std::mutex> lock(storage_write_request_lock_);
+      storage_write_pipeline_queue_.emplace_back();
+      PipelineStoredDescription& stored_description =
+          storage_write_pipeline_queue_.back();
+      stored_description.description_hash = description.GetHash();
+      std::memcpy(&stored_description.description, &description,
+                  sizeof(description));
+    }
+    storage_write_request_cond_.notify_all();
+  }
+
+  QueuePipelineCreation(creation_arguments);
+  if (creation_threads_.empty() &&
+      pipeline.second.pipeline == VK_NULL_HANDLE) {
+    // Created synchronously, and failed.
+    return false;
+  }
+  last_pipeline_ = &pipeline;
+  pipeline_handle_out = GetPipelineHandleForDraw(pipeline.second);
+  pipeline_layout_out = pipeline_layout;
+  return true;
+}
+
+const void* VulkanPipelineCache::GetPipelineHandleForDraw(Pipeline& pipeline) {
+  if (creation_skip_draws_ &&
+      !pipeline.creation_completed.load(std::memory_order_acquire)) {
+    ++draws_skipped_in_frame_;
+    return nullptr;
+  }
+  return &pipeline;
+}
+
+bool VulkanPipelineCache::GetPipelineCreationObjects(
+    const PipelineDescription& description,
+    const VulkanShader::VulkanTranslation* vertex_shader,
+    const VulkanShader::VulkanTranslation* pixel_shader,
+    const PipelineLayoutProvider*& pipeline_layout_out,
+    VkShaderModule& geometry_shader_out, VkRenderPass& render_pass_out) {
   const PipelineLayoutProvider* pipeline_layout =
       command_processor_.GetPipelineLayout(
           pixel_shader
@@ -337,23 +1179,13 @@ bool VulkanPipelineCache::ConfigurePipeline(
               RenderTargetCache::Path::kPixelShaderInterlock
           ? render_target_cache_.GetFragmentShaderInterlockRenderPass()
           : render_target_cache_.GetHostRenderTargetsRenderPass(
-                render_pass_key);
+                description.render_pass_key);
   if (render_pass == VK_NULL_HANDLE) {
     return false;
   }
-  PipelineCreationArguments creation_arguments;
-  auto& pipeline =
-      *pipelines_.emplace(description, Pipeline(pipeline_layout)).first;
-  creation_arguments.pipeline = &pipeline;
-  creation_arguments.vertex_shader = vertex_shader;
-  creation_arguments.pixel_shader = pixel_shader;
-  creation_arguments.geometry_shader = geometry_shader;
-  creation_arguments.render_pass = render_pass;
-  if (!EnsurePipelineCreated(creation_arguments)) {
-    return false;
-  }
-  pipeline_out = pipeline.second.pipeline;
   pipeline_layout_out = pipeline_layout;
+  geometry_shader_out = geometry_shader;
+  render_pass_out = render_pass;
   return true;
 }
 
@@ -389,6 +1221,7 @@ bool VulkanPipelineCache::TranslateAnalyzedShader(
           texture_binding_count * sizeof(*texture_bindings.data());
       uint64_t texture_binding_layout_hash =
           XXH3_64bits(texture_bindings.data(), texture_binding_layout_bytes);
+      std::lock_guard<std::mutex> layouts_lock(layouts_mutex_);
       auto found_range =
           texture_binding_layout_map_.equal_range(texture_binding_layout_hash);
       for (auto it = found_range.first; it != found_range.second; ++it) {
@@ -436,6 +1269,21 @@ bool VulkanPipelineCache::TranslateAnalyzedShader(
   return true;
 }
 
+void VulkanPipelineCache::StoreShader(Shader& shader) {
+  if (!shader_storage_file_ ||
+      shader.ucode_storage_index() == shader_storage_index_) {
+    return;
+  }
+  shader.set_ucode_storage_index(shader_storage_index_);
+  assert_not_null(storage_write_thread_);
+  shader_storage_file_flush_needed_ = true;
+  {
+    std::lock_guard<std::mutex> lock(storage_write_request_lock_);
+    storage_write_shader_queue_.push_back(&shader);
+  }
+  storage_write_request_cond_.notify_all();
+}
+
 void VulkanPipelineCache::WritePipelineRenderTargetDescription(
     reg::RB_BLENDCONTROL blend_control, uint32_t write_mask,
     PipelineRenderTarget& render_target_out) const {
@@ -2279,7 +3127,7 @@ bool VulkanPipelineCache::EnsurePipelineCreated(
   const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
   VkDevice device = provider.device();
   VkPipeline pipeline;
-  if (dfn.vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1,
+  if (dfn.vkCreateGraphicsPipelines(device, vk_pipeline_cache_, 1,
                                     &pipeline_create_info, nullptr,
                                     &pipeline) != VK_SUCCESS) {
     // TODO(Triang3l): Move these error messages outside.
@@ -2298,6 +3146,194 @@ bool VulkanPipelineCache::EnsurePipelineCreated(
   return true;
 }
 
+void VulkanPipelineCache::CreatePipeline(
+    const PipelineCreationArguments& creation_arguments) {
+  if (EnsurePipelineCreated(creation_arguments)) {
+    pipelines_created_in_frame_.fetch_add(1, std::memory_order_relaxed);
+  }
+  // Publish the pipeline object (or the failure) to the command processor
+  // thread.
+  creation_arguments.pipeline->second.creation_completed.store(
+      true, std::memory_order_release);
+}
+
+void VulkanPipelineCache::QueuePipelineCreation(
+    const PipelineCreationArguments& creation_arguments) {
+  if (creation_threads_.empty()) {
+    CreatePipeline(creation_arguments);
+    return;
+  }
+  // Submit the pipeline for creation to any available thread.
+  {
+    std::lock_guard<xe_mutex> lock(creation_request_lock_);
+    creation_queue_.push_back(creation_arguments);
+  }
+  creation_request_cond_.notify_one();
+}
+
+void VulkanPipelineCache::StorageWriteThread() {
+  ShaderStoredHeader shader_header;
+  // Don't leak anything in unused bits.
+  std::memset(&shader_header, 0, sizeof(shader_header));
+
+  std::vector<uint32_t> ucode_guest_endian;
+  ucode_guest_endian.reserve(0xFFFF);
+
+  bool flush_shaders = false;
+  bool flush_pipelines = false;
+
+  while (true) {
+    if (flush_shaders) {
+      flush_shaders = false;
+      assert_not_null(shader_storage_file_);
+      fflush(shader_storage_file_);
+    }
+    if (flush_pipelines) {
+      flush_pipelines = false;
+      assert_not_null(pipeline_storage_file_);
+      fflush(pipeline_storage_file_);
+    }
+
+    const Shader* shader = nullptr;
+    PipelineStoredDescription pipeline_description;
+    bool write_pipeline = false;
+    {
+      std::unique_lock<std::mutex> lock(storage_write_request_lock_);
+      if (storage_write_thread_shutdown_) {
+        return;
+      }
+      if (!storage_write_shader_queue_.empty()) {
+        shader = storage_write_shader_queue_.front();
+        storage_write_shader_queue_.pop_front();
+      } else if (storage_write_flush_shaders_) {
+        storage_write_flush_shaders_ = false;
+        flush_shaders = true;
+      }
+      if (!storage_write_pipeline_queue_.empty()) {
+        std::memcpy(&pipeline_description,
+                    &storage_write_pipeline_queue_.front(),
+                    sizeof(pipeline_description));
+        storage_write_pipeline_queue_.pop_front();
+        write_pipeline = true;
+      } else if (storage_write_flush_pipelines_) {
+        storage_write_flush_pipelines_ = false;
+        flush_pipelines = true;
+      }
+      if (!shader && !write_pipeline) {
+        storage_write_request_cond_.wait(lock);
+        continue;
+      }
+    }
+
+    if (shader) {
+      shader_header.ucode_data_hash = shader->ucode_data_hash();
+      shader_header.ucode_dword_count = shader->ucode_dword_count();
+      shader_header.type = shader->type();
+      assert_not_null(shader_storage_file_);
+      fwrite(&shader_header, sizeof(shader_header), 1, shader_storage_file_);
+      if (shader_header.ucode_dword_count) {
+        ucode_guest_endian.resize(shader_header.ucode_dword_count);
+        // Need to swap because the hash is calculated for the shader with guest
+        // endianness.
+        xe::copy_and_swap(ucode_guest_endian.data(), shader->ucode_dwords(),
+                          shader_header.ucode_dword_count);
+        fwrite(ucode_guest_endian.data(),
+               shader_header.ucode_dword_count * sizeof(uint32_t), 1,
+               shader_storage_file_);
+      }
+    }
+
+    if (write_pipeline) {
+      assert_not_null(pipeline_storage_file_);
+      fwrite(&pipeline_description, sizeof(pipeline_description), 1,
+             pipeline_storage_file_);
+    }
+  }
+}
+
+void VulkanPipelineCache::CreationThread(size_t thread_index) {
+  while (true) {
+    PipelineCreationArguments pipeline_to_create;
+
+    // Check if need to shut down or set the completion event and dequeue the
+    // pipeline if there is any.
+    {
+      std::unique_lock<xe_mutex> lock(creation_request_lock_);
+      if (thread_index >= creation_threads_shutdown_from_ ||
+          creation_queue_.empty()) {
+        if (creation_completion_set_event_ && creation_threads_busy_ == 0) {
+          // Last pipeline in the queue created - signal the event if requested.
+          creation_completion_set_event_ = false;
+          creation_completion_event_->Set();
+        }
+        if (thread_index >= creation_threads_shutdown_from_) {
+          return;
+        }
+        creation_request_cond_.wait(lock);
+        continue;
+      }
+      // Take the pipeline from the queue and increment the busy thread count
+      // until the pipeline is created - other threads must be able to dequeue
+      // requests, but can't set the completion event until the pipelines are
+      // fully created (rather than just started creating).
+      pipeline_to_create = creation_queue_.front();
+      creation_queue_.pop_front();
+      ++creation_threads_busy_;
+    }
+
+    // Create the Vulkan pipeline.
+    CreatePipeline(pipeline_to_create);
+
+    // Pipeline created - the thread is not busy anymore, safe to set the
+    // completion event if needed (at the next iteration, or in some other
+    // thread).
+    {
+      std::lock_guard<xe_mutex> lock(creation_request_lock_);
+      --creation_threads_busy_;
+    }
+  }
+}
+
+void VulkanPipelineCache::CreateQueuedPipelinesOnProcessorThread() {
+  assert_false(creation_threads_.empty());
+  while (true) {
+    PipelineCreationArguments pipeline_to_create;
+    {
+      std::lock_guard<xe_mutex> lock(creation_request_lock_);
+      if (creation_queue_.empty()) {
+        break;
+      }
+      pipeline_to_create = creation_queue_.front();
+      creation_queue_.pop_front();
+    }
+    CreatePipeline(pipeline_to_create);
+  }
+}
+
+void VulkanPipelineCache::AwaitPipelineCreation() {
+  if (creation_threads_.empty()) {
+    return;
+  }
+  CreateQueuedPipelinesOnProcessorThread();
+  // Await creation of all queued pipelines.
+  bool await_creation_completion_event;
+  {
+    std::lock_guard<xe_mutex> lock(creation_request_lock_);
+    // Assuming the creation queue is already empty (because the processor
+    // thread also worked on creating the leftover pipelines), so only check
+    // if there are threads with pipelines currently being created.
+    await_creation_completion_event = creation_threads_busy_ != 0;
+    if (await_creation_completion_event) {
+      creation_completion_event_->Reset();
+      creation_completion_set_event_ = true;
+    }
+  }
+  if (await_creation_completion_event) {
+    creation_request_cond_.notify_one();
+    xe::threading::Wait(creation_completion_event_.get(), false);
+  }
+}
+
 }  // namespace vulkan
 }  // namespace gpu
 }  // namespace xe
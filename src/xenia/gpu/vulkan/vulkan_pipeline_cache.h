@@ -10,15 +10,24 @@
 #ifndef XENIA_GPU_VULKAN_VULKAN_PIPELINE_STATE_CACHE_H_
 #define XENIA_GPU_VULKAN_VULKAN_PIPELINE_STATE_CACHE_H_
 
+#include <atomic>
+#include <condition_variable>
 #include <cstddef>
+#include <cstdio>
 #include <cstring>
+#include <deque>
+#include <filesystem>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "xenia/base/hash.h"
 #include "xenia/base/platform.h"
+#include "xenia/base/string_buffer.h"
+#include "xenia/base/threading.h"
 #include "xenia/base/xxhash.h"
 #include "xenia/gpu/primitive_processor.h"
 #include "xenia/gpu/register_file.h"
@@ -59,6 +68,15 @@ class VulkanPipelineCache {
   bool Initialize();
   void Shutdown();
 
+  void InitializeShaderStorage(const std::filesystem::path& cache_root,
+                               uint32_t title_id, bool blocking);
+  void ShutdownShaderStorage();
+
+  void EndSubmission();
+  // Publishes the per-frame pipeline creation statistics to the profiler and
+  // resets them.
+  void EndFrame();
+
   VulkanShader* LoadShader(xenos::ShaderType shader_type,
                            const uint32_t* host_address, uint32_t dword_count);
   // Analyze shader microcode on the translator thread.
@@ -78,7 +96,12 @@ class VulkanPipelineCache {
 
   bool EnsureShadersTranslated(VulkanShader::VulkanTranslation* vertex_shader,
                                VulkanShader::VulkanTranslation* pixel_shader);
-  // TODO(Triang3l): Return a deferred creation handle.
+  // The returned pipeline handle must be resolved with
+  // GetVulkanPipelineByHandle at command buffer execution time since the
+  // pipeline may still be being created by the creation threads. If skipping
+  // draws while pipelines are being created is enabled, nullptr is returned as
+  // the handle (with true as the result) if the pipeline is not ready yet, and
+  // the draw must be dropped.
   bool ConfigurePipeline(
       VulkanShader::VulkanTranslation* vertex_shader,
       VulkanShader::VulkanTranslation* pixel_shader,
@@ -86,10 +109,49 @@ class VulkanPipelineCache {
       reg::RB_DEPTHCONTROL normalized_depth_control,
       uint32_t normalized_color_mask,
       VulkanRenderTargetCache::RenderPassKey render_pass_key,
-      VkPipeline& pipeline_out,
+      const void*& pipeline_handle_out,
       const PipelineLayoutProvider*& pipeline_layout_out);
 
+  // May return VK_NULL_HANDLE if the pipeline has failed to be created.
+  static VkPipeline GetVulkanPipelineByHandle(const void* handle) {
+    return static_cast<const Pipeline*>(handle)->pipeline;
+  }
+
+  // Pipeline lookups in ConfigurePipeline, and how many of them have found an
+  // existing pipeline, for performance statistics.
+  uint64_t pipeline_lookup_count() const { return pipeline_lookup_count_; }
+  uint64_t pipeline_lookup_hit_count() const {
+    return pipeline_lookup_hit_count_;
+  }
+
  private:
+  XEPACKEDSTRUCT(ShaderStoredHeader, {
+    uint64_t ucode_data_hash;
+
+    uint32_t ucode_dword_count : 31;
+    xenos::ShaderType type : 1;
+
+    static constexpr uint32_t kVersion = 0x20201219;
+  });
+
+  // Header of the serialized VkPipelineCache data, which is specific to the
+  // device and the driver, unlike the shareable shader and pipeline description
+  // storage.
+  XEPACKEDSTRUCT(PipelineCacheStoredHeader, {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendor_id;
+    uint32_t device_id;
+    uint32_t driver_version;
+    uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+    uint64_t data_size;
+    uint64_t data_hash;
+
+    static constexpr uint32_t kVersion = 0x20261016;
+  });
+  // 'XEVC'.
+  static constexpr uint32_t kPipelineCacheStoredMagic = 0x43564558;
+
   enum class PipelineGeometryShader : uint32_t {
     kNone,
     kPointList,
@@ -198,6 +260,13 @@ class VulkanPipelineCache {
         return size_t(description.GetHash());
       }
     };
+
+    static constexpr uint32_t kVersion = 0x20261016;
+  });
+
+  XEPACKEDSTRUCT(PipelineStoredDescription, {
+    uint64_t description_hash;
+    PipelineDescription description;
   });
 
   struct Pipeline {
@@ -205,8 +274,14 @@ class VulkanPipelineCache {
     // The layouts are owned by the VulkanCommandProcessor, and must not be
     // destroyed by it while the pipeline cache is active.
     const PipelineLayoutProvider* pipeline_layout;
+    // Set with release ordering by the thread creating the pipeline after
+    // `pipeline` has been written (even if creation has failed), for checking
+    // whether the pipeline is usable on the command processor thread without
+    // awaiting the creation threads.
+    std::atomic<bool> creation_completed;
     Pipeline(const PipelineLayoutProvider* pipeline_layout_provider)
-        : pipeline_layout(pipeline_layout_provider) {}
+        : pipeline_layout(pipeline_layout_provider),
+          creation_completed(false) {}
   };
 
   // Description that can be passed from the command processor thread to the
@@ -246,10 +321,18 @@ class VulkanPipelineCache {
     }
   };
 
+  VulkanShader* LoadShader(xenos::ShaderType shader_type,
+                           const uint32_t* host_address, uint32_t dword_count,
+                           uint64_t data_hash);
+
   // Can be called from multiple threads.
   bool TranslateAnalyzedShader(SpirvShaderTranslator& translator,
                                VulkanShader::VulkanTranslation& translation);
 
+  // Queues a newly translated shader for writing to the storage if it hasn't
+  // been written to the currently open storage yet.
+  void StoreShader(Shader& shader);
+
   void WritePipelineRenderTargetDescription(
       reg::RB_BLENDCONTROL blend_control, uint32_t write_mask,
       PipelineRenderTarget& render_target_out) const;
@@ -272,11 +355,31 @@ class VulkanPipelineCache {
       GeometryShaderKey& key_out);
   VkShaderModule GetGeometryShader(GeometryShaderKey key);
 
+  // Looks up the objects needed for creating a pipeline with the description -
+  // must be called on the command processor thread. The shaders must be
+  // translated and valid.
+  bool GetPipelineCreationObjects(
+      const PipelineDescription& description,
+      const VulkanShader::VulkanTranslation* vertex_shader,
+      const VulkanShader::VulkanTranslation* pixel_shader,
+      const PipelineLayoutProvider*& pipeline_layout_out,
+      VkShaderModule& geometry_shader_out, VkRenderPass& render_pass_out);
+
   // Can be called from creation threads - all needed data must be fully set up
   // at the point of the call: shaders must be translated, pipeline layout and
   // render pass objects must be available.
   bool EnsurePipelineCreated(
       const PipelineCreationArguments& creation_arguments);
+  // Creates the pipeline and marks it as completed - can be called from
+  // creation threads.
+  void CreatePipeline(const PipelineCreationArguments& creation_arguments);
+  // Submits the pipeline for creation to the creation threads if there are any,
+  // or creates it immediately otherwise.
+  void QueuePipelineCreation(
+      const PipelineCreationArguments& creation_arguments);
+  // Returns the handle to reference in the command buffer, or nullptr if the
+  // draw must be dropped because the pipeline is still being created.
+  const void* GetPipelineHandleForDraw(Pipeline& pipeline);
 
   VulkanCommandProcessor& command_processor_;
   const RegisterFile& register_file_;
@@ -324,6 +427,79 @@ class VulkanPipelineCache {
   // Previously used pipeline, to avoid lookups if the state wasn't changed.
   const std::pair<const PipelineDescription, Pipeline>* last_pipeline_ =
       nullptr;
+
+  uint64_t pipeline_lookup_count_ = 0;
+  uint64_t pipeline_lookup_hit_count_ = 0;
+
+  // Driver-side cache of compiled pipelines, serialized to the local
+  // (non-shareable) storage when the shader storage is shut down.
+  VkPipelineCache vk_pipeline_cache_ = VK_NULL_HANDLE;
+  std::filesystem::path vk_pipeline_cache_file_path_;
+
+  // Currently open shader storage path.
+  std::filesystem::path shader_storage_cache_root_;
+  uint32_t shader_storage_title_id_ = 0;
+
+  // Shader storage output stream, for preload in the next emulator runs.
+  FILE* shader_storage_file_ = nullptr;
+  // For only writing shaders to the currently open storage once, incremented
+  // when switching the storage.
+  uint32_t shader_storage_index_ = 0;
+  bool shader_storage_file_flush_needed_ = false;
+
+  // Pipeline storage output stream, for preload in the next emulator runs.
+  FILE* pipeline_storage_file_ = nullptr;
+  bool pipeline_storage_file_flush_needed_ = false;
+
+  // Thread for asynchronous writing to the storage streams.
+  void StorageWriteThread();
+  std::mutex storage_write_request_lock_;
+  std::condition_variable storage_write_request_cond_;
+  // Storage thread input is protected with storage_write_request_lock_, and the
+  // thread is notified about its change via storage_write_request_cond_.
+  std::deque<const Shader*> storage_write_shader_queue_;
+  std::deque<PipelineStoredDescription> storage_write_pipeline_queue_;
+  bool storage_write_flush_shaders_ = false;
+  bool storage_write_flush_pipelines_ = false;
+  bool storage_write_thread_shutdown_ = false;
+  std::unique_ptr<xe::threading::Thread> storage_write_thread_;
+
+  // Pipeline creation threads.
+  void CreationThread(size_t thread_index);
+  void CreateQueuedPipelinesOnProcessorThread();
+  // Waits until all queued pipelines are created, helping the creation threads
+  // on the calling thread.
+  void AwaitPipelineCreation();
+  xe_mutex creation_request_lock_;
+  std::condition_variable_any creation_request_cond_;
+  // Protected with creation_request_lock_, notify_one creation_request_cond_
+  // when set.
+  std::deque<PipelineCreationArguments> creation_queue_;
+  // Number of threads that are currently creating a pipeline - incremented when
+  // a pipeline is dequeued (the completion event can't be triggered before this
+  // is zero). Protected with creation_request_lock_.
+  size_t creation_threads_busy_ = 0;
+  // Manual-reset event set when the last queued pipeline is created and there
+  // are no more pipelines to create. This is triggered by the thread creating
+  // the last pipeline.
+  std::unique_ptr<xe::threading::Event> creation_completion_event_;
+  // Whether setting the event on completion is queued. Protected with
+  // creation_request_lock_, notify_one creation_request_cond_ when set.
+  bool creation_completion_set_event_ = false;
+  // Creation threads with this index or above need to be shut down as soon as
+  // possible. Protected with creation_request_lock_, notify_all
+  // creation_request_cond_ when set.
+  size_t creation_threads_shutdown_from_ = SIZE_MAX;
+  std::vector<std::unique_ptr<xe::threading::Thread>> creation_threads_;
+  // Whether draws with pipelines that are not created yet are dropped instead
+  // of awaiting the creation at the end of the submission. Latched at
+  // initialization since handles of pending pipelines may only be referenced
+  // by the command buffer if the submission awaits their creation.
+  bool creation_skip_draws_ = false;
+
+  // Per-frame statistics, reset in EndFrame.
+  std::atomic<uint32_t> pipelines_created_in_frame_{0};
+  uint32_t draws_skipped_in_frame_ = 0;
 };
 
 }  // namespace vulkan
@@ -1051,6 +1051,10 @@ bool VulkanRenderTargetCache::Resolve(const Memory& memory,
   DeferredCommandBuffer& command_buffer =
       command_processor_.deferred_command_buffer();
 
+  // Resolve clears are attributed to resolves too.
+  command_processor_.SetGpuProfilerCategory(
+      VulkanGpuProfiler::Category::kResolves);
+
   // Copying.
   bool copied = false;
   if (resolve_info.copy_dest_extent_length) {
@@ -1284,9 +1288,17 @@ bool VulkanRenderTargetCache::Update(
       RenderTarget* const* depth_and_color_render_targets =
           last_update_accumulated_render_targets();
 
+      const std::vector<Transfer>* transfers = last_update_transfers();
+      for (uint32_t i = 0; i < 1 + xenos::kMaxColorRenderTargets; ++i) {
+        if (!transfers[i].empty()) {
+          command_processor_.SetGpuProfilerCategory(
+              VulkanGpuProfiler::Category::kRenderTargetTransfers);
+          break;
+        }
+      }
       PerformTransfersAndResolveClears(1 + xenos::kMaxColorRenderTargets,
                                        depth_and_color_render_targets,
-                                       last_update_transfers());
+                                       transfers);
 
       uint32_t render_targets_are_srgb =
           gamma_render_target_as_srgb_
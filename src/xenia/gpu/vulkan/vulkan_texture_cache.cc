@@ -1341,6 +1341,9 @@ bool VulkanTextureCache::LoadTextureDataFromResidentMemoryImpl(Texture& texture,
   DeferredCommandBuffer& command_buffer =
       command_processor_.deferred_command_buffer();
 
+  command_processor_.SetGpuProfilerCategory(
+      VulkanGpuProfiler::Category::kTextureLoads);
+
   command_processor_.BindExternalComputePipeline(pipeline);
 
   command_buffer.CmdVkBindDescriptorSets(
@@ -10,7 +10,6 @@
 #include "xenia/base/console_app_main.h"
 #include "xenia/base/logging.h"
 #include "xenia/gpu/trace_dump.h"
-#include "xenia/gpu/vulkan/vulkan_command_processor.h"
 #include "xenia/gpu/vulkan/vulkan_graphics_system.h"
 #include "xenia/ui/vulkan/vulkan_provider.h"
 
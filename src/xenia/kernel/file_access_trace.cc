@@ -0,0 +1,192 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/kernel/file_access_trace.h"
+
+#include <algorithm>
+
+#include "xenia/base/cvar.h"
+#include "xenia/base/logging.h"
+#include "xenia/emulator.h"
+#include "xenia/kernel/kernel_state.h"
+#include "xenia/vfs/entry.h"
+#include "xenia/vfs/file.h"
+#include "xenia/vfs/virtual_file_system.h"
+
+DEFINE_bool(record_file_access_trace, false,
+            "Record the file reads of titles to prefetch the data on later "
+            "launches. Replaces the existing trace of the title.",
+            "Kernel");
+DEFINE_int32(file_access_trace_max_reads, 65536,
+             "Maximum number of reads to record in a file access trace.",
+             "Kernel");
+DEFINE_bool(prefetch_file_access_trace, true,
+            "Read the data in the recorded file access trace of the title in "
+            "the background when it's launched.",
+            "Kernel");
+
+namespace xe {
+namespace kernel {
+
+// Merged reads are split so the prefetcher can be cancelled quickly.
+constexpr uint64_t kMaxAccessLength = 1024 * 1024;
+
+FileAccessTrace::FileAccessTrace(KernelState* kernel_state)
+    : kernel_state_(kernel_state) {}
+
+FileAccessTrace::~FileAccessTrace() { OnTitleTerminate(); }
+
+std::filesystem::path FileAccessTrace::GetTracePath(uint32_t title_id) const {
+  return kernel_state_->emulator()->cache_root() / "file_traces" /
+         fmt::format("{:08X}.txt", title_id);
+}
+
+void FileAccessTrace::OnTitleLaunch(uint32_t title_id) {
+  OnTitleTerminate();
+  if (!title_id) {
+    return;
+  }
+
+  if (cvars::record_file_access_trace) {
+    std::lock_guard<xe_mutex> lock(recording_lock_);
+    recording_title_id_ = title_id;
+    recorded_accesses_.clear();
+    recording_.store(true, std::memory_order_relaxed);
+    XELOGI("Recording the file access trace of title {:08X}", title_id);
+    return;
+  }
+
+  if (!cvars::prefetch_file_access_trace) {
+    return;
+  }
+  std::vector<Access> accesses;
+  if (!vfs::LoadFileAccessTrace(GetTracePath(title_id), accesses) ||
+      accesses.empty()) {
+    return;
+  }
+  XELOGI("Prefetching {} file reads of title {:08X}", accesses.size(),
+         title_id);
+  prefetch_cancelled_.store(false, std::memory_order_relaxed);
+  xe::threading::Thread::CreationParameters thread_params;
+  thread_params.create_suspended = false;
+  prefetch_thread_ = xe::threading::Thread::Create(
+      thread_params, [this, accesses = std::move(accesses)]() mutable {
+        PrefetchThreadMain(std::move(accesses));
+      });
+  if (prefetch_thread_) {
+    prefetch_thread_->set_name("File Access Prefetch");
+  }
+}
+
+void FileAccessTrace::OnTitleTerminate() {
+  StopPrefetch();
+  if (recording_.exchange(false, std::memory_order_relaxed)) {
+    StoreTrace();
+  }
+}
+
+void FileAccessTrace::RecordRead(const vfs::Entry* entry, uint64_t offset,
+                                 uint64_t length) {
+  if (!length) {
+    return;
+  }
+  std::lock_guard<xe_mutex> lock(recording_lock_);
+  if (!recording_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  const std::string& path = entry->absolute_path();
+  if (!recorded_accesses_.empty()) {
+    Access& last_access = recorded_accesses_.back();
+    if (last_access.offset + last_access.length == offset &&
+        last_access.length + length <= kMaxAccessLength &&
+        last_access.path == path) {
+      last_access.length += length;
+      return;
+    }
+  }
+  if (recorded_accesses_.size() >=
+      size_t(std::max(cvars::file_access_trace_max_reads, int32_t(0)))) {
+    return;
+  }
+  recorded_accesses_.push_back({path, offset, length});
+}
+
+void FileAccessTrace::StoreTrace() {
+  std::vector<Access> accesses;
+  uint32_t title_id;
+  {
+    std::lock_guard<xe_mutex> lock(recording_lock_);
+    accesses.swap(recorded_accesses_);
+    title_id = recording_title_id_;
+  }
+  if (accesses.empty()) {
+    return;
+  }
+  auto trace_path = GetTracePath(title_id);
+  std::error_code error_code;
+  std::filesystem::create_directories(trace_path.parent_path(), error_code);
+  if (!vfs::StoreFileAccessTrace(trace_path, accesses)) {
+    XELOGE("Failed to write the file access trace {}",
+           xe::path_to_utf8(trace_path));
+    return;
+  }
+  XELOGI("Stored {} file reads of title {:08X} to {}", accesses.size(),
+         title_id, xe::path_to_utf8(trace_path));
+}
+
+void FileAccessTrace::StopPrefetch() {
+  if (!prefetch_thread_) {
+    return;
+  }
+  prefetch_cancelled_.store(true, std::memory_order_relaxed);
+  xe::threading::Wait(prefetch_thread_.get(), false);
+  prefetch_thread_.reset();
+}
+
+void FileAccessTrace::PrefetchThreadMain(std::vector<Access> accesses) {
+  vfs::VirtualFileSystem* file_system = kernel_state_->file_system();
+  std::vector<uint8_t> buffer;
+  const std::string* file_path = nullptr;
+  vfs::File* file = nullptr;
+  uint64_t bytes_prefetched = 0;
+  for (const Access& access : accesses) {
+    if (prefetch_cancelled_.load(std::memory_order_relaxed)) {
+      break;
+    }
+    if (!file_path || *file_path != access.path) {
+      if (file) {
+        file->Destroy();
+        file = nullptr;
+      }
+      file_path = &access.path;
+      vfs::Entry* entry = file_system->ResolvePath(access.path);
+      if (!entry ||
+          XFAILED(entry->Open(vfs::FileAccess::kGenericRead, &file))) {
+        file = nullptr;
+      }
+    }
+    if (!file) {
+      continue;
+    }
+    size_t length = size_t(std::min(access.length, kMaxAccessLength));
+    if (buffer.size() < length) {
+      buffer.resize(length);
+    }
+    size_t bytes_read = 0;
+    file->ReadSync(buffer.data(), length, size_t(access.offset), &bytes_read);
+    bytes_prefetched += bytes_read;
+  }
+  if (file) {
+    file->Destroy();
+  }
+  XELOGI("Prefetched {} bytes of the file access trace", bytes_prefetched);
+}
+
+}  // namespace kernel
+}  // namespace xe
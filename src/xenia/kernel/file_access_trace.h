@@ -0,0 +1,80 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_KERNEL_FILE_ACCESS_TRACE_H_
+#define XENIA_KERNEL_FILE_ACCESS_TRACE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "xenia/base/mutex.h"
+#include "xenia/base/threading.h"
+#include "xenia/vfs/file_access_trace.h"
+
+namespace xe {
+namespace vfs {
+class Entry;
+}  // namespace vfs
+}  // namespace xe
+
+namespace xe {
+namespace kernel {
+
+class KernelState;
+
+// Records the ordered file reads of a title, and on later launches of the
+// same title, reads the same data in the background ahead of the title to
+// warm the host page cache and the block caches of the devices.
+//
+// Traces are stored in the format of xe::vfs::LoadFileAccessTrace, and can also
+// be replayed with xenia-vfs-dump --benchmark=trace.
+class FileAccessTrace {
+ public:
+  explicit FileAccessTrace(KernelState* kernel_state);
+  ~FileAccessTrace();
+
+  // Starts recording or prefetching, depending on the configuration and
+  // whether a trace exists for the title.
+  void OnTitleLaunch(uint32_t title_id);
+  // Stores the recorded trace and stops prefetching.
+  void OnTitleTerminate();
+
+  bool is_recording() const {
+    return recording_.load(std::memory_order_relaxed);
+  }
+  void RecordRead(const vfs::Entry* entry, uint64_t offset, uint64_t length);
+
+ private:
+  using Access = vfs::FileAccessTraceRecord;
+
+  std::filesystem::path GetTracePath(uint32_t title_id) const;
+  void StoreTrace();
+  void StopPrefetch();
+  void PrefetchThreadMain(std::vector<Access> accesses);
+
+  KernelState* kernel_state_;
+
+  std::atomic<bool> recording_{false};
+  xe_mutex recording_lock_;
+  uint32_t recording_title_id_ = 0;
+  // Contiguous reads of the same file are merged.
+  std::vector<Access> recorded_accesses_;
+
+  std::atomic<bool> prefetch_cancelled_{false};
+  std::unique_ptr<xe::threading::Thread> prefetch_thread_;
+};
+
+}  // namespace kernel
+}  // namespace xe
+
+#endif  // XENIA_KERNEL_FILE_ACCESS_TRACE_H_
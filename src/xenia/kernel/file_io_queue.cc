@@ -0,0 +1,253 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/kernel/file_io_queue.h"
+
+#include <algorithm>
+
+#include "xenia/base/assert.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/logging.h"
+#include "xenia/kernel/kernel_state.h"
+#include "xenia/kernel/xevent.h"
+#include "xenia/kernel/xfile.h"
+#include "xenia/kernel/xthread.h"
+#include "xenia/memory.h"
+
+DEFINE_bool(async_file_io, true,
+            "Perform reads and writes of files opened for asynchronous I/O on "
+            "host worker threads instead of the guest thread.",
+            "Kernel");
+DEFINE_int32(async_file_io_threads, -1,
+             "Number of host threads for asynchronous file I/O (-1 = 2, or 1 "
+             "on systems with less than 4 logical processors).",
+             "Kernel");
+DEFINE_int32(async_file_io_queue_depth, 64,
+             "Maximum number of pending asynchronous file I/O requests, "
+             "further requests are performed on the guest thread.",
+             "Kernel");
+
+namespace xe {
+namespace kernel {
+
+FileIOQueue::FileIOQueue(KernelState* kernel_state)
+    : kernel_state_(kernel_state) {}
+
+FileIOQueue::~FileIOQueue() {
+  {
+    std::lock_guard<xe_mutex> lock(lock_);
+    shutting_down_ = true;
+  }
+  cond_.notify_all();
+  // The remaining requests are completed before the workers exit.
+  for (auto& worker_thread : worker_threads_) {
+    xe::threading::Wait(worker_thread.get(), false);
+  }
+}
+
+bool FileIOQueue::Submit(Request request) {
+  if (!cvars::async_file_io) {
+    return false;
+  }
+  {
+    std::lock_guard<xe_mutex> lock(lock_);
+    if (shutting_down_ ||
+        queue_.size() >=
+            size_t(std::max(cvars::async_file_io_queue_depth, int32_t(1)))) {
+      return false;
+    }
+    if (worker_threads_.empty()) {
+      uint32_t thread_count;
+      if (cvars::async_file_io_threads > 0) {
+        thread_count = uint32_t(cvars::async_file_io_threads);
+      } else {
+        thread_count =
+            xe::threading::logical_processor_count() >= 4 ? 2 : 1;
+      }
+      for (uint32_t i = 0; i < thread_count; ++i) {
+        xe::threading::Thread::CreationParameters thread_params;
+        thread_params.create_suspended = false;
+        auto worker_thread = xe::threading::Thread::Create(
+            thread_params, [this]() { WorkerThreadMain(); });
+        if (!worker_thread) {
+          break;
+        }
+        worker_thread->set_name("File I/O Worker");
+        worker_threads_.push_back(std::move(worker_thread));
+      }
+      if (worker_threads_.empty()) {
+        XELOGE("Failed to create the asynchronous file I/O threads");
+        return false;
+      }
+    }
+    queue_.push_back({std::move(request), std::chrono::steady_clock::now()});
+    {
+      std::lock_guard<xe_mutex> statistics_lock(statistics_lock_);
+      statistics_.max_queue_depth =
+          std::max(statistics_.max_queue_depth, uint32_t(queue_.size()));
+    }
+  }
+  cond_.notify_one();
+  return true;
+}
+
+void FileIOQueue::WorkerThreadMain() {
+  while (true) {
+    QueuedRequest queued_request;
+    {
+      std::unique_lock<xe_mutex> lock(lock_);
+      cond_.wait(lock, [this]() { return shutting_down_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        // Shutting down.
+        return;
+      }
+      queued_request = std::move(queue_.front());
+      queue_.pop_front();
+      ++active_count_;
+    }
+    Request& request = queued_request.request;
+    uint32_t bytes_transferred = Execute(request);
+    RecordCompletion(request.type, bytes_transferred,
+                     uint64_t(std::chrono::duration_cast<
+                                  std::chrono::microseconds>(
+                                  std::chrono::steady_clock::now() -
+                                  queued_request.submit_time)
+                                  .count()),
+                     true);
+    // Release the references to the objects before reporting the completion.
+    queued_request = QueuedRequest();
+    bool idle;
+    {
+      std::lock_guard<xe_mutex> lock(lock_);
+      --active_count_;
+      idle = !active_count_ && queue_.empty();
+    }
+    if (idle) {
+      idle_cond_.notify_all();
+    }
+  }
+}
+
+void FileIOQueue::Drain() {
+  std::unique_lock<xe_mutex> lock(lock_);
+  idle_cond_.wait(lock,
+                  [this]() { return !active_count_ && queue_.empty(); });
+}
+
+void FileIOQueue::Cancel() {
+  std::deque<QueuedRequest> cancelled_requests;
+  {
+    std::unique_lock<xe_mutex> lock(lock_);
+    cancelled_requests.swap(queue_);
+    idle_cond_.wait(lock, [this]() { return !active_count_; });
+  }
+  if (!cancelled_requests.empty()) {
+    XELOGI("Cancelled {} pending asynchronous file I/O requests",
+           cancelled_requests.size());
+  }
+}
+
+uint32_t FileIOQueue::Execute(Request& request) {
+  // Completion ports and the wait handle of the file are notified by XFile.
+  uint32_t bytes_transferred = 0;
+  X_STATUS result;
+  switch (request.type) {
+    case RequestType::kRead:
+      result =
+          request.file->Read(request.buffer, request.length,
+                             request.byte_offset, &bytes_transferred,
+                             request.apc_context);
+      break;
+    case RequestType::kReadScatter:
+      result = request.file->ReadScatter(request.buffer, request.length,
+                                         request.byte_offset,
+                                         &bytes_transferred,
+                                         request.apc_context);
+      break;
+    case RequestType::kWrite:
+      result =
+          request.file->Write(request.buffer, request.length,
+                              request.byte_offset, &bytes_transferred,
+                              request.apc_context);
+      break;
+    default:
+      assert_unhandled_case(request.type);
+      return 0;
+  }
+
+  if (request.io_status_block) {
+    auto io_status_block =
+        kernel_state_->memory()->TranslateVirtual<X_IO_STATUS_BLOCK*>(
+            request.io_status_block);
+    io_status_block->information = bytes_transferred;
+    io_status_block->status = result;
+  }
+
+  if (request.event) {
+    request.event->Set(0, false);
+  }
+
+  if (request.apc_routine && request.apc_thread) {
+    // Queuing an APC requires a guest context, which worker threads don't
+    // have.
+    kernel_state_->QueueDispatch([request]() {
+      request.apc_thread->EnqueueApc(request.apc_routine, request.apc_context,
+                                     request.io_status_block, 0);
+    });
+  }
+
+  return bytes_transferred;
+}
+
+void FileIOQueue::RecordCompletion(RequestType type,
+                                   uint32_t bytes_transferred,
+                                   uint64_t latency_us, bool queued) {
+  std::lock_guard<xe_mutex> lock(statistics_lock_);
+  if (type == RequestType::kWrite) {
+    ++statistics_.write_count;
+    statistics_.bytes_written += bytes_transferred;
+  } else {
+    ++statistics_.read_count;
+    statistics_.bytes_read += bytes_transferred;
+  }
+  if (queued) {
+    ++statistics_.queued_count;
+  }
+  statistics_.total_latency_us += latency_us;
+  statistics_.max_latency_us = std::max(statistics_.max_latency_us, latency_us);
+}
+
+FileIOQueue::Statistics FileIOQueue::statistics() {
+  std::lock_guard<xe_mutex> lock(statistics_lock_);
+  return statistics_;
+}
+
+void FileIOQueue::LogAndResetStatistics() {
+  Statistics statistics;
+  {
+    std::lock_guard<xe_mutex> lock(statistics_lock_);
+    statistics = statistics_;
+    statistics_ = {};
+  }
+  uint64_t request_count = statistics.read_count + statistics.write_count;
+  if (!request_count) {
+    return;
+  }
+  XELOGI(
+      "File I/O of title {:08X}: {} reads ({} bytes), {} writes ({} bytes), "
+      "{} done asynchronously, {} us average, {} us maximum latency, {} "
+      "maximum queue depth",
+      kernel_state_->title_id(), statistics.read_count, statistics.bytes_read,
+      statistics.write_count, statistics.bytes_written,
+      statistics.queued_count, statistics.total_latency_us / request_count,
+      statistics.max_latency_us, statistics.max_queue_depth);
+}
+
+}  // namespace kernel
+}  // namespace xe
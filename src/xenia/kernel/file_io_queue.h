@@ -0,0 +1,129 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_KERNEL_FILE_IO_QUEUE_H_
+#define XENIA_KERNEL_FILE_IO_QUEUE_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "xenia/base/mutex.h"
+#include "xenia/base/threading.h"
+#include "xenia/kernel/xobject.h"
+#include "xenia/xbox.h"
+
+namespace xe {
+namespace kernel {
+
+class KernelState;
+class XEvent;
+class XFile;
+class XThread;
+
+// Performs the reads and writes of files opened for asynchronous I/O on host
+// worker threads, so guest threads are not blocked by host disk I/O. Requests
+// are completed like on the guest thread - the I/O status block is written,
+// the event is signaled, completion ports are notified and the APC is queued
+// to the thread that has issued the request.
+class FileIOQueue {
+ public:
+  enum class RequestType {
+    kRead,
+    kReadScatter,
+    kWrite,
+  };
+
+  struct Request {
+    RequestType type;
+    object_ref<XFile> file;
+    object_ref<XEvent> event;
+    // Thread to queue the APC to, if apc_routine is not 0.
+    object_ref<XThread> apc_thread;
+    uint32_t apc_routine;
+    uint32_t apc_context;
+    uint32_t io_status_block;
+    // Segment array for kReadScatter.
+    uint32_t buffer;
+    uint32_t length;
+    uint64_t byte_offset;
+  };
+
+  struct Statistics {
+    uint64_t read_count;
+    uint64_t write_count;
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+    // Requests done by the workers rather than on the guest thread.
+    uint64_t queued_count;
+    uint64_t total_latency_us;
+    uint64_t max_latency_us;
+    uint32_t max_queue_depth;
+  };
+
+  explicit FileIOQueue(KernelState* kernel_state);
+  ~FileIOQueue();
+
+  // Returns false if the request must be done on the guest thread instead,
+  // either because asynchronous I/O is disabled or the queue is full. The
+  // caller must write X_STATUS_PENDING to the I/O status block and reset the
+  // event before submitting, as the request may complete at any time.
+  bool Submit(Request request);
+
+  // For requests done on the guest thread.
+  void RecordCompletion(RequestType type, uint32_t bytes_transferred,
+                        uint64_t latency_us, bool queued);
+
+  // Waits until all the submitted requests are completed, for instance, so the
+  // guest memory and the objects they write to are consistent when saving the
+  // state.
+  void Drain();
+  // Drops the requests that haven't been started yet without completing them,
+  // and waits for the ones currently being performed to be completed - for
+  // terminating the title that has issued them.
+  void Cancel();
+
+  Statistics statistics();
+  // Logs the statistics of the current title and starts counting anew.
+  void LogAndResetStatistics();
+
+ private:
+  struct QueuedRequest {
+    Request request;
+    std::chrono::steady_clock::time_point submit_time;
+  };
+
+  void WorkerThreadMain();
+  // Returns the number of bytes transferred.
+  uint32_t Execute(Request& request);
+
+  KernelState* kernel_state_;
+
+  xe_mutex lock_;
+  std::condition_variable_any cond_;
+  std::deque<QueuedRequest> queue_;
+  // Requests taken from the queue by the workers and not completed yet.
+  uint32_t active_count_ = 0;
+  // Notified when the queue becomes empty with no active requests.
+  std::condition_variable_any idle_cond_;
+  bool shutting_down_ = false;
+  // Created on the first request.
+  std::vector<std::unique_ptr<xe::threading::Thread>> worker_threads_;
+
+  xe_mutex statistics_lock_;
+  Statistics statistics_ = {};
+};
+
+}  // namespace kernel
+}  // namespace xe
+
+#endif  // XENIA_KERNEL_FILE_IO_QUEUE_H_
@@ -14,3 +14,7 @@ DEFINE_bool(headless, false,
             "UI");
 DEFINE_bool(log_high_frequency_kernel_calls, false,
             "Log kernel calls with the kHighFrequency tag.", "Kernel");
+DEFINE_bool(profile_kernel_exports, false,
+            "Collect call counts and latency histograms of kernel exports, "
+            "logged when the title terminates.",
+            "Kernel");
@@ -66,6 +66,8 @@ KernelState::KernelState(Emulator* emulator)
 
   app_manager_ = std::make_unique<xam::AppManager>();
   achievement_manager_ = std::make_unique<AchievementManager>();
+  file_io_queue_ = std::make_unique<FileIOQueue>(this);
+  file_access_trace_ = std::make_unique<FileAccessTrace>(this);
   user_profiles_.emplace(0, std::make_unique<xam::UserProfile>(0));
 
   InitializeKernelGuestGlobals();
@@ -94,6 +96,11 @@ KernelState::KernelState(Emulator* emulator)
 KernelState::~KernelState() {
   SetExecutableModule(nullptr);
 
+  // Completes the pending requests, which may queue APCs to the dispatch
+  // thread.
+  file_io_queue_.reset();
+  file_access_trace_.reset();
+
   if (dispatch_thread_running_) {
     dispatch_thread_running_ = false;
     dispatch_cond_.notify_all();
@@ -337,6 +344,8 @@ void KernelState::SetExecutableModule(object_ref<UserModule> module) {
     return;
   }
 
+  file_access_trace_->OnTitleLaunch(executable_module_->title_id());
+
   auto title_process =
       memory_->TranslateVirtual<X_KPROCESS*>(GetTitleProcess());
 
@@ -582,6 +591,15 @@ void KernelState::UnloadUserModule(const object_ref<UserModule>& module,
 
 void KernelState::TerminateTitle() {
   XELOGD("KernelState::TerminateTitle");
+  // The requests may write to guest memory and objects that are about to be
+  // released.
+  file_io_queue_->Cancel();
+  file_io_queue_->LogAndResetStatistics();
+  file_access_trace_->OnTitleTerminate();
+  if (cvars::profile_kernel_exports) {
+    ExportProfiler::Dump();
+    ExportProfiler::Reset();
+  }
   auto global_lock = global_critical_region_.Acquire();
 
   // Call terminate routines.
@@ -636,6 +654,9 @@ void KernelState::TerminateTitle() {
   // Release all objects in the object table.
   object_table_.PurgeAllObjects();
 
+  // No files of the title are open anymore.
+  file_system()->ReclaimRetiredEntries();
+
   // Unregister all notify listeners.
   notify_listeners_.clear();
 
@@ -808,6 +829,12 @@ void KernelState::CompleteOverlappedImmediateEx(uint32_t overlapped_ptr,
   CompleteOverlappedEx(overlapped_ptr, result, extended_error, length);
 }
 
+void KernelState::QueueDispatch(std::function<void()> fn) {
+  auto global_lock = global_critical_region_.Acquire();
+  dispatch_queue_.push_back(std::move(fn));
+  dispatch_cond_.notify_all();
+}
+
 void KernelState::CompleteOverlappedDeferred(
     std::function<void()> completion_callback, uint32_t overlapped_ptr,
     X_RESULT result, std::function<void()> pre_callback,
@@ -24,6 +24,8 @@
 #include "xenia/base/mutex.h"
 #include "xenia/cpu/backend/backend.h"
 #include "xenia/cpu/export_resolver.h"
+#include "xenia/kernel/file_access_trace.h"
+#include "xenia/kernel/file_io_queue.h"
 #include "xenia/kernel/util/kernel_fwd.h"
 #include "xenia/kernel/util/native_list.h"
 #include "xenia/kernel/util/object_table.h"
@@ -193,6 +195,10 @@ class KernelState {
   xam::ContentManager* content_manager() const {
     return content_manager_.get();
   }
+  FileIOQueue* file_io_queue() const { return file_io_queue_.get(); }
+  FileAccessTrace* file_access_trace() const {
+    return file_access_trace_.get();
+  }
 
   std::bitset<4> GetConnectedUsers() const;
   void UpdateUsedUserProfiles();
@@ -320,6 +326,10 @@ class KernelState {
       uint32_t overlapped_ptr, std::function<void()> pre_callback = nullptr,
       std::function<void()> post_callback = nullptr);
 
+  // Runs the function on the kernel dispatch thread, for work from host
+  // threads that needs a guest context.
+  void QueueDispatch(std::function<void()> fn);
+
   bool Save(ByteStream* stream);
   bool Restore(ByteStream* stream);
 
@@ -358,6 +368,8 @@ class KernelState {
   std::unique_ptr<xam::ContentManager> content_manager_;
   std::map<uint8_t, std::unique_ptr<xam::UserProfile>> user_profiles_;
   std::unique_ptr<AchievementManager> achievement_manager_;
+  std::unique_ptr<FileIOQueue> file_io_queue_;
+  std::unique_ptr<FileAccessTrace> file_access_trace_;
 
   KernelVersion kernel_version_;
 
@@ -0,0 +1,146 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/kernel/util/export_profiler.h"
+
+#include <chrono>
+#include <utility>
+
+#include "xenia/base/logging.h"
+#include "xenia/base/mutex.h"
+
+namespace xe {
+namespace kernel {
+
+namespace {
+
+struct ProfilerState {
+  xe_mutex lock;
+  std::vector<std::pair<const cpu::Export*, ExportProfiler::Counters*>>
+      exports;
+  // For converting ticks to nanoseconds, as the TSC frequency can't be
+  // queried on all CPUs.
+  uint64_t reset_ticks = ExportProfiler::ticks();
+  std::chrono::steady_clock::time_point reset_time =
+      std::chrono::steady_clock::now();
+};
+
+ProfilerState& GetProfilerState() {
+  static ProfilerState state;
+  return state;
+}
+
+}  // namespace
+
+void ExportProfiler::Register(const cpu::Export* export_entry,
+                              Counters* counters) {
+  ProfilerState& state = GetProfilerState();
+  std::lock_guard<xe_mutex> lock(state.lock);
+  state.exports.emplace_back(export_entry, counters);
+}
+
+std::vector<ExportProfiler::ExportStatistics>
+ExportProfiler::GetStatistics() {
+  ProfilerState& state = GetProfilerState();
+  std::lock_guard<xe_mutex> lock(state.lock);
+  uint64_t elapsed_ticks = ticks() - state.reset_ticks;
+  uint64_t elapsed_ns =
+      uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now() - state.reset_time)
+                   .count());
+  double ns_per_tick =
+      elapsed_ticks ? double(elapsed_ns) / double(elapsed_ticks) : 0.0;
+  auto to_ns = [ns_per_tick](uint64_t ticks) {
+    return uint64_t(double(ticks) * ns_per_tick);
+  };
+
+  std::vector<ExportStatistics> statistics;
+  for (const auto& export_counters : state.exports) {
+    const Counters& counters = *export_counters.second;
+    uint64_t call_count = counters.call_count.load(std::memory_order_relaxed);
+    if (!call_count) {
+      continue;
+    }
+    ExportStatistics export_statistics;
+    export_statistics.export_entry = export_counters.first;
+    export_statistics.call_count = call_count;
+    export_statistics.total_ns =
+        to_ns(counters.total_ticks.load(std::memory_order_relaxed));
+    export_statistics.max_ns =
+        to_ns(counters.max_ticks.load(std::memory_order_relaxed));
+    export_statistics.p50_ns = 0;
+    export_statistics.p99_ns = 0;
+    uint64_t histogram_count = 0;
+    uint32_t histogram[kHistogramBucketCount];
+    for (uint32_t i = 0; i < kHistogramBucketCount; ++i) {
+      histogram[i] = counters.histogram[i].load(std::memory_order_relaxed);
+      histogram_count += histogram[i];
+    }
+    uint64_t calls_below = 0;
+    for (uint32_t i = 0; i < kHistogramBucketCount; ++i) {
+      calls_below += histogram[i];
+      uint64_t bucket_max_ns = to_ns(uint64_t(2) << i);
+      if (!export_statistics.p50_ns && calls_below * 2 >= histogram_count) {
+        export_statistics.p50_ns = bucket_max_ns;
+      }
+      if (!export_statistics.p99_ns &&
+          calls_below * 100 >= histogram_count * 99) {
+        export_statistics.p99_ns = bucket_max_ns;
+        break;
+      }
+    }
+    statistics.push_back(export_statistics);
+  }
+  std::sort(statistics.begin(), statistics.end(),
+            [](const ExportStatistics& a, const ExportStatistics& b) {
+              return a.total_ns > b.total_ns;
+            });
+  return statistics;
+}
+
+void ExportProfiler::Dump(size_t max_count) {
+  std::vector<ExportStatistics> statistics = GetStatistics();
+  if (statistics.empty()) {
+    XELOGI("No kernel export calls have been profiled");
+    return;
+  }
+  XELOGI("Kernel exports by total time:");
+  for (size_t i = 0; i < std::min(statistics.size(), max_count); ++i) {
+    const ExportStatistics& export_statistics = statistics[i];
+    XELOGI(
+        "  {}: {} calls, {:.3f} ms total, {:.2f} us average, p50 <= {:.2f} "
+        "us, p99 <= {:.2f} us, max {:.2f} us",
+        export_statistics.export_entry->name, export_statistics.call_count,
+        double(export_statistics.total_ns) / 1e6,
+        double(export_statistics.total_ns) / 1e3 /
+            double(export_statistics.call_count),
+        double(export_statistics.p50_ns) / 1e3,
+        double(export_statistics.p99_ns) / 1e3,
+        double(export_statistics.max_ns) / 1e3);
+  }
+}
+
+void ExportProfiler::Reset() {
+  ProfilerState& state = GetProfilerState();
+  std::lock_guard<xe_mutex> lock(state.lock);
+  for (const auto& export_counters : state.exports) {
+    Counters& counters = *export_counters.second;
+    counters.call_count.store(0, std::memory_order_relaxed);
+    counters.total_ticks.store(0, std::memory_order_relaxed);
+    counters.max_ticks.store(0, std::memory_order_relaxed);
+    for (uint32_t i = 0; i < kHistogramBucketCount; ++i) {
+      counters.histogram[i].store(0, std::memory_order_relaxed);
+    }
+  }
+  state.reset_ticks = ticks();
+  state.reset_time = std::chrono::steady_clock::now();
+}
+
+}  // namespace kernel
+}  // namespace xe
@@ -0,0 +1,94 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_KERNEL_UTIL_EXPORT_PROFILER_H_
+#define XENIA_KERNEL_UTIL_EXPORT_PROFILER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "xenia/base/clock.h"
+#include "xenia/base/math.h"
+#include "xenia/base/platform.h"
+#include "xenia/cpu/export_resolver.h"
+
+#if XE_ARCH_AMD64
+#if XE_COMPILER_MSVC
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+namespace xe {
+namespace kernel {
+
+// Call counts and latency histograms of the kernel exports, collected by the
+// shim trampolines when profile_kernel_exports is enabled.
+class ExportProfiler {
+ public:
+  // Power of two buckets of the latency in ticks.
+  static constexpr uint32_t kHistogramBucketCount = 40;
+
+  struct Counters {
+    std::atomic<uint64_t> call_count{0};
+    std::atomic<uint64_t> total_ticks{0};
+    std::atomic<uint64_t> max_ticks{0};
+    std::atomic<uint32_t> histogram[kHistogramBucketCount] = {};
+
+    void Record(uint64_t ticks) {
+      call_count.fetch_add(1, std::memory_order_relaxed);
+      total_ticks.fetch_add(ticks, std::memory_order_relaxed);
+      uint64_t current_max_ticks = max_ticks.load(std::memory_order_relaxed);
+      while (ticks > current_max_ticks &&
+             !max_ticks.compare_exchange_weak(current_max_ticks, ticks,
+                                              std::memory_order_relaxed)) {
+      }
+      uint32_t bucket = 63 - xe::lzcnt(ticks | 1);
+      histogram[std::min(bucket, kHistogramBucketCount - 1)].fetch_add(
+          1, std::memory_order_relaxed);
+    }
+  };
+
+  struct ExportStatistics {
+    const cpu::Export* export_entry;
+    uint64_t call_count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    // Upper bounds of the histogram buckets containing the percentiles.
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+  };
+
+  // The TSC where available, as it's cheaper than the OS clock.
+  static uint64_t ticks() {
+#if XE_ARCH_AMD64
+    return __rdtsc();
+#else
+    return Clock::QueryHostTickCount();
+#endif
+  }
+
+  // Called once for each export when it's registered.
+  static void Register(const cpu::Export* export_entry, Counters* counters);
+
+  // Exports that have been called since the last reset, by total time in
+  // descending order.
+  static std::vector<ExportStatistics> GetStatistics();
+  // Logs the max_count exports with the most total time.
+  static void Dump(size_t max_count = 32);
+  static void Reset();
+};
+
+}  // namespace kernel
+}  // namespace xe
+
+#endif  // XENIA_KERNEL_UTIL_EXPORT_PROFILER_H_
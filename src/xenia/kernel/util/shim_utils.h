@@ -23,6 +23,7 @@
 #include "xenia/cpu/ppc/ppc_context.h"
 #include "xenia/kernel/kernel_flags.h"
 #include "xenia/kernel/kernel_state.h"
+#include "xenia/kernel/util/export_profiler.h"
 
 namespace xe {
 namespace kernel {
@@ -556,6 +557,7 @@ struct ExportRegistrerHelper {
 
     static const auto export_entry =
         new cpu::Export(ORDINAL, xe::cpu::Export::Type::kFunction, name, TAGS);
+    static ExportProfiler::Counters profiler_counters;
     struct X {
       static void Trampoline(PPCContext* ppc_context) {
         Param::Init init = {
@@ -572,6 +574,8 @@ struct ExportRegistrerHelper {
              cvars::log_high_frequency_kernel_calls)) {
           PrintKernelCall(export_entry, params);
         }
+        const bool profile = cvars::profile_kernel_exports;
+        uint64_t profile_start_ticks = profile ? ExportProfiler::ticks() : 0;
         if constexpr (std::is_void<R>::value) {
           KernelTrampoline(fn, std::forward<std::tuple<Ps...>>(params),
                            std::make_index_sequence<sizeof...(Ps)>());
@@ -585,6 +589,10 @@ struct ExportRegistrerHelper {
             // TODO(benvanik): log result.
           }
         }
+        if (profile) {
+          profiler_counters.Record(ExportProfiler::ticks() -
+                                   profile_start_ticks);
+        }
       }
     };
     struct Y {
@@ -606,6 +614,7 @@ struct ExportRegistrerHelper {
       }
     };
     export_entry->function_data.trampoline = &X::Trampoline;
+    ExportProfiler::Register(export_entry, &profiler_counters);
     return export_entry;
   }
 };
@@ -9,8 +9,9 @@
 
 #include "xenia/kernel/xam/content_manager.h"
 
+#include <algorithm>
 #include <array>
-#include <set>
+#include <cctype>
 #include <string>
 
 #include "third_party/fmt/include/fmt/format.h"
@@ -55,17 +56,48 @@ ContentPackage::~ContentPackage() {
   fs->UnregisterDevice(device_path_);
 }
 
+// Title and content type directories are named with 8 hexadecimal digits.
+static bool ParseIdDirectoryName(const std::filesystem::path& name,
+                                 uint32_t& id_out) {
+  auto name_str = xe::path_to_utf8(name);
+  if (name_str.size() != 8 ||
+      !std::all_of(name_str.cbegin(), name_str.cend(),
+                   [](char c) { return std::isxdigit(uint8_t(c)) != 0; })) {
+    return false;
+  }
+  id_out = xe::string_util::from_string<uint32_t>(name_str, true);
+  return true;
+}
+
 ContentManager::ContentManager(KernelState* kernel_state,
                                const std::filesystem::path& root_path)
-    : kernel_state_(kernel_state), root_path_(root_path) {}
+    : kernel_state_(kernel_state), root_path_(root_path) {
+  xe::threading::Thread::CreationParameters thread_params;
+  thread_params.create_suspended = false;
+  index_thread_ = xe::threading::Thread::Create(
+      thread_params, [this]() { IndexAllContent(); });
+  if (index_thread_) {
+    index_thread_->set_name("Content Indexer");
+  }
+}
 
-ContentManager::~ContentManager() = default;
+ContentManager::~ContentManager() {
+  if (index_thread_) {
+    index_thread_cancelled_ = true;
+    xe::threading::Wait(index_thread_.get(), false);
+  }
+}
 
-std::filesystem::path ContentManager::ResolvePackageRoot(
-    XContentType content_type, uint32_t title_id) {
+uint32_t ContentManager::ResolveTitleId(uint32_t title_id) const {
   if (title_id == kCurrentlyRunningTitleId) {
-    title_id = kernel_state_->title_id();
+    return kernel_state_->title_id();
   }
+  return title_id;
+}
+
+std::filesystem::path ContentManager::ResolvePackageRoot(
+    XContentType content_type, uint32_t title_id) {
+  title_id = ResolveTitleId(title_id);
   auto title_id_str = fmt::format("{:08X}", title_id);
   auto content_type_str = fmt::format("{:08X}", uint32_t(content_type));
 
@@ -93,56 +125,122 @@ std::vector<XCONTENT_AGGREGATE_DATA> ContentManager::ListContent(
     uint32_t device_id, XContentType content_type, uint32_t title_id) {
   std::vector<XCONTENT_AGGREGATE_DATA> result;
 
-  if (title_id == kCurrentlyRunningTitleId) {
-    title_id = kernel_state_->title_id();
-  }
+  title_id = ResolveTitleId(title_id);
 
-  std::set<uint32_t> title_ids = {title_id};
+  std::lock_guard<xe_mutex> lock(content_index_lock_);
 
+  std::vector<uint32_t> title_ids = {title_id};
   if (content_type == XContentType::kPublisher) {
-    std::string publisher_id_regex =
-        fmt::format("^{:04X}.*", static_cast<uint16_t>(title_id >> 16));
-    // Get all publisher entries
-    auto publisher_entries = xe::filesystem::FilterByName(
-        xe::filesystem::ListDirectories(root_path_),
-        std::regex(publisher_id_regex));
-
-    for (const auto& entry : publisher_entries) {
-      title_ids.insert(xe::string_util::from_string<uint32_t>(
-          xe::path_to_utf8(entry.name), true));
+    // Get all publisher entries.
+    for (uint32_t publisher_title_id : GetIndexedTitleIds()) {
+      if ((publisher_title_id >> 16) == (title_id >> 16) &&
+          publisher_title_id != title_id) {
+        title_ids.push_back(publisher_title_id);
+      }
     }
+    std::sort(title_ids.begin(), title_ids.end());
   }
 
-  for (const uint32_t& title_id : title_ids) {
-    // Search path:
-    // content_root/title_id/type_name/*
-    auto package_root = ResolvePackageRoot(content_type, title_id);
-    auto file_infos = xe::filesystem::ListFiles(package_root);
-
-    for (const auto& file_info : file_infos) {
-      if (file_info.type != xe::filesystem::FileInfo::Type::kDirectory) {
-        // Directories only.
-        continue;
-      }
-
-      XCONTENT_AGGREGATE_DATA content_data;
-      if (XSUCCEEDED(ReadContentHeaderFile(
-              xe::path_to_utf8(file_info.name) + ".header", content_type,
-              content_data, title_id))) {
-        result.emplace_back(std::move(content_data));
+  for (uint32_t content_title_id : title_ids) {
+    for (const IndexedContent& content :
+         GetIndexedContent(content_type, content_title_id)) {
+      XCONTENT_AGGREGATE_DATA& content_data = result.emplace_back(content.data);
+      if (content.has_header) {
+        content_data.unk134 = kernel_state_->user_profile(uint32_t(0))->xuid();
       } else {
         content_data.device_id = device_id;
-        content_data.content_type = content_type;
-        content_data.set_display_name(xe::path_to_utf16(file_info.name));
-        content_data.set_file_name(xe::path_to_utf8(file_info.name));
-        content_data.title_id = title_id;
-        result.emplace_back(std::move(content_data));
       }
     }
   }
   return result;
 }
 
+const std::vector<ContentManager::IndexedContent>&
+ContentManager::GetIndexedContent(XContentType content_type,
+                                  uint32_t title_id) {
+  uint64_t key = uint64_t(title_id) << 32 | uint32_t(content_type);
+  auto it = content_index_.find(key);
+  if (it != content_index_.end()) {
+    return it->second;
+  }
+
+  // Search path:
+  // content_root/title_id/type_name/*
+  std::vector<IndexedContent> packages;
+  auto header_root = root_path_ / fmt::format("{:08X}", title_id) /
+                     kGameContentHeaderDirName /
+                     fmt::format("{:08X}", uint32_t(content_type));
+  for (const auto& file_info :
+       xe::filesystem::ListFiles(ResolvePackageRoot(content_type, title_id))) {
+    if (file_info.type != xe::filesystem::FileInfo::Type::kDirectory) {
+      // Directories only.
+      continue;
+    }
+    IndexedContent& package = packages.emplace_back();
+    auto header_name = xe::path_to_utf8(file_info.name) + ".header";
+    package.has_header = XSUCCEEDED(ReadContentHeader(
+        header_root / xe::to_path(header_name), package.data));
+    if (package.has_header) {
+      // It only reads basic info, however importing savefiles
+      // usually requires title_id to be provided
+      // Kinda simple workaround for that, but still assumption
+      package.data.title_id = title_id;
+    } else {
+      package.data.content_type = content_type;
+      package.data.set_display_name(xe::path_to_utf16(file_info.name));
+      package.data.set_file_name(xe::path_to_utf8(file_info.name));
+      package.data.title_id = title_id;
+    }
+  }
+  return content_index_.emplace(key, std::move(packages)).first->second;
+}
+
+const std::vector<uint32_t>& ContentManager::GetIndexedTitleIds() {
+  if (!title_ids_indexed_) {
+    indexed_title_ids_.clear();
+    for (const auto& entry : xe::filesystem::ListDirectories(root_path_)) {
+      uint32_t title_id;
+      if (ParseIdDirectoryName(entry.name, title_id)) {
+        indexed_title_ids_.push_back(title_id);
+      }
+    }
+    title_ids_indexed_ = true;
+  }
+  return indexed_title_ids_;
+}
+
+void ContentManager::InvalidateContentIndex(XContentType content_type,
+                                            uint32_t title_id) {
+  title_id = ResolveTitleId(title_id);
+  std::lock_guard<xe_mutex> lock(content_index_lock_);
+  content_index_.erase(uint64_t(title_id) << 32 | uint32_t(content_type));
+  // The directory of the title may have been created.
+  title_ids_indexed_ = false;
+}
+
+void ContentManager::IndexAllContent() {
+  std::vector<uint32_t> title_ids;
+  {
+    std::lock_guard<xe_mutex> lock(content_index_lock_);
+    title_ids = GetIndexedTitleIds();
+  }
+  for (uint32_t title_id : title_ids) {
+    for (const auto& entry : xe::filesystem::ListDirectories(
+             root_path_ / fmt::format("{:08X}", title_id))) {
+      if (index_thread_cancelled_) {
+        return;
+      }
+      uint32_t content_type;
+      if (!ParseIdDirectoryName(entry.name, content_type)) {
+        // Headers, profile.
+        continue;
+      }
+      std::lock_guard<xe_mutex> lock(content_index_lock_);
+      GetIndexedContent(XContentType(content_type), title_id);
+    }
+  }
+}
+
 std::unique_ptr<ContentPackage> ContentManager::ResolvePackage(
     const std::string_view root_name, const XCONTENT_AGGREGATE_DATA& data,
     const uint32_t disc_number) {
@@ -184,11 +282,41 @@ X_RESULT ContentManager::WriteContentHeaderFile(
     auto file = xe::filesystem::OpenFile(header_path / header_filename, "wb");
     fwrite(data, 1, sizeof(XCONTENT_AGGREGATE_DATA), file);
     fclose(file);
+    InvalidateContentIndex(
+        XContentType(load_and_swap<uint32_t>(&data->content_type)),
+        kernel_state_->title_id());
     return X_STATUS_SUCCESS;
   }
   return X_STATUS_NO_SUCH_FILE;
 }
 
+X_RESULT ContentManager::ReadContentHeader(
+    const std::filesystem::path& header_path, XCONTENT_AGGREGATE_DATA& data) {
+  constexpr uint32_t header_size = sizeof(XCONTENT_AGGREGATE_DATA);
+
+  auto file = xe::filesystem::OpenFile(header_path, "rb");
+  if (!file) {
+    return X_STATUS_NO_SUCH_FILE;
+  }
+
+  std::array<uint8_t, header_size> buffer = {};
+
+  auto file_size = std::filesystem::file_size(header_path);
+  if (file_size != header_size && file_size != sizeof(XCONTENT_DATA)) {
+    fclose(file);
+    return X_STATUS_END_OF_FILE;
+  }
+
+  size_t result = fread(buffer.data(), 1, file_size, file);
+  if (result != file_size) {
+    fclose(file);
+    return X_STATUS_END_OF_FILE;
+  }
+  fclose(file);
+  std::memcpy(&data, buffer.data(), buffer.size());
+  return X_STATUS_SUCCESS;
+}
+
 X_RESULT ContentManager::ReadContentHeaderFile(const std::string_view file_name,
                                                XContentType content_type,
                                                XCONTENT_AGGREGATE_DATA& data,
@@ -202,34 +330,17 @@ X_RESULT ContentManager::ReadContentHeaderFile(const std::string_view file_name,
   auto header_file_path = root_path_ / title_id_str /
                           kGameContentHeaderDirName / content_type_directory /
                           file_name;
-  constexpr uint32_t header_size = sizeof(XCONTENT_AGGREGATE_DATA);
-
-  if (std::filesystem::exists(header_file_path)) {
-    auto file = xe::filesystem::OpenFile(header_file_path, "rb");
 
-    std::array<uint8_t, header_size> buffer;
-
-    auto file_size = std::filesystem::file_size(header_file_path);
-    if (file_size != header_size && file_size != sizeof(XCONTENT_DATA)) {
-      fclose(file);
-      return X_STATUS_END_OF_FILE;
-    }
-
-    size_t result = fread(buffer.data(), 1, file_size, file);
-    if (result != file_size) {
-      fclose(file);
-      return X_STATUS_END_OF_FILE;
-    }
-    fclose(file);
-    std::memcpy(&data, buffer.data(), buffer.size());
-    // It only reads basic info, however importing savefiles
-    // usually requires title_id to be provided
-    // Kinda simple workaround for that, but still assumption
-    data.title_id = title_id;
-    data.unk134 = kernel_state_->user_profile(uint32_t(0))->xuid();
-    return X_STATUS_SUCCESS;
+  X_RESULT result = ReadContentHeader(header_file_path, data);
+  if (XFAILED(result)) {
+    return result;
   }
-  return X_STATUS_NO_SUCH_FILE;
+  // It only reads basic info, however importing savefiles
+  // usually requires title_id to be provided
+  // Kinda simple workaround for that, but still assumption
+  data.title_id = title_id;
+  data.unk134 = kernel_state_->user_profile(uint32_t(0))->xuid();
+  return X_STATUS_SUCCESS;
 }
 
 X_RESULT ContentManager::CreateContent(const std::string_view root_name,
@@ -250,6 +361,7 @@ X_RESULT ContentManager::CreateContent(const std::string_view root_name,
   if (!std::filesystem::create_directories(package_path)) {
     return X_ERROR_ACCESS_DENIED;
   }
+  InvalidateContentIndex(data.content_type, data.title_id);
 
   auto package = ResolvePackage(root_name, data);
   assert_not_null(package);
@@ -321,7 +433,9 @@ X_RESULT ContentManager::SetContentThumbnail(
     const XCONTENT_AGGREGATE_DATA& data, std::vector<uint8_t> buffer) {
   auto global_lock = global_critical_region_.Acquire();
   auto package_path = ResolvePackagePath(data);
-  std::filesystem::create_directories(package_path);
+  if (std::filesystem::create_directories(package_path)) {
+    InvalidateContentIndex(data.content_type, data.title_id);
+  }
   if (std::filesystem::exists(package_path)) {
     auto thumb_path = package_path / kThumbnailFileName;
     auto file = xe::filesystem::OpenFile(thumb_path, "wb");
@@ -343,6 +457,7 @@ X_RESULT ContentManager::DeleteContent(const XCONTENT_AGGREGATE_DATA& data) {
 
   auto package_path = ResolvePackagePath(data);
   if (std::filesystem::remove_all(package_path) > 0) {
+    InvalidateContentIndex(data.content_type, data.title_id);
     return X_ERROR_SUCCESS;
   } else {
     return X_ERROR_FILE_NOT_FOUND;
@@ -10,6 +10,7 @@
 #ifndef XENIA_KERNEL_XAM_CONTENT_MANAGER_H_
 #define XENIA_KERNEL_XAM_CONTENT_MANAGER_H_
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -18,6 +19,7 @@
 #include "xenia/base/memory.h"
 #include "xenia/base/mutex.h"
 #include "xenia/base/string_key.h"
+#include "xenia/base/threading.h"
 #include "xenia/base/string_util.h"
 #include "xenia/xbox.h"
 
@@ -169,16 +171,48 @@ class ContentManager {
   std::filesystem::path ResolveGameUserContentPath();
   bool IsContentOpen(const XCONTENT_AGGREGATE_DATA& data) const;
   void CloseOpenedFilesFromContent(const std::string_view root_name);
+  // Must be called when packages of the title are modified on the host other
+  // than through the content manager.
+  void InvalidateContentIndex(XContentType content_type, uint32_t title_id);
 
  private:
+  struct IndexedContent {
+    XCONTENT_AGGREGATE_DATA data;
+    // Whether the data is from the header file rather than only the name of
+    // the package directory.
+    bool has_header;
+  };
+
+  uint32_t ResolveTitleId(uint32_t title_id) const;
   std::filesystem::path ResolvePackageRoot(XContentType content_type,
                                            uint32_t title_id = -1);
   std::filesystem::path ResolvePackagePath(const XCONTENT_AGGREGATE_DATA& data,
                                            const uint32_t disc_number = -1);
+  static X_RESULT ReadContentHeader(const std::filesystem::path& header_path,
+                                    XCONTENT_AGGREGATE_DATA& data);
+
+  // The content index must be locked by the caller. Package roots and the
+  // root directory are scanned when they're not in the index yet.
+  const std::vector<IndexedContent>& GetIndexedContent(
+      XContentType content_type, uint32_t title_id);
+  const std::vector<uint32_t>& GetIndexedTitleIds();
+  void IndexAllContent();
 
   KernelState* kernel_state_;
   std::filesystem::path root_path_;
 
+  // Packages on the host, so enumeration doesn't need to access the disk.
+  // Entries are removed when the content of the title is modified through the
+  // content manager.
+  xe_mutex content_index_lock_;
+  // Title ID << 32 | content type -> packages.
+  std::unordered_map<uint64_t, std::vector<IndexedContent>> content_index_;
+  std::vector<uint32_t> indexed_title_ids_;
+  bool title_ids_indexed_ = false;
+  // Fills the index after startup.
+  std::unique_ptr<xe::threading::Thread> index_thread_;
+  std::atomic<bool> index_thread_cancelled_{false};
+
   // TODO(benvanik): remove use of global lock, it's bad here!
   xe::global_critical_region global_critical_region_;
   std::unordered_map<string_key, ContentPackage*> open_packages_;
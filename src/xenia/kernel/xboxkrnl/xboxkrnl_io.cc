@@ -7,10 +7,13 @@
  ******************************************************************************
  */
 
+#include <chrono>
+
 #include "xenia/base/logging.h"
 #include "xenia/base/memory.h"
 #include "xenia/base/mutex.h"
 #include "xenia/cpu/processor.h"
+#include "xenia/kernel/file_io_queue.h"
 #include "xenia/kernel/info/file.h"
 #include "xenia/kernel/kernel_state.h"
 #include "xenia/kernel/util/shim_utils.h"
@@ -125,6 +128,60 @@ dword_result_t NtOpenFile_entry(
 }
 DECLARE_XBOXKRNL_EXPORT1(NtOpenFile, kFileSystem, kImplemented);
 
+// Queues the request to the host I/O workers if the file has been opened for
+// asynchronous I/O with an explicit offset. Reads starting at the end of the
+// file are done on the guest thread, so X_STATUS_END_OF_FILE is returned
+// directly.
+static bool SubmitAsyncFileIO(FileIOQueue::RequestType type,
+                              const object_ref<XFile>& file,
+                              const object_ref<XEvent>& ev,
+                              uint32_t apc_routine, uint32_t apc_context,
+                              uint32_t io_status_block_ptr, uint32_t buffer,
+                              uint32_t length, uint64_t byte_offset) {
+  if (file->is_synchronous() || byte_offset == uint64_t(-1) ||
+      byte_offset == uint64_t(-2)) {
+    return false;
+  }
+  if (type != FileIOQueue::RequestType::kWrite &&
+      byte_offset >= file->entry()->size()) {
+    return false;
+  }
+  FileIOQueue::Request request;
+  request.type = type;
+  request.file = file;
+  request.event = ev;
+  // Low bit probably means do not queue to IO ports.
+  request.apc_routine = 0;
+  if ((apc_routine & ~1u) && apc_context) {
+    request.apc_routine = apc_routine & ~1u;
+    request.apc_thread = retain_object(XThread::GetCurrentThread());
+  }
+  request.apc_context = apc_context;
+  request.io_status_block = io_status_block_ptr;
+  request.buffer = buffer;
+  request.length = length;
+  request.byte_offset = byte_offset;
+  // May be completed by the worker at any time after submitting.
+  if (io_status_block_ptr) {
+    auto io_status_block =
+        kernel_memory()->TranslateVirtual<X_IO_STATUS_BLOCK*>(
+            io_status_block_ptr);
+    io_status_block->status = X_STATUS_PENDING;
+    io_status_block->information = 0;
+  }
+  if (ev) {
+    ev->Reset();
+  }
+  return kernel_state()->file_io_queue()->Submit(std::move(request));
+}
+
+static uint64_t GetFileIOLatency(
+    std::chrono::steady_clock::time_point start_time) {
+  return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::steady_clock::now() - start_time)
+                      .count());
+}
+
 dword_result_t NtReadFile_entry(dword_t file_handle, dword_t event_handle,
                                 lpvoid_t apc_routine_ptr, lpvoid_t apc_context,
                                 pointer_t<X_IO_STATUS_BLOCK> io_status_block,
@@ -144,13 +201,23 @@ dword_result_t NtReadFile_entry(dword_t file_handle, dword_t event_handle,
   }
 
   if (XSUCCEEDED(result)) {
-    if (true || file->is_synchronous()) {
+    uint64_t byte_offset =
+        byte_offset_ptr ? static_cast<uint64_t>(*byte_offset_ptr) : -1;
+    if (SubmitAsyncFileIO(FileIOQueue::RequestType::kRead, file, ev,
+                          static_cast<uint32_t>(apc_routine_ptr), apc_context,
+                          io_status_block.guest_address(),
+                          buffer.guest_address(), buffer_length,
+                          byte_offset)) {
+      result = X_STATUS_PENDING;
+    } else {
       // Synchronous.
+      auto start_time = std::chrono::steady_clock::now();
       uint32_t bytes_read = 0;
-      result = file->Read(
-          buffer.guest_address(), buffer_length,
-          byte_offset_ptr ? static_cast<uint64_t>(*byte_offset_ptr) : -1,
-          &bytes_read, apc_context);
+      result = file->Read(buffer.guest_address(), buffer_length, byte_offset,
+                          &bytes_read, apc_context);
+      kernel_state()->file_io_queue()->RecordCompletion(
+          FileIOQueue::RequestType::kRead, bytes_read,
+          GetFileIOLatency(start_time), false);
       if (io_status_block) {
         io_status_block->status = result;
         io_status_block->information = bytes_read;
@@ -174,25 +241,6 @@ dword_result_t NtReadFile_entry(dword_t file_handle, dword_t event_handle,
       // Mark that we should signal the event now. We do this after
       // we have written the info out.
       signal_event = true;
-    } else {
-      // TODO(benvanik): async.
-
-      // X_STATUS_PENDING if not returning immediately.
-      // XFile is waitable and signalled after each async req completes.
-      // reset the input event (->Reset())
-      /*xeNtReadFileState* call_state = new xeNtReadFileState();
-      XAsyncRequest* request = new XAsyncRequest(
-      state, file,
-      (XAsyncRequest::CompletionCallback)xeNtReadFileCompleted,
-      call_state);*/
-      // result = file->Read(buffer.guest_address(), buffer_length, byte_offset,
-      //                     request);
-      if (io_status_block) {
-        io_status_block->status = X_STATUS_PENDING;
-        io_status_block->information = 0;
-      }
-
-      result = X_STATUS_PENDING;
     }
   }
 
@@ -227,13 +275,25 @@ dword_result_t NtReadFileScatter_entry(
   }
 
   if (XSUCCEEDED(result)) {
-    if (true || file->is_synchronous()) {
+    uint64_t byte_offset =
+        byte_offset_ptr ? static_cast<uint64_t>(*byte_offset_ptr) : -1;
+    // TODO: On Windows it might be worth trying to use Win32 ReadFileScatter
+    // here instead of handling it ourselves
+    if (SubmitAsyncFileIO(FileIOQueue::RequestType::kReadScatter, file, ev,
+                          static_cast<uint32_t>(apc_routine_ptr), apc_context,
+                          io_status_block.guest_address(),
+                          segment_array.guest_address(), length,
+                          byte_offset)) {
+      result = X_STATUS_PENDING;
+    } else {
       // Synchronous.
+      auto start_time = std::chrono::steady_clock::now();
       uint32_t bytes_read = 0;
-      result = file->ReadScatter(
-          segment_array.guest_address(), length,
-          byte_offset_ptr ? static_cast<uint64_t>(*byte_offset_ptr) : -1,
-          &bytes_read, apc_context);
+      result = file->ReadScatter(segment_array.guest_address(), length,
+                                 byte_offset, &bytes_read, apc_context);
+      kernel_state()->file_io_queue()->RecordCompletion(
+          FileIOQueue::RequestType::kReadScatter, bytes_read,
+          GetFileIOLatency(start_time), false);
       if (io_status_block) {
         io_status_block->status = result;
         io_status_block->information = bytes_read;
@@ -257,28 +317,6 @@ dword_result_t NtReadFileScatter_entry(
       // Mark that we should signal the event now. We do this after
       // we have written the info out.
       signal_event = true;
-    } else {
-      // TODO(benvanik): async.
-
-      // TODO: On Windows it might be worth trying to use Win32 ReadFileScatter
-      // here instead of handling it ourselves
-
-      // X_STATUS_PENDING if not returning immediately.
-      // XFile is waitable and signalled after each async req completes.
-      // reset the input event (->Reset())
-      /*xeNtReadFileState* call_state = new xeNtReadFileState();
-      XAsyncRequest* request = new XAsyncRequest(
-      state, file,
-      (XAsyncRequest::CompletionCallback)xeNtReadFileCompleted,
-      call_state);*/
-      // result = file->Read(buffer.guest_address(), buffer_length, byte_offset,
-      //                     request);
-      if (io_status_block) {
-        io_status_block->status = X_STATUS_PENDING;
-        io_status_block->information = 0;
-      }
-
-      result = X_STATUS_PENDING;
     }
   }
 
@@ -317,14 +355,23 @@ dword_result_t NtWriteFile_entry(dword_t file_handle, dword_t event_handle,
 
   // Execute write.
   if (XSUCCEEDED(result)) {
-    // TODO(benvanik): async path.
-    if (true || file->is_synchronous()) {
+    uint64_t byte_offset =
+        byte_offset_ptr ? static_cast<uint64_t>(*byte_offset_ptr) : -1;
+    if (SubmitAsyncFileIO(FileIOQueue::RequestType::kWrite, file, ev,
+                          static_cast<uint32_t>(apc_routine), apc_context,
+                          io_status_block.guest_address(),
+                          buffer.guest_address(), buffer_length,
+                          byte_offset)) {
+      result = X_STATUS_PENDING;
+    } else {
       // Synchronous request.
+      auto start_time = std::chrono::steady_clock::now();
       uint32_t bytes_written = 0;
-      result = file->Write(
-          buffer.guest_address(), buffer_length,
-          byte_offset_ptr ? static_cast<uint64_t>(*byte_offset_ptr) : -1,
-          &bytes_written, apc_context);
+      result = file->Write(buffer.guest_address(), buffer_length, byte_offset,
+                           &bytes_written, apc_context);
+      kernel_state()->file_io_queue()->RecordCompletion(
+          FileIOQueue::RequestType::kWrite, bytes_written,
+          GetFileIOLatency(start_time), false);
 
       if (io_status_block) {
         io_status_block->status = result;
@@ -349,14 +396,6 @@ dword_result_t NtWriteFile_entry(dword_t file_handle, dword_t event_handle,
       // Mark that we should signal the event now. We do this after
       // we have written the info out.
       signal_event = true;
-    } else {
-      // X_STATUS_PENDING if not returning immediately.
-      result = X_STATUS_PENDING;
-
-      if (io_status_block) {
-        io_status_block->status = X_STATUS_PENDING;
-        io_status_block->information = 0;
-      }
     }
   }
 
@@ -150,6 +150,12 @@ X_STATUS XFile::Read(uint32_t buffer_guest_address, uint32_t buffer_length,
                   : memory()->TranslateVirtual(buffer_guest_address),
               buffer_length, size_t(byte_offset), &bytes_read);
           if (XSUCCEEDED(result)) {
+            FileAccessTrace* file_access_trace =
+                kernel_state()->file_access_trace();
+            if (file_access_trace->is_recording()) {
+              file_access_trace->RecordRead(file_->entry(), byte_offset,
+                                            bytes_read);
+            }
             if (buffer_physical_heap) {
               buffer_physical_heap->TriggerCallbacks(
                   xe::global_critical_region::AcquireDirect(),
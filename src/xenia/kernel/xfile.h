@@ -10,6 +10,7 @@
 #ifndef XENIA_KERNEL_XFILE_H_
 #define XENIA_KERNEL_XFILE_H_
 
+#include <atomic>
 #include <string>
 
 #include "xenia/kernel/xevent.h"
@@ -195,7 +196,8 @@ class XFile : public XObject {
 
   // TODO(benvanik): create flags, open state, etc.
 
-  uint64_t position_ = 0;
+  // Updated by the asynchronous I/O workers too.
+  std::atomic<uint64_t> position_{0};
 
   xe::filesystem::WildcardEngine find_engine_;
   size_t find_index_ = 0;
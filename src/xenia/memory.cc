@@ -10,10 +10,13 @@
 #include "xenia/memory.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cstring>
+#include <functional>
 #include <utility>
 
 #include "third_party/fmt/include/fmt/format.h"
+#include "third_party/zstd/lib/zstd.h"
 #include "xenia/base/assert.h"
 #include "xenia/base/byte_stream.h"
 #include "xenia/base/clock.h"
@@ -21,6 +24,7 @@
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/base/threading.h"
+#include "xenia/base/xxhash.h"
 
 #include "xenia/cpu/mmio_handler.h"
 
@@ -33,6 +37,18 @@ DEFINE_bool(protect_on_release, false,
             "Protect released memory to prevent accesses.", "Memory");
 DEFINE_bool(scribble_heap, false,
             "Scribble 0xCD into all allocated heap memory.", "Memory");
+DEFINE_int32(save_state_threads, -1,
+             "Number of threads compressing and decompressing memory in save "
+             "states. -1 to use all logical CPU cores.",
+             "Memory");
+DEFINE_int32(save_state_compression_level, 1,
+             "zstd compression level of memory in save states.", "Memory");
+DEFINE_bool(host_write_watch, false,
+            "On Linux 6.7+, detect guest writes to memory used by the GPU with "
+            "write protection resolved by the host kernel (userfaultfd) and "
+            "scanned when the GPU processes new commands, instead of an access "
+            "violation for the first write to each page.",
+            "Memory");
 
 namespace xe {
 uint32_t get_page_count(uint32_t value, uint32_t page_size) {
@@ -158,6 +174,17 @@ bool Memory::Initialize() {
   virtual_membase_ = mapping_base_;
   physical_membase_ = mapping_base_ + 0x100000000ull;
 
+#if XE_PLATFORM_LINUX
+  if (cvars::host_write_watch) {
+    write_watch_ = xe::memory::WriteWatch::Create();
+    if (!write_watch_) {
+      XELOGI(
+          "Host write watch is not supported, detecting writes to memory used "
+          "by the GPU via access violations");
+    }
+  }
+#endif
+
   // Prepare virtual heaps.
   heaps_.v00000000.Initialize(this, virtual_membase_, HeapType::kGuestVirtual,
                               0x00000000, 0x40000000, 4096);
@@ -554,6 +581,17 @@ bool Memory::TriggerPhysicalMemoryCallbacks(
   return false;
 }
 
+void Memory::TriggerPhysicalMemoryWriteWatchCallbacks() {
+#if XE_PLATFORM_LINUX
+  if (!write_watch_) {
+    return;
+  }
+  heaps_.vA0000000.TriggerWriteWatchCallbacks();
+  heaps_.vC0000000.TriggerWriteWatchCallbacks();
+  heaps_.vE0000000.TriggerWriteWatchCallbacks();
+#endif
+}
+
 void* Memory::RegisterPhysicalMemoryInvalidationCallback(
     PhysicalMemoryInvalidationCallback callback, void* callback_context) {
   auto entry = new std::pair<PhysicalMemoryInvalidationCallback, void*>(
@@ -648,26 +686,117 @@ void Memory::DumpMap() {
   XELOGE("");
 }
 
-bool Memory::Save(ByteStream* stream) {
+// Runs the tasks on save_state_threads threads, including the calling one.
+static void RunSaveStateTasks(size_t task_count,
+                              const std::function<void(size_t)>& task) {
+  std::atomic<size_t> next_task_index(0);
+  auto run_tasks = [&]() {
+    size_t task_index;
+    while ((task_index = next_task_index.fetch_add(
+                1, std::memory_order_relaxed)) < task_count) {
+      task(task_index);
+    }
+  };
+  uint32_t logical_processor_count = xe::threading::logical_processor_count();
+  uint32_t thread_count =
+      cvars::save_state_threads < 0
+          ? logical_processor_count
+          : std::min(uint32_t(std::max(cvars::save_state_threads, 1)),
+                     logical_processor_count);
+  thread_count = uint32_t(std::min(size_t(thread_count), task_count));
+  std::vector<std::unique_ptr<xe::threading::Thread>> threads;
+  xe::threading::Thread::CreationParameters thread_params;
+  for (uint32_t i = 1; i < thread_count; ++i) {
+    std::unique_ptr<xe::threading::Thread> thread =
+        xe::threading::Thread::Create(thread_params, run_tasks);
+    if (!thread) {
+      break;
+    }
+    thread->set_name("Save State");
+    threads.push_back(std::move(thread));
+  }
+  run_tasks();
+  for (const std::unique_ptr<xe::threading::Thread>& thread : threads) {
+    xe::threading::Wait(thread.get(), false);
+  }
+}
+
+bool Memory::Save(ByteStream* stream, bool incremental) {
   XELOGD("Serializing memory...");
-  heaps_.v00000000.Save(stream);
-  heaps_.v40000000.Save(stream);
-  heaps_.v80000000.Save(stream);
-  heaps_.v90000000.Save(stream);
-  heaps_.physical.Save(stream);
+  BaseHeap* const heaps[] = {
+      &heaps_.v00000000, &heaps_.v40000000, &heaps_.v80000000,
+      &heaps_.v90000000, &heaps_.physical,
+  };
+  std::vector<std::pair<BaseHeap*, uint32_t>> chunk_heaps;
+  for (BaseHeap* heap : heaps) {
+    if (!heap->Save(stream)) {
+      return false;
+    }
+    for (uint32_t i = 0; i < heap->save_chunk_count(); ++i) {
+      chunk_heaps.emplace_back(heap, i);
+    }
+  }
+
+  std::vector<HeapSaveChunk> chunks(chunk_heaps.size());
+  RunSaveStateTasks(chunks.size(), [&](size_t i) {
+    chunk_heaps[i].first->SaveChunk(chunk_heaps[i].second, incremental,
+                                    chunks[i]);
+  });
+
+  size_t stored_chunk_count = 0;
+  for (const HeapSaveChunk& chunk : chunks) {
+    stream->Write(chunk.hash);
+    stream->Write(chunk.page_mask);
+    stream->Write(chunk.unchanged);
+    stream->Write(uint32_t(chunk.data.size()));
+    stream->Write(chunk.data.data(), chunk.data.size());
+    if (!chunk.data.empty()) {
+      ++stored_chunk_count;
+    }
+  }
+  XELOGD("Stored {} of {} memory chunks", stored_chunk_count, chunks.size());
 
   return true;
 }
 
-bool Memory::Restore(ByteStream* stream) {
+bool Memory::Restore(ByteStream* stream, bool incremental) {
   XELOGD("Restoring memory...");
-  heaps_.v00000000.Restore(stream);
-  heaps_.v40000000.Restore(stream);
-  heaps_.v80000000.Restore(stream);
-  heaps_.v90000000.Restore(stream);
-  heaps_.physical.Restore(stream);
+  BaseHeap* const heaps[] = {
+      &heaps_.v00000000, &heaps_.v40000000, &heaps_.v80000000,
+      &heaps_.v90000000, &heaps_.physical,
+  };
+  std::vector<std::pair<BaseHeap*, uint32_t>> chunk_heaps;
+  for (BaseHeap* heap : heaps) {
+    if (!heap->Restore(stream)) {
+      return false;
+    }
+    for (uint32_t i = 0; i < heap->save_chunk_count(); ++i) {
+      chunk_heaps.emplace_back(heap, i);
+    }
+  }
 
-  return true;
+  std::vector<HeapSaveChunk> chunks(chunk_heaps.size());
+  for (HeapSaveChunk& chunk : chunks) {
+    chunk.hash = stream->Read<uint64_t>();
+    chunk.page_mask = stream->Read<uint64_t>();
+    chunk.unchanged = stream->Read<bool>();
+    chunk.data.resize(stream->Read<uint32_t>());
+    stream->Read(chunk.data.data(), chunk.data.size());
+  }
+
+  std::atomic<bool> chunks_restored(true);
+  RunSaveStateTasks(chunks.size(), [&](size_t i) {
+    if (!chunk_heaps[i].first->RestoreChunk(chunk_heaps[i].second, incremental,
+                                            chunks[i])) {
+      chunks_restored.store(false, std::memory_order_relaxed);
+    }
+  });
+
+  for (BaseHeap* heap : heaps) {
+    heap->RestoreProtection();
+  }
+
+  return chunks_restored.load(std::memory_order_relaxed);
 }
 
 xe::memory::PageAccess ToPageAccess(uint32_t protect) {
@@ -790,75 +919,221 @@ void BaseHeap::DumpMap() {
 bool BaseHeap::Save(ByteStream* stream) {
   XELOGD("Heap {:08X}-{:08X}", heap_base_, heap_base_ + (heap_size_ - 1));
 
-  for (size_t i = 0; i < page_table_.size(); i++) {
-    auto& page = page_table_[i];
-    stream->Write(page.qword);
-    if (!page.state) {
-      // Unallocated.
-      continue;
-    }
-
-    // TODO(DrChat): write compressed with snappy.
-    if (page.state & kMemoryAllocationCommit) {
-      void* addr = TranslateRelative(i * page_size_);
-
-      memory::PageAccess old_access;
-      memory::Protect(addr, page_size_, memory::PageAccess::kReadWrite,
-                      &old_access);
-
-      stream->Write(addr, page_size_);
-
-      memory::Protect(addr, page_size_, old_access, nullptr);
-    }
+  size_t page_table_size = page_table_.size() * sizeof(PageEntry);
+  std::vector<uint8_t> compressed(ZSTD_compressBound(page_table_size));
+  size_t compressed_size =
+      ZSTD_compress(compressed.data(), compressed.size(), page_table_.data(),
+                    page_table_size, cvars::save_state_compression_level);
+  if (ZSTD_isError(compressed_size)) {
+    XELOGE("Failed to compress the page table: {}",
+           ZSTD_getErrorName(compressed_size));
+    return false;
   }
+  stream->Write(uint32_t(page_table_.size()));
+  stream->Write(uint32_t(compressed_size));
+  stream->Write(compressed.data(), compressed_size);
 
+  save_chunk_hashes_.resize(save_chunk_count());
   return true;
 }
 
 bool BaseHeap::Restore(ByteStream* stream) {
   XELOGD("Heap {:08X}-{:08X}", heap_base_, heap_base_ + (heap_size_ - 1));
 
-  for (size_t i = 0; i < page_table_.size(); i++) {
-    auto& page = page_table_[i];
-    page.qword = stream->Read<uint64_t>();
-    if (!page.state) {
-      // Unallocated.
+  if (stream->Read<uint32_t>() != page_table_.size()) {
+    XELOGE("Saved page count of the heap doesn't match");
+    return false;
+  }
+  std::vector<uint8_t> compressed(stream->Read<uint32_t>());
+  stream->Read(compressed.data(), compressed.size());
+  size_t page_table_size = page_table_.size() * sizeof(PageEntry);
+  size_t decompressed_size =
+      ZSTD_decompress(page_table_.data(), page_table_size, compressed.data(),
+                      compressed.size());
+  if (ZSTD_isError(decompressed_size) ||
+      decompressed_size != page_table_size) {
+    XELOGE("Failed to decompress the page table");
+    return false;
+  }
+
+  // Commit the memory if it isn't already, in runs of committed pages. We do
+  // not need to reserve any memory, as the mapping has already taken care of
+  // that. The pages are writable until RestoreProtection.
+  unreserved_page_count_ = 0;
+  uint32_t commit_run_start = 0;
+  uint32_t commit_run_length = 0;
+  for (uint32_t i = 0; i <= uint32_t(page_table_.size()); ++i) {
+    bool committed = i < page_table_.size() &&
+                     (page_table_[i].state & kMemoryAllocationCommit);
+    if (committed) {
+      if (!commit_run_length) {
+        commit_run_start = i;
+      }
+      ++commit_run_length;
       continue;
     }
-
-    memory::PageAccess page_access = memory::PageAccess::kNoAccess;
-    if ((page.current_protect & kMemoryProtectRead) &&
-        (page.current_protect & kMemoryProtectWrite)) {
-      page_access = memory::PageAccess::kReadWrite;
-    } else if (page.current_protect & kMemoryProtectRead) {
-      page_access = memory::PageAccess::kReadOnly;
+    if (i < page_table_.size() && !page_table_[i].state) {
+      ++unreserved_page_count_;
     }
-
-    // Commit the memory if it isn't already. We do not need to reserve any
-    // memory, as the mapping has already taken care of that.
-    if (page.state & kMemoryAllocationCommit) {
-      xe::memory::AllocFixed(TranslateRelative(i * page_size_), page_size_,
+    if (commit_run_length) {
+      xe::memory::AllocFixed(TranslateRelative(commit_run_start * page_size_),
+                             commit_run_length * page_size_,
                              memory::AllocationType::kCommit,
                              memory::PageAccess::kReadWrite);
+      commit_run_length = 0;
     }
+  }
 
-    // Now read into memory. We'll set R/W protection first, then set the
-    // protection back to its previous state.
-    // TODO(DrChat): read compressed with snappy.
-    if (page.state & kMemoryAllocationCommit) {
-      void* addr = TranslateRelative(i * page_size_);
-      xe::memory::Protect(addr, page_size_, memory::PageAccess::kReadWrite,
-                          nullptr);
+  save_chunk_hashes_.resize(save_chunk_count());
+  return true;
+}
+
+static bool IsZeroPage(const uint8_t* data, uint32_t size) {
+  auto data_qwords = reinterpret_cast<const uint64_t*>(data);
+  uint64_t bits = 0;
+  for (uint32_t i = 0; i < size / sizeof(uint64_t); ++i) {
+    bits |= data_qwords[i];
+  }
+  return !bits;
+}
+
+void BaseHeap::SaveChunk(uint32_t chunk_index, bool incremental,
+                         HeapSaveChunk& chunk) {
+  uint32_t first_page = chunk_index * HeapSaveChunk::kPageCount;
+  uint32_t page_count = std::min(HeapSaveChunk::kPageCount,
+                                 uint32_t(page_table_.size()) - first_page);
+
+  // Calls the function with the host pointer to each committed page, making it
+  // readable for the duration of the call if needed.
+  auto for_each_committed_page = [&](auto function) {
+    for (uint32_t i = 0; i < page_count; ++i) {
+      const PageEntry& page = page_table_[first_page + i];
+      if (!(page.state & kMemoryAllocationCommit)) {
+        continue;
+      }
+      uint8_t* page_data =
+          TranslateRelative(size_t(first_page + i) * page_size_);
+      bool readable = (page.current_protect & kMemoryProtectRead) != 0;
+      if (!readable) {
+        xe::memory::Protect(page_data, page_size_,
+                            memory::PageAccess::kReadOnly);
+      }
+      function(i, page_data);
+      if (!readable) {
+        xe::memory::Protect(page_data, page_size_,
+                            ToPageAccess(page.current_protect));
+      }
+    }
+  };
+
+  XXH3_state_t hash_state;
+  XXH3_64bits_reset(&hash_state);
+  XXH3_64bits_update(&hash_state, &page_table_[first_page],
+                     sizeof(PageEntry) * page_count);
+  chunk.page_mask = 0;
+  for_each_committed_page([&](uint32_t i, const uint8_t* page_data) {
+    if (!IsZeroPage(page_data, page_size_)) {
+      chunk.page_mask |= uint64_t(1) << i;
+      XXH3_64bits_update(&hash_state, page_data, page_size_);
+    }
+  });
+  XXH3_64bits_update(&hash_state, &chunk.page_mask, sizeof(chunk.page_mask));
+  chunk.hash = XXH3_64bits_digest(&hash_state);
+
+  chunk.unchanged =
+      incremental && save_chunk_hashes_[chunk_index] == chunk.hash;
+  if (!incremental) {
+    save_chunk_hashes_[chunk_index] = chunk.hash;
+  }
+  chunk.data.clear();
+  if (chunk.unchanged || !chunk.page_mask) {
+    return;
+  }
+
+  std::vector<uint8_t> pages;
+  pages.reserve(size_t(xe::bit_count(chunk.page_mask)) * page_size_);
+  for_each_committed_page([&](uint32_t i, const uint8_t* page_data) {
+    if (chunk.page_mask & (uint64_t(1) << i)) {
+      pages.insert(pages.end(), page_data, page_data + page_size_);
+    }
+  });
+  chunk.data.resize(ZSTD_compressBound(pages.size()));
+  size_t compressed_size =
+      ZSTD_compress(chunk.data.data(), chunk.data.size(), pages.data(),
+                    pages.size(), cvars::save_state_compression_level);
+  if (ZSTD_isError(compressed_size)) {
+    // Only possible with invalid parameters.
+    assert_always();
+    compressed_size = 0;
+  }
+  chunk.data.resize(compressed_size);
+}
 
-      stream->Read(addr, page_size_);
+bool BaseHeap::RestoreChunk(uint32_t chunk_index, bool incremental,
+                            const HeapSaveChunk& chunk) {
+  if (!incremental) {
+    save_chunk_hashes_[chunk_index] = chunk.hash;
+  }
+  if (chunk.unchanged) {
+    // Already restored from the base save.
+    return true;
+  }
 
-      xe::memory::Protect(addr, page_size_, page_access, nullptr);
+  uint32_t first_page = chunk_index * HeapSaveChunk::kPageCount;
+  uint32_t page_count = std::min(HeapSaveChunk::kPageCount,
+                                 uint32_t(page_table_.size()) - first_page);
+  std::vector<uint8_t> pages(size_t(xe::bit_count(chunk.page_mask)) *
+                             page_size_);
+  if (!pages.empty()) {
+    size_t decompressed_size = ZSTD_decompress(
+        pages.data(), pages.size(), chunk.data.data(), chunk.data.size());
+    if (ZSTD_isError(decompressed_size) || decompressed_size != pages.size()) {
+      XELOGE("Failed to decompress the pages of heap {:08X} at {:08X}",
+             heap_base_, heap_base_ + first_page * page_size_);
+      return false;
     }
   }
 
+  const uint8_t* page_source = pages.data();
+  for (uint32_t i = 0; i < page_count; ++i) {
+    if (!(page_table_[first_page + i].state & kMemoryAllocationCommit)) {
+      continue;
+    }
+    uint8_t* page_data = TranslateRelative(size_t(first_page + i) * page_size_);
+    if (chunk.page_mask & (uint64_t(1) << i)) {
+      std::memcpy(page_data, page_source, page_size_);
+      page_source += page_size_;
+    } else if (!IsZeroPage(page_data, page_size_)) {
+      // Don't touch the pages that are already zero, so they stay unbacked.
+      std::memset(page_data, 0, page_size_);
+    }
+  }
   return true;
 }
 
+void BaseHeap::RestoreProtection() {
+  // Restore made all committed pages writable, protect runs of pages with the
+  // same access.
+  uint32_t run_start = 0;
+  memory::PageAccess run_access = memory::PageAccess::kReadWrite;
+  for (uint32_t i = 0; i <= uint32_t(page_table_.size()); ++i) {
+    memory::PageAccess page_access = memory::PageAccess::kReadWrite;
+    if (i < page_table_.size() &&
+        (page_table_[i].state & kMemoryAllocationCommit)) {
+      page_access = ToPageAccess(page_table_[i].current_protect);
+    }
+    if (i < page_table_.size() && page_access == run_access) {
+      continue;
+    }
+    if (run_access != memory::PageAccess::kReadWrite) {
+      xe::memory::Protect(TranslateRelative(run_start * page_size_),
+                          (i - run_start) * page_size_, run_access);
+    }
+    run_start = i;
+    run_access = page_access;
+  }
+}
+
 void BaseHeap::Reset() {
   // TODO(DrChat): protect pages.
   std::memset(page_table_.data(), 0, sizeof(PageEntry) * page_table_.size());
@@ -1725,7 +2000,6 @@ template <bool enable_invalidation_notifications>
 XE_NOINLINE void PhysicalHeap::EnableAccessCallbacksInner(
     const uint32_t system_page_first, const uint32_t system_page_last,
     xe::memory::PageAccess protect_access) XE_RESTRICT {
-  uint8_t* protect_base = membase_ + heap_base_;
   uint32_t protect_system_page_first = UINT32_MAX;
 
   SystemPageFlagsBlock* XE_RESTRICT sys_page_flags = system_page_flags_.data();
@@ -1800,26 +2074,101 @@ XE_NOINLINE void PhysicalHeap::EnableAccessCallbacksInner(
       }
     } else {
       if (protect_system_page_first != UINT32_MAX) {
-        xe::memory::Protect(
-            protect_base + (protect_system_page_first << system_page_shift_),
-            (i - protect_system_page_first) << system_page_shift_,
-            protect_access);
+        ProtectForAccessCallbacks(protect_system_page_first,
+                                  i - protect_system_page_first,
+                                  protect_access);
         protect_system_page_first = UINT32_MAX;
       }
     }
   }
 
   if (protect_system_page_first != UINT32_MAX) {
-    xe::memory::Protect(
-        protect_base + (protect_system_page_first << system_page_shift_),
-        (system_page_last + 1 - protect_system_page_first)
+    ProtectForAccessCallbacks(protect_system_page_first,
+                              system_page_last + 1 - protect_system_page_first,
+                              protect_access);
+  }
+}
+
+void PhysicalHeap::ProtectForAccessCallbacks(
+    uint32_t system_page_first, uint32_t system_page_count,
+    xe::memory::PageAccess protect_access) {
+  uint8_t* protect_address =
+      membase_ + heap_base_ + (system_page_first << system_page_shift_);
+  size_t protect_length = size_t(system_page_count) << system_page_shift_;
+#if XE_PLATFORM_LINUX
+  // Only write watches are possible without protection.
+  if (memory_->write_watch_ &&
+      protect_access == xe::memory::PageAccess::kReadOnly &&
+      memory_->write_watch_->Watch(protect_address, protect_length)) {
+    return;
+  }
+#endif
+  xe::memory::Protect(protect_address, protect_length, protect_access);
+}
+
+void PhysicalHeap::TriggerWriteWatchCallbacks() {
+#if XE_PLATFORM_LINUX
+  xe::memory::WriteWatch* write_watch = memory_->write_watch_.get();
+  if (!write_watch) {
+    return;
+  }
+  auto global_lock = global_critical_region_.Acquire();
+  std::vector<std::pair<uintptr_t, size_t>>& written_ranges =
+      memory_->write_watch_ranges_;
+  written_ranges.clear();
+  // Only scanning the runs of 64-page blocks containing watched pages.
+  uint8_t* heap_host_base = membase_ + heap_base_;
+  uint32_t block_count = uint32_t(system_page_flags_.size());
+  uint32_t block_index = 0;
+  while (block_index < block_count) {
+    if (!system_page_flags_[block_index].notify_on_invalidation) {
+      ++block_index;
+      continue;
+    }
+    uint32_t run_block_first = block_index;
+    while (block_index < block_count &&
+           system_page_flags_[block_index].notify_on_invalidation) {
+      ++block_index;
+    }
+    uint32_t run_system_page_first = run_block_first << 6;
+    uint32_t run_system_page_end =
+        std::min(block_index << 6, system_page_count_);
+    write_watch->GetWrittenRanges(
+        heap_host_base + (run_system_page_first << system_page_shift_),
+        size_t(run_system_page_end - run_system_page_first)
             << system_page_shift_,
-        protect_access);
+        written_ranges);
+  }
+  // Pages that aren't watched are skipped by TriggerCallbacksLocked.
+  for (const std::pair<uintptr_t, size_t>& written_range : written_ranges) {
+    uint32_t host_offset_first = uint32_t(
+        written_range.first - reinterpret_cast<uintptr_t>(heap_host_base));
+    uint32_t host_offset_end =
+        host_offset_first + uint32_t(written_range.second);
+    if (host_offset_end <= host_address_offset()) {
+      continue;
+    }
+    uint32_t heap_relative_first =
+        xe::sat_sub(host_offset_first, host_address_offset());
+    TriggerCallbacksLocked(
+        heap_base_ + heap_relative_first,
+        host_offset_end - host_address_offset() - heap_relative_first, true,
+        false, true);
   }
+#endif
 }
+
 bool PhysicalHeap::TriggerCallbacks(
     global_unique_lock_type global_lock_locked_once, uint32_t virtual_address,
     uint32_t length, bool is_write, bool unwatch_exact_range, bool unprotect) {
+  return TriggerCallbacksLocked(virtual_address, length, is_write,
+                                unwatch_exact_range, unprotect);
+}
+
+bool PhysicalHeap::TriggerCallbacksLocked(uint32_t virtual_address,
+                                          uint32_t length, bool is_write,
+                                          bool unwatch_exact_range,
+                                          bool unprotect) {
   // TODO(Triang3l): Support read watches.
   assert_true(is_write);
   if (!is_write) {
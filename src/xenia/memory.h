@@ -98,6 +98,23 @@ union PageEntry {
   };
 };
 
+// Contents of a range of pages of a heap in a save state. The pages of the
+// heaps are saved in chunks compressed independently, so they can be processed
+// on multiple threads.
+struct HeapSaveChunk {
+  static constexpr uint32_t kPageCount = 64;
+
+  // Hash of the page table entries and of the stored pages.
+  uint64_t hash;
+  // Pages stored in data - committed pages not filled with zeros.
+  uint64_t page_mask;
+  // In incremental saves, the contents are not stored if the chunk is
+  // identical to the one in the base save.
+  bool unchanged;
+  // Stored pages compressed with zstd.
+  std::vector<uint8_t> data;
+};
+
 // Heap abstraction for page-based allocation.
 class BaseHeap {
  public:
@@ -198,8 +215,21 @@ class BaseHeap {
   xe::memory::PageAccess QueryRangeAccess(uint32_t low_address,
                                           uint32_t high_address);
 
+  // Saves and restores the page table. The contents of the pages are saved and
+  // restored separately in chunks, and the page protection is applied after
+  // all of them have been restored.
   bool Save(ByteStream* stream);
   bool Restore(ByteStream* stream);
+  uint32_t save_chunk_count() const {
+    return uint32_t((page_table_.size() + HeapSaveChunk::kPageCount - 1) /
+                    HeapSaveChunk::kPageCount);
+  }
+  // Thread-safe for different chunks. Full saves and restores become the base
+  // of subsequent incremental saves.
+  void SaveChunk(uint32_t chunk_index, bool incremental, HeapSaveChunk& chunk);
+  bool RestoreChunk(uint32_t chunk_index, bool incremental,
+                    const HeapSaveChunk& chunk);
+  void RestoreProtection();
 
   void Reset();
 
@@ -221,6 +251,8 @@ class BaseHeap {
   uint32_t unreserved_page_count_;
   xe::global_critical_region global_critical_region_;
   std::vector<PageEntry> page_table_;
+  // HeapSaveChunk::hash of each chunk in the last full save or restore.
+  std::vector<uint64_t> save_chunk_hashes_;
 };
 
 // Normal heap allowing allocations from guest virtual address ranges.
@@ -282,6 +314,10 @@ class PhysicalHeap : public BaseHeap {
                         bool is_write, bool unwatch_exact_range,
                         bool unprotect = true);
 
+  // Triggers callbacks for the watched pages written since the last call, if
+  // writes are tracked by the host kernel rather than via access violations.
+  void TriggerWriteWatchCallbacks();
+
   uint32_t GetPhysicalAddress(uint32_t address) const;
 
   uint32_t SystemPagenumToGuestPagenum(uint32_t num) const {
@@ -297,6 +333,16 @@ class PhysicalHeap : public BaseHeap {
   }
 
  protected:
+  // Makes writes to the pages trigger callbacks - with the host write watch if
+  // possible, or by protecting them otherwise.
+  void ProtectForAccessCallbacks(uint32_t system_page_first,
+                                 uint32_t system_page_count,
+                                 xe::memory::PageAccess protect_access);
+  // Called with the global critical region locked.
+  bool TriggerCallbacksLocked(uint32_t virtual_address, uint32_t length,
+                              bool is_write, bool unwatch_exact_range,
+                              bool unprotect);
+
   VirtualHeap* parent_heap_;
 
   uint32_t system_page_size_;
@@ -503,6 +549,12 @@ class Memory {
       uint32_t length, bool is_write, bool unwatch_exact_range,
       bool unprotect = true);
 
+  // With the host write watch (host_write_watch), guest writes to watched
+  // physical memory don't cause access violations, and are only detected when
+  // this is called. Must be called before using the data in the watched ranges,
+  // such as when the GPU starts executing newly submitted commands.
+  void TriggerPhysicalMemoryWriteWatchCallbacks();
+
   // Allocates virtual memory from the 'system' heap.
   // System memory is kept separate from game memory but is still accessible
   // using normal guest virtual addresses. Kernel structures and other internal
@@ -536,8 +588,10 @@ class Memory {
   // Dumps a map of all allocated memory to the log.
   void DumpMap();
 
-  bool Save(ByteStream* stream);
-  bool Restore(ByteStream* stream);
+  // Incremental saves only contain the chunks of pages that have changed since
+  // the last full save or restore, and must be restored on top of it.
+  bool Save(ByteStream* stream, bool incremental = false);
+  bool Restore(ByteStream* stream, bool incremental = false);
 
   void SetMMIOExceptionRecordingCallback(cpu::MmioAccessRecordCallback callback,
                                          void* context);
@@ -581,6 +635,14 @@ class Memory {
 
   std::unique_ptr<cpu::MMIOHandler> mmio_handler_;
 
+#if XE_PLATFORM_LINUX
+  // Null if writes to watched physical memory are detected via access
+  // violations.
+  std::unique_ptr<xe::memory::WriteWatch> write_watch_;
+  // Protected by global_critical_region_.
+  std::vector<std::pair<uintptr_t, size_t>> write_watch_ranges_;
+#endif
+
   struct {
     VirtualHeap v00000000;
     VirtualHeap v40000000;
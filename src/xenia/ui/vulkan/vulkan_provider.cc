@@ -870,9 +870,14 @@ void VulkanProvider::TryCreateDevice() {
 
   XELOGVK("Requested properties and features of the Vulkan device:");
 
+  device_info_.driverVersion = properties.driverVersion;
   XELOGVK("* driverVersion: 0x{:X}", properties.driverVersion);
+  device_info_.vendorID = properties.vendorID;
   XELOGVK("* vendorID: 0x{:04X}", properties.vendorID);
+  device_info_.deviceID = properties.deviceID;
   XELOGVK("* deviceID: 0x{:04X}", properties.deviceID);
+  std::memcpy(device_info_.pipelineCacheUUID, properties.pipelineCacheUUID,
+              sizeof(device_info_.pipelineCacheUUID));
 
 #define LIMIT(name)                           \
   device_info_.name = properties.limits.name; \
@@ -922,6 +927,7 @@ void VulkanProvider::TryCreateDevice() {
   LIMIT_SAMPLE_COUNTS(sampledImageIntegerSampleCounts)
   LIMIT_SAMPLE_COUNTS(sampledImageDepthSampleCounts)
   LIMIT_SAMPLE_COUNTS(sampledImageStencilSampleCounts)
+  LIMIT(timestampPeriod)
   LIMIT(standardSampleLocations)
   LIMIT(optimalBufferCopyOffsetAlignment)
   LIMIT(optimalBufferCopyRowPitchAlignment)
@@ -1168,6 +1174,11 @@ void VulkanProvider::TryCreateDevice() {
 
   queue_families_.clear();
   queue_families_.resize(queue_family_count);
+  for (uint32_t queue_family_index = 0; queue_family_index < queue_family_count;
+       ++queue_family_index) {
+    queue_families_[queue_family_index].timestamp_valid_bits =
+        queue_families_properties[queue_family_index].timestampValidBits;
+  }
 
   queue_family_graphics_compute_ = UINT32_MAX;
   queue_family_sparse_binding_ = UINT32_MAX;
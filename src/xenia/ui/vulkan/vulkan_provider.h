@@ -73,6 +73,10 @@ class VulkanProvider : public GraphicsProvider {
     uint32_t memory_types_host_cached;
 
     uint32_t apiVersion;
+    uint32_t driverVersion;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
     uint32_t maxImageDimension2D;
     uint32_t maxImageDimension3D;
     uint32_t maxImageDimensionCube;
@@ -105,6 +109,7 @@ class VulkanProvider : public GraphicsProvider {
     VkSampleCountFlags sampledImageIntegerSampleCounts;
     VkSampleCountFlags sampledImageDepthSampleCounts;
     VkSampleCountFlags sampledImageStencilSampleCounts;
+    float timestampPeriod;
     VkSampleCountFlags standardSampleLocations;
     VkDeviceSize optimalBufferCopyOffsetAlignment;
     VkDeviceSize optimalBufferCopyRowPitchAlignment;
@@ -285,6 +290,8 @@ class VulkanProvider : public GraphicsProvider {
     uint32_t queue_first_index = 0;
     uint32_t queue_count = 0;
     bool potentially_supports_present = false;
+    // 0 if timestamp queries are not supported.
+    uint32_t timestamp_valid_bits = 0;
   };
   const std::vector<QueueFamily>& queue_families() const {
     return queue_families_;
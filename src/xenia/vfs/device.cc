@@ -10,6 +10,7 @@
 #include "xenia/vfs/device.h"
 
 #include "xenia/base/logging.h"
+#include "xenia/base/string.h"
 
 namespace xe {
 namespace vfs {
@@ -17,5 +18,36 @@ namespace vfs {
 Device::Device(const std::string_view mount_path) : mount_path_(mount_path) {}
 Device::~Device() = default;
 
+Entry* Device::ResolvePathCached(const std::string_view path) {
+  size_t path_hash = xe::utf8::hash_fnv1a_case(path);
+  uint64_t path_cache_generation;
+  {
+    std::lock_guard<xe_mutex> lock(path_cache_lock_);
+    auto it = path_cache_.find(path_hash);
+    if (it != path_cache_.end() &&
+        xe::utf8::equal_case(it->second.path, path)) {
+      return it->second.entry;
+    }
+    path_cache_generation = path_cache_generation_;
+  }
+  Entry* entry = ResolvePath(path);
+  if (entry) {
+    std::lock_guard<xe_mutex> lock(path_cache_lock_);
+    if (path_cache_generation == path_cache_generation_) {
+      if (path_cache_.size() >= kMaxCachedPaths) {
+        path_cache_.clear();
+      }
+      path_cache_[path_hash] = {std::string(path), entry};
+    }
+  }
+  return entry;
+}
+
+void Device::InvalidatePathCache() {
+  std::lock_guard<xe_mutex> lock(path_cache_lock_);
+  path_cache_.clear();
+  ++path_cache_generation_;
+}
+
 }  // namespace vfs
 }  // namespace xe
@@ -12,6 +12,7 @@
 
 #include <memory>
 #include <string>
+#include <unordered_map>
 
 #include "xenia/base/mutex.h"
 #include "xenia/base/string_buffer.h"
@@ -32,6 +33,13 @@ class Device {
 
   virtual void Dump(StringBuffer* string_buffer) = 0;
   virtual Entry* ResolvePath(const std::string_view path) = 0;
+  // ResolvePath through the cache of previously resolved paths.
+  Entry* ResolvePathCached(const std::string_view path);
+  // Must be called when entries are created, deleted or renamed.
+  void InvalidatePathCache();
+  // Releases the entries retired by deletion and renaming, see
+  // Entry::ReclaimRetired for when it may be called.
+  virtual void ReclaimRetiredEntries() {}
 
   virtual const std::string& name() const = 0;
   virtual uint32_t attributes() const = 0;
@@ -45,6 +53,19 @@ class Device {
  protected:
   xe::global_critical_region global_critical_region_;
   std::string mount_path_;
+
+ private:
+  struct CachedPath {
+    std::string path;
+    Entry* entry;
+  };
+  static constexpr size_t kMaxCachedPaths = 4096;
+
+  xe_mutex path_cache_lock_;
+  // Case-insensitive hash of the path -> the last path resolved with it.
+  std::unordered_map<size_t, CachedPath> path_cache_;
+  // Incremented on invalidation, so paths resolved before it aren't cached.
+  uint64_t path_cache_generation_ = 0;
 };
 
 }  // namespace vfs
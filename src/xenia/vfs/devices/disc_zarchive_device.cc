@@ -9,6 +9,10 @@
 
 #include "xenia/vfs/devices/disc_zarchive_device.h"
 
+#include <algorithm>
+#include <cstring>
+
+#include "xenia/base/cvar.h"
 #include "xenia/base/literals.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
@@ -16,6 +20,15 @@
 
 #include "third_party/zarchive/include/zarchive/zarchivereader.h"
 
+DEFINE_int32(zarchive_cache_size, 64,
+             "Size of the cache of decompressed ZArchive disc image data in "
+             "MiB (0 to disable).",
+             "Storage");
+DEFINE_int32(zarchive_read_ahead, 8,
+             "Number of 64 KiB chunks of ZArchive disc image files to "
+             "decompress ahead of sequential reads (0 to disable).",
+             "Storage");
+
 namespace xe {
 namespace vfs {
 
@@ -23,7 +36,16 @@ DiscZarchiveDevice::DiscZarchiveDevice(const std::string_view mount_path,
                                        const std::filesystem::path& host_path)
     : Device(mount_path), name_("GDFX"), host_path_(host_path), reader_() {}
 
-DiscZarchiveDevice::~DiscZarchiveDevice() {};
+DiscZarchiveDevice::~DiscZarchiveDevice() {
+  if (read_ahead_thread_) {
+    {
+      std::lock_guard<xe_mutex> lock(read_ahead_lock_);
+      read_ahead_shutdown_ = true;
+    }
+    read_ahead_cond_.notify_all();
+    xe::threading::Wait(read_ahead_thread_.get(), false);
+  }
+}
 
 bool DiscZarchiveDevice::Initialize() {
   reader_ =
@@ -43,6 +65,19 @@ bool DiscZarchiveDevice::Initialize() {
   root_entry->absolute_path_ = root_path;
   root_entry_ = std::unique_ptr<Entry>(root_entry);
 
+  max_cached_chunks_ =
+      size_t(std::max(cvars::zarchive_cache_size, int32_t(0))) *
+      (1024 * 1024 / kChunkSize);
+  if (max_cached_chunks_ && cvars::zarchive_read_ahead > 0) {
+    xe::threading::Thread::CreationParameters thread_params;
+    thread_params.create_suspended = false;
+    read_ahead_thread_ = xe::threading::Thread::Create(
+        thread_params, [this]() { ReadAheadThreadMain(); });
+    if (read_ahead_thread_) {
+      read_ahead_thread_->set_name("ZArchive Read Ahead");
+    }
+  }
+
   return ReadAllEntries("", root_entry, nullptr);
 }
 
@@ -69,6 +104,141 @@ Entry* DiscZarchiveDevice::ResolvePath(const std::string_view path) {
   return root_entry_->ResolvePath(path);
 }
 
+size_t DiscZarchiveDevice::ReadFile(uint32_t handle, uint64_t file_size,
+                                    uint64_t offset, size_t length,
+                                    void* buffer, bool sequential) {
+  if (offset >= file_size) {
+    return 0;
+  }
+  length = size_t(std::min(uint64_t(length), file_size - offset));
+  if (!max_cached_chunks_ || length > kMaxCachedReadLength) {
+    std::lock_guard<xe_mutex> lock(reader_lock_);
+    return size_t(reader_->ReadFromFile(handle, offset, length, buffer));
+  }
+
+  uint64_t first_chunk_index = offset >> kChunkSizeLog2;
+  uint64_t last_chunk_index = (offset + length - 1) >> kChunkSizeLog2;
+  size_t bytes_read = 0;
+  for (uint64_t chunk_index = first_chunk_index;
+       chunk_index <= last_chunk_index; ++chunk_index) {
+    auto chunk = GetChunk(handle, file_size, chunk_index);
+    if (!chunk) {
+      break;
+    }
+    uint64_t chunk_offset = chunk_index << kChunkSizeLog2;
+    size_t copy_offset = size_t(offset + bytes_read - chunk_offset);
+    if (copy_offset >= chunk->data.size()) {
+      break;
+    }
+    size_t copy_length =
+        std::min(length - bytes_read, chunk->data.size() - copy_offset);
+    std::memcpy(static_cast<uint8_t*>(buffer) + bytes_read,
+                chunk->data.data() + copy_offset, copy_length);
+    bytes_read += copy_length;
+  }
+
+  if (sequential && read_ahead_thread_) {
+    uint64_t chunk_count = (file_size + kChunkSize - 1) >> kChunkSizeLog2;
+    uint64_t read_ahead_end =
+        std::min(last_chunk_index + 1 + uint64_t(cvars::zarchive_read_ahead),
+                 chunk_count);
+    bool queued = false;
+    {
+      std::lock_guard<xe_mutex> lock(read_ahead_lock_);
+      for (uint64_t chunk_index = last_chunk_index + 1;
+           chunk_index < read_ahead_end; ++chunk_index) {
+        // Don't let read-ahead fall behind too much if multiple files are
+        // streamed at once.
+        if (read_ahead_queue_.size() >= max_cached_chunks_ / 2) {
+          break;
+        }
+        if (LookupChunk(GetChunkKey(handle, chunk_index))) {
+          continue;
+        }
+        read_ahead_queue_.push_back({handle, file_size, chunk_index});
+        queued = true;
+      }
+    }
+    if (queued) {
+      read_ahead_cond_.notify_one();
+    }
+  }
+
+  return bytes_read;
+}
+
+std::shared_ptr<const DiscZarchiveDevice::Chunk>
+DiscZarchiveDevice::LookupChunk(uint64_t key) {
+  std::lock_guard<xe_mutex> lock(chunk_cache_lock_);
+  auto it = chunk_cache_.find(key);
+  if (it == chunk_cache_.end()) {
+    return nullptr;
+  }
+  // Move to the front of the LRU.
+  chunk_lru_.splice(chunk_lru_.begin(), chunk_lru_, it->second);
+  return *it->second;
+}
+
+std::shared_ptr<const DiscZarchiveDevice::Chunk> DiscZarchiveDevice::GetChunk(
+    uint32_t handle, uint64_t file_size, uint64_t chunk_index) {
+  uint64_t key = GetChunkKey(handle, chunk_index);
+  auto chunk = LookupChunk(key);
+  if (chunk) {
+    return chunk;
+  }
+
+  uint64_t chunk_offset = chunk_index << kChunkSizeLog2;
+  if (chunk_offset >= file_size) {
+    return nullptr;
+  }
+  auto new_chunk = std::make_shared<Chunk>();
+  new_chunk->key = key;
+  new_chunk->data.resize(
+      size_t(std::min(uint64_t(kChunkSize), file_size - chunk_offset)));
+  uint64_t bytes_read;
+  {
+    std::lock_guard<xe_mutex> lock(reader_lock_);
+    bytes_read = reader_->ReadFromFile(handle, chunk_offset,
+                                       new_chunk->data.size(),
+                                       new_chunk->data.data());
+  }
+  if (bytes_read != new_chunk->data.size()) {
+    return nullptr;
+  }
+
+  std::lock_guard<xe_mutex> lock(chunk_cache_lock_);
+  auto it = chunk_cache_.find(key);
+  if (it != chunk_cache_.end()) {
+    // Decompressed on another thread at the same time.
+    return *it->second;
+  }
+  chunk_lru_.push_front(new_chunk);
+  chunk_cache_.emplace(key, chunk_lru_.begin());
+  while (chunk_lru_.size() > max_cached_chunks_) {
+    chunk_cache_.erase(chunk_lru_.back()->key);
+    chunk_lru_.pop_back();
+  }
+  return new_chunk;
+}
+
+void DiscZarchiveDevice::ReadAheadThreadMain() {
+  while (true) {
+    ReadAheadRequest request;
+    {
+      std::unique_lock<xe_mutex> lock(read_ahead_lock_);
+      read_ahead_cond_.wait(lock, [this]() {
+        return read_ahead_shutdown_ || !read_ahead_queue_.empty();
+      });
+      if (read_ahead_shutdown_) {
+        return;
+      }
+      request = read_ahead_queue_.front();
+      read_ahead_queue_.pop_front();
+    }
+    GetChunk(request.handle, request.file_size, request.chunk_index);
+  }
+}
+
 bool DiscZarchiveDevice::ReadAllEntries(const std::string& path,
                                         DiscZarchiveEntry* node,
                                         DiscZarchiveEntry* parent) {
@@ -83,7 +253,7 @@ bool DiscZarchiveDevice::ReadAllEntries(const std::string& path,
     entry->attributes_ = kFileAttributeReadOnly;
     entry->handle_ = static_cast<uint32_t>(handle);
     entry->parent_ = parent;
-    entry->children_.push_back(std::unique_ptr<Entry>(entry));
+    entry->AddChild(std::unique_ptr<Entry>(entry));
     return true;
   }
 
@@ -117,7 +287,7 @@ bool DiscZarchiveDevice::ReadAllEntries(const std::string& path,
         entry->data_size_ = 0;
         entry->size_ = dirEntry.size;
         entry->attributes_ = kFileAttributeDirectory | kFileAttributeReadOnly;
-        node->children_.push_back(std::unique_ptr<Entry>(entry));
+        node->AddChild(std::unique_ptr<Entry>(entry));
         if (!ReadAllEntries(full_path + "\\", entry, node)) {
           return false;
         }
@@ -126,7 +296,7 @@ bool DiscZarchiveDevice::ReadAllEntries(const std::string& path,
         entry->attributes_ = kFileAttributeReadOnly;
         entry->allocation_size_ =
             xe::round_up(entry->size_, bytes_per_sector());
-        node->children_.push_back(std::unique_ptr<Entry>(entry));
+        node->AddChild(std::unique_ptr<Entry>(entry));
       }
     }
     return true;
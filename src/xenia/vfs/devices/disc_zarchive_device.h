@@ -10,10 +10,17 @@
 #ifndef XENIA_VFS_DEVICES_DISC_ZARCHIVE_DEVICE_H_
 #define XENIA_VFS_DEVICES_DISC_ZARCHIVE_DEVICE_H_
 
+#include <condition_variable>
+#include <deque>
+#include <list>
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "xenia/base/mapped_memory.h"
+#include "xenia/base/mutex.h"
+#include "xenia/base/threading.h"
 #include "xenia/vfs/device.h"
 
 #include "third_party/zarchive/include/zarchive/zarchivereader.h"
@@ -49,14 +56,61 @@ class DiscZarchiveDevice : public Device {
 
   ZArchiveReader* reader() const { return reader_.get(); }
 
+  // Reads file data through the cache of decompressed chunks. If the read is
+  // sequential, the following chunks are decompressed in the background.
+  size_t ReadFile(uint32_t handle, uint64_t file_size, uint64_t offset,
+                  size_t length, void* buffer, bool sequential);
+
  private:
+  // Files are cached in aligned chunks of this size, matching the size of the
+  // compressed blocks in the archive.
+  static constexpr uint32_t kChunkSizeLog2 = 16;
+  static constexpr uint32_t kChunkSize = uint32_t(1) << kChunkSizeLog2;
+  // Larger reads don't go through the cache, as they would evict the chunks
+  // of smaller reads, and they're decompressed efficiently anyway.
+  static constexpr size_t kMaxCachedReadLength = 16 * kChunkSize;
+
+  struct Chunk {
+    uint64_t key;
+    std::vector<uint8_t> data;
+  };
+
+  struct ReadAheadRequest {
+    uint32_t handle;
+    uint64_t file_size;
+    uint64_t chunk_index;
+  };
+
   bool ReadAllEntries(const std::string& path, DiscZarchiveEntry* node,
                       DiscZarchiveEntry* parent);
 
+  static uint64_t GetChunkKey(uint32_t handle, uint64_t chunk_index) {
+    return uint64_t(handle) << 32 | chunk_index;
+  }
+  std::shared_ptr<const Chunk> GetChunk(uint32_t handle, uint64_t file_size,
+                                        uint64_t chunk_index);
+  std::shared_ptr<const Chunk> LookupChunk(uint64_t key);
+  void ReadAheadThreadMain();
+
   std::string name_;
   std::filesystem::path host_path_;
   std::unique_ptr<Entry> root_entry_;
   std::unique_ptr<ZArchiveReader> reader_;
+  xe_mutex reader_lock_;
+
+  // LRU of the decompressed chunks, most recently used first.
+  xe_mutex chunk_cache_lock_;
+  std::list<std::shared_ptr<const Chunk>> chunk_lru_;
+  std::unordered_map<uint64_t,
+                     std::list<std::shared_ptr<const Chunk>>::iterator>
+      chunk_cache_;
+  size_t max_cached_chunks_ = 0;
+
+  xe_mutex read_ahead_lock_;
+  std::condition_variable_any read_ahead_cond_;
+  std::deque<ReadAheadRequest> read_ahead_queue_;
+  bool read_ahead_shutdown_ = false;
+  std::unique_ptr<xe::threading::Thread> read_ahead_thread_;
 };
 
 }  // namespace vfs
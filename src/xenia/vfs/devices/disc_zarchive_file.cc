@@ -31,13 +31,17 @@ X_STATUS DiscZarchiveFile::ReadSync(void* buffer, size_t buffer_length,
   if (byte_offset >= entry_->size()) {
     return X_STATUS_END_OF_FILE;
   }
-  const uint64_t bytes_read =
+  // Streaming reads continue where the previous one has ended.
+  bool sequential = byte_offset != 0 &&
+                    byte_offset == next_sequential_offset_.load(
+                                       std::memory_order_relaxed);
+  const size_t bytes_read =
       ((DiscZarchiveDevice*)entry_->device_)
-          ->reader()
-          ->ReadFromFile(entry_->handle_, byte_offset, buffer_length, buffer);
-  const size_t real_length =
-      std::min(buffer_length, entry_->data_size() - byte_offset);
-  *out_bytes_read = real_length;
+          ->ReadFile(entry_->handle_, entry_->data_size(), byte_offset,
+                     buffer_length, buffer, sequential);
+  next_sequential_offset_.store(byte_offset + bytes_read,
+                                std::memory_order_relaxed);
+  *out_bytes_read = bytes_read;
   return X_STATUS_SUCCESS;
 }
 
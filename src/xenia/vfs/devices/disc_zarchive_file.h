@@ -10,6 +10,8 @@
 #ifndef XENIA_VFS_DEVICES_DISC_ZARCHIVE_FILE_H_
 #define XENIA_VFS_DEVICES_DISC_ZARCHIVE_FILE_H_
 
+#include <atomic>
+
 #include "xenia/vfs/file.h"
 
 namespace xe {
@@ -34,6 +36,8 @@ class DiscZarchiveFile : public File {
 
  private:
   DiscZarchiveEntry* entry_;
+  // For detecting sequential reads to decompress ahead.
+  std::atomic<size_t> next_sequential_offset_{0};
 };
 
 }  // namespace vfs
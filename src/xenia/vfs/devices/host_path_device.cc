@@ -9,12 +9,21 @@
 
 #include "xenia/vfs/devices/host_path_device.h"
 
+#include <queue>
+
+#include "xenia/base/cvar.h"
 #include "xenia/base/filesystem.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/kernel/xfile.h"
 #include "xenia/vfs/devices/host_path_entry.h"
 
+DEFINE_bool(host_path_prefetch, false,
+            "List the directories of host path devices on a background thread "
+            "after mounting rather than only when they are accessed by the "
+            "title.",
+            "Storage");
+
 namespace xe {
 namespace vfs {
 
@@ -26,7 +35,12 @@ HostPathDevice::HostPathDevice(const std::string_view mount_path,
       host_path_(host_path),
       read_only_(read_only) {}
 
-HostPathDevice::~HostPathDevice() = default;
+HostPathDevice::~HostPathDevice() {
+  if (prefetch_thread_) {
+    prefetch_cancelled_ = true;
+    xe::threading::Wait(prefetch_thread_.get(), false);
+  }
+}
 
 bool HostPathDevice::Initialize() {
   if (!std::filesystem::exists(host_path_)) {
@@ -42,7 +56,17 @@ bool HostPathDevice::Initialize() {
   auto root_entry = new HostPathEntry(this, nullptr, "", host_path_);
   root_entry->attributes_ = kFileAttributeDirectory;
   root_entry_ = std::unique_ptr<Entry>(root_entry);
-  PopulateEntry(root_entry);
+  // Directories are listed on demand, as mounting large content roots would
+  // otherwise walk the whole host tree.
+  root_entry->set_children_populated(false);
+
+  if (cvars::host_path_prefetch) {
+    xe::threading::Thread::CreationParameters thread_params;
+    thread_params.create_suspended = false;
+    prefetch_thread_ = xe::threading::Thread::Create(
+        thread_params, [this]() { PrefetchEntries(); });
+    prefetch_thread_->set_name("Host Path Prefetch");
+  }
 
   return true;
 }
@@ -60,16 +84,33 @@ Entry* HostPathDevice::ResolvePath(const std::string_view path) {
   return root_entry_->ResolvePath(path);
 }
 
-void HostPathDevice::PopulateEntry(HostPathEntry* parent_entry) {
-  auto child_infos = xe::filesystem::ListFiles(parent_entry->host_path());
-  for (auto& child_info : child_infos) {
-    auto child = HostPathEntry::Create(
-        this, parent_entry, parent_entry->host_path() / child_info.name,
-        child_info);
-    parent_entry->children_.push_back(std::unique_ptr<Entry>(child));
+void HostPathDevice::ReclaimRetiredEntries() {
+  // The prefetch queue may contain deleted directories.
+  if (prefetch_thread_ &&
+      xe::threading::Wait(prefetch_thread_.get(), false,
+                          std::chrono::milliseconds(0)) !=
+          xe::threading::WaitResult::kSuccess) {
+    return;
+  }
+  root_entry_->ReclaimRetired();
+}
 
-    if (child_info.type == xe::filesystem::FileInfo::Type::kDirectory) {
-      PopulateEntry(child);
+void HostPathDevice::PrefetchEntries() {
+  // Breadth-first, so the directories closer to the root, which are more
+  // likely to be accessed soon, are listed first.
+  std::queue<Entry*> queue;
+  queue.push(root_entry_.get());
+  while (!queue.empty() && !prefetch_cancelled_) {
+    Entry* entry = queue.front();
+    queue.pop();
+    // Listed without holding the lock.
+    entry->EnsurePopulated();
+    // The children may be modified by the title concurrently.
+    auto global_lock = global_critical_region_.Acquire();
+    for (auto& child : entry->children()) {
+      if (child->attributes() & kFileAttributeDirectory) {
+        queue.push(child.get());
+      }
     }
   }
 }
@@ -10,8 +10,11 @@
 #ifndef XENIA_VFS_DEVICES_HOST_PATH_DEVICE_H_
 #define XENIA_VFS_DEVICES_HOST_PATH_DEVICE_H_
 
+#include <atomic>
+#include <memory>
 #include <string>
 
+#include "xenia/base/threading.h"
 #include "xenia/vfs/device.h"
 
 namespace xe {
@@ -28,6 +31,7 @@ class HostPathDevice : public Device {
   bool Initialize() override;
   void Dump(StringBuffer* string_buffer) override;
   Entry* ResolvePath(const std::string_view path) override;
+  void ReclaimRetiredEntries() override;
 
   bool is_read_only() const override { return read_only_; }
 
@@ -45,12 +49,17 @@ class HostPathDevice : public Device {
   std::filesystem::path host_path() const { return host_path_; }
 
  private:
-  void PopulateEntry(HostPathEntry* parent_entry);
+  void PrefetchEntries();
 
   std::string name_;
   std::filesystem::path host_path_;
   std::unique_ptr<Entry> root_entry_;
   bool read_only_;
+
+  // Lists the directories ahead of the accesses if host_path_prefetch is
+  // enabled.
+  std::unique_ptr<xe::threading::Thread> prefetch_thread_;
+  std::atomic<bool> prefetch_cancelled_{false};
 };
 
 }  // namespace vfs
@@ -40,6 +40,8 @@ HostPathEntry* HostPathEntry::Create(Device* device, Entry* parent,
   entry->write_timestamp_ = file_info.write_timestamp;
   if (file_info.type == xe::filesystem::FileInfo::Type::kDirectory) {
     entry->attributes_ = kFileAttributeDirectory;
+    // Listed when accessed for the first time.
+    entry->set_children_populated(false);
   } else {
     entry->attributes_ = kFileAttributeNormal;
     if (device->is_read_only()) {
@@ -68,6 +70,17 @@ X_STATUS HostPathEntry::Open(uint32_t desired_access, File** out_file) {
   return X_STATUS_SUCCESS;
 }
 
+std::vector<std::unique_ptr<Entry>> HostPathEntry::ListChildren() {
+  auto child_infos = xe::filesystem::ListFiles(host_path_);
+  std::vector<std::unique_ptr<Entry>> children;
+  children.reserve(child_infos.size());
+  for (auto& child_info : child_infos) {
+    children.emplace_back(HostPathEntry::Create(
+        device_, this, host_path_ / child_info.name, child_info));
+  }
+  return children;
+}
+
 std::unique_ptr<MappedMemory> HostPathEntry::OpenMapped(MappedMemory::Mode mode,
                                                         size_t offset,
                                                         size_t length) {
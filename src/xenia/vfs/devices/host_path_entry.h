@@ -43,6 +43,7 @@ class HostPathEntry : public Entry {
  private:
   friend class HostPathDevice;
 
+  std::vector<std::unique_ptr<Entry>> ListChildren() override;
   std::unique_ptr<Entry> CreateEntryInternal(const std::string_view name,
                                              uint32_t attributes) override;
   bool DeleteEntryInternal(Entry* entry) override;
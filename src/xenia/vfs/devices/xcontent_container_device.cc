@@ -131,11 +131,34 @@ void XContentContainerDevice::Dump(StringBuffer* string_buffer) {
   root_entry_->Dump(string_buffer, 0);
 }
 
+bool XContentContainerDevice::OpenReadHandle(
+    size_t file_index, const std::filesystem::path& path) {
+  auto file_handle = xe::filesystem::FileHandle::OpenExisting(
+      path, xe::filesystem::FileAccess::kFileReadData);
+  if (!file_handle) {
+    return false;
+  }
+  read_handles_[file_index] = std::move(file_handle);
+  return true;
+}
+
+bool XContentContainerDevice::ReadHostFile(size_t file_index, size_t offset,
+                                           void* buffer, size_t buffer_length,
+                                           size_t* out_bytes_read) {
+  auto it = read_handles_.find(file_index);
+  if (it == read_handles_.end()) {
+    *out_bytes_read = 0;
+    return false;
+  }
+  return it->second->Read(offset, buffer, buffer_length, out_bytes_read);
+}
+
 void XContentContainerDevice::CloseFiles() {
   for (auto& file : files_) {
     fclose(file.second);
   }
   files_.clear();
+  read_handles_.clear();
   files_total_size_ = 0;
 }
 
@@ -12,8 +12,10 @@
 
 #include <filesystem>
 #include <map>
+#include <memory>
 #include <string_view>
 
+#include "xenia/base/filesystem.h"
 #include "xenia/base/math.h"
 #include "xenia/kernel/util/xex2_info.h"
 #include "xenia/kernel/xam/content_manager.h"
@@ -63,6 +65,11 @@ class XContentContainerDevice : public Device {
 
   kernel::xam::XCONTENT_AGGREGATE_DATA content_header() const;
 
+  // Reads from the host file with the given index at the given offset. Safe to
+  // call from multiple threads, as reads don't share a file position.
+  bool ReadHostFile(size_t file_index, size_t offset, void* buffer,
+                    size_t buffer_length, size_t* out_bytes_read);
+
  protected:
   XContentContainerDevice(const std::string_view mount_path,
                           const std::filesystem::path& host_path);
@@ -83,6 +90,8 @@ class XContentContainerDevice : public Device {
   virtual void SetupContainer() {};
 
   Entry* ResolvePath(const std::string_view path);
+  // Opens the host file with the given index for ReadHostFile.
+  bool OpenReadHandle(size_t file_index, const std::filesystem::path& path);
   void CloseFiles();
   void Dump(StringBuffer* string_buffer);
   Result ReadHeaderAndVerify(FILE* header_file);
@@ -102,7 +111,10 @@ class XContentContainerDevice : public Device {
   std::string name_;
   std::filesystem::path host_path_;
 
+  // Used while reading the container structure.
   std::map<size_t, FILE*> files_;
+  // Used for reading the data of the files in the container.
+  std::map<size_t, std::unique_ptr<xe::filesystem::FileHandle>> read_handles_;
   size_t files_total_size_;
   std::unique_ptr<Entry> root_entry_;
   std::unique_ptr<XContentContainerHeader> header_;
@@ -10,6 +10,7 @@
 #include "xenia/vfs/devices/xcontent_container_entry.h"
 #include "xenia/vfs/devices/xcontent_container_file.h"
 
+#include <algorithm>
 #include <map>
 
 namespace xe {
@@ -36,6 +37,45 @@ std::unique_ptr<XContentContainerEntry> XContentContainerEntry::Create(
   return std::move(entry);
 }
 
+void XContentContainerEntry::FinalizeBlockList() {
+  size_t merged_count = 0;
+  size_t data_offset = 0;
+  for (const BlockRecord& record : block_list_) {
+    if (merged_count) {
+      BlockRecord& last_record = block_list_[merged_count - 1];
+      if (last_record.file == record.file &&
+          last_record.offset + last_record.length == record.offset) {
+        last_record.length += record.length;
+        data_offset += record.length;
+        continue;
+      }
+    }
+    BlockRecord& merged_record = block_list_[merged_count++];
+    merged_record = record;
+    merged_record.data_offset = data_offset;
+    data_offset += record.length;
+  }
+  block_list_.resize(merged_count);
+  block_list_.shrink_to_fit();
+}
+
+const XContentContainerEntry::BlockRecord*
+XContentContainerEntry::FindBlockRecord(size_t data_offset) const {
+  auto it = std::upper_bound(
+      block_list_.cbegin(), block_list_.cend(), data_offset,
+      [](size_t offset, const BlockRecord& record) {
+        return offset < record.data_offset;
+      });
+  if (it == block_list_.cbegin()) {
+    return nullptr;
+  }
+  --it;
+  if (data_offset - it->data_offset >= it->length) {
+    return nullptr;
+  }
+  return &*it;
+}
+
 X_STATUS XContentContainerEntry::Open(uint32_t desired_access,
                                       File** out_file) {
   *out_file = new XContentContainerFile(desired_access, this);
@@ -44,10 +44,19 @@ class XContentContainerEntry : public Entry {
     size_t file;
     size_t offset;
     size_t length;
+    // Offset of the record in the data of the entry, set by FinalizeBlockList.
+    size_t data_offset;
   };
+  // Records of contiguous ranges of the host files, sorted by data_offset.
   const std::vector<BlockRecord>& block_list() const { return block_list_; }
+  // Returns the record containing the given offset in the data of the entry.
+  const BlockRecord* FindBlockRecord(size_t data_offset) const;
 
  private:
+  // Merges contiguous blocks into a single record and calculates the data
+  // offsets of the records.
+  void FinalizeBlockList();
+
   friend class StfsContainerDevice;
   friend class SvodContainerDevice;
 
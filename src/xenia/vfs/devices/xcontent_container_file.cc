@@ -11,6 +11,7 @@
 #include <cmath>
 
 #include "xenia/base/math.h"
+#include "xenia/vfs/devices/xcontent_container_device.h"
 #include "xenia/vfs/devices/xcontent_container_entry.h"
 #include "xenia/vfs/devices/xcontent_container_file.h"
 
@@ -32,34 +33,31 @@ X_STATUS XContentContainerFile::ReadSync(void* buffer, size_t buffer_length,
     return X_STATUS_END_OF_FILE;
   }
 
-  size_t src_offset = 0;
+  auto device = static_cast<XContentContainerDevice*>(entry_->device());
   uint8_t* p = reinterpret_cast<uint8_t*>(buffer);
   size_t remaining_length =
       std::min(buffer_length, entry_->size() - byte_offset);
 
   *out_bytes_read = 0;
-  for (size_t i = 0; i < entry_->block_list().size(); i++) {
-    auto& record = entry_->block_list()[i];
-    if (src_offset + record.length <= byte_offset) {
-      // Doesn't begin in this region. Skip it.
-      src_offset += record.length;
-      continue;
-    }
-
-    size_t read_offset =
-        (byte_offset > src_offset) ? byte_offset - src_offset : 0;
+  const XContentContainerEntry::BlockRecord* record =
+      entry_->FindBlockRecord(byte_offset);
+  const XContentContainerEntry::BlockRecord* records_end =
+      entry_->block_list().data() + entry_->block_list().size();
+  for (; record && record != records_end && remaining_length; ++record) {
+    size_t read_offset = byte_offset + *out_bytes_read - record->data_offset;
     size_t read_length =
-        std::min(record.length - read_offset, remaining_length);
+        std::min(record->length - read_offset, remaining_length);
 
-    auto& file = entry_->files()->at(record.file);
-    xe::filesystem::Seek(file, record.offset + read_offset, SEEK_SET);
-    auto num_read = fread(p, 1, read_length, file);
+    size_t num_read = 0;
+    if (!device->ReadHostFile(record->file, record->offset + read_offset, p,
+                              read_length, &num_read)) {
+      break;
+    }
 
     *out_bytes_read += num_read;
     p += num_read;
-    src_offset += record.length;
     remaining_length -= read_length;
-    if (remaining_length == 0) {
+    if (num_read != read_length) {
       break;
     }
   }
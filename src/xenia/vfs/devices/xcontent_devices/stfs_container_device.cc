@@ -47,6 +47,9 @@ XContentContainerDevice::Result StfsContainerDevice::LoadHostFiles(
   }
 
   files_.emplace(std::make_pair(0, header_file));
+  if (!OpenReadHandle(0, host_path_)) {
+    return Result::kReadError;
+  }
   return Result::kSuccess;
 }
 
@@ -91,7 +94,7 @@ StfsContainerDevice::Result StfsContainerDevice::Read() {
       std::unique_ptr<XContentContainerEntry> entry =
           ReadEntry(parent_entry, &files_, &dir_entry);
       all_entries.push_back(entry.get());
-      parent_entry->children_.emplace_back(std::move(entry));
+      parent_entry->AddChild(std::move(entry));
     }
 
     const StfsHashEntry* block_hash = GetBlockHash(table_block_index);
@@ -171,6 +174,8 @@ std::unique_ptr<XContentContainerEntry> StfsContainerDevice::ReadEntry(
           dir_entry->allocated_data_blocks());
       assert_always();
     }
+
+    entry->FinalizeBlockList();
   }
 
   return entry;
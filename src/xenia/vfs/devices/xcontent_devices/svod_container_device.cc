@@ -55,7 +55,10 @@ SvodContainerDevice::Result SvodContainerDevice::LoadHostFiles(
     auto& fragment = fragment_files.at(i);
     auto path = fragment.path / fragment.name;
     auto file = xe::filesystem::OpenFile(path, "rb");
-    if (!file) {
+    if (!file || !OpenReadHandle(i, path)) {
+      if (file) {
+        fclose(file);
+      }
       XELOGI("Failed to map SVOD file {}.", xe::path_to_utf8(path));
       CloseFiles();
       return Result::kReadError;
@@ -228,10 +231,11 @@ SvodContainerDevice::Result SvodContainerDevice::ReadEntry(
         last_record = entry->block_list_.size() - 1;
         last_offset = offset;
       }
+      entry->FinalizeBlockList();
     }
   }
 
-  parent->children_.emplace_back(std::move(entry));
+  parent->AddChild(std::move(entry));
 
   // Read the right node.
   if (dir_entry.node_r) {
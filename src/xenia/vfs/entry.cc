@@ -16,6 +16,9 @@
 namespace xe {
 namespace vfs {
 
+// Child index slot of a deleted child, to continue probing past it.
+static const void* const kDeletedChild = reinterpret_cast<const void*>(1);
+
 Entry::Entry(Device* device, Entry* parent, const std::string_view path)
     : device_(device),
       parent_(parent),
@@ -29,6 +32,8 @@ Entry::Entry(Device* device, Entry* parent, const std::string_view path)
   assert_not_null(device);
   absolute_path_ = xe::utf8::join_guest_paths(device->mount_path(), path);
   name_ = xe::utf8::find_name_from_guest_path(path);
+  child_key_.reset(
+      new ChildKey{this, xe::utf8::hash_fnv1a_case(name_), name_});
 }
 
 Entry::~Entry() = default;
@@ -39,6 +44,7 @@ void Entry::Dump(xe::StringBuffer* string_buffer, int indent) {
   }
   string_buffer->Append(name());
   string_buffer->Append('\n');
+  EnsurePopulated();
   for (auto& child : children_) {
     child->Dump(string_buffer, indent + 2);
   }
@@ -47,15 +53,106 @@ void Entry::Dump(xe::StringBuffer* string_buffer, int indent) {
 bool Entry::is_read_only() const { return device_->is_read_only(); }
 
 Entry* Entry::GetChild(const std::string_view name) {
-  auto global_lock = global_critical_region_.Acquire();
-  auto it = std::find_if(children_.cbegin(), children_.cend(),
-                         [&](const auto& child) {
-                           return xe::utf8::equal_case(child->name(), name);
-                         });
-  if (it == children_.cend()) {
+  EnsurePopulated();
+  const ChildIndex* index = child_index_.load(std::memory_order_acquire);
+  if (!index) {
     return nullptr;
   }
-  return (*it).get();
+  size_t name_hash = xe::utf8::hash_fnv1a_case(name);
+  size_t slot_mask = index->capacity - 1;
+  for (size_t i = name_hash & slot_mask;; i = (i + 1) & slot_mask) {
+    const ChildKey* key = index->slots[i].load(std::memory_order_acquire);
+    if (!key) {
+      return nullptr;
+    }
+    if (key != kDeletedChild && key->name_hash == name_hash &&
+        xe::utf8::equal_case(key->name, name)) {
+      return key->entry;
+    }
+  }
+}
+
+void Entry::IndexChild(Entry* child) {
+  ChildIndex* index = child_index_.load(std::memory_order_relaxed);
+  if (!index || (child_index_used_slots_ + 1) * 4 > index->capacity * 3) {
+    // Rehash into a new table, dropping the deleted slots.
+    size_t capacity = 8;
+    while ((children_.size() + 1) * 2 > capacity) {
+      capacity *= 2;
+    }
+    auto new_index = std::make_unique<ChildIndex>(capacity);
+    child_index_used_slots_ = 0;
+    for (const auto& existing_child : children_) {
+      if (existing_child.get() == child) {
+        continue;
+      }
+      size_t slot_mask = capacity - 1;
+      const ChildKey* key = existing_child->child_key_.get();
+      size_t i = key->name_hash & slot_mask;
+      while (new_index->slots[i].load(std::memory_order_relaxed)) {
+        i = (i + 1) & slot_mask;
+      }
+      new_index->slots[i].store(key, std::memory_order_relaxed);
+      ++child_index_used_slots_;
+    }
+    index = new_index.get();
+    child_indices_.push_back(std::move(new_index));
+    child_index_.store(index, std::memory_order_release);
+  }
+  const ChildKey* key = child->child_key_.get();
+  size_t slot_mask = index->capacity - 1;
+  size_t i = key->name_hash & slot_mask;
+  while (index->slots[i].load(std::memory_order_relaxed)) {
+    i = (i + 1) & slot_mask;
+  }
+  index->slots[i].store(key, std::memory_order_release);
+  ++child_index_used_slots_;
+}
+
+void Entry::UnindexChild(Entry* child) {
+  ChildIndex* index = child_index_.load(std::memory_order_relaxed);
+  if (!index) {
+    return;
+  }
+  const ChildKey* key = child->child_key_.get();
+  size_t slot_mask = index->capacity - 1;
+  for (size_t i = key->name_hash & slot_mask;; i = (i + 1) & slot_mask) {
+    const ChildKey* slot_key = index->slots[i].load(std::memory_order_relaxed);
+    if (!slot_key) {
+      return;
+    }
+    if (slot_key == key) {
+      // Other children may be placed after it, so it can't be emptied.
+      index->slots[i].store(static_cast<const ChildKey*>(kDeletedChild),
+                            std::memory_order_release);
+      return;
+    }
+  }
+}
+
+Entry* Entry::AddChild(std::unique_ptr<Entry> entry) {
+  auto global_lock = global_critical_region_.Acquire();
+  children_.push_back(std::move(entry));
+  Entry* child = children_.back().get();
+  IndexChild(child);
+  return child;
+}
+
+void Entry::EnsurePopulated() {
+  if (children_populated_.load(std::memory_order_acquire)) {
+    return;
+  }
+  // Listing may involve host I/O, only publish the result under the lock.
+  std::vector<std::unique_ptr<Entry>> children = ListChildren();
+  auto global_lock = global_critical_region_.Acquire();
+  if (children_populated_.load(std::memory_order_relaxed)) {
+    // Populated by another thread meanwhile.
+    return;
+  }
+  for (auto& child : children) {
+    AddChild(std::move(child));
+  }
+  children_populated_.store(true, std::memory_order_release);
 }
 
 Entry* Entry::ResolvePath(const std::string_view path) {
@@ -73,6 +170,7 @@ Entry* Entry::ResolvePath(const std::string_view path) {
 
 Entry* Entry::IterateChildren(const xe::filesystem::WildcardEngine& engine,
                               size_t* current_index) {
+  EnsurePopulated();
   auto global_lock = global_critical_region_.Acquire();
   while (*current_index < children_.size()) {
     auto& child = children_[*current_index];
@@ -85,6 +183,8 @@ Entry* Entry::IterateChildren(const xe::filesystem::WildcardEngine& engine,
 }
 
 Entry* Entry::CreateEntry(const std::string_view name, uint32_t attributes) {
+  // For checking whether the entry already exists, not under the lock.
+  EnsurePopulated();
   auto global_lock = global_critical_region_.Acquire();
   if (is_read_only()) {
     return nullptr;
@@ -97,10 +197,11 @@ Entry* Entry::CreateEntry(const std::string_view name, uint32_t attributes) {
   if (!entry) {
     return nullptr;
   }
-  children_.push_back(std::move(entry));
   // TODO(benvanik): resort? would break iteration?
+  Entry* child = AddChild(std::move(entry));
+  device_->InvalidatePathCache();
   Touch();
-  return children_.back().get();
+  return child;
 }
 
 bool Entry::Delete(Entry* entry) {
@@ -114,12 +215,15 @@ bool Entry::Delete(Entry* entry) {
   if (!DeleteEntryInternal(entry)) {
     return false;
   }
+  UnindexChild(entry);
   for (auto it = children_.begin(); it != children_.end(); ++it) {
     if (it->get() == entry) {
+      deleted_children_.push_back(std::move(*it));
       children_.erase(it);
       break;
     }
   }
+  device_->InvalidatePathCache();
   Touch();
   return true;
 }
@@ -144,10 +248,38 @@ void Entry::Rename(const std::filesystem::path file_path) {
 
   RenameEntryInternal(guest_path_without_root);
 
+  auto global_lock = global_critical_region_.Acquire();
+  if (parent_) {
+    parent_->UnindexChild(this);
+  }
   absolute_path_ = xe::utf8::join_guest_paths(device_->mount_path(),
                                               guest_path_without_root);
   path_ = guest_path_without_root;
   name_ = xe::path_to_utf8(file_path.filename());
+  // The old key may still be compared by lookups on other threads.
+  std::unique_ptr<const ChildKey> new_child_key(
+      new ChildKey{this, xe::utf8::hash_fnv1a_case(name_), name_});
+  if (parent_) {
+    parent_->retired_child_keys_.push_back(std::move(child_key_));
+  }
+  child_key_ = std::move(new_child_key);
+  if (parent_) {
+    parent_->IndexChild(this);
+  }
+  device_->InvalidatePathCache();
+}
+
+void Entry::ReclaimRetired() {
+  auto global_lock = global_critical_region_.Acquire();
+  deleted_children_.clear();
+  retired_child_keys_.clear();
+  if (child_indices_.size() > 1) {
+    // The last one is the current index.
+    child_indices_.erase(child_indices_.begin(), child_indices_.end() - 1);
+  }
+  for (auto& child : children_) {
+    child->ReclaimRetired();
+  }
 }
 
 }  // namespace vfs
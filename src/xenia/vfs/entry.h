@@ -10,6 +10,7 @@
 #ifndef XENIA_VFS_ENTRY_H_
 #define XENIA_VFS_ENTRY_H_
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <vector>
@@ -96,22 +97,38 @@ class Entry {
 
   bool is_read_only() const;
 
+  // Doesn't take any locks once the directory has been populated.
   Entry* GetChild(const std::string_view name);
   Entry* ResolvePath(const std::string_view path);
 
-  const std::vector<std::unique_ptr<Entry>>& children() const {
+  const std::vector<std::unique_ptr<Entry>>& children() {
+    EnsurePopulated();
     return children_;
   }
-  size_t child_count() const { return children_.size(); }
+  size_t child_count() {
+    EnsurePopulated();
+    return children_.size();
+  }
   Entry* IterateChildren(const xe::filesystem::WildcardEngine& engine,
                          size_t* current_index);
 
+  // Lists the children of a directory created on demand if not done yet. The
+  // listing is done without holding the global critical region.
+  void EnsurePopulated();
+
   Entry* CreateEntry(const std::string_view name, uint32_t attributes);
   bool Delete(Entry* entry);
   bool Delete();
   void Touch();
 
   void Rename(const std::filesystem::path file_path);
+
+  // Releases the deleted children, the names replaced by renaming and the old
+  // child indices of this entry and its descendants. Must only be called when
+  // no other thread may be looking up or accessing these entries, such as
+  // when the title is terminated.
+  void ReclaimRetired();
+
   // If successful, out_file points to a new file. When finished, call
   // file->Destroy()
   virtual X_STATUS Open(uint32_t desired_access, File** out_file) = 0;
@@ -127,6 +144,22 @@ class Entry {
  protected:
   Entry(Device* device, Entry* parent, const std::string_view path);
 
+  // Adds a child entry when populating the directory.
+  Entry* AddChild(std::unique_ptr<Entry> entry);
+
+  // Directories of devices that create their entries on demand are marked as
+  // not populated, and ListChildren is called the first time their children are
+  // accessed. It may be called concurrently on multiple threads, without the
+  // global critical region held, and the children from only one of the calls
+  // are added.
+  void set_children_populated(bool populated) {
+    children_populated_.store(populated, std::memory_order_release);
+  }
+  bool children_populated() const {
+    return children_populated_.load(std::memory_order_acquire);
+  }
+  virtual std::vector<std::unique_ptr<Entry>> ListChildren() { return {}; }
+
   virtual std::unique_ptr<Entry> CreateEntryInternal(
       const std::string_view name, uint32_t attributes) {
     return nullptr;
@@ -146,7 +179,45 @@ class Entry {
   uint64_t create_timestamp_;
   uint64_t access_timestamp_;
   uint64_t write_timestamp_;
+  // Must not be modified directly, use AddChild.
   std::vector<std::unique_ptr<Entry>> children_;
+
+ private:
+  // Name of an entry as seen by the child index of its parent. Immutable, so
+  // lookups can compare names while the entry is being renamed - renaming
+  // replaces the key instead.
+  struct ChildKey {
+    Entry* entry;
+    size_t name_hash;
+    std::string name;
+  };
+
+  // Open addressing hash table of the children by the case-insensitive hash of
+  // the name. Modified under the global critical region, with lookups not
+  // taking any locks. A new table is created when it's 3/4 full, the old ones
+  // are kept until ReclaimRetired, as other threads may still be searching in
+  // them.
+  struct ChildIndex {
+    explicit ChildIndex(size_t capacity)
+        : capacity(capacity),
+          slots(new std::atomic<const ChildKey*>[capacity]()) {}
+    size_t capacity;
+    std::unique_ptr<std::atomic<const ChildKey*>[]> slots;
+  };
+
+  void IndexChild(Entry* child);
+  void UnindexChild(Entry* child);
+
+  std::unique_ptr<const ChildKey> child_key_;
+  std::atomic<bool> children_populated_{true};
+  std::atomic<ChildIndex*> child_index_{nullptr};
+  // Children and deleted children slots in the current index.
+  size_t child_index_used_slots_ = 0;
+  std::vector<std::unique_ptr<ChildIndex>> child_indices_;
+  // Kept alive until ReclaimRetired, as they may be in use by lookups on other
+  // threads.
+  std::vector<std::unique_ptr<Entry>> deleted_children_;
+  std::vector<std::unique_ptr<const ChildKey>> retired_child_keys_;
 };
 
 }  // namespace vfs
@@ -0,0 +1,64 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/vfs/file_access_trace.h"
+
+#include <cinttypes>
+#include <cstdio>
+
+#include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/filesystem.h"
+
+namespace xe {
+namespace vfs {
+
+bool LoadFileAccessTrace(const std::filesystem::path& trace_path,
+                         std::vector<FileAccessTraceRecord>& records_out) {
+  FILE* file = xe::filesystem::OpenFile(trace_path, "r");
+  if (!file) {
+    return false;
+  }
+  char line[1024];
+  while (std::fgets(line, sizeof(line), file)) {
+    uint64_t offset, length;
+    int path_start = 0;
+    if (std::sscanf(line, "%" SCNx64 " %" SCNx64 " %n", &offset, &length,
+                    &path_start) < 2 ||
+        !path_start) {
+      continue;
+    }
+    std::string path(line + path_start);
+    while (!path.empty() && (path.back() == '\n' || path.back() == '\r')) {
+      path.pop_back();
+    }
+    if (path.empty() || !length) {
+      continue;
+    }
+    records_out.push_back({std::move(path), offset, length});
+  }
+  fclose(file);
+  return true;
+}
+
+bool StoreFileAccessTrace(const std::filesystem::path& trace_path,
+                          const std::vector<FileAccessTraceRecord>& records) {
+  FILE* file = xe::filesystem::OpenFile(trace_path, "w");
+  if (!file) {
+    return false;
+  }
+  for (const FileAccessTraceRecord& record : records) {
+    fmt::print(file, "{:X} {:X} {}\n", record.offset, record.length,
+               record.path);
+  }
+  fclose(file);
+  return true;
+}
+
+}  // namespace vfs
+}  // namespace xe
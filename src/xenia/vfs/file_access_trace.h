@@ -0,0 +1,40 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_VFS_FILE_ACCESS_TRACE_H_
+#define XENIA_VFS_FILE_ACCESS_TRACE_H_
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace xe {
+namespace vfs {
+
+// A single read of a file access trace.
+struct FileAccessTraceRecord {
+  // Absolute guest path of the file.
+  std::string path;
+  uint64_t offset;
+  uint64_t length;
+};
+
+// File access traces are stored as text with a read per line, as
+// "offset length path", with the offset and the length in hexadecimal.
+// Malformed lines and empty reads are skipped when loading.
+bool LoadFileAccessTrace(const std::filesystem::path& trace_path,
+                         std::vector<FileAccessTraceRecord>& records_out);
+bool StoreFileAccessTrace(const std::filesystem::path& trace_path,
+                          const std::vector<FileAccessTraceRecord>& records);
+
+}  // namespace vfs
+}  // namespace xe
+
+#endif  // XENIA_VFS_FILE_ACCESS_TRACE_H_
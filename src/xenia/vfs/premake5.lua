@@ -19,7 +19,7 @@ project("xenia-vfs")
   filter {}
 
   recursive_platform_files()
-  removefiles({"vfs_dump.cc"})
+  removefiles({"vfs_dump.cc", "vfs_benchmark.cc"})
 
 project("xenia-vfs-dump")
   uuid("2EF270C7-41A8-4D0E-ACC5-59693A9CCE32")
@@ -34,6 +34,7 @@ project("xenia-vfs-dump")
 
   files({
     "vfs_dump.cc",
+    "vfs_benchmark.cc",
     project_root.."/src/xenia/base/console_app_main_"..platform_suffix..".cc",
   })
   resincludedirs({
@@ -0,0 +1,326 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/vfs/vfs_benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <queue>
+#include <random>
+#include <thread>
+#include <unordered_map>
+
+#include "xenia/base/logging.h"
+#include "xenia/vfs/file.h"
+
+namespace xe {
+namespace vfs {
+
+namespace {
+
+uint64_t GetElapsedNs(std::chrono::steady_clock::time_point start) {
+  return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now() - start)
+                      .count());
+}
+
+// Files opened by a benchmark thread, kept open for the whole run so opening
+// is not measured together with the reads.
+class OpenFiles {
+ public:
+  ~OpenFiles() {
+    for (auto& it : files_) {
+      it.second->Destroy();
+    }
+  }
+
+  File* Get(Entry* entry) {
+    auto it = files_.find(entry);
+    if (it != files_.end()) {
+      return it->second;
+    }
+    File* file = nullptr;
+    if (XFAILED(entry->Open(FileAccess::kGenericRead, &file)) || !file) {
+      return nullptr;
+    }
+    files_.emplace(entry, file);
+    return file;
+  }
+
+ private:
+  std::unordered_map<Entry*, File*> files_;
+};
+
+template <typename Function>
+void RunOnThreads(uint32_t thread_count, Function function) {
+  std::vector<std::thread> threads;
+  threads.reserve(thread_count);
+  for (uint32_t i = 0; i < thread_count; ++i) {
+    threads.emplace_back(function, i);
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+}  // namespace
+
+VfsBenchmark::VfsBenchmark(Device* device) : device_(device) {}
+
+bool VfsBenchmark::Initialize() {
+  Entry* root = device_->ResolvePath("/");
+  if (!root) {
+    return false;
+  }
+  std::queue<Entry*> queue;
+  queue.push(root);
+  while (!queue.empty()) {
+    Entry* entry = queue.front();
+    queue.pop();
+    if (entry->attributes() & kFileAttributeDirectory) {
+      directories_.push_back(entry);
+      for (auto& child : entry->children()) {
+        queue.push(child.get());
+      }
+    } else if (entry->size()) {
+      files_.push_back({entry, entry->size()});
+      total_file_size_ += entry->size();
+    }
+  }
+  return true;
+}
+
+VfsBenchmark::Result VfsBenchmark::RunSequential(uint32_t thread_count,
+                                                 uint32_t read_size,
+                                                 uint64_t max_bytes) {
+  thread_count = std::max(thread_count, uint32_t(1));
+  std::vector<std::vector<uint64_t>> latencies_ns(thread_count);
+  std::vector<uint64_t> thread_bytes(thread_count, 0);
+  uint64_t thread_max_bytes = max_bytes / thread_count;
+  auto start = std::chrono::steady_clock::now();
+  RunOnThreads(thread_count, [&](uint32_t thread_index) {
+    OpenFiles open_files;
+    std::vector<uint8_t> buffer(read_size);
+    for (size_t i = thread_index; i < files_.size(); i += thread_count) {
+      File* file = open_files.Get(files_[i].entry);
+      if (!file) {
+        continue;
+      }
+      for (uint64_t offset = 0; offset < files_[i].size; offset += read_size) {
+        if (thread_bytes[thread_index] >= thread_max_bytes) {
+          return;
+        }
+        size_t bytes_read = 0;
+        auto read_start = std::chrono::steady_clock::now();
+        file->ReadSync(buffer.data(), read_size, size_t(offset), &bytes_read);
+        latencies_ns[thread_index].push_back(GetElapsedNs(read_start));
+        thread_bytes[thread_index] += bytes_read;
+      }
+    }
+  });
+  uint64_t elapsed_ns = GetElapsedNs(start);
+  uint64_t bytes = 0;
+  for (uint64_t thread_byte_count : thread_bytes) {
+    bytes += thread_byte_count;
+  }
+  return MakeResult("sequential", thread_count, bytes, elapsed_ns,
+                    latencies_ns);
+}
+
+VfsBenchmark::Result VfsBenchmark::RunRandom(uint32_t thread_count,
+                                             uint32_t read_size,
+                                             uint64_t operation_count) {
+  thread_count = std::max(thread_count, uint32_t(1));
+  std::vector<std::vector<uint64_t>> latencies_ns(thread_count);
+  std::vector<uint64_t> thread_bytes(thread_count, 0);
+  std::vector<const FileInfo*> files;
+  for (const FileInfo& file_info : files_) {
+    if (file_info.size >= read_size) {
+      files.push_back(&file_info);
+    }
+  }
+  if (files.empty()) {
+    return MakeResult("random", thread_count, 0, 0, latencies_ns);
+  }
+  auto start = std::chrono::steady_clock::now();
+  RunOnThreads(thread_count, [&](uint32_t thread_index) {
+    OpenFiles open_files;
+    std::vector<uint8_t> buffer(read_size);
+    // Fixed seeds so runs are comparable.
+    std::mt19937_64 random(thread_index);
+    std::uniform_int_distribution<size_t> file_distribution(0,
+                                                            files.size() - 1);
+    for (uint64_t i = thread_index; i < operation_count; i += thread_count) {
+      const FileInfo& file_info = *files[file_distribution(random)];
+      File* file = open_files.Get(file_info.entry);
+      if (!file) {
+        continue;
+      }
+      uint64_t offset =
+          std::uniform_int_distribution<uint64_t>(
+              0, (file_info.size - read_size) / read_size)(random) *
+          read_size;
+      size_t bytes_read = 0;
+      auto read_start = std::chrono::steady_clock::now();
+      file->ReadSync(buffer.data(), read_size, size_t(offset), &bytes_read);
+      latencies_ns[thread_index].push_back(GetElapsedNs(read_start));
+      thread_bytes[thread_index] += bytes_read;
+    }
+  });
+  uint64_t elapsed_ns = GetElapsedNs(start);
+  uint64_t bytes = 0;
+  for (uint64_t thread_byte_count : thread_bytes) {
+    bytes += thread_byte_count;
+  }
+  return MakeResult("random", thread_count, bytes, elapsed_ns, latencies_ns);
+}
+
+VfsBenchmark::Result VfsBenchmark::RunDirectoryWalk(uint32_t iterations,
+                                                    bool cached) {
+  std::vector<std::string> paths;
+  paths.reserve(directories_.size() + files_.size());
+  for (Entry* directory : directories_) {
+    paths.push_back(directory->path());
+  }
+  for (const FileInfo& file_info : files_) {
+    paths.push_back(file_info.entry->path());
+  }
+  std::vector<std::vector<uint64_t>> latencies_ns(1);
+  latencies_ns[0].reserve(paths.size() * iterations);
+  uint64_t child_count = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < iterations; ++i) {
+    for (const std::string& path : paths) {
+      auto resolve_start = std::chrono::steady_clock::now();
+      Entry* entry = cached ? device_->ResolvePathCached(path)
+                            : device_->ResolvePath(path);
+      latencies_ns[0].push_back(GetElapsedNs(resolve_start));
+      if (entry && (entry->attributes() & kFileAttributeDirectory)) {
+        child_count += entry->child_count();
+      }
+    }
+  }
+  uint64_t elapsed_ns = GetElapsedNs(start);
+  XELOGI("Directory walk: {} directories, {} files, {} children enumerated",
+         directories_.size(), files_.size(), child_count);
+  return MakeResult(cached ? "resolve-path-cached" : "resolve-path", 1, 0,
+                    elapsed_ns, latencies_ns);
+}
+
+VfsBenchmark::Result VfsBenchmark::RunTrace(
+    const std::vector<Access>& accesses, uint32_t thread_count) {
+  thread_count = std::max(thread_count, uint32_t(1));
+  // Resolved before the run so only the reads are measured.
+  std::vector<Entry*> entries;
+  entries.reserve(accesses.size());
+  uint64_t max_length = 0;
+  size_t unresolved_count = 0;
+  for (const Access& access : accesses) {
+    // Traces recorded by the emulator contain absolute guest paths, with the
+    // mount path of the device, which is not known here.
+    std::string_view path = access.path;
+    Entry* entry = device_->ResolvePath(path);
+    while (!entry && !path.empty() && path.front() == '\\') {
+      size_t separator = path.find('\\', 1);
+      path = separator != std::string_view::npos ? path.substr(separator)
+                                                 : std::string_view();
+      entry = path.empty() ? nullptr : device_->ResolvePath(path);
+    }
+    if (!entry) {
+      ++unresolved_count;
+    }
+    entries.push_back(entry);
+    max_length = std::max(max_length, access.length);
+  }
+  if (unresolved_count) {
+    XELOGW("{} of {} traced reads are from files not present on the device",
+           unresolved_count, accesses.size());
+  }
+  std::vector<std::vector<uint64_t>> latencies_ns(thread_count);
+  std::vector<uint64_t> thread_bytes(thread_count, 0);
+  auto start = std::chrono::steady_clock::now();
+  RunOnThreads(thread_count, [&](uint32_t thread_index) {
+    OpenFiles open_files;
+    std::vector<uint8_t> buffer(size_t(max_length));
+    for (size_t i = thread_index; i < accesses.size(); i += thread_count) {
+      if (!entries[i]) {
+        continue;
+      }
+      File* file = open_files.Get(entries[i]);
+      if (!file) {
+        continue;
+      }
+      size_t bytes_read = 0;
+      auto read_start = std::chrono::steady_clock::now();
+      file->ReadSync(buffer.data(), size_t(accesses[i].length),
+                     size_t(accesses[i].offset), &bytes_read);
+      latencies_ns[thread_index].push_back(GetElapsedNs(read_start));
+      thread_bytes[thread_index] += bytes_read;
+    }
+  });
+  uint64_t elapsed_ns = GetElapsedNs(start);
+  uint64_t bytes = 0;
+  for (uint64_t thread_byte_count : thread_bytes) {
+    bytes += thread_byte_count;
+  }
+  return MakeResult("trace", thread_count, bytes, elapsed_ns, latencies_ns);
+}
+
+void VfsBenchmark::LogResult(const Result& result) {
+  double seconds = double(result.elapsed_ns) / 1e9;
+  double operations_per_second =
+      seconds > 0.0 ? double(result.operation_count) / seconds : 0.0;
+  if (result.bytes) {
+    XELOGI(
+        "{} ({} threads): {} reads, {:.2f} MB/s, {:.0f} IOPS, p50 {:.1f} us, "
+        "p99 {:.1f} us, max {:.1f} us",
+        result.name, result.thread_count, result.operation_count,
+        seconds > 0.0 ? double(result.bytes) / (1024.0 * 1024.0) / seconds
+                      : 0.0,
+        operations_per_second, double(result.p50_latency_ns) / 1e3,
+        double(result.p99_latency_ns) / 1e3,
+        double(result.max_latency_ns) / 1e3);
+  } else {
+    XELOGI(
+        "{}: {} operations, {:.0f} per second, p50 {:.1f} us, p99 {:.1f} us, "
+        "max {:.1f} us",
+        result.name, result.operation_count, operations_per_second,
+        double(result.p50_latency_ns) / 1e3,
+        double(result.p99_latency_ns) / 1e3,
+        double(result.max_latency_ns) / 1e3);
+  }
+}
+
+VfsBenchmark::Result VfsBenchmark::MakeResult(
+    std::string name, uint32_t thread_count, uint64_t bytes,
+    uint64_t elapsed_ns, std::vector<std::vector<uint64_t>>& latencies_ns) {
+  std::vector<uint64_t> all_latencies_ns;
+  for (std::vector<uint64_t>& thread_latencies_ns : latencies_ns) {
+    all_latencies_ns.insert(all_latencies_ns.end(),
+                            thread_latencies_ns.cbegin(),
+                            thread_latencies_ns.cend());
+  }
+  Result result = {};
+  result.name = std::move(name);
+  result.thread_count = thread_count;
+  result.operation_count = all_latencies_ns.size();
+  result.bytes = bytes;
+  result.elapsed_ns = elapsed_ns;
+  if (!all_latencies_ns.empty()) {
+    std::sort(all_latencies_ns.begin(), all_latencies_ns.end());
+    size_t last = all_latencies_ns.size() - 1;
+    result.p50_latency_ns = all_latencies_ns[last / 2];
+    result.p99_latency_ns = all_latencies_ns[last * 99 / 100];
+    result.max_latency_ns = all_latencies_ns[last];
+  }
+  return result;
+}
+
+}  // namespace vfs
+}  // namespace xe
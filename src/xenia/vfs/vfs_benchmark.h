@@ -0,0 +1,83 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_VFS_VFS_BENCHMARK_H_
+#define XENIA_VFS_VFS_BENCHMARK_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "xenia/vfs/device.h"
+#include "xenia/vfs/file_access_trace.h"
+
+namespace xe {
+namespace vfs {
+
+// Measures the throughput and the latency of reads and path resolution of a
+// mounted device with synthetic or recorded access patterns.
+class VfsBenchmark {
+ public:
+  using Access = FileAccessTraceRecord;
+
+  struct Result {
+    std::string name;
+    uint32_t thread_count;
+    uint64_t operation_count;
+    uint64_t bytes;
+    uint64_t elapsed_ns;
+    uint64_t p50_latency_ns;
+    uint64_t p99_latency_ns;
+    uint64_t max_latency_ns;
+  };
+
+  explicit VfsBenchmark(Device* device);
+
+  // Collects the files and the directories of the device.
+  bool Initialize();
+
+  size_t file_count() const { return files_.size(); }
+  uint64_t total_file_size() const { return total_file_size_; }
+
+  // Reads whole files in read_size blocks, with files distributed among the
+  // threads, until max_bytes have been read.
+  Result RunSequential(uint32_t thread_count, uint32_t read_size,
+                       uint64_t max_bytes);
+  // Reads aligned read_size blocks at random locations of random files.
+  Result RunRandom(uint32_t thread_count, uint32_t read_size,
+                   uint64_t operation_count);
+  // Resolves the path of every file and directory, and enumerates the
+  // children of every directory, the given number of times.
+  Result RunDirectoryWalk(uint32_t iterations, bool cached);
+  // Replays the reads of a trace loaded with LoadFileAccessTrace, split among
+  // the threads in order.
+  Result RunTrace(const std::vector<Access>& accesses, uint32_t thread_count);
+
+  static void LogResult(const Result& result);
+
+ private:
+  struct FileInfo {
+    Entry* entry;
+    uint64_t size;
+  };
+
+  static Result MakeResult(std::string name, uint32_t thread_count,
+                           uint64_t bytes, uint64_t elapsed_ns,
+                           std::vector<std::vector<uint64_t>>& latencies_ns);
+
+  Device* device_;
+  std::vector<FileInfo> files_;
+  std::vector<Entry*> directories_;
+  uint64_t total_file_size_ = 0;
+};
+
+}  // namespace vfs
+}  // namespace xe
+
+#endif  // XENIA_VFS_VFS_BENCHMARK_H_
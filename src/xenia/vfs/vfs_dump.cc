@@ -7,6 +7,7 @@
  ******************************************************************************
  */
 
+#include <algorithm>
 #include <queue>
 #include <string>
 #include <vector>
@@ -16,9 +17,14 @@
 #include "xenia/base/literals.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
+#include "xenia/base/utf8.h"
 
+#include "xenia/vfs/devices/disc_image_device.h"
+#include "xenia/vfs/devices/disc_zarchive_device.h"
+#include "xenia/vfs/devices/host_path_device.h"
 #include "xenia/vfs/devices/xcontent_container_device.h"
 #include "xenia/vfs/file.h"
+#include "xenia/vfs/vfs_benchmark.h"
 #include "xenia/vfs/virtual_file_system.h"
 
 namespace xe {
@@ -30,20 +36,117 @@ DEFINE_transient_path(source, "", "Specifies the file to dump from.",
 DEFINE_transient_path(dump_path, "",
                       "Specifies the directory to dump files to.", "General");
 
+DEFINE_transient_string(
+    benchmark, "",
+    "Instead of dumping, benchmark the device with the comma-separated access "
+    "patterns: sequential, random, directory, multithreaded, trace or all.",
+    "Benchmark");
+DEFINE_transient_path(benchmark_trace, "",
+                      "Access trace to replay for the trace pattern.",
+                      "Benchmark");
+DEFINE_int32(benchmark_threads, 4,
+             "Number of threads for the multithreaded and trace patterns.",
+             "Benchmark");
+DEFINE_int32(benchmark_operations, 20000,
+             "Number of reads for the random and multithreaded patterns.",
+             "Benchmark");
+DEFINE_int32(benchmark_max_mb, 1024,
+             "Maximum amount of data to read in the sequential pattern, in "
+             "MiB.",
+             "Benchmark");
+
+// Mounts any kind of source the emulator can launch from.
+static std::unique_ptr<Device> CreateDevice(
+    const std::filesystem::path& path) {
+  if (std::filesystem::is_directory(path)) {
+    return std::make_unique<HostPathDevice>("", path, true);
+  }
+  std::unique_ptr<Device> device =
+      XContentContainerDevice::CreateContentDevice("", path);
+  if (device) {
+    return device;
+  }
+  if (xe::utf8::lower_ascii(xe::path_to_utf8(path.extension())) == ".zar") {
+    return std::make_unique<DiscZarchiveDevice>("", path);
+  }
+  return std::make_unique<DiscImageDevice>("", path);
+}
+
+static int RunBenchmarks(Device* device) {
+  VfsBenchmark benchmark(device);
+  if (!benchmark.Initialize()) {
+    XELOGE("Failed to enumerate the files of the device");
+    return 1;
+  }
+  XELOGI("Benchmarking {} files, {} bytes", benchmark.file_count(),
+         benchmark.total_file_size());
+
+  std::vector<std::string_view> patterns =
+      xe::utf8::split(cvars::benchmark, ",", true);
+  auto has_pattern = [&patterns](const std::string_view name) {
+    for (const std::string_view pattern : patterns) {
+      if (pattern == name || pattern == "all") {
+        return true;
+      }
+    }
+    return false;
+  };
+  uint32_t thread_count =
+      uint32_t(std::max(cvars::benchmark_threads, int32_t(1)));
+  uint64_t operation_count =
+      uint64_t(std::max(cvars::benchmark_operations, int32_t(1)));
+
+  if (has_pattern("sequential")) {
+    VfsBenchmark::LogResult(benchmark.RunSequential(
+        1, 64 * 1024,
+        uint64_t(std::max(cvars::benchmark_max_mb, int32_t(1))) * 1024 *
+            1024));
+  }
+  if (has_pattern("random")) {
+    VfsBenchmark::LogResult(
+        benchmark.RunRandom(1, 4 * 1024, operation_count));
+  }
+  if (has_pattern("directory")) {
+    VfsBenchmark::LogResult(benchmark.RunDirectoryWalk(16, false));
+    VfsBenchmark::LogResult(benchmark.RunDirectoryWalk(16, true));
+  }
+  if (has_pattern("multithreaded")) {
+    VfsBenchmark::LogResult(
+        benchmark.RunRandom(thread_count, 4 * 1024, operation_count));
+  }
+  if (has_pattern("trace")) {
+    std::vector<VfsBenchmark::Access> accesses;
+    if (cvars::benchmark_trace.empty() ||
+        !LoadFileAccessTrace(cvars::benchmark_trace, accesses)) {
+      XELOGE("Failed to load the access trace {}",
+             xe::path_to_utf8(cvars::benchmark_trace));
+      return 1;
+    }
+    VfsBenchmark::LogResult(benchmark.RunTrace(accesses, 1));
+    VfsBenchmark::LogResult(benchmark.RunTrace(accesses, thread_count));
+  }
+  return 0;
+}
+
 int vfs_dump_main(const std::vector<std::string>& args) {
-  if (cvars::source.empty() || cvars::dump_path.empty()) {
+  if (cvars::source.empty() ||
+      (cvars::dump_path.empty() && cvars::benchmark.empty())) {
     XELOGE("Usage: {} [source] [dump_path]", xe::path_to_utf8(args[0]));
+    XELOGE("       {} [source] --benchmark=[patterns]",
+           xe::path_to_utf8(args[0]));
     return 1;
   }
 
-  std::filesystem::path base_path = cvars::dump_path;
-  std::unique_ptr<vfs::Device> device =
-      vfs::XContentContainerDevice::CreateContentDevice("", cvars::source);
+  std::unique_ptr<vfs::Device> device = CreateDevice(cvars::source);
 
-  if (!device->Initialize()) {
+  if (!device || !device->Initialize()) {
     XELOGE("Failed to initialize device");
     return 1;
   }
+  if (!cvars::benchmark.empty()) {
+    return RunBenchmarks(device.get());
+  }
+  std::filesystem::path base_path = cvars::dump_path;
   return VirtualFileSystem::ExtractContentFiles(device.get(), base_path);
 }
 
@@ -53,6 +53,13 @@ bool VirtualFileSystem::UnregisterDevice(const std::string_view path) {
   return false;
 }
 
+void VirtualFileSystem::ReclaimRetiredEntries() {
+  auto global_lock = global_critical_region_.Acquire();
+  for (auto& device : devices_) {
+    device->ReclaimRetiredEntries();
+  }
+}
+
 bool VirtualFileSystem::RegisterSymbolicLink(const std::string_view path,
                                              const std::string_view target) {
   auto global_lock = global_critical_region_.Acquire();
@@ -110,34 +117,39 @@ bool VirtualFileSystem::ResolveSymbolicLink(const std::string_view path,
 }
 
 Entry* VirtualFileSystem::ResolvePath(const std::string_view path) {
-  auto global_lock = global_critical_region_.Acquire();
-
   // Resolve relative paths
   auto normalized_path(xe::utf8::canonicalize_guest_path(path));
 
-  // Resolve symlinks.
-  std::string resolved_path;
-  if (ResolveSymbolicLink(normalized_path, resolved_path)) {
-    normalized_path = resolved_path;
-  }
+  Device* device;
+  {
+    auto global_lock = global_critical_region_.Acquire();
 
-  // Find the device.
-  auto it =
-      std::find_if(devices_.cbegin(), devices_.cend(), [&](const auto& d) {
-        return xe::utf8::starts_with(normalized_path, d->mount_path());
-      });
-  if (it == devices_.cend()) {
-    // Supress logging the error for ShaderDumpxe:\CompareBackEnds as this is
-    // not an actual problem nor something we care about.
-    if (path != "ShaderDumpxe:\\CompareBackEnds") {
-      XELOGE("ResolvePath({}) failed - device not found", path);
+    // Resolve symlinks.
+    std::string resolved_path;
+    if (ResolveSymbolicLink(normalized_path, resolved_path)) {
+      normalized_path = resolved_path;
     }
-    return nullptr;
+
+    // Find the device.
+    auto it =
+        std::find_if(devices_.cbegin(), devices_.cend(), [&](const auto& d) {
+          return xe::utf8::starts_with(normalized_path, d->mount_path());
+        });
+    if (it == devices_.cend()) {
+      // Supress logging the error for ShaderDumpxe:\CompareBackEnds as this
+      // is not an actual problem nor something we care about.
+      if (path != "ShaderDumpxe:\\CompareBackEnds") {
+        XELOGE("ResolvePath({}) failed - device not found", path);
+      }
+      return nullptr;
+    }
+    device = it->get();
   }
 
-  const auto& device = *it;
-  auto relative_path = normalized_path.substr(device->mount_path().size());
-  return device->ResolvePath(relative_path);
+  // Entries are looked up without locking.
+  auto relative_path = std::string_view(normalized_path)
+                           .substr(device->mount_path().size());
+  return device->ResolvePathCached(relative_path);
 }
 
 Entry* VirtualFileSystem::CreatePath(const std::string_view path,
@@ -154,8 +166,8 @@ Entry* VirtualFileSystem::CreatePath(const std::string_view path,
   }
   auto parent_entry = partial_entry;
   for (size_t i = 1; i < path_parts.size() - 1; ++i) {
-    partial_path = xe::utf8::join_guest_paths(partial_path, path_parts[i]);
-    auto child_entry = ResolvePath(partial_path);
+    // Continue from the parent instead of resolving the whole path again.
+    auto child_entry = parent_entry->GetChild(path_parts[i]);
     if (!child_entry) {
       child_entry =
           parent_entry->CreateEntry(path_parts[i], kFileAttributeDirectory);
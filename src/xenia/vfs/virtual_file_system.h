@@ -32,6 +32,9 @@ class VirtualFileSystem {
 
   bool RegisterDevice(std::unique_ptr<Device> device);
   bool UnregisterDevice(const std::string_view path);
+  // Releases the deleted and renamed entries of all devices, when no guest
+  // code can be accessing them anymore.
+  void ReclaimRetiredEntries();
 
   bool RegisterSymbolicLink(const std::string_view path,
                             const std::string_view target);